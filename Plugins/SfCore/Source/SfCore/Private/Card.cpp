@@ -5,8 +5,9 @@
 
 #include "CardObject.h"
 #include "FormCharacterComponent.h"
+#include "SfClassIndexManifest.h"
 
-FCard::FCard(): ClassIndex(0), OwnerConstituentInstanceId(0), bUsingPredictedTimestamp(false), LifetimeEndTimestamp(0),
+FCard::FCard(): ClassIndex(InvalidClassIndex), OwnerConstituentInstanceId(0), bUsingPredictedTimestamp(false), LifetimeEndTimestamp(0),
                 bIsNotCorrected(0),
                 bIsDisabledForDestroy(false),
                 ServerAwaitClientSyncTimeoutTimestamp(0)
@@ -26,18 +27,22 @@ FCard::FCard(const TSubclassOf<UCardObject>& InCardClass, const ECardType InCard
 	//Get the deterministic index of the class.
 	if (Class.Get())
 	{
-		for (uint16 i = 0; i < UFormCoreComponent::GetAllCardObjectClassesSortedByName().Num(); i++)
+		const int32 FoundClassIndex = USfClassIndexManifest::GetCardObjectClassIndex().FindIndex(Class.Get());
+		if (FoundClassIndex == INDEX_NONE || FoundClassIndex >= InvalidClassIndex)
 		{
-			if (UFormCoreComponent::GetAllCardObjectClassesSortedByName()[i] == Class.Get())
-			{
-				ClassIndex = i;
-				break;
-			}
+			UE_LOG(LogSfCore, Error, TEXT("CardObject class %s is not in the SfClassIndexManifest."),
+			       *Class.Get()->GetName());
+			ClassIndex = InvalidClassIndex;
+		}
+		else
+		{
+			ClassIndex = FoundClassIndex;
 		}
 	}
 	else
 	{
 		UE_LOG(LogSfCore, Error, TEXT("FCard has no CardObject."));
+		ClassIndex = InvalidClassIndex;
 	}
 
 	switch (InCardType)
@@ -120,6 +125,24 @@ FNetCardIdentifier FCard::GetNetCardIdentifier() const
 	return FNetCardIdentifier(ClassIndex, OwnerConstituentInstanceId);
 }
 
+bool FCard::IsClassIndexed(const TSubclassOf<UCardObject>& InCardClass)
+{
+	if (!InCardClass.Get())
+	{
+		UE_LOG(LogSfCore, Error, TEXT("FCard has no CardObject."));
+		return false;
+	}
+	const int32 FoundClassIndex = USfClassIndexManifest::GetCardObjectClassIndex().FindIndex(InCardClass.Get());
+	if (FoundClassIndex == INDEX_NONE || FoundClassIndex >= InvalidClassIndex)
+	{
+		UE_LOG(LogSfCore, Error,
+		       TEXT("CardObject class %s is not in the SfClassIndexManifest and can't be added as a card."),
+		       *InCardClass.Get()->GetName());
+		return false;
+	}
+	return true;
+}
+
 bool FCard::operator==(const FCard& Other) const
 {
 	return Class == Other.Class && OwnerConstituentInstanceId == Other.OwnerConstituentInstanceId &&
@@ -145,7 +168,12 @@ bool FCard::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
 	}
 	if (Ar.IsLoading())
 	{
-		Class = UFormCoreComponent::GetAllCardObjectClassesSortedByName()[ClassIndex];
+		//InvalidClassIndex is never in range so unknown classes are rejected here.
+		Class = USfClassIndexManifest::GetCardObjectClassIndex().GetClass(ClassIndex);
+		if (!Class.Get())
+		{
+			bOutSuccess = false;
+		}
 	}
 	Ar << OwnerConstituentInstanceId;
 	Ar.SerializeBits(&bIsDisabledForDestroy, 1);
@@ -9,11 +9,12 @@
 #include "Inventory.h"
 #include "Slotable.h"
 #include "FormQueryComponent.h"
+#include "SfParamSerializer.h"
 #include "Net/UnrealNetwork.h"
 #include "Net/Core/PushModel/PushModel.h"
 
 FActionSet::FActionSet(): NumActionsMinusOne(0), ActionZero(0), ActionOne(0), ActionTwo(0), ActionThree(0),
-                          WorldTime(0)
+                          ParamNumBits{}, WorldTime(0), Hash(0)
 {
 }
 
@@ -23,7 +24,9 @@ FActionSet::FActionSet(const float InCurrentWorldTime, const uint8 InActionZero,
                                                                             ActionOne(InActionOne),
                                                                             ActionTwo(InActionTwo),
                                                                             ActionThree(InActionThree),
-                                                                            WorldTime(InCurrentWorldTime)
+                                                                            ParamNumBits{},
+                                                                            WorldTime(InCurrentWorldTime),
+                                                                            Hash(0)
 {
 	if (InActionZero == 0)
 	{
@@ -53,49 +56,18 @@ FActionSet::FActionSet(const float InCurrentWorldTime, const uint8 InActionZero,
 		}
 		UConstituent::IsIdWithinRange(InActionThree);
 	}
+	UpdateHash();
 }
 
 FActionSet::FActionSet(const float InCurrentWorldTime, const uint8 InActionZero, const FBitWriter& InActionZeroParams,
 	const uint8 InActionOne, const FBitWriter& InActionOneParams, const uint8 InActionTwo, const FBitWriter& InActionTwoParams,
-	const uint8 InActionThree, const FBitWriter& InActionThreeParams): NumActionsMinusOne(0),
-																			ActionZero(InActionZero),
-																			ActionOne(InActionOne),
-																			ActionTwo(InActionTwo),
-																			ActionThree(InActionThree),
-																			WorldTime(InCurrentWorldTime)
+	const uint8 InActionThree, const FBitWriter& InActionThreeParams): FActionSet(InCurrentWorldTime, InActionZero,
+		InActionOne, InActionTwo, InActionThree)
 {
-	if (InActionZero == 0)
-	{
-		UE_LOG(LogSfCore, Error, TEXT("Created ActionSet with no action zero."));
-	}
-	UConstituent::IsIdWithinRange(InActionZero);
-	if (InActionOne != 0)
-	{
-		NumActionsMinusOne = 1;
-		UConstituent::IsIdWithinRange(InActionOne);
-	}
-	if (InActionTwo != 0)
-	{
-		NumActionsMinusOne = 2;
-		if (InActionOne == 0)
-		{
-			UE_LOG(LogSfCore, Error, TEXT("Created ActionSet with action two but no action one."));
-		}
-		UConstituent::IsIdWithinRange(InActionTwo);
-	}
-	if (InActionThree != 0)
-	{
-		NumActionsMinusOne = 3;
-		if (InActionTwo == 0)
-		{
-			UE_LOG(LogSfCore, Error, TEXT("Created ActionSet with action three but no action two."));
-		}
-		UConstituent::IsIdWithinRange(InActionThree);
-	}
-	ActionZeroParams = BitWriterToBitArray(InActionZeroParams);
-	ActionOneParams = BitWriterToBitArray(InActionOneParams);
-	ActionTwoParams = BitWriterToBitArray(InActionTwoParams);
-	ActionThreeParams = BitWriterToBitArray(InActionThreeParams);
+	AppendParams(0, InActionZeroParams.GetData(), InActionZeroParams.GetNumBits());
+	AppendParams(1, InActionOneParams.GetData(), InActionOneParams.GetNumBits());
+	AppendParams(2, InActionTwoParams.GetData(), InActionTwoParams.GetNumBits());
+	AppendParams(3, InActionThreeParams.GetData(), InActionThreeParams.GetNumBits());
 }
 
 bool FActionSet::TryAddActionCheckIfSameFrame(const float InCurrentWorldTime, const uint8 InAction, const FBitWriter& InParams = FBitWriter())
@@ -105,35 +77,29 @@ bool FActionSet::TryAddActionCheckIfSameFrame(const float InCurrentWorldTime, co
 	if (NumActionsMinusOne == 0)
 	{
 		ActionOne = InAction;
-		ActionOneParams = BitWriterToBitArray(InParams);
-		NumActionsMinusOne++;
 	}
 	else if (NumActionsMinusOne == 1)
 	{
 		ActionTwo = InAction;
-		ActionTwoParams = BitWriterToBitArray(InParams);
-		NumActionsMinusOne++;
 	}
 	else if (NumActionsMinusOne == 2)
 	{
 		ActionThree = InAction;
-		ActionThreeParams = BitWriterToBitArray(InParams);
-		NumActionsMinusOne++;
 	}
 	else
 	{
 		UE_LOG(LogSfCore, Error, TEXT("Action dropped because too many actions were executed in one frame."))
+		return true;
 	}
+	NumActionsMinusOne++;
+	AppendParams(NumActionsMinusOne, InParams.GetData(), InParams.GetNumBits());
+	UpdateHash();
 	return true;
 }
 
 bool FActionSet::operator==(const FActionSet& Other) const
 {
-	if (NumActionsMinusOne == Other.NumActionsMinusOne &&
-		ActionZero == Other.ActionZero && ActionOne == Other.ActionOne && ActionTwo == Other.ActionTwo && ActionThree ==
-		Other.ActionThree)
-		return true;
-	return false;
+	return Hash == Other.Hash;
 }
 
 bool FActionSet::operator!=(const FActionSet& Other) const
@@ -141,23 +107,109 @@ bool FActionSet::operator!=(const FActionSet& Other) const
 	return !(*this == Other);
 }
 
+uint8 FActionSet::GetAction(const int32 InIndex) const
+{
+	switch (InIndex)
+	{
+	case 0: return ActionZero;
+	case 1: return ActionOne;
+	case 2: return ActionTwo;
+	case 3: return ActionThree;
+	default: return 0;
+	}
+}
+
+TBitArray<> FActionSet::GetParams(const int32 InIndex) const
+{
+	TBitArray<> Params;
+	if (InIndex < 0 || InIndex > 3 || ParamNumBits[InIndex] == 0) return Params;
+	Params.Init(false, ParamNumBits[InIndex]);
+	FMemory::Memcpy(Params.GetData(), ParamBytes.GetData() + GetParamByteOffset(InIndex),
+	                FMath::DivideAndRoundUp<int32>(ParamNumBits[InIndex], 8));
+	return Params;
+}
+
 TMap<uint8, TBitArray<>> FActionSet::ToMap() const
 {
 	TMap<uint8, TBitArray<>> Map;
-	Map.Add(ActionZero, ActionZeroParams);
-	if (NumActionsMinusOne > 0)
+	for (int32 i = 0; i <= NumActionsMinusOne; i++)
 	{
-		Map.Add(ActionOne, ActionOneParams);
+		Map.Add(GetAction(i), GetParams(i));
 	}
-	if (NumActionsMinusOne > 1)
+	return Map;
+}
+
+void FActionSet::UpdateHash()
+{
+	Hash = (NumActionsMinusOne & 3) | (ActionZero & 63) << 2 | (ActionOne & 63) << 8 | (ActionTwo & 63) << 14
+		| (ActionThree & 63) << 20;
+}
+
+int32 FActionSet::GetParamByteOffset(const int32 InIndex) const
+{
+	int32 Offset = 0;
+	for (int32 i = 0; i < InIndex; i++)
 	{
-		Map.Add(ActionTwo, ActionTwoParams);
+		Offset += FMath::DivideAndRoundUp<int32>(ParamNumBits[i], 8);
 	}
-	if (NumActionsMinusOne > 2)
+	return Offset;
+}
+
+void FActionSet::AppendParams(const int32 InIndex, const uint8* InData, const int64 InNumBits)
+{
+	if (InNumBits <= 0) return;
+	if (InNumBits > MAX_uint16)
 	{
-		Map.Add(ActionThree, ActionThreeParams);
+		UE_LOG(LogSfCore, Error, TEXT("Action params are limited to %d bits. Params dropped."), MAX_uint16);
+		return;
+	}
+	ParamNumBits[InIndex] = InNumBits;
+	//Params of later actions would have to be moved, which doesn't happen as params are appended in order.
+	ParamBytes.SetNumUninitialized(GetParamByteOffset(InIndex));
+	ParamBytes.Append(InData, FMath::DivideAndRoundUp<int32>(InNumBits, 8));
+}
+
+void FActionSet::Serialize(FArchive& Ar)
+{
+	Ar.SerializeBits(&NumActionsMinusOne, 2);
+
+	bool bSendParams = ParamBytes.Num() > 0;
+	Ar.SerializeBits(&bSendParams, 1);
+
+	if (Ar.IsLoading())
+	{
+		ActionOne = 0;
+		ActionTwo = 0;
+		ActionThree = 0;
+		FMemory::Memzero(ParamNumBits);
+		ParamBytes.Reset();
+	}
+
+	//Default action followed by up to three overflow actions.
+	for (int32 i = 0; i <= NumActionsMinusOne; i++)
+	{
+		uint8& Action = i == 0 ? ActionZero : i == 1 ? ActionOne : i == 2 ? ActionTwo : ActionThree;
+		Ar.SerializeBits(&Action, 6);
+		if (!bSendParams) continue;
+		uint32 NumBits = ParamNumBits[i];
+		Ar.SerializeIntPacked(NumBits);
+		if (Ar.IsLoading())
+		{
+			if (NumBits > MAX_uint16)
+			{
+				Ar.SetError();
+				break;
+			}
+			ParamNumBits[i] = NumBits;
+			ParamBytes.AddZeroed(FMath::DivideAndRoundUp<int32>(NumBits, 8));
+		}
+		Ar.SerializeBits(ParamBytes.GetData() + GetParamByteOffset(i), NumBits);
+	}
+
+	if (Ar.IsLoading())
+	{
+		UpdateHash();
 	}
-	return Map;
 }
 
 bool FActionSet::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
@@ -166,6 +218,19 @@ bool FActionSet::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
 	return true;
 }
 
+bool FSfReplicatedActionState::operator==(const FSfReplicatedActionState& Other) const
+{
+	return ServerTimestamp == Other.ServerTimestamp && ActionSet == Other.ActionSet;
+}
+
+bool FSfReplicatedActionState::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	Ar << ServerTimestamp;
+	Ar << ActionSet;
+	bOutSuccess = !Ar.IsError();
+	return true;
+}
+
 FBufferedInput::FBufferedInput(): LifetimePredictedTimestamp(0)
 {
 }
@@ -199,16 +264,11 @@ bool FBufferedInput::operator==(const FBufferedInput& Other) const
 bool FBufferedInput::CheckConditionsMet(const UConstituent* InCurrentConstituent) const
 {
 	UInventory* InventoryToCheck = InCurrentConstituent->OwningSlotable->OwningInventory;
-	//This might look like a heavy check every time an input is pressed and when cards are added and removed. However,
-	//note that most of the time only 1 for loop will run as it's likely that only 1 type of card will be checked.
+	//Cards are indexed by class and owner in the inventory so these are cheap lookups.
 	for (const TSubclassOf<UCardObject>& OwnedCardRequired : OwnedCardsRequired)
 	{
 		if (!OwnedCardRequired.Get()) continue;
-		if (!InventoryToCheck->Cards.FindByPredicate([OwnedCardRequired, InCurrentConstituent](const FCard& Card)
-		{
-			return Card.OwnerConstituentInstanceId == InCurrentConstituent->InstanceId && Card.Class ==
-				OwnedCardRequired;
-		}))
+		if (InventoryToCheck->FindCardIndex(OwnedCardRequired, InCurrentConstituent->InstanceId) == INDEX_NONE)
 		{
 			return false;
 		}
@@ -216,11 +276,7 @@ bool FBufferedInput::CheckConditionsMet(const UConstituent* InCurrentConstituent
 	for (const TSubclassOf<UCardObject>& OwnedCardRequiredGone : OwnedCardsRequiredGone)
 	{
 		if (!OwnedCardRequiredGone.Get()) continue;
-		if (InventoryToCheck->Cards.FindByPredicate([OwnedCardRequiredGone, InCurrentConstituent](const FCard& Card)
-		{
-			return Card.OwnerConstituentInstanceId == InCurrentConstituent->InstanceId && Card.Class ==
-				OwnedCardRequiredGone;
-		}))
+		if (InventoryToCheck->FindCardIndex(OwnedCardRequiredGone, InCurrentConstituent->InstanceId) != INDEX_NONE)
 		{
 			return false;
 		}
@@ -228,10 +284,7 @@ bool FBufferedInput::CheckConditionsMet(const UConstituent* InCurrentConstituent
 	for (const TSubclassOf<UCardObject>& SharedCardRequired : SharedCardsRequired)
 	{
 		if (!SharedCardRequired.Get()) continue;
-		if (!InventoryToCheck->Cards.FindByPredicate([SharedCardRequired](const FCard& Card)
-		{
-			return Card.OwnerConstituentInstanceId == 0 && Card.Class == SharedCardRequired;
-		}))
+		if (InventoryToCheck->FindCardIndex(SharedCardRequired, 0) == INDEX_NONE)
 		{
 			return false;
 		}
@@ -239,10 +292,7 @@ bool FBufferedInput::CheckConditionsMet(const UConstituent* InCurrentConstituent
 	for (const TSubclassOf<UCardObject>& SharedCardRequiredGone : SharedCardsRequiredGone)
 	{
 		if (!SharedCardRequiredGone.Get()) continue;
-		if (InventoryToCheck->Cards.FindByPredicate([SharedCardRequiredGone](const FCard& Card)
-		{
-			return Card.OwnerConstituentInstanceId == 0 && Card.Class == SharedCardRequiredGone;
-		}))
+		if (InventoryToCheck->FindCardIndex(SharedCardRequiredGone, 0) != INDEX_NONE)
 		{
 			return false;
 		}
@@ -271,6 +321,10 @@ void UConstituent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLife
 	DOREPLIFETIME_WITH_PARAMS_FAST(UConstituent, OriginatingConstituent, DefaultParams);
 	DOREPLIFETIME_WITH_PARAMS_FAST(UConstituent, InstanceId, DefaultParams);
 	DOREPLIFETIME_WITH_PARAMS_FAST(UConstituent, FormCore, DefaultParams);
+	FDoRepLifetimeParams SimulatedOnlyParams;
+	SimulatedOnlyParams.bIsPushBased = true;
+	SimulatedOnlyParams.Condition = COND_SimulatedOnly;
+	DOREPLIFETIME_WITH_PARAMS_FAST(UConstituent, ReplicatedActionState, SimulatedOnlyParams);
 }
 
 void UConstituent::SetFormCore()
@@ -396,8 +450,8 @@ void UConstituent::InternalExecuteAction(const uint8 InActionId, const bool bInI
 			InternalServerOnExecute(InActionId, BitWriterToBitArray(SerializedParams));
 		}
 		LastActionSetTimestamp = GetWorld()->GetGameState()->GetServerWorldTimeSeconds();
-		//Flag so FormCoreComponent can call NetMulticastClientPerformActionSet on the LastActionSet.
-		bLastActionSetPendingClientExecution = true;
+		//FormCoreComponent sends the LastActionSet to clients at the end of the frame.
+		FormCore->QueueActionSetForClients(this);
 	}
 	else if (bEnableInputsAndPrediction && FormCharacter && bInIsPredictableContext && GetOwner()->
 		GetLocalRole() ==
@@ -422,100 +476,7 @@ void UConstituent::SerializeGenericStruct(FProperty* Property, void* StructPtr,
 {
 	if (const FStructProperty* StructProperty = CastField<FStructProperty>(Property))
 	{
-		// Walk the structs' properties.
-		for (TFieldIterator<FProperty> PropertyIt(StructProperty->Struct); PropertyIt; ++PropertyIt)
-		{
-			for (int32 ArrayIndex = 0; ArrayIndex < PropertyIt->ArrayDim; ArrayIndex++)
-			{
-				void* ValuePtr = PropertyIt->ContainerPtrToValuePtr<void>(StructPtr, ArrayIndex);
-				SerializeProperty(*PropertyIt, ValuePtr, Ar);
-				if (Ar.IsError())
-				{
-					UE_LOG(LogSfCore, Error, TEXT("Error serializing property in generic struct."));
-				}
-			}
-		}
-	}
-}
-
-void UConstituent::SerializeProperty(FProperty* Property, void* ValuePtr, FArchive& Ar)
-{
-	const bool bIsSaving = Ar.IsSaving();
-	
-	if (const FNumericProperty* NumericProperty = CastField<FNumericProperty>(Property))
-	{
-		if (NumericProperty->IsFloatingPoint())
-		{
-			float FloatValue = bIsSaving ? NumericProperty->GetFloatingPointPropertyValue(ValuePtr) : 0;
-			Ar << FloatValue;
-			if (!bIsSaving)
-			{
-				NumericProperty->SetFloatingPointPropertyValue(ValuePtr, FloatValue);
-			}
-		}
-		else if (NumericProperty->IsInteger())
-		{
-			int64 IntValue = bIsSaving ? NumericProperty->GetSignedIntPropertyValue(ValuePtr) : 0;
-			Ar << IntValue;
-			if (!bIsSaving)
-			{
-				NumericProperty->SetIntPropertyValue(ValuePtr, IntValue);
-			}
-		}
-	}
-	
-	else if (const FBoolProperty* BoolProperty = CastField<FBoolProperty>(Property))
-	{
-		bool bBoolValue = bIsSaving ? BoolProperty->GetPropertyValue(ValuePtr) : false;
-		Ar.SerializeBits(&bBoolValue, 1);
-		if (!bIsSaving)
-		{
-			BoolProperty->SetPropertyValue(ValuePtr, bBoolValue);
-		}
-	}
-	
-	else if (const FNameProperty* NameProperty = CastField<FNameProperty>(Property))
-	{
-		FName NameValue = bIsSaving ? NameProperty->GetPropertyValue(ValuePtr) : FName();
-		Ar << NameValue;
-		if (!bIsSaving)
-		{
-			NameProperty->SetPropertyValue(ValuePtr, NameValue);
-		}
-	}
-	
-	else if (const FStrProperty* StringProperty = CastField<FStrProperty>(Property))
-	{
-		FString StringValue = bIsSaving ? StringProperty->GetPropertyValue(ValuePtr) : FString();
-		Ar << StringValue;
-		if (!bIsSaving)
-		{
-			StringProperty->SetPropertyValue(ValuePtr, StringValue);
-		}
-	}
-	
-	else if (const FTextProperty* TextProperty = CastField<FTextProperty>(Property))
-	{
-		FText TextValue = bIsSaving ? TextProperty->GetPropertyValue(ValuePtr) : FText();
-		Ar << TextValue;
-		if (!bIsSaving)
-		{
-			TextProperty->SetPropertyValue(ValuePtr, TextValue);
-		}
-	}
-	
-	else if (const FArrayProperty* ArrayProperty = CastField<FArrayProperty>(Property))
-	{
-		FScriptArrayHelper Helper(ArrayProperty, ValuePtr);
-		for (int32 i = 0, n = Helper.Num(); i < n; ++i)
-		{
-			SerializeProperty(ArrayProperty->Inner, Helper.GetRawPtr(i), Ar);
-		}
-	}
-	
-	else if (Property)
-	{
-		SerializeGenericStruct(Property, ValuePtr, Ar);
+		FSfParamSerializer::SerializeStruct(StructProperty->Struct, StructPtr, Ar);
 	}
 }
 
@@ -577,6 +538,20 @@ int32 UConstituent::GetInstanceId() const
 	return InstanceId;
 }
 
+void UConstituent::OnRep_ReplicatedActionState()
+{
+	//Effects are fast forwarded with the time since the action set was sent.
+	ClientPerformActionSet(ReplicatedActionState.ActionSet, ReplicatedActionState.ServerTimestamp);
+}
+
+void UConstituent::OnRep_InstanceId()
+{
+	if (FormCore)
+	{
+		FormCore->MarkConstituentTableDirty();
+	}
+}
+
 UConstituent* UConstituent::GetTrueOriginatingConstituent() const
 {
 	//We search down the constituent origin chain and return the last constituent.
@@ -598,13 +573,15 @@ UConstituent* UConstituent::GetOriginatingConstituent() const
 	return OriginatingConstituent;
 }
 
-void UConstituent::NetMulticastClientPerformActionSet_Implementation(const FActionSet& InActionSet,
-                                                                     const float InServerTimestamp)
+bool UConstituent::ClientPerformActionSet(const FActionSet& InActionSet, const float InServerTimestamp)
 {
-	if (HasAuthority()) return;
+	//The multicast is unreliable and may arrive after the replicated action state, or after a later multicast, so
+	//action sets that were already performed or are older are dropped.
+	if (InServerTimestamp <= LastActionSetTimestamp) return false;
 	LastActionSet = InActionSet;
 	LastActionSetTimestamp = InServerTimestamp;
 	InternalClientPerformActionSet();
+	return true;
 }
 
 void UConstituent::InternalClientPerformActionSet()
@@ -632,21 +609,23 @@ void UConstituent::InternalClientPerformActionSet()
 	}
 	if (GetOwner()->GetLocalRole() == ROLE_AutonomousProxy)
 	{
-		for (const TPair<uint8, TBitArray<>>& Pair : LastActionSet.ToMap())
+		for (int32 i = 0; i <= LastActionSet.NumActionsMinusOne; i++)
 		{
 			if (Autonomous_OnExecute.IsBound())
 			{
-				InternalAutonomousOnExecute(Pair.Key, TimeSinceExecution, FormCore->IsFirstPerson(), Pair.Value);
+				InternalAutonomousOnExecute(LastActionSet.GetAction(i), TimeSinceExecution, FormCore->IsFirstPerson(),
+				                            LastActionSet.GetParams(i));
 			}
 		}
 	}
 	if (GetOwner()->GetLocalRole() == ROLE_SimulatedProxy)
 	{
-		for (const TPair<uint8, TBitArray<>>& Pair : LastActionSet.ToMap())
+		for (int32 i = 0; i <= LastActionSet.NumActionsMinusOne; i++)
 		{
 			if (Simulated_OnExecute.IsBound())
 			{
-				InternalSimulatedOnExecute(Pair.Key, TimeSinceExecution, FormCore->IsFirstPerson(), Pair.Value);
+				InternalSimulatedOnExecute(LastActionSet.GetAction(i), TimeSinceExecution, FormCore->IsFirstPerson(),
+				                           LastActionSet.GetParams(i));
 			}
 		}
 	}
@@ -657,18 +636,6 @@ void UConstituent::IncrementTimeSincePredictedLastActionSet(const float InTimePa
 	TimeSincePredictedLastActionSet.SetFloat(TimeSincePredictedLastActionSet.GetFloat() + InTimePassed);
 }
 
-void UConstituent::PerformLastActionSetOnClients()
-{
-	if (!HasAuthority())
-	{
-		UE_LOG(LogSfCore, Error,
-		       TEXT("UConstituent of class %s tried to call PerformLastActionSetsOnClients without authority."),
-		       *GetClass()->GetName());
-		return;
-	}
-	NetMulticastClientPerformActionSet(LastActionSet, GetWorld()->GetGameState()->GetServerWorldTimeSeconds());
-}
-
 USfQuery* UConstituent::GetQuery(const TSubclassOf<USfQuery> QueryClass) const
 {
 	if (!FormCore) return nullptr;
@@ -794,7 +761,7 @@ TBitArray<> BitWriterToBitArray(const FBitWriter& Source)
 {
 	TBitArray<> BitArray;
 	BitArray.SetNumUninitialized(Source.GetNumBits());
-	FMemory::Memcpy(&BitArray, Source.GetData(), Source.GetNumBytes());
+	FMemory::Memcpy(BitArray.GetData(), Source.GetData(), Source.GetNumBytes());
 	return BitArray;
 }
 
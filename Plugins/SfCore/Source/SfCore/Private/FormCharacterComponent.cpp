@@ -8,9 +8,12 @@
 #include "Slotable.h"
 #include "EnhancedInputComponent.h"
 #include "FormStatComponent.h"
+#include "SfCurveTable.h"
 #include "SfGameState.h"
 #include "GameFramework/Character.h"
 
+DECLARE_CYCLE_STAT(TEXT("Sf Apply Velocity Curves"), STAT_SfApplyVelocityCurves, STATGROUP_Game);
+
 FInventoryCards::FInventoryCards()
 {
 }
@@ -79,6 +82,102 @@ bool FCardIdentifiersInAnInventory::operator==(const FCardIdentifiersInAnInvento
 	return Other.CardIdentifiers == CardIdentifiers;
 }
 
+uint32 FCardIdentifiersInAnInventory::CalculateDigest() const
+{
+	uint32 Digest = 0;
+	for (const FNetCardIdentifier& CardIdentifier : CardIdentifiers)
+	{
+		Digest += GetTypeHash(CardIdentifier);
+	}
+	return Digest;
+}
+
+void FCardIdentifiersInAnInventory::CountDelta(const FCardIdentifiersInAnInventory& Baseline, uint32& OutNumRemoved,
+                                               uint32& OutNumAdded) const
+{
+	int32 NumKept = 0;
+	for (const FNetCardIdentifier& CardIdentifier : Baseline.CardIdentifiers)
+	{
+		if (NumKept < CardIdentifiers.Num() && CardIdentifiers[NumKept] == CardIdentifier)
+		{
+			NumKept++;
+		}
+	}
+	OutNumRemoved = Baseline.CardIdentifiers.Num() - NumKept;
+	OutNumAdded = CardIdentifiers.Num() - NumKept;
+}
+
+void FCardIdentifiersInAnInventory::WriteDelta(FArchive& Ar, const FCardIdentifiersInAnInventory& Baseline) const
+{
+	uint32 NumRemoved;
+	uint32 NumAdded;
+	CountDelta(Baseline, NumRemoved, NumAdded);
+	Ar.SerializeIntPacked(NumRemoved);
+	//Removed cards are sent as the distance from the previous removed card.
+	int32 NumKept = 0;
+	uint32 NextIndex = 0;
+	for (int32 i = 0; i < Baseline.CardIdentifiers.Num(); i++)
+	{
+		if (NumKept < CardIdentifiers.Num() && CardIdentifiers[NumKept] == Baseline.CardIdentifiers[i])
+		{
+			NumKept++;
+			continue;
+		}
+		uint32 Gap = i - NextIndex;
+		Ar.SerializeIntPacked(Gap);
+		NextIndex = i + 1;
+	}
+	Ar.SerializeIntPacked(NumAdded);
+	for (int32 i = NumKept; i < CardIdentifiers.Num(); i++)
+	{
+		FNetCardIdentifier CardIdentifier = CardIdentifiers[i];
+		Ar << CardIdentifier;
+	}
+}
+
+void FCardIdentifiersInAnInventory::ReadDelta(FArchive& Ar, const FCardIdentifiersInAnInventory* Baseline)
+{
+	CardIdentifiers.Reset();
+	uint32 NumRemoved = 0;
+	Ar.SerializeIntPacked(NumRemoved);
+	uint32 NextIndex = 0;
+	for (uint32 i = 0; i < NumRemoved && !Ar.IsError(); i++)
+	{
+		uint32 Gap = 0;
+		Ar.SerializeIntPacked(Gap);
+		const uint32 RemovedIndex = NextIndex + Gap;
+		if (Baseline)
+		{
+			if (RemovedIndex < NextIndex || RemovedIndex >= static_cast<uint32>(Baseline->CardIdentifiers.Num()))
+			{
+				Ar.SetError();
+				return;
+			}
+			//Keep the cards up to the removed one.
+			for (uint32 j = NextIndex; j < RemovedIndex; j++)
+			{
+				CardIdentifiers.Add(Baseline->CardIdentifiers[j]);
+			}
+		}
+		NextIndex = RemovedIndex + 1;
+	}
+	if (Baseline)
+	{
+		for (int32 j = NextIndex; j < Baseline->CardIdentifiers.Num(); j++)
+		{
+			CardIdentifiers.Add(Baseline->CardIdentifiers[j]);
+		}
+	}
+	uint32 NumAdded = 0;
+	Ar.SerializeIntPacked(NumAdded);
+	for (uint32 i = 0; i < NumAdded && !Ar.IsError(); i++)
+	{
+		FNetCardIdentifier CardIdentifier;
+		Ar << CardIdentifier;
+		CardIdentifiers.Add(CardIdentifier);
+	}
+}
+
 bool FCardIdentifiersInAnInventory::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
 {
 	Ar << CardIdentifiers;
@@ -155,6 +254,18 @@ bool FTimestampedMovementCurve::NetSerialize(FArchive& Ar, UPackageMap* Map, boo
 	return bOutSuccess;
 }
 
+uint32 GetTypeHash(const FTimestampedMovementCurve& MovementCurve)
+{
+	uint32 Hash = GetTypeHash(MovementCurve.StartTimestamp);
+	Hash = HashCombine(Hash, GetTypeHash(MovementCurve.EndTimestamp));
+	//The vector is hashed at the precision it is sent with.
+	Hash = HashCombine(Hash, GetTypeHash(FMath::RoundToInt64(MovementCurve.Vector.X * 100)));
+	Hash = HashCombine(Hash, GetTypeHash(FMath::RoundToInt64(MovementCurve.Vector.Y * 100)));
+	Hash = HashCombine(Hash, GetTypeHash(FMath::RoundToInt64(MovementCurve.Vector.Z * 100)));
+	Hash = HashCombine(Hash, FSfCurveTable::GetCurveHash(MovementCurve.MagnitudeCurve));
+	return HashCombine(Hash, GetTypeHash(MovementCurve.bSelfInitiated));
+}
+
 FMovementCurveKey::FMovementCurveKey(): Key(0)
 {
 }
@@ -186,11 +297,11 @@ bool FMovementCurveKey::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutS
 }
 
 FSavedMove_Sf::FSavedMove_Sf()
-	: bWantsToSprint(0), EnabledInputSets(0), PrimaryInputSet(0), SecondaryInputSet(0), TertiaryInputSet(0),
-	  PredictedNetClock(0), ServerWorldTimeOnClient(0), bDisableSelfMovement(0)
+	: bWantsToSprint(0), InputBits(0), InputBitsSerial(0),
+	  PredictedNetClockTicks(0), PredictedNetClockRemainder(0), ServerWorldTimeOnClient(0), CardIdentifiersSerial(0),
+	  CardStateDigest(0),
+	  bDisableSelfMovement(0), SfStateHash(0), bSfStateChanged(0), bMadePredictedChanges(0)
 {
-	//We force no combine as we want to send all moves as soon as possible to reduce input latency.
-	bForceNoCombine = true;
 }
 
 void FSavedMove_Sf::Clear()
@@ -199,16 +310,25 @@ void FSavedMove_Sf::Clear()
 
 	bWantsToSprint = 0;
 	LookPitch.InternalValue = 0;
-	EnabledInputSets = 0;
-	PrimaryInputSet = 0;
-	SecondaryInputSet = 0;
-	TertiaryInputSet = 0;
-	PredictedNetClock = 0;
+	InputBits = 0;
+	InputBitsSerial = 0;
+	PredictedNetClockTicks = 0;
+	PredictedNetClockRemainder = 0;
 	ServerWorldTimeOnClient = 0;
-	PendingActionSets.Empty();
-	CardIdentifiersInInventories.Empty();
-	Resources.Items.Empty();
-	VelocityCurveKeys.Empty();
+	//Saved moves are pooled so we keep the allocations.
+	PendingActionSets.Reset();
+	CardIdentifiersInInventories.Reset();
+	CardIdentifiersSerial = 0;
+	CardStateDigest = 0;
+	Resources.Items.Reset();
+	VelocityCurveKeys.Reset();
+	bDisableSelfMovement = 0;
+	TimesSinceLastAction.Reset();
+	Cards.Reset();
+	VelocityCurves.Reset();
+	SfStateHash = 0;
+	bSfStateChanged = 0;
+	bMadePredictedChanges = 0;
 }
 
 void FSavedMove_Sf::SetMoveFor(ACharacter* C, float InDeltaTime, FVector const& NewAccel,
@@ -223,19 +343,8 @@ void FSavedMove_Sf::SetMoveFor(ACharacter* C, float InDeltaTime, FVector const&
 	{
 		LookPitch.SetFloat(CharacterComponent->LookComponent->GetRelativeRotation().Pitch);
 	}
-	EnabledInputSets = CharacterComponent->EnabledInputSets;
-	if (EnabledInputSets > 0)
-	{
-		PrimaryInputSet = CharacterComponent->PrimaryInputSet;
-	}
-	if (EnabledInputSets > 1)
-	{
-		SecondaryInputSet = CharacterComponent->SecondaryInputSet;
-	}
-	if (EnabledInputSets > 2)
-	{
-		TertiaryInputSet = CharacterComponent->TertiaryInputSet;
-	}
+	InputBits = CharacterComponent->InputBits;
+	InputBitsSerial = CharacterComponent->InputBitsSerial;
 
 	//We try to use the non-averaged server world time if possible.
 	if (const ASfGameState* SfGameState = Cast<ASfGameState>(CharacterComponent->GetWorld()->GetGameState()))
@@ -262,33 +371,139 @@ void FSavedMove_Sf::PrepMoveFor(ACharacter* C)
 		CharacterComponent->LookComponent->SetRelativeRotation(FRotator(Angle, 0, 0));
 	}
 
-	if (CharacterComponent->EnabledInputSets > 0)
+	CharacterComponent->InputBits = InputBits;
+
+	CharacterComponent->ServerWorldTimeOnClient = ServerWorldTimeOnClient;
+}
+
+void FSavedMove_Sf::PostUpdate(ACharacter* C, EPostUpdateMode PostUpdateMode)
+{
+	UFormCharacterComponent* CharacterComponent = Cast<UFormCharacterComponent>(C->GetCharacterMovement());
+	const FNetworkPredictionData_Client_Character* ClientData = CharacterComponent->GetPredictionData_Client_Character();
+	//Moves that have been sent are replayed, while the pending move is replayed before it is sent.
+	const bool bWasSent = PostUpdateMode == PostUpdate_Replay && ClientData && ClientData->PendingMove.Get() != this;
+	PredictedNetClockTicks = CharacterComponent->PredictedNetClockTicks;
+	PredictedNetClockRemainder = CharacterComponent->PredictedNetClockRemainder;
+	//Card identifiers are kept as they were sent, as they are the baselines that the server knows.
+	if (!bWasSent)
+	{
+		TArrayCopyKeepAllocation(CardIdentifiersInInventories, CharacterComponent->CardIdentifiersInInventories,
+		                         &FCardIdentifiersInAnInventory::CardIdentifiers);
+		CardIdentifiersSerial = CharacterComponent->CardIdentifiersSerial;
+		CardStateDigest = CharacterComponent->CardStateDigest;
+	}
+	TArrayCopyKeepAllocation(VelocityCurveKeys, CharacterComponent->ClientSentVelocityCurveKeys);
+	bDisableSelfMovement = CharacterComponent->bDisableSelfMovement;
+	TArrayCopyKeepAllocation(VelocityCurves, CharacterComponent->ActiveVelocityCurves);
+	if (bWasSent && CharacterComponent->IsScopedReplaying())
 	{
-		CharacterComponent->PrimaryInputSet = PrimaryInputSet;
+		//Only what was re-simulated is updated, as the rest of the current state is from later moves.
+		PostUpdateScopedReplay(CharacterComponent);
 	}
-	if (CharacterComponent->EnabledInputSets > 1)
+	else
 	{
-		CharacterComponent->SecondaryInputSet = SecondaryInputSet;
+		TArrayCopyKeepAllocation(PendingActionSets, CharacterComponent->PendingActionSets);
+		TArrayCopyKeepAllocation(TimesSinceLastAction, CharacterComponent->ClientTimesSinceLastAction);
+		TArrayCopyKeepAllocation(Resources.Items, CharacterComponent->ClientSentResources.Items);
+		//The snapshot is shared between moves and only replaced when cards change.
+		Cards = CharacterComponent->ClientCardsSnapshot;
 	}
-	if (CharacterComponent->EnabledInputSets > 2)
+
+	SfStateHash = CalculateSfStateHash();
+	//Replayed moves are never combined as the state they were recorded with has been corrected.
+	bSfStateChanged = PostUpdateMode != PostUpdate_Record || SfStateHash != CharacterComponent->LastRecordedSfStateHash;
+	CharacterComponent->LastRecordedSfStateHash = SfStateHash;
+	bMadePredictedChanges = CharacterComponent->bMadePredictedChanges;
+	CharacterComponent->bMadePredictedChanges = false;
+
+	FSavedMove_Character::PostUpdate(C, PostUpdateMode);
+}
+
+void FSavedMove_Sf::PostUpdateScopedReplay(UFormCharacterComponent* CharacterComponent)
+{
+	if (CharacterComponent->bStopReplayOnConvergence)
 	{
-		CharacterComponent->TertiaryInputSet = TertiaryInputSet;
+		//Inventories that converged don't need to be updated as they are the same as what was recorded.
+		for (int32 i = 0; i < CharacterComponent->FormCore->GetInventories().Num(); i++)
+		{
+			if (!CharacterComponent->ShouldSimulateInventory(i) || !HasInventoryConverged(CharacterComponent, i)) continue;
+			CharacterComponent->ClientResumePredictedInventory(i);
+		}
 	}
 
-	CharacterComponent->ServerWorldTimeOnClient = ServerWorldTimeOnClient;
+	//Resources were offset when the correction was received.
+	const TArray<int32>& InventoryStarts = CharacterComponent->PendingActionSetInventoryStarts;
+	if (PendingActionSets.Num() != CharacterComponent->PendingActionSets.Num()
+		|| TimesSinceLastAction.Num() != CharacterComponent->ClientTimesSinceLastAction.Num()
+		|| InventoryStarts.Num() == 0 || InventoryStarts.Last() != PendingActionSets.Num())
+	{
+		TArrayCopyKeepAllocation(PendingActionSets, CharacterComponent->PendingActionSets);
+		TArrayCopyKeepAllocation(TimesSinceLastAction, CharacterComponent->ClientTimesSinceLastAction);
+	}
+	else
+	{
+		for (int32 i = 0; i < InventoryStarts.Num() - 1; i++)
+		{
+			if (!CharacterComponent->ShouldSimulateInventory(i)) continue;
+			for (int32 j = InventoryStarts[i]; j < InventoryStarts[i + 1]; j++)
+			{
+				PendingActionSets[j] = CharacterComponent->PendingActionSets[j];
+				TimesSinceLastAction[j] = CharacterComponent->ClientTimesSinceLastAction[j];
+			}
+		}
+	}
+
+	const TArray<UInventory*>& Inventories = CharacterComponent->FormCore->GetInventories();
+	if (!Cards.IsValid() || Cards->Num() != Inventories.Num())
+	{
+		Cards = CharacterComponent->ClientCardsSnapshot;
+		return;
+	}
+	TSharedPtr<TArray<FInventoryCards>> MergedCards;
+	for (int32 i = 0; i < Inventories.Num(); i++)
+	{
+		if (!CharacterComponent->ShouldSimulateInventory(i)) continue;
+		if (!MergedCards.IsValid())
+		{
+			MergedCards = MakeShared<TArray<FInventoryCards>>(*Cards);
+		}
+		(*MergedCards)[i].Cards = Inventories[i]->Cards;
+	}
+	if (MergedCards.IsValid())
+	{
+		Cards = MergedCards;
+	}
 }
 
-void FSavedMove_Sf::PostUpdate(ACharacter* C, EPostUpdateMode PostUpdateMode)
+bool FSavedMove_Sf::HasInventoryConverged(const UFormCharacterComponent* CharacterComponent,
+                                          const int32 InventoryIndex) const
 {
-	const UFormCharacterComponent* CharacterComponent = Cast<UFormCharacterComponent>(C->GetCharacterMovement());
-	PredictedNetClock = CharacterComponent->PredictedNetClock;
-	PendingActionSets = CharacterComponent->PendingActionSets;
-	CardIdentifiersInInventories = CharacterComponent->CardIdentifiersInInventories;
-	Resources = CharacterComponent->ClientSentResources;
-	VelocityCurveKeys = CharacterComponent->ClientSentVelocityCurveKeys;
-	bDisableSelfMovement = CharacterComponent->bDisableSelfMovement;
-
-	FSavedMove_Character::PostUpdate(C, PostUpdateMode);
+	const TArray<UInventory*>& Inventories = CharacterComponent->FormCore->GetInventories();
+	const TArray<int32>& InventoryStarts = CharacterComponent->PendingActionSetInventoryStarts;
+	if (!Cards.IsValid() || Cards->Num() != Inventories.Num() || !InventoryStarts.IsValidIndex(InventoryIndex + 1)
+		|| PendingActionSets.Num() != CharacterComponent->PendingActionSets.Num()
+		|| TimesSinceLastAction.Num() != CharacterComponent->ClientTimesSinceLastAction.Num())
+	{
+		return false;
+	}
+	//Buffered inputs aren't recorded, so an inventory can only be compared while it has none now and had none when
+	//the correction was received.
+	const TBitArray<>& BufferedInputInventories = CharacterComponent->ClientPredictedBufferedInputInventories;
+	if (!BufferedInputInventories.IsValidIndex(InventoryIndex) || BufferedInputInventories[InventoryIndex]
+		|| CharacterComponent->HasInventoryBufferedInputs(InventoryIndex))
+	{
+		return false;
+	}
+	if ((*Cards)[InventoryIndex].Cards != Inventories[InventoryIndex]->Cards) return false;
+	for (int32 i = InventoryStarts[InventoryIndex]; i < InventoryStarts[InventoryIndex + 1]; i++)
+	{
+		if (PendingActionSets[i] != CharacterComponent->PendingActionSets[i]
+			|| !(TimesSinceLastAction[i] == CharacterComponent->ClientTimesSinceLastAction[i]))
+		{
+			return false;
+		}
+	}
+	return true;
 }
 
 uint8 FSavedMove_Sf::GetCompressedFlags() const
@@ -302,7 +517,62 @@ uint8 FSavedMove_Sf::GetCompressedFlags() const
 
 bool FSavedMove_Sf::CanCombineWith(const FSavedMovePtr& NewMove, ACharacter* InCharacter, float MaxDelta) const
 {
-	return false;
+	const UFormCharacterComponent* CharacterComponent = Cast<UFormCharacterComponent>(
+		InCharacter->GetCharacterMovement());
+	if (!CharacterComponent || !CharacterComponent->bAllowMoveCombining) return false;
+	const FSavedMove_Sf* NewSfMove = static_cast<FSavedMove_Sf*>(NewMove.Get());
+
+	//The server simulates a combined move as one Sf tick, which is only equivalent to the two ticks on the client if
+	//nothing happened in the first. Anything that happens in the new move is sent with it.
+	if (bSfStateChanged || bMadePredictedChanges) return false;
+
+	//Inputs would be applied at a different time if they are changed.
+	if (InputBits != NewSfMove->InputBits) return false;
+
+	//Velocity curves change velocity over time, which can't be reproduced by a single longer move.
+	if (!VelocityCurveKeys.IsEmpty() || bDisableSelfMovement != CharacterComponent->bDisableSelfMovement) return false;
+
+	return Super::CanCombineWith(NewMove, InCharacter, MaxDelta);
+}
+
+void FSavedMove_Sf::CombineWith(const FSavedMove_Character* OldMove, ACharacter* InCharacter, APlayerController* PC,
+                                const FVector& OldStartLocation)
+{
+	Super::CombineWith(OldMove, InCharacter, PC, OldStartLocation);
+
+	//Movement is reverted and resimulated for the combined time, but the Sf tick of the old move has already run.
+	UFormCharacterComponent* CharacterComponent = Cast<UFormCharacterComponent>(InCharacter->GetCharacterMovement());
+	CharacterComponent->CombinedMoveSimulatedDeltaTime = OldMove->DeltaTime;
+}
+
+uint32 FSavedMove_Sf::CalculateSfStateHash() const
+{
+	//Action sets are identified by their time and actions, so params don't need to be hashed.
+	uint32 Hash = bDisableSelfMovement;
+	for (const FIdentifiedActionSet& IdentifiedActionSet : PendingActionSets)
+	{
+		const FActionSet& ActionSet = IdentifiedActionSet.ActionSet;
+		Hash = HashCombine(Hash, GetTypeHash(IdentifiedActionSet.ConstituentInstanceId));
+		Hash = HashCombine(Hash, GetTypeHash(ActionSet.WorldTime));
+		Hash = HashCombine(Hash, ActionSet.Hash);
+	}
+	for (const FCardIdentifiersInAnInventory& Inventory : CardIdentifiersInInventories)
+	{
+		Hash = HashCombine(Hash, GetTypeHash(Inventory.CardIdentifiers.Num()));
+		for (const FNetCardIdentifier& CardIdentifier : Inventory.CardIdentifiers)
+		{
+			Hash = HashCombine(Hash, CardIdentifier.ClassIndex | CardIdentifier.OwnerConstituentInstanceId << 16);
+		}
+	}
+	for (const FResource& Resource : Resources.Items)
+	{
+		Hash = HashCombine(Hash, GetTypeHash(Resource.Value));
+	}
+	for (const FMovementCurveKey& CurveKey : VelocityCurveKeys)
+	{
+		Hash = HashCombine(Hash, CurveKey.Key);
+	}
+	return Hash;
 }
 
 FNetworkPredictionData_Client_Sf::FNetworkPredictionData_Client_Sf(const UCharacterMovementComponent& ClientMovement)
@@ -316,8 +586,10 @@ FSavedMovePtr FNetworkPredictionData_Client_Sf::AllocateNewMove()
 }
 
 FSfNetworkMoveData::FSfNetworkMoveData()
-	: EnabledInputSets(0), PrimaryInputSet(0), SecondaryInputSet(0), TertiaryInputSet(0),
-	  PredictedNetClock(0), ServerWorldTimeOnClient(0), bDisableSelfMovement(0)
+	: InputBits(0), InputBitsSerial(0), InputBitsStateId(0), bInputBitsUnchanged(0), bInputBitsBaselineLost(0),
+	  PredictedNetClockTicks(0), ServerWorldTimeOnClient(0), CardIdentifiersSerial(0), CardIdentifiersStateId(0),
+	  bCardIdentifiersUnchanged(0), bCardIdentifiersBaselineLost(0), CardStateDigest(0),
+	  bCardStateDigestUnchanged(0), bHasCardIdentifiers(0), bDisableSelfMovement(0)
 {
 }
 
@@ -351,38 +623,31 @@ bool FSfNetworkMoveData::Serialize(UCharacterMovementComponent& CharacterMovemen
 	}
 
 	//We add our flags to serialization.
-	Ar.SerializeBits(&EnabledInputSets, 2);
-	if (EnabledInputSets > 0)
-	{
-		SerializeOptionalValue<uint8>(bIsSaving, Ar, PrimaryInputSet, 0);
-	}
-	if (EnabledInputSets > 1)
-	{
-		SerializeOptionalValue<uint8>(bIsSaving, Ar, SecondaryInputSet, 0);
-	}
-	if (EnabledInputSets > 2)
-	{
-		SerializeOptionalValue<uint8>(bIsSaving, Ar, TertiaryInputSet, 0);
-	}
+	SerializeInputBits(Ar, CharacterComponent);
 
 	Ar << LookPitch;
 
-	//Conditionally serialize the clock to only send every second.
-	bool bDoSerializeClock = bIsSaving && static_cast<float>(CharacterComponent->NetClockNextInteger) <
-		PredictedNetClock;
+	//Conditionally serialize the clock to only send every second. It is also sent if the clock was corrected to well
+	//before the next send.
+	const int32 TicksUntilClockSend = UFormCharacterComponent::CalculateTicksBetweenPredictedNetClocks(
+		PredictedNetClockTicks, CharacterComponent->NetClockNextSendTicks);
+	bool bDoSerializeClock = bIsSaving && (TicksUntilClockSend <= 0 || TicksUntilClockSend > static_cast<int32>(
+		UFormCharacterComponent::PredictedNetClockTicksPerSecond));
 	Ar.SerializeBits(&bDoSerializeClock, 1);
 	if (bDoSerializeClock)
 	{
-		Ar << PredictedNetClock;
+		Ar.SerializeInt(PredictedNetClockTicks, UFormCharacterComponent::PredictedNetClockTicksPerLoop);
 		if (bIsSaving)
 		{
-			CharacterComponent->NetClockNextInteger = FMath::CeilToInt(PredictedNetClock);
+			CharacterComponent->NetClockNextSendTicks = (PredictedNetClockTicks
+				+ UFormCharacterComponent::PredictedNetClockTicksPerSecond) % UFormCharacterComponent::
+				PredictedNetClockTicksPerLoop;
 		}
 	}
 	else if (!bIsSaving)
 	{
-		//Negative values mean do not check on server.
-		PredictedNetClock = -1;
+		//The server doesn't check moves without the clock.
+		PredictedNetClockTicks = UFormCharacterComponent::UnsentPredictedNetClockTicks;
 	}
 
 	//Only serialize pending action sets if actions were made that frame.
@@ -394,22 +659,28 @@ bool FSfNetworkMoveData::Serialize(UCharacterMovementComponent& CharacterMovemen
 		Ar << ServerWorldTimeOnClient;
 		Ar << PendingActionSets;
 	}
+	else if (!bIsSaving)
+	{
+		//Move data is reused so we clear the action sets from the last move.
+		PendingActionSets.Reset();
+	}
 
-	//Conditionally serialize InventoryCardIdentifiers if they have been changed.
-	bool bDoSerializeCardIdentifiers = bIsSaving && (CardIdentifiersInInventories != CharacterComponent->
-		OldCardIdentifiersInInventories || CharacterComponent->bClientForceSerialize);
-	Ar.SerializeBits(&bDoSerializeCardIdentifiers, 1);
-	if (bDoSerializeCardIdentifiers)
+	if (CharacterComponent->bVerifyCardsWithDigest)
 	{
-		Ar << CardIdentifiersInInventories;
-		//We set update OldInventoryCardIdentifiers on both the server and client.
-		//The client version is what we use to check if we have attempted to send our latest changes already.
-		//The server version is what is used if the client indicates they have no updates.
-		CharacterComponent->OldCardIdentifiersInInventories = CardIdentifiersInInventories;
+		SerializeCardStateDigest(Ar, CharacterComponent);
+		//Card identifiers are only sent when the server has asked for them after a digest mismatch.
+		bool bDoSerializeCardIdentifiers = bIsSaving && (CharacterComponent->CorrectionConditionFlags &
+			Request_CardIdentifiers) != 0;
+		Ar.SerializeBits(&bDoSerializeCardIdentifiers, 1);
+		bHasCardIdentifiers = bDoSerializeCardIdentifiers;
+		if (bDoSerializeCardIdentifiers)
+		{
+			Ar << CardIdentifiersInInventories;
+		}
 	}
-	else if (!bIsSaving)
+	else
 	{
-		CardIdentifiersInInventories = CharacterComponent->OldCardIdentifiersInInventories;
+		SerializeCardIdentifiers(Ar, CharacterComponent);
 	}
 
 	//Only if FormResource is available on the form.
@@ -425,11 +696,11 @@ bool FSfNetworkMoveData::Serialize(UCharacterMovementComponent& CharacterMovemen
 			//We set update OldClientSentResources on both the server and client.
 			//The client version is what we use to check if we have attempted to send our latest changes already.
 			//The server version is what is used if the client indicates they have no updates.
-			CharacterComponent->OldClientSentResources = Resources;
+			TArrayCopyKeepAllocation(CharacterComponent->OldClientSentResources.Items, Resources.Items);
 		}
 		else if (!bIsSaving)
 		{
-			Resources = CharacterComponent->OldClientSentResources;
+			TArrayCopyKeepAllocation(Resources.Items, CharacterComponent->OldClientSentResources.Items);
 		}
 	}
 
@@ -443,11 +714,11 @@ bool FSfNetworkMoveData::Serialize(UCharacterMovementComponent& CharacterMovemen
 		//We set update OldClientSentVelocityCurveKeys on both the server and client.
 		//The client version is what we use to check if we have attempted to send our latest changes already.
 		//The server version is what is used if the client indicates they have no updates.
-		CharacterComponent->OldClientSentVelocityCurveKeys = VelocityCurveKeys;
+		TArrayCopyKeepAllocation(CharacterComponent->OldClientSentVelocityCurveKeys, VelocityCurveKeys);
 	}
 	else if (!bIsSaving)
 	{
-		VelocityCurveKeys = CharacterComponent->OldClientSentVelocityCurveKeys;
+		TArrayCopyKeepAllocation(VelocityCurveKeys, CharacterComponent->OldClientSentVelocityCurveKeys);
 	}
 
 	Ar.SerializeBits(&bDisableSelfMovement, 1);
@@ -457,35 +728,222 @@ bool FSfNetworkMoveData::Serialize(UCharacterMovementComponent& CharacterMovemen
 	return !Ar.IsError();
 }
 
-void FSfNetworkMoveData::ClientFillNetworkMoveData(const FSavedMove_Character& ClientMove, ENetworkMoveType MoveType)
+void FSfNetworkMoveData::SerializeCardIdentifiers(FArchive& Ar, UFormCharacterComponent* CharacterComponent)
 {
-	FCharacterNetworkMoveData::ClientFillNetworkMoveData(ClientMove, MoveType);
+	const bool bIsSaving = Ar.IsSaving();
+	constexpr uint32 StateIdCount = UFormCharacterComponent::CardIdentifierStateIdCount;
+	if (bIsSaving && CharacterComponent->bClientForceSerialize)
+	{
+		//The server may not have our baseline, so we send whole states until a new one is acknowledged.
+		CharacterComponent->bHasCardIdentifiersBaseline = false;
+	}
+	const uint32 BaselineSerial = CharacterComponent->CardIdentifiersBaselineSerial;
 
-	const FSavedMove_Sf* SavedMove = static_cast<const FSavedMove_Sf*>(&ClientMove);
+	//Nothing is sent if the state is the baseline and there isn't a newer state that the server could have received.
+	bool bDoSerializeCardIdentifiers = bIsSaving && !(CharacterComponent->bHasCardIdentifiersBaseline &&
+		CardIdentifiersSerial == BaselineSerial && CharacterComponent->CardIdentifiersSerial == BaselineSerial);
+	Ar.SerializeBits(&bDoSerializeCardIdentifiers, 1);
+	bCardIdentifiersUnchanged = !bDoSerializeCardIdentifiers;
+	bCardIdentifiersBaselineLost = false;
+	if (!bDoSerializeCardIdentifiers) return;
 
-	LookPitch = SavedMove->LookPitch;
+	uint32 StateId = CardIdentifiersSerial % StateIdCount;
+	Ar.SerializeInt(StateId, StateIdCount);
+	CardIdentifiersStateId = StateId;
 
-	//Copy additional inputs.
-	EnabledInputSets = SavedMove->EnabledInputSets;
-	if (SavedMove->EnabledInputSets > 0)
+	//Ids wrap, so the baseline can't be used once the server could have received a newer state with the same id.
+	bool bIsDelta = bIsSaving && CharacterComponent->bHasCardIdentifiersBaseline &&
+		CharacterComponent->CardIdentifiersSerial - BaselineSerial < StateIdCount &&
+		CardIdentifiersInInventories.Num() == CharacterComponent->CardIdentifiersBaseline.Num();
+	Ar.SerializeBits(&bIsDelta, 1);
+	if (!bIsDelta)
+	{
+		Ar << CardIdentifiersInInventories;
+	}
+	else
+	{
+		uint32 BaselineId = BaselineSerial % StateIdCount;
+		Ar.SerializeInt(BaselineId, StateIdCount);
+		const TArray<FCardIdentifiersInAnInventory>* Baseline = bIsSaving
+			                                                        ? &CharacterComponent->CardIdentifiersBaseline
+			                                                        : CharacterComponent->GetServerCardIdentifierState(
+				                                                        BaselineId);
+		uint32 NumInventories = CardIdentifiersInInventories.Num();
+		Ar.SerializeIntPacked(NumInventories);
+		if (!bIsSaving)
+		{
+			if (NumInventories > MAX_uint8)
+			{
+				Ar.SetError();
+				return;
+			}
+			CardIdentifiersInInventories.SetNum(NumInventories, false);
+			//We still read past the deltas so the rest of the move can be used.
+			bCardIdentifiersBaselineLost = !Baseline || static_cast<uint32>(Baseline->Num()) != NumInventories;
+		}
+		for (uint32 i = 0; i < NumInventories && !Ar.IsError(); i++)
+		{
+			const FCardIdentifiersInAnInventory* InventoryBaseline = bCardIdentifiersBaselineLost
+				                                                         ? nullptr
+				                                                         : &(*Baseline)[i];
+			FCardIdentifiersInAnInventory& Inventory = CardIdentifiersInInventories[i];
+			uint32 NumRemoved = 0;
+			uint32 NumAdded = 0;
+			if (bIsSaving)
+			{
+				Inventory.CountDelta(*InventoryBaseline, NumRemoved, NumAdded);
+			}
+			bool bIsChanged = NumRemoved + NumAdded > 0;
+			Ar.SerializeBits(&bIsChanged, 1);
+			if (!bIsChanged)
+			{
+				if (!bIsSaving && InventoryBaseline)
+				{
+					TArrayCopyKeepAllocation(Inventory.CardIdentifiers, InventoryBaseline->CardIdentifiers);
+				}
+				continue;
+			}
+			//Inventories are sent whole if that's smaller.
+			bool bIsInventoryDelta = NumRemoved + NumAdded < static_cast<uint32>(Inventory.CardIdentifiers.Num());
+			Ar.SerializeBits(&bIsInventoryDelta, 1);
+			if (!bIsInventoryDelta)
+			{
+				Ar << Inventory.CardIdentifiers;
+			}
+			else if (bIsSaving)
+			{
+				Inventory.WriteDelta(Ar, *InventoryBaseline);
+			}
+			else
+			{
+				Inventory.ReadDelta(Ar, InventoryBaseline);
+			}
+		}
+	}
+
+	if (!bIsSaving && !bCardIdentifiersBaselineLost && !Ar.IsError())
+	{
+		CharacterComponent->StoreServerCardIdentifierState(StateId, CardIdentifiersInInventories);
+	}
+}
+
+void FSfNetworkMoveData::SerializeCardStateDigest(FArchive& Ar, const UFormCharacterComponent* CharacterComponent)
+{
+	//Every move after the acknowledged one with the same card identifier serial had the same digest, so the last
+	//digest the server processed is still ours.
+	bool bDoSerializeDigest = Ar.IsSaving() && (CharacterComponent->bClientForceSerialize ||
+		!CharacterComponent->bHasCardStateDigestBaseline ||
+		CardIdentifiersSerial != CharacterComponent->CardStateDigestBaselineSerial);
+	Ar.SerializeBits(&bDoSerializeDigest, 1);
+	bCardStateDigestUnchanged = !bDoSerializeDigest;
+	if (bDoSerializeDigest)
+	{
+		Ar << CardStateDigest;
+	}
+}
+
+void FSfNetworkMoveData::SerializeInputBits(FArchive& Ar, UFormCharacterComponent* CharacterComponent)
+{
+	const bool bIsSaving = Ar.IsSaving();
+	constexpr uint32 StateIdCount = UFormCharacterComponent::InputBitsStateIdCount;
+	bInputBitsUnchanged = false;
+	bInputBitsBaselineLost = false;
+	//Both sides have the same registry, so only the bits of registered inputs are sent.
+	const uint32 NumInputs = FMath::Min(CharacterComponent->InputActionRegistry.Num(),
+	                                    UFormCharacterComponent::MaxInputActions);
+	if (NumInputs == 0)
+	{
+		InputBits = 0;
+		return;
+	}
+	if (bIsSaving && CharacterComponent->bClientForceSerialize)
 	{
-		PrimaryInputSet = SavedMove->PrimaryInputSet;
+		//The server may not have our baseline, so we send whole states until a new one is acknowledged.
+		CharacterComponent->bHasInputBitsBaseline = false;
 	}
-	if (SavedMove->EnabledInputSets > 1)
+	const uint32 BaselineSerial = CharacterComponent->InputBitsBaselineSerial;
+
+	//Nothing is sent if the state is the baseline and there isn't a newer state that the server could have received.
+	bool bDoSerializeInputBits = bIsSaving && !(CharacterComponent->bHasInputBitsBaseline &&
+		InputBitsSerial == BaselineSerial && CharacterComponent->InputBitsSerial == BaselineSerial);
+	Ar.SerializeBits(&bDoSerializeInputBits, 1);
+	bInputBitsUnchanged = !bDoSerializeInputBits;
+	if (!bDoSerializeInputBits) return;
+
+	uint32 StateId = InputBitsSerial % StateIdCount;
+	Ar.SerializeInt(StateId, StateIdCount);
+	InputBitsStateId = StateId;
+
+	//Ids wrap, so the baseline can't be used once the server could have received a newer state with the same id.
+	//Deltas are the indices of the inputs that changed, and are only sent if they are smaller than all of the bits.
+	const uint64 ChangedBits = bIsSaving ? InputBits ^ CharacterComponent->InputBitsBaseline : 0;
+	uint32 NumChanged = FMath::CountBits(ChangedBits);
+	const uint32 DeltaSize = FMath::CeilLogTwo(StateIdCount) + FMath::CeilLogTwo(NumInputs + 1)
+		+ NumChanged * FMath::CeilLogTwo(NumInputs);
+	bool bIsDelta = bIsSaving && CharacterComponent->bHasInputBitsBaseline &&
+		CharacterComponent->InputBitsSerial - BaselineSerial < StateIdCount && DeltaSize < NumInputs;
+	Ar.SerializeBits(&bIsDelta, 1);
+	if (!bIsDelta)
 	{
-		SecondaryInputSet = SavedMove->SecondaryInputSet;
+		if (!bIsSaving)
+		{
+			InputBits = 0;
+		}
+		Ar.SerializeBits(&InputBits, NumInputs);
 	}
-	if (SavedMove->EnabledInputSets > 2)
+	else
 	{
-		TertiaryInputSet = SavedMove->TertiaryInputSet;
+		uint32 BaselineId = BaselineSerial % StateIdCount;
+		Ar.SerializeInt(BaselineId, StateIdCount);
+		Ar.SerializeInt(NumChanged, NumInputs + 1);
+		if (!bIsSaving)
+		{
+			const uint64* Baseline = CharacterComponent->GetServerInputBitsState(BaselineId);
+			//We still read past the changes so the rest of the move can be used.
+			bInputBitsBaselineLost = !Baseline;
+			InputBits = Baseline ? *Baseline : 0;
+		}
+		uint64 BitsToWrite = ChangedBits;
+		for (uint32 i = 0; i < NumChanged && !Ar.IsError(); i++)
+		{
+			uint32 Index = bIsSaving ? FMath::CountTrailingZeros64(BitsToWrite) : 0;
+			Ar.SerializeInt(Index, NumInputs);
+			//Clears the lowest set bit.
+			BitsToWrite &= BitsToWrite - 1;
+			if (!bIsSaving)
+			{
+				InputBits ^= 1ull << Index;
+			}
+		}
+	}
+
+	if (!bIsSaving && !bInputBitsBaselineLost && !Ar.IsError())
+	{
+		CharacterComponent->StoreServerInputBitsState(StateId, InputBits);
 	}
+}
+
+void FSfNetworkMoveData::ClientFillNetworkMoveData(const FSavedMove_Character& ClientMove, ENetworkMoveType MoveType)
+{
+	FCharacterNetworkMoveData::ClientFillNetworkMoveData(ClientMove, MoveType);
+
+	const FSavedMove_Sf* SavedMove = static_cast<const FSavedMove_Sf*>(&ClientMove);
+
+	LookPitch = SavedMove->LookPitch;
+
+	//Copy additional inputs.
+	InputBits = SavedMove->InputBits;
+	InputBitsSerial = SavedMove->InputBitsSerial;
 
 	ServerWorldTimeOnClient = SavedMove->ServerWorldTimeOnClient;
-	PredictedNetClock = SavedMove->PredictedNetClock;
-	PendingActionSets = SavedMove->PendingActionSets;
-	CardIdentifiersInInventories = SavedMove->CardIdentifiersInInventories;
-	Resources = SavedMove->Resources;
-	VelocityCurveKeys = SavedMove->VelocityCurveKeys;
+	PredictedNetClockTicks = SavedMove->PredictedNetClockTicks;
+	TArrayCopyKeepAllocation(PendingActionSets, SavedMove->PendingActionSets);
+	TArrayCopyKeepAllocation(CardIdentifiersInInventories, SavedMove->CardIdentifiersInInventories,
+	                         &FCardIdentifiersInAnInventory::CardIdentifiers);
+	CardIdentifiersSerial = SavedMove->CardIdentifiersSerial;
+	CardStateDigest = SavedMove->CardStateDigest;
+	TArrayCopyKeepAllocation(Resources.Items, SavedMove->Resources.Items);
+	TArrayCopyKeepAllocation(VelocityCurveKeys, SavedMove->VelocityCurveKeys);
 
 	bDisableSelfMovement = SavedMove->bDisableSelfMovement;
 }
@@ -497,7 +955,7 @@ FSfNetworkMoveDataContainer::FSfNetworkMoveDataContainer()
 	OldMoveData = &OldSfMove;
 }
 
-FSfMoveResponseDataContainer::FSfMoveResponseDataContainer(): PredictedNetClock(0), bDisableSelfMovement(0)
+FSfMoveResponseDataContainer::FSfMoveResponseDataContainer()
 {
 }
 
@@ -512,7 +970,7 @@ void FSfMoveResponseDataContainer::ServerFillResponseData(const UCharacterMoveme
 void FSfMoveResponseDataContainer::SerializeCardResponse(FArchive& Ar, UFormCharacterComponent* CharacterComponent,
                                                          const bool bIsSaving)
 {
-	Ar << CardResponse;
+	Ar << CharacterComponent->CardResponse;
 	if (!bIsSaving)
 	{
 		CharacterComponent->bClientCardsWereUpdated = true;
@@ -520,6 +978,64 @@ void FSfMoveResponseDataContainer::SerializeCardResponse(FArchive& Ar, UFormChar
 	}
 }
 
+bool FSfMoveResponseDataContainer::SerializeSectionNum(FArchive& Ar, int32& Num)
+{
+	uint32 PackedNum = Num;
+	Ar.SerializeIntPacked(PackedNum);
+	if (PackedNum > MAX_uint16)
+	{
+		Ar.SetError();
+		return false;
+	}
+	Num = PackedNum;
+	return !Ar.IsError();
+}
+
+template <typename SerializeElementType, typename RestoreElementType>
+bool FSfMoveResponseDataContainer::SerializeDirtyElements(FArchive& Ar, const int32 NumElements,
+                                                          TBitArray<>& DirtyMask,
+                                                          SerializeElementType&& SerializeElement,
+                                                          RestoreElementType&& RestoreElement)
+{
+	const bool bIsSaving = Ar.IsSaving();
+	if (!bIsSaving)
+	{
+		DirtyMask.Init(false, NumElements);
+	}
+	//The mask may be from a move where there were more or less elements.
+	const int32 NumMaskedElements = FMath::Min(NumElements, DirtyMask.Num());
+	bool bIsSectionDirty = false;
+	for (int32 i = 0; bIsSaving && i < NumMaskedElements && !bIsSectionDirty; i++)
+	{
+		bIsSectionDirty = DirtyMask[i];
+	}
+	Ar.SerializeBits(&bIsSectionDirty, 1);
+
+	bool bRestored = true;
+	for (int32 i = 0; i < NumElements; i++)
+	{
+		bool bIsElementDirty = bIsSaving && i < NumMaskedElements && DirtyMask[i];
+		if (bIsSectionDirty)
+		{
+			Ar.SerializeBits(&bIsElementDirty, 1);
+		}
+		if (bIsElementDirty)
+		{
+			SerializeElement(i);
+			if (!bIsSaving)
+			{
+				DirtyMask[i] = true;
+			}
+		}
+		else if (!bIsSaving && !RestoreElement(i))
+		{
+			bRestored = false;
+		}
+		if (Ar.IsError()) return false;
+	}
+	return bRestored;
+}
+
 bool FSfMoveResponseDataContainer::Serialize(UCharacterMovementComponent& CharacterMovement, FArchive& Ar,
                                              UPackageMap* PackageMap)
 {
@@ -561,17 +1077,59 @@ bool FSfMoveResponseDataContainer::Serialize(UCharacterMovementComponent& Charac
 			& (Repredict_NetClock | Repredict_Sf)) != 0;
 		if (bDoSerializeClock)
 		{
-			Ar << CharacterComponent->PredictedNetClock;
+			Ar.SerializeInt(CharacterComponent->PredictedNetClockTicks, UFormCharacterComponent::PredictedNetClockTicksPerLoop);
+			//The remainder isn't sent, so replaying continues from the one we had at the corrected move.
+			if (!bIsSaving)
+			{
+				if (const FSavedMove_Sf* ClockMove = CharacterComponent->FindSavedMoveForResponse(ClientAdjustment.TimeStamp))
+				{
+					CharacterComponent->PredictedNetClockRemainder = ClockMove->PredictedNetClockRemainder;
+				}
+			}
 		}
 		//Otherwise we leave it as is and don't increment in rollback.
 
+		//The client restores whatever isn't sent from the move that is being corrected.
+		const FSavedMove_Sf* CorrectedMove = bIsSaving
+			                                     ? nullptr
+			                                     : CharacterComponent->FindSavedMoveForResponse(ClientAdjustment.TimeStamp);
+
 		//Conditionally serialize Cards.
 		//We serialize if Update_Cards or Repredict_ActionSetsCardsResources is true.
 		bool bDoSerializeCards = (CharacterComponent->CorrectionConditionFlags
 			& (Update_Cards | Repredict_Sf)) != 0;
 		if (bDoSerializeCards)
 		{
-			SerializeCardResponse(Ar, CharacterComponent, bIsSaving);
+			TArray<FInventoryCards>& CardResponse = CharacterComponent->CardResponse;
+			if (bIsSaving && (CharacterComponent->CorrectionConditionFlags & Update_Cards) != 0)
+			{
+				//Server initiated changes aren't tracked per inventory.
+				UFormCharacterComponent::MarkResponseDirty(CharacterComponent->CardResponseDirtyMask, 0,
+				                                           CardResponse.Num());
+			}
+			int32 NumInventories = CardResponse.Num();
+			if (SerializeSectionNum(Ar, NumInventories))
+			{
+				if (!bIsSaving)
+				{
+					CardResponse.SetNum(NumInventories, false);
+				}
+				const TArray<FInventoryCards>* CorrectedCards = CorrectedMove ? CorrectedMove->Cards.Get() : nullptr;
+				const bool bRestored = SerializeDirtyElements(
+					Ar, NumInventories, CharacterComponent->CardResponseDirtyMask,
+					[&](const int32 i) { Ar << CardResponse[i]; },
+					[&](const int32 i)
+					{
+						if (!CorrectedCards || !CorrectedCards->IsValidIndex(i)) return false;
+						TArrayCopyKeepAllocation(CardResponse[i].Cards, (*CorrectedCards)[i].Cards);
+						return true;
+					});
+				if (!bIsSaving && bRestored)
+				{
+					CharacterComponent->bClientCardsWereUpdated = true;
+					CharacterComponent->bMovementSpeedNeedsRecalculation = true;
+				}
+			}
 		}
 
 		//Conditionally serialize Resources.
@@ -579,10 +1137,28 @@ bool FSfMoveResponseDataContainer::Serialize(UCharacterMovementComponent& Charac
 			& Repredict_Sf) != 0 && CharacterComponent->FormResource;
 		if (bDoSerializeResources)
 		{
-			CharacterComponent->ResourcesResponse.NetSerialize(Ar, PackageMap, bLocalSuccess);
-			if (!bIsSaving)
+			//Only values are serialized.
+			TArray<FResource>& ResourceItems = CharacterComponent->ResourcesResponse.Items;
+			int32 NumResources = ResourceItems.Num();
+			if (SerializeSectionNum(Ar, NumResources))
 			{
-				CharacterComponent->bClientResourcesWereUpdated = true;
+				if (!bIsSaving)
+				{
+					ResourceItems.SetNum(NumResources, false);
+				}
+				const bool bRestored = SerializeDirtyElements(
+					Ar, NumResources, CharacterComponent->ResourcesResponseDirtyMask,
+					[&](const int32 i) { Ar << ResourceItems[i].Value; },
+					[&](const int32 i)
+					{
+						if (!CorrectedMove || !CorrectedMove->Resources.Items.IsValidIndex(i)) return false;
+						ResourceItems[i].Value = CorrectedMove->Resources.Items[i].Value;
+						return true;
+					});
+				if (!bIsSaving && bRestored)
+				{
+					CharacterComponent->bClientResourcesWereUpdated = true;
+				}
 			}
 		}
 
@@ -591,11 +1167,39 @@ bool FSfMoveResponseDataContainer::Serialize(UCharacterMovementComponent& Charac
 			& Repredict_Sf) != 0;
 		if (bDoSerializeActionSets)
 		{
-			Ar << CharacterComponent->ActionSetResponses;
-			Ar << CharacterComponent->TimesSinceLastAction;
-			if (!bIsSaving)
+			TArray<FActionSet>& ActionSetResponses = CharacterComponent->ActionSetResponses;
+			TArray<FUint16_Quantize100>& TimesSinceLastAction = CharacterComponent->TimesSinceLastAction;
+			int32 NumConstituents = ActionSetResponses.Num();
+			if (SerializeSectionNum(Ar, NumConstituents))
 			{
-				CharacterComponent->bClientActionsWereUpdated = true;
+				if (!bIsSaving)
+				{
+					ActionSetResponses.SetNum(NumConstituents, false);
+					TimesSinceLastAction.SetNum(NumConstituents, false);
+				}
+				//PendingActionSets are packed in the same order as ActionSetResponses.
+				const bool bRestored = SerializeDirtyElements(
+					Ar, NumConstituents, CharacterComponent->ActionSetResponseDirtyMask,
+					[&](const int32 i)
+					{
+						Ar << ActionSetResponses[i];
+						Ar << TimesSinceLastAction[i];
+					},
+					[&](const int32 i)
+					{
+						if (!CorrectedMove || !CorrectedMove->PendingActionSets.IsValidIndex(i) || !CorrectedMove->
+							TimesSinceLastAction.IsValidIndex(i))
+						{
+							return false;
+						}
+						ActionSetResponses[i] = CorrectedMove->PendingActionSets[i].ActionSet;
+						TimesSinceLastAction[i] = CorrectedMove->TimesSinceLastAction[i];
+						return true;
+					});
+				if (!bIsSaving && bRestored)
+				{
+					CharacterComponent->bClientActionsWereUpdated = true;
+				}
 			}
 		}
 
@@ -604,18 +1208,43 @@ bool FSfMoveResponseDataContainer::Serialize(UCharacterMovementComponent& Charac
 			& Repredict_Sf) != 0;
 		if (bDoSerializeVelocityCurves)
 		{
-			uint16 NumCurves = CharacterComponent->ActiveVelocityCurves.Num();
-			Ar << NumCurves;
-			if (!bIsSaving)
+			//Curves are received separately as they are only applied if they can all be restored.
+			TArray<FTimestampedMovementCurve> ReceivedCurves;
+			TArray<FTimestampedMovementCurve>& Curves = bIsSaving
+				                                            ? CharacterComponent->ActiveVelocityCurves
+				                                            : ReceivedCurves;
+			int32 NumCurves = Curves.Num();
+			if (SerializeSectionNum(Ar, NumCurves))
 			{
-				TArray<FTimestampedMovementCurve>& Curves = CharacterComponent->ActiveVelocityCurves;
-				Curves.Empty();
-				Curves.Reserve(NumCurves);
-				Curves.AddDefaulted(NumCurves);
+				if (!bIsSaving)
+				{
+					Curves.SetNum(NumCurves);
+				}
+				const bool bRestored = SerializeDirtyElements(
+					Ar, NumCurves, CharacterComponent->VelocityCurveResponseDirtyMask,
+					[&](const int32 i) { Curves[i].NetSerialize(Ar, PackageMap, bLocalSuccess); },
+					[&](const int32 i)
+					{
+						if (!CorrectedMove || !CorrectedMove->VelocityCurves.IsValidIndex(i)) return false;
+						Curves[i] = CorrectedMove->VelocityCurves[i];
+						return true;
+					});
+				if (!bIsSaving && bRestored)
+				{
+					CharacterComponent->ActiveVelocityCurves = MoveTemp(ReceivedCurves);
+				}
 			}
-			for (FTimestampedMovementCurve& Curve : CharacterComponent->ActiveVelocityCurves)
+		}
+
+		if (!bIsSaving)
+		{
+			if ((CharacterComponent->CorrectionConditionFlags & Repredict_Sf) != 0)
+			{
+				CharacterComponent->ClientSetupReplayScope(ClientAdjustment.TimeStamp);
+			}
+			else
 			{
-				Curve.NetSerialize(Ar, PackageMap, bLocalSuccess);
+				CharacterComponent->bScopedReplay = false;
 			}
 		}
 
@@ -664,6 +1293,7 @@ bool FSfMoveResponseDataContainer::Serialize(UCharacterMovementComponent& Charac
 		//We reset flags after serialization for the next frame.
 		CharacterComponent->CorrectionConditionFlags = 0;
 	}
+	CharacterComponent->ResetResponseDirtyMasks();
 	return !Ar.IsError();
 }
 
@@ -673,7 +1303,6 @@ UFormCharacterComponent::UFormCharacterComponent()
 	SetMoveResponseDataContainer(SfMoveResponseDataContainer);
 	bWantsToSprint = false;
 	bMovementSpeedNeedsRecalculation = true;
-	EnabledInputSets = 0;
 	bClientActionsWereUpdated = false;
 	bClientCardsWereUpdated = false;
 	bClientResourcesWereUpdated = false;
@@ -723,6 +1352,15 @@ void UFormCharacterComponent::ClientAdjustPosition_Implementation(float TimeStam
 	Super::ClientAdjustPosition_Implementation(TimeStamp, NewLoc, NewVel, NewBase, NewBaseBoneName, bHasBase,
 	                                           bBaseRelativePosition, ServerMovementMode,
 	                                           OptionalRotation);
+	UpdateCardIdentifiersBaseline();
+	UpdateInputBitsBaseline();
+}
+
+void UFormCharacterComponent::ClientAckGoodMove_Implementation(float TimeStamp)
+{
+	Super::ClientAckGoodMove_Implementation(TimeStamp);
+	UpdateCardIdentifiersBaseline();
+	UpdateInputBitsBaseline();
 }
 
 void UFormCharacterComponent::MarkCardsDirty()
@@ -735,33 +1373,46 @@ bool UFormCharacterComponent::IsReplaying() const
 	return bIsReplaying;
 }
 
+bool UFormCharacterComponent::IsScopedReplaying() const
+{
+	return bIsReplaying && bScopedReplay;
+}
+
+void UFormCharacterComponent::RecordPredictedChange()
+{
+	bMadePredictedChanges = true;
+	//A change made while re-simulating only some inventories is applied to the latest state of the rest, so the server
+	//is sent the full state to verify. A mismatch is corrected with a full replay since this move is now marked.
+	if (IsScopedReplaying())
+	{
+		bClientForceSerialize = true;
+	}
+}
+
+void UFormCharacterComponent::MarkInputDispatchTableDirty()
+{
+	bInputDispatchTableDirty = true;
+}
+
+bool UFormCharacterComponent::ShouldSimulateInventory(const int32 InventoryIndex) const
+{
+	return !IsScopedReplaying() || (ScopedReplayInventories.IsValidIndex(InventoryIndex) && ScopedReplayInventories[
+		InventoryIndex]);
+}
+
 void UFormCharacterComponent::SetupFormCharacter(UFormCoreComponent* FormCoreComponent)
 {
 	FormCore = FormCoreComponent;
 
-	//Sanity check to ensure only 24 slotable inputs are available.
-	if (InputActionRegistry.Num() > 24)
+	//Sanity check to ensure only 64 slotable inputs are available.
+	if (InputActionRegistry.Num() > MaxInputActions)
 	{
 		UE_LOG(LogSfCore, Error,
 		       TEXT(
-			       "Only 24 input actions can be registered in UFormCharacterComponent class %s, removing additional ones."
+			       "Only 64 input actions can be registered in UFormCharacterComponent class %s, removing additional ones."
 		       ), *GetClass()->GetName());
-		const uint16 CountToRemove = InputActionRegistry.Num() - 24;
-		InputActionRegistry.RemoveAt(24, CountToRemove);
-	}
-
-	//Enable input sets depending on how many are necessary.
-	if (InputActionRegistry.Num() < 9)
-	{
-		EnabledInputSets = 1;
-	}
-	else if (InputActionRegistry.Num() < 17)
-	{
-		EnabledInputSets = 2;
-	}
-	else
-	{
-		EnabledInputSets = 3;
+		const int32 CountToRemove = InputActionRegistry.Num() - MaxInputActions;
+		InputActionRegistry.RemoveAt(MaxInputActions, CountToRemove);
 	}
 }
 
@@ -776,27 +1427,50 @@ void UFormCharacterComponent::SecondarySetupFormCharacter()
 
 float UFormCharacterComponent::CalculateFuturePredictedTimestamp(const float InAdditionalTime) const
 {
-	//Read implementation of CalculateTimeUntilPredictedTimestamp for explanation of how this works.
-	const float FutureTime = PredictedNetClock + InAdditionalTime;
-	if (FutureTime < 40000.0) return FutureTime;
-	return FutureTime - 40000.0;
+	//Wraps around the loop of the clock. The additional time can be negative.
+	const int64 FutureTicks = static_cast<int64>(PredictedNetClockTicks) + FMath::RoundToInt64(
+		InAdditionalTime * PredictedNetClockTicksPerSecond);
+	const int64 WrappedTicks = (FutureTicks % PredictedNetClockTicksPerLoop + PredictedNetClockTicksPerLoop)
+		% PredictedNetClockTicksPerLoop;
+	return static_cast<float>(WrappedTicks) / PredictedNetClockTicksPerSecond;
 }
 
 float UFormCharacterComponent::CalculateTimeUntilPredictedTimestamp(const float InTimestamp) const
 {
-	//We treat the PredictedNetClock variable as a loop, and we assume if a point in the cycle is closer going forward, then
-	//it is ahead in time and vice versa if it is closer going backwards.
-	const float TimeToFirstTimestamp = PredictedNetClock > InTimestamp ? InTimestamp : PredictedNetClock;
-	const float TimeBetween = FMath::Abs(PredictedNetClock - InTimestamp);
-	const float TimeAfterSecondTimestamp = PredictedNetClock > InTimestamp
-		                                       ? 40000.0 - PredictedNetClock
-		                                       : InTimestamp - PredictedNetClock;
-	const float TimeExterior = TimeToFirstTimestamp + TimeAfterSecondTimestamp;
-	if (TimeExterior > TimeBetween)
-	{
-		return PredictedNetClock > InTimestamp ? -TimeBetween : TimeBetween;
-	}
-	return PredictedNetClock > InTimestamp ? TimeExterior : -TimeExterior;
+	return static_cast<float>(CalculateTicksBetweenPredictedNetClocks(
+		PredictedNetClockTicks, PredictedTimestampToTicks(InTimestamp))) / PredictedNetClockTicksPerSecond;
+}
+
+float UFormCharacterComponent::CalculateTimeBetweenPredictedTimestamps(const float InFrom, const float InTo)
+{
+	return static_cast<float>(CalculateTicksBetweenPredictedNetClocks(
+		PredictedTimestampToTicks(InFrom), PredictedTimestampToTicks(InTo))) / PredictedNetClockTicksPerSecond;
+}
+
+uint32 UFormCharacterComponent::PredictedTimestampToTicks(const float InTimestamp)
+{
+	//Timestamps are exact multiples of a tick, so this only rounds away error from timestamps made by hand.
+	const int64 Ticks = FMath::RoundToInt64(static_cast<double>(InTimestamp) * PredictedNetClockTicksPerSecond);
+	return static_cast<uint32>((Ticks % PredictedNetClockTicksPerLoop + PredictedNetClockTicksPerLoop)
+		% PredictedNetClockTicksPerLoop);
+}
+
+int32 UFormCharacterComponent::CalculateTicksBetweenPredictedNetClocks(const uint32 InFrom, const uint32 InTo)
+{
+	//We treat the clock as a loop, and we assume if a point in the loop is closer going forward, then it is ahead in
+	//time and vice versa if it is closer going backwards.
+	const uint32 ForwardTicks = (InTo - InFrom) & (PredictedNetClockTicksPerLoop - 1);
+	if (ForwardTicks < PredictedNetClockTicksPerLoop / 2) return static_cast<int32>(ForwardTicks);
+	return static_cast<int32>(ForwardTicks) - static_cast<int32>(PredictedNetClockTicksPerLoop);
+}
+
+uint32 UFormCharacterComponent::AddTimeToPredictedNetClock(const uint32 InTicks, float& InOutRemainder,
+                                                          const float InDeltaSeconds)
+{
+	const float UnaddedTime = InOutRemainder + InDeltaSeconds;
+	const uint32 AddedTicks = FMath::Max(FMath::FloorToInt(UnaddedTime * PredictedNetClockTicksPerSecond), 0);
+	InOutRemainder = UnaddedTime - static_cast<float>(AddedTicks) / PredictedNetClockTicksPerSecond;
+	return InTicks + AddedTicks;
 }
 
 float UFormCharacterComponent::CalculateTimeSincePredictedTimestamp(const float InTimestamp) const
@@ -876,7 +1550,7 @@ FMovementCurveKey UFormCharacterComponent::Predicted_StartVelocityCurve(const FV
                                                                         const float InDuration,
                                                                         const bool bInSelfInitiated)
 {
-	const uint16 Index = ActiveVelocityCurves.Emplace(PredictedNetClock, CalculateFuturePredictedTimestamp(InDuration),
+	const uint16 Index = ActiveVelocityCurves.Emplace(GetPredictedNetClock(), CalculateFuturePredictedTimestamp(InDuration),
 	                                                  InVector, InMagnitudeCurve, bInSelfInitiated);
 	return FMovementCurveKey(ActiveVelocityCurves[Index]);
 }
@@ -891,7 +1565,7 @@ FMovementCurveKey UFormCharacterComponent::Server_StartVelocityCurve(const FVect
                                                                      const float InDuration,
                                                                      const bool bInSelfInitiated)
 {
-	const uint16 Index = ActiveVelocityCurves.Emplace(PredictedNetClock, CalculateFuturePredictedTimestamp(InDuration),
+	const uint16 Index = ActiveVelocityCurves.Emplace(GetPredictedNetClock(), CalculateFuturePredictedTimestamp(InDuration),
 	                                                  InVector, InMagnitudeCurve, bInSelfInitiated);
 	return FMovementCurveKey(ActiveVelocityCurves[Index]);
 }
@@ -903,7 +1577,7 @@ void UFormCharacterComponent::Server_EndVelocityCurve(const FMovementCurveKey& I
 
 void UFormCharacterComponent::InternalEndVelocityCurve(const FMovementCurveKey& InCurveKey)
 {
-	for (uint16 i = 0; i <= ActiveVelocityCurves.Num(); i++)
+	for (int32 i = 0; i < ActiveVelocityCurves.Num(); i++)
 	{
 		if (InCurveKey == FMovementCurveKey(ActiveVelocityCurves[i]))
 		{
@@ -922,40 +1596,18 @@ void UFormCharacterComponent::OnInputDown(const FInputActionInstance& Instance)
 {
 	if (GetOwner()->GetLocalRole() != ROLE_AutonomousProxy) return;
 	//Use the registry index to write to input sets.
-	const uint8 InputIndex = FindInputIndexInRegistry(Instance);
+	const int32 InputIndex = FindInputIndexInRegistry(Instance);
 	if (InputIndex == INDEX_NONE) return;
-	if (InputIndex < 8)
-	{
-		SetInputSet(&PrimaryInputSet, InputIndex, true);
-	}
-	else if (InputIndex < 16)
-	{
-		SetInputSet(&SecondaryInputSet, InputIndex - 8, true);
-	}
-	else
-	{
-		SetInputSet(&TertiaryInputSet, InputIndex - 16, true);
-	}
+	SetInputBit(InputIndex, true);
 }
 
 void UFormCharacterComponent::OnInputUp(const FInputActionInstance& Instance)
 {
 	if (GetOwner()->GetLocalRole() != ROLE_AutonomousProxy) return;
 	//Use the registry index to write to input sets.
-	const uint8 InputIndex = FindInputIndexInRegistry(Instance);
+	const int32 InputIndex = FindInputIndexInRegistry(Instance);
 	if (InputIndex == INDEX_NONE) return;
-	if (InputIndex < 8)
-	{
-		SetInputSet(&PrimaryInputSet, InputIndex, false);
-	}
-	else if (InputIndex < 16)
-	{
-		SetInputSet(&SecondaryInputSet, InputIndex - 8, false);
-	}
-	else
-	{
-		SetInputSet(&TertiaryInputSet, InputIndex - 16, false);
-	}
+	SetInputBit(InputIndex, false);
 }
 
 void UFormCharacterComponent::BeginPlay()
@@ -997,8 +1649,8 @@ bool UFormCharacterComponent::ServerCheckClientError(float ClientTimeStamp, floa
 		CorrectionConditionFlags |= Repredict_Movement;
 	}
 	SfServerCheckClientError();
-	//We don't rollback if we only want to update cards, we only send changes with a good ack.
-	return (CorrectionConditionFlags & ~Update_Cards) != 0;
+	//We don't rollback if we only want to update cards or request card identifiers, we only send changes with a good ack.
+	return (CorrectionConditionFlags & ~(Update_Cards | Request_CardIdentifiers)) != 0;
 }
 
 void UFormCharacterComponent::MoveAutonomous(float ClientTimeStamp, float DeltaTime, uint8 CompressedFlags,
@@ -1037,10 +1689,12 @@ bool UFormCharacterComponent::CardCanBeFoundInInventory(UInventory* Inventory,
 	return false;
 }
 
-void UFormCharacterComponent::HandleInventoryDifferencesAndSetCorrectionFlags(
+bool UFormCharacterComponent::HandleInventoryDifferencesAndSetCorrectionFlags(
 	UInventory* Inventory, const FCardIdentifiersInAnInventory& InCardIdentifierInventoryFromClient)
 {
+	bool bDiverged = false;
 	TArray<FCard>& ServerCards = Inventory->Cards;
+	TArray<int32, TInlineAllocator<8>> DestroyedIndices;
 	for (int16 i = ServerCards.Num() - 1; i >= 0; i--)
 	{
 		if (CardHasEquivalentCardIdentifierFromClient(InCardIdentifierInventoryFromClient, ServerCards[i]))
@@ -1057,18 +1711,21 @@ void UFormCharacterComponent::HandleInventoryDifferencesAndSetCorrectionFlags(
 			{
 				//If the card is awaiting client sync to be destroyed, we destroy once the client acks that the card is
 				//destroyed.
-				ServerCards.RemoveAt(i, 1, false);
+				DestroyedIndices.Add(i);
 			}
 			else
 			{
 				//Otherwise we should correct the client with the missing card.
 				CorrectionConditionFlags |= Repredict_Sf;
+				bDiverged = true;
 				UE_LOG(LogSfCore, Display,
 				       TEXT("Cards caused recorrection as client is missing a card that exists on the server."));
 			}
 		}
 	}
-	ServerCards.Shrink();
+	//The client has none of the destroyed cards, so removing them before the client identifiers are checked is the
+	//same as removing them in the loop.
+	Inventory->RemoveCardsAt(DestroyedIndices, false);
 
 	//Check if any card identifier is missing the equivalent card on the server. If so correct.
 	for (const FNetCardIdentifier& CardIdentifier : InCardIdentifierInventoryFromClient.CardIdentifiers)
@@ -1076,10 +1733,77 @@ void UFormCharacterComponent::HandleInventoryDifferencesAndSetCorrectionFlags(
 		if (!CardCanBeFoundInInventory(Inventory, CardIdentifier))
 		{
 			CorrectionConditionFlags |= Repredict_Sf;
+			bDiverged = true;
 			UE_LOG(LogSfCore, Display,
 			       TEXT("Cards caused recorrection as client has a card that doesn't exist on the server."));
 		}
 	}
+	return bDiverged;
+}
+
+void UFormCharacterComponent::HandleCardIdentifierDifferencesAndSetCorrectionFlags(
+	const TArray<FCardIdentifiersInAnInventory>& InCardIdentifiersInInventoriesFromClient)
+{
+	//If there is a difference in the number of inventories, ie when the server added or removed an inventory and the
+	//client hasn't synced up yet, we don't check cards since we can't with a index mismatch.
+	const TArray<UInventory*>& Inventories = FormCore->GetInventories();
+	if (InCardIdentifiersInInventoriesFromClient.Num() != Inventories.Num())
+	{
+		MarkResponseDirty(CardResponseDirtyMask, 0, Inventories.Num());
+		return;
+	}
+	for (uint8 InventoryIndex = 0; InventoryIndex < Inventories.Num(); InventoryIndex++)
+	{
+		if (HandleInventoryDifferencesAndSetCorrectionFlags(Inventories[InventoryIndex],
+		                                                    InCardIdentifiersInInventoriesFromClient[InventoryIndex]))
+		{
+			MarkResponseDirty(CardResponseDirtyMask, InventoryIndex);
+		}
+	}
+}
+
+void UFormCharacterComponent::HandleCardStateDigestAndSetCorrectionFlags(const FSfNetworkMoveData* MoveData)
+{
+	const TArray<UInventory*>& Inventories = FormCore->GetInventories();
+	//The digest is compared against all cards, including those awaiting client sync.
+	uint32 Digest = GetTypeHash(Inventories.Num());
+	for (const UInventory* Inventory : Inventories)
+	{
+		Digest = HashCombine(Digest, Inventory->CalculateCardDigest());
+	}
+	if (!MoveData->bCardStateDigestUnchanged)
+	{
+		ServerLastProcessedCardStateDigest = MoveData->CardStateDigest;
+	}
+	const bool bDigestMatches = ServerLastProcessedCardStateDigest == Digest;
+
+	if (MoveData->bHasCardIdentifiers)
+	{
+		HandleCardIdentifierDifferencesAndSetCorrectionFlags(MoveData->CardIdentifiersInInventories);
+	}
+	else if (bDigestMatches)
+	{
+		//The client has exactly our cards, which is the only case where comparing identifiers changes nothing but
+		//cards awaiting client sync.
+		for (UInventory* Inventory : Inventories)
+		{
+			for (FCard& Card : Inventory->Cards)
+			{
+				Card.bIsNotCorrected = false;
+			}
+		}
+	}
+
+	if (!bDigestMatches)
+	{
+		//Comparing identifiers is needed to tell cards awaiting client sync apart from mispredictions.
+		CorrectionConditionFlags |= Request_CardIdentifiers;
+		if (!MoveData->bHasCardIdentifiers)
+		{
+			//We don't know which inventories differ.
+			MarkResponseDirty(CardResponseDirtyMask, 0, Inventories.Num());
+		}
+	}
 }
 
 void UFormCharacterComponent::HandleResourcesDifferencesAndSetCorrectionFlags(
@@ -1088,121 +1812,354 @@ void UFormCharacterComponent::HandleResourcesDifferencesAndSetCorrectionFlags(
 	const FResourceArray& ServerResources = FormResourceComponent->Resources;
 	if (InResources.Items.Num() != ServerResources.Items.Num())
 	{
-		//If client sent resources array is a different size we must correct.
-		CorrectionConditionFlags |= Repredict_Sf;
-		UE_LOG(LogSfCore, Display, TEXT("Resources caused recorrection. Client length %d, server length %d."),
-		       InResources.Items.Num(), ServerResources.Items.Num());
+		//If client sent resources array is a different size we must correct.
+		CorrectionConditionFlags |= Repredict_Sf;
+		MarkResponseDirty(ResourcesResponseDirtyMask, 0, ServerResources.Items.Num());
+		UE_LOG(LogSfCore, Display, TEXT("Resources caused recorrection. Client length %d, server length %d."),
+		       InResources.Items.Num(), ServerResources.Items.Num());
+		return;
+	}
+	for (uint16 i = 0; i < ServerResources.Items.Num(); i++)
+	{
+		if (ServerResources.Items[i].Value != InResources.Items[i].Value)
+		{
+			CorrectionConditionFlags |= Repredict_Sf;
+			MarkResponseDirty(ResourcesResponseDirtyMask, i);
+			UE_LOG(LogSfCore, Display, TEXT("Resources caused recorrection. Client value %f, server value %f."),
+			       InResources.Items[i].Value, ServerResources.Items[i].Value);
+		}
+	}
+}
+
+void UFormCharacterComponent::HandleVelocityCurveDifferencesAndSetCorrectionFlags(const FSfNetworkMoveData* MoveData)
+{
+	const TArray<FMovementCurveKey>& Keys = MoveData->VelocityCurveKeys;
+	if (Keys.Num() != ActiveVelocityCurves.Num())
+	{
+		//If client sent array is a different size we must correct.
+		CorrectionConditionFlags |= Repredict_Sf;
+		MarkResponseDirty(VelocityCurveResponseDirtyMask, 0, ActiveVelocityCurves.Num());
+		UE_LOG(LogSfCore, Display, TEXT("Velocity curves caused recorrection. Client length %d, server length %d."),
+		       Keys.Num(), ActiveVelocityCurves.Num());
+		return;
+	}
+	for (uint16 i = 0; i < ActiveVelocityCurves.Num(); i++)
+	{
+		if (FMovementCurveKey(ActiveVelocityCurves[i]) != Keys[i])
+		{
+			CorrectionConditionFlags |= Repredict_Sf;
+			MarkResponseDirty(VelocityCurveResponseDirtyMask, i);
+			UE_LOG(LogSfCore, Display, TEXT("Velocity curves caused recorrection."));
+		}
+	}
+}
+
+void UFormCharacterComponent::SfServerCheckClientError()
+{
+	const FSfNetworkMoveData* MoveData = static_cast<FSfNetworkMoveData*>(GetCurrentNetworkMoveData());
+
+	//Don't check if the clock wasn't sent.
+	if (MoveData->PredictedNetClockTicks != UnsentPredictedNetClockTicks)
+	{
+		//If not within acceptable tolerance we correct and repredict.
+		const int32 TicksApart = CalculateTicksBetweenPredictedNetClocks(PredictedNetClockTicks,
+		                                                                 MoveData->PredictedNetClockTicks);
+		if (FMath::Abs(TicksApart) > NetClockAcceptableTolerance * PredictedNetClockTicksPerSecond)
+		{
+			CorrectionConditionFlags |= Repredict_NetClock;
+			UE_LOG(LogSfCore, Display, TEXT("NetClock caused recorrection %u and %u."),
+			       MoveData->PredictedNetClockTicks, PredictedNetClockTicks);
+		}
+	}
+
+	//Don't correct if there is a count mismatch as it is likely just the delay in UObject synchronization.
+	if (MoveData->PendingActionSets.Num() != PendingActionSets.Num())
+	{
+		//The client can't restore any action sets from a move that doesn't line up with ours.
+		MarkResponseDirty(ActionSetResponseDirtyMask, 0, PendingActionSets.Num());
+	}
+	else if (MoveData->PendingActionSets != PendingActionSets)
+	{
+		for (int32 i = 0; i < PendingActionSets.Num(); i++)
+		{
+			if (MoveData->PendingActionSets[i] != PendingActionSets[i])
+			{
+				MarkResponseDirty(ActionSetResponseDirtyMask, i);
+			}
+		}
+		CorrectionConditionFlags |= Repredict_Sf;
+		UE_LOG(LogSfCore, Display, TEXT("ActionSets caused recorrection. Client length %d, Server length %d."),
+		       MoveData->PendingActionSets.Num(), PendingActionSets.Num());
+		if (MoveData->PendingActionSets.Num() > 0 && PendingActionSets.Num() > 0)
+		{
+			UE_LOG(LogSfCore, Display,
+			       TEXT("Client InstanceId: %d, Server InstanceID: %d, Client Action0: %d, Server Action0: %d"),
+			       MoveData->PendingActionSets[0].ConstituentInstanceId, PendingActionSets[0].ConstituentInstanceId,
+			       MoveData->PendingActionSets[0].ActionSet.ActionZero, PendingActionSets[0].ActionSet.ActionZero);
+		}
+	}
+
+	//Find the card identifiers the client had, which are the ones from the last move if they are unchanged.
+	const TArray<FCardIdentifiersInAnInventory>* ClientCardIdentifiersInInventories = nullptr;
+	if (MoveData->bCardIdentifiersUnchanged)
+	{
+		ClientCardIdentifiersInInventories = GetServerCardIdentifierState(ServerLastProcessedCardIdentifiersStateId);
+	}
+	else if (!MoveData->bCardIdentifiersBaselineLost)
+	{
+		ClientCardIdentifiersInInventories = &MoveData->CardIdentifiersInInventories;
+		ServerLastProcessedCardIdentifiersStateId = MoveData->CardIdentifiersStateId;
+	}
+
+	if (bVerifyCardsWithDigest)
+	{
+		HandleCardStateDigestAndSetCorrectionFlags(MoveData);
+	}
+	else if (!ClientCardIdentifiersInInventories)
+	{
+		//A correction makes the client send whole card identifiers again.
+		CorrectionConditionFlags |= Repredict_Sf;
+		MarkResponseDirty(CardResponseDirtyMask, 0, FormCore->GetInventories().Num());
+		UE_LOG(LogSfCore, Display, TEXT("Cards caused recorrection as the client's card identifier baseline was lost."));
+	}
+	else
+	{
+		HandleCardIdentifierDifferencesAndSetCorrectionFlags(*ClientCardIdentifiersInInventories);
+	}
+
+	if (FormResource)
+	{
+		HandleResourcesDifferencesAndSetCorrectionFlags(FormResource, MoveData->Resources);
+	}
+
+	HandleVelocityCurveDifferencesAndSetCorrectionFlags(MoveData);
+
+	if (MoveData->bDisableSelfMovement != bDisableSelfMovement)
+	{
+		CorrectionConditionFlags |= Repredict_Sf;
+		CorrectionConditionFlags |= Repredict_Movement;
+	}
+}
+
+void UFormCharacterComponent::MarkResponseDirty(TBitArray<>& DirtyMask, const int32 Index)
+{
+	MarkResponseDirty(DirtyMask, Index, Index + 1);
+}
+
+void UFormCharacterComponent::MarkResponseDirty(TBitArray<>& DirtyMask, const int32 StartIndex, const int32 EndIndex)
+{
+	if (DirtyMask.Num() < EndIndex)
+	{
+		DirtyMask.Add(false, EndIndex - DirtyMask.Num());
+	}
+	for (int32 i = StartIndex; i < EndIndex; i++)
+	{
+		DirtyMask[i] = true;
+	}
+}
+
+void UFormCharacterComponent::ResetResponseDirtyMasks()
+{
+	//Reset keeps the allocations.
+	ActionSetResponseDirtyMask.Reset();
+	CardResponseDirtyMask.Reset();
+	ResourcesResponseDirtyMask.Reset();
+	VelocityCurveResponseDirtyMask.Reset();
+}
+
+void UFormCharacterComponent::ClientSetupReplayScope(const float TimeStamp)
+{
+	bScopedReplay = false;
+	if (!bScopedReconciliation || (CorrectionConditionFlags & Repredict_NetClock) != 0) return;
+	FNetworkPredictionData_Client_Character* ClientData = GetPredictionData_Client_Character();
+	const int32 MoveIndex = ClientData ? ClientData->GetSavedMoveIndex(TimeStamp) : INDEX_NONE;
+	if (MoveIndex == INDEX_NONE) return;
+	const FSavedMove_Sf* CorrectedMove = static_cast<const FSavedMove_Sf*>(ClientData->SavedMoves[MoveIndex].Get());
+
+	//Predicted card and resource changes aren't tied to the inventory of the constituent that made them, so one made
+	//by a diverged inventory would be kept or made twice, and one made to a diverged inventory would be lost.
+	bool bMadeChangesSinceCorrectedMove = bMadePredictedChanges;
+	for (int32 i = MoveIndex + 1; i < ClientData->SavedMoves.Num() && !bMadeChangesSinceCorrectedMove; i++)
+	{
+		bMadeChangesSinceCorrectedMove = static_cast<const FSavedMove_Sf*>(ClientData->SavedMoves[i].Get())->
+			bMadePredictedChanges;
+	}
+	if (const FSavedMove_Sf* PendingMove = static_cast<const FSavedMove_Sf*>(ClientData->PendingMove.Get()))
+	{
+		bMadeChangesSinceCorrectedMove |= PendingMove->bMadePredictedChanges;
+	}
+	if (bMadeChangesSinceCorrectedMove) return;
+
+	//Everything is re-simulated if the correction couldn't be restored or doesn't line up with our state.
+	const TArray<UInventory*>& Inventories = FormCore->GetInventories();
+	if (!bClientCardsWereUpdated || !bClientActionsWereUpdated || CardResponse.Num() != Inventories.Num()
+		|| PendingActionSetInventoryStarts.Num() != Inventories.Num() + 1
+		|| ActionSetResponses.Num() != PendingActionSetInventoryStarts.Last())
+	{
+		return;
+	}
+	if (FormResource && (!bClientResourcesWereUpdated
+		|| ResourcesResponse.Items.Num() != FormResource->Resources.Items.Num()
+		|| CorrectedMove->Resources.Items.Num() != FormResource->Resources.Items.Num()))
+	{
 		return;
 	}
-	for (uint16 i = 0; i < ServerResources.Items.Num(); i++)
+
+	//An inventory is re-simulated if its cards or any of its constituents diverged.
+	ScopedReplayInventories.Init(false, Inventories.Num());
+	for (int32 i = 0; i < Inventories.Num(); i++)
 	{
-		if (ServerResources.Items[i].Value != InResources.Items[i].Value)
+		bool bDiverged = CardResponseDirtyMask.IsValidIndex(i) && CardResponseDirtyMask[i];
+		for (int32 j = PendingActionSetInventoryStarts[i]; j < PendingActionSetInventoryStarts[i + 1] && !bDiverged; j++)
 		{
-			CorrectionConditionFlags |= Repredict_Sf;
-			UE_LOG(LogSfCore, Display, TEXT("Resources caused recorrection. Client value %f, server value %f."),
-			       InResources.Items[0].Value, ServerResources.Items[0].Value);
-			return;
+			bDiverged = ActionSetResponseDirtyMask.IsValidIndex(j) && ActionSetResponseDirtyMask[j];
+		}
+		ScopedReplayInventories[i] = bDiverged;
+	}
+
+	if (FormResource)
+	{
+		//Resources are offset by how much they diverged so that resource updates since the corrected move are kept.
+		//No predicted changes were made since then, so any made while replaying are new and are applied.
+		const TArray<FResource>& Resources = FormResource->Resources.Items;
+		for (int32 i = 0; i < Resources.Num(); i++)
+		{
+			float Offset = 0;
+			if (ResourcesResponseDirtyMask.IsValidIndex(i) && ResourcesResponseDirtyMask[i])
+			{
+				Offset = ResourcesResponse.Items[i].Value - CorrectedMove->Resources.Items[i].Value;
+			}
+			FResource OffsetResource = Resources[i];
+			FormResource->LocalInternalAddResourceValue(OffsetResource, Offset);
+			ResourcesResponse.Items[i].Value = OffsetResource.Value;
+			if (Offset == 0) continue;
+			//The moves that are replayed keep their resources, so they are offset as well.
+			for (int32 MoveToOffsetIndex = MoveIndex; MoveToOffsetIndex < ClientData->SavedMoves.Num(); MoveToOffsetIndex++)
+			{
+				FSavedMove_Sf* MoveToOffset = static_cast<FSavedMove_Sf*>(ClientData->SavedMoves[MoveToOffsetIndex].Get());
+				if (!MoveToOffset->Resources.Items.IsValidIndex(i)) continue;
+				FormResource->LocalInternalAddResourceValue(MoveToOffset->Resources.Items[i], Offset);
+			}
 		}
 	}
+
+	if (bStopReplayOnConvergence)
+	{
+		ClientSnapshotPredictedState();
+	}
+
+	bScopedReplay = true;
 }
 
-void UFormCharacterComponent::HandleVelocityCurveDifferencesAndSetCorrectionFlags(const FSfNetworkMoveData* MoveData)
+void UFormCharacterComponent::ClientSnapshotPredictedState()
 {
-	const TArray<FMovementCurveKey>& Keys = MoveData->VelocityCurveKeys;
-	if (Keys.Num() != ActiveVelocityCurves.Num())
+	ClientPredictedTimesSinceLastAction.Reset(PendingActionSets.Num());
+	for (const UConstituent* Constituent : FormCore->GetOrderedConstituents())
 	{
-		//If client sent array is a different size we must correct.
-		CorrectionConditionFlags |= Repredict_Sf;
-		UE_LOG(LogSfCore, Display, TEXT("Velocity curves caused recorrection. Client length %d, server length %d."),
-		       Keys.Num(), ActiveVelocityCurves.Num());
-		return;
+		ClientPredictedTimesSinceLastAction.Add(Constituent->TimeSincePredictedLastActionSet);
 	}
-	for (uint16 i = 0; i < ActiveVelocityCurves.Num(); i++)
+	const TArray<UInventory*>& Inventories = FormCore->GetInventories();
+	ClientPredictedLastInputBits.Reset(Inventories.Num());
+	ClientPredictedLastInputStates.SetNum(Inventories.Num());
+	ClientPredictedBufferedInputInventories.Init(false, Inventories.Num());
+	for (int32 i = 0; i < Inventories.Num(); i++)
 	{
-		if (FMovementCurveKey(ActiveVelocityCurves[i]) != Keys[i])
-		{
-			CorrectionConditionFlags |= Repredict_Sf;
-			UE_LOG(LogSfCore, Display, TEXT("Resources caused recorrection."));
-			return;
-		}
+		ClientPredictedLastInputBits.Add(Inventories[i] ? Inventories[i]->LastInputBits : 0);
+		ClientPredictedLastInputStates[i] = Inventories[i] ? Inventories[i]->OrderedLastInputState : TBitArray<>();
+		ClientPredictedBufferedInputInventories[i] = HasInventoryBufferedInputs(i);
 	}
 }
 
-void UFormCharacterComponent::SfServerCheckClientError()
+void UFormCharacterComponent::ClientResumePredictedInventory(const int32 InventoryIndex)
 {
-	const FSfNetworkMoveData* MoveData = static_cast<FSfNetworkMoveData*>(GetCurrentNetworkMoveData());
+	if (!ScopedReplayInventories.IsValidIndex(InventoryIndex)) return;
+	ScopedReplayInventories[InventoryIndex] = false;
 
-	//Don't check if negative.
-	if (MoveData->PredictedNetClock >= 0)
+	//The latest recorded move has the state that was predicted before the correction.
+	const FNetworkPredictionData_Client_Character* ClientData = GetPredictionData_Client_Character();
+	if (!ClientData) return;
+	const FSavedMove_Sf* LatestMove = static_cast<const FSavedMove_Sf*>(ClientData->PendingMove.Get());
+	if (!LatestMove)
 	{
-		//If not within acceptable tolerance we correct and repredict.
-		if (MoveData->PredictedNetClock > PredictedNetClock + NetClockAcceptableTolerance
-			|| MoveData->PredictedNetClock < PredictedNetClock - NetClockAcceptableTolerance)
-		{
-			CorrectionConditionFlags |= Repredict_NetClock;
-			UE_LOG(LogSfCore, Display, TEXT("NetClock caused recorrection %f and %f."), MoveData->PredictedNetClock,
-			       PredictedNetClock);
-		}
+		if (ClientData->SavedMoves.Num() == 0) return;
+		LatestMove = static_cast<const FSavedMove_Sf*>(ClientData->SavedMoves.Last().Get());
 	}
 
-	//Don't correct if there is a count mismatch as it is likely just the delay in UObject synchronization.
-	if (MoveData->PendingActionSets != PendingActionSets && MoveData->PendingActionSets.Num() == PendingActionSets.
-		Num())
+	UInventory* Inventory = FormCore->GetInventories()[InventoryIndex];
+	if (ClientPredictedLastInputBits.IsValidIndex(InventoryIndex))
 	{
-		CorrectionConditionFlags |= Repredict_Sf;
-		UE_LOG(LogSfCore, Display, TEXT("ActionSets caused recorrection. Client length %d, Server length %d."),
-		       MoveData->PendingActionSets.Num(), PendingActionSets.Num());
-		if (MoveData->PendingActionSets.Num() > 0 && PendingActionSets.Num() > 0)
-		{
-			UE_LOG(LogSfCore, Display,
-			       TEXT("Client InstanceId: %d, Server InstanceID: %d, Client Action0: %d, Server Action0: %d"),
-			       MoveData->PendingActionSets[0].ConstituentInstanceId, PendingActionSets[0].ConstituentInstanceId,
-			       MoveData->PendingActionSets[0].ActionSet.ActionZero, PendingActionSets[0].ActionSet.ActionZero);
-		}
+		Inventory->LastInputBits = ClientPredictedLastInputBits[InventoryIndex];
+		Inventory->OrderedLastInputState = ClientPredictedLastInputStates[InventoryIndex];
+		//The slots may have changed since the snapshot, so they are checked against the restored bits again.
+		MarkInputDispatchTableDirty();
 	}
-
-	//If there is a difference in the number of inventories, ie when the server added or removed an inventory and the
-	//client hasn't synced up yet, we don't check cards since we can't with a index mismatch.
-	const TArray<UInventory*> Inventories = FormCore->GetInventories();
-	const TArray<FCardIdentifiersInAnInventory>& ClientCardIdentifiersInInventories = MoveData->
-		CardIdentifiersInInventories;
-	if (ClientCardIdentifiersInInventories.Num() != Inventories.Num()) return;
-
-	for (uint8 InventoryIndex = 0; InventoryIndex < Inventories.Num(); InventoryIndex++)
+	if (LatestMove->Cards.IsValid() && LatestMove->Cards->IsValidIndex(InventoryIndex))
 	{
-		HandleInventoryDifferencesAndSetCorrectionFlags(Inventories[InventoryIndex],
-		                                                ClientCardIdentifiersInInventories[InventoryIndex]);
+		TArrayCopyKeepAllocation(Inventory->Cards, (*LatestMove->Cards)[InventoryIndex].Cards);
+		Inventory->MarkCardIndexDirty();
+		Inventory->MarkCardExpiryQueuesDirty();
+		Inventory->ClientCheckAndUpdateCardObjects();
 	}
 
-	if (FormResource)
+	//Action sets are packed in the same order as the ordered constituents.
+	const TArray<UConstituent*>& Constituents = FormCore->GetOrderedConstituents();
+	const TArray<int32>& InventoryStarts = FormCore->GetOrderedConstituentInventoryStarts();
+	if (InventoryStarts != PendingActionSetInventoryStarts || !InventoryStarts.IsValidIndex(InventoryIndex + 1)) return;
+	for (int32 i = InventoryStarts[InventoryIndex]; i < InventoryStarts[InventoryIndex + 1]; i++)
 	{
-		HandleResourcesDifferencesAndSetCorrectionFlags(FormResource, MoveData->Resources);
+		if (LatestMove->PendingActionSets.IsValidIndex(i))
+		{
+			Constituents[i]->PredictedLastActionSet = LatestMove->PendingActionSets[i].ActionSet;
+		}
+		if (ClientPredictedTimesSinceLastAction.IsValidIndex(i))
+		{
+			Constituents[i]->TimeSincePredictedLastActionSet = ClientPredictedTimesSinceLastAction[i];
+		}
 	}
+}
 
-	HandleVelocityCurveDifferencesAndSetCorrectionFlags(MoveData);
-
-	if (MoveData->bDisableSelfMovement != bDisableSelfMovement)
+bool UFormCharacterComponent::HasInventoryBufferedInputs(const int32 InventoryIndex) const
+{
+	const TArray<UConstituent*>& Constituents = FormCore->GetOrderedConstituents();
+	const TArray<int32>& InventoryStarts = FormCore->GetOrderedConstituentInventoryStarts();
+	if (!InventoryStarts.IsValidIndex(InventoryIndex + 1)) return false;
+	for (int32 i = InventoryStarts[InventoryIndex]; i < InventoryStarts[InventoryIndex + 1]; i++)
 	{
-		CorrectionConditionFlags |= Repredict_Sf;
-		CorrectionConditionFlags |= Repredict_Movement;
+		if (!Constituents[i]->BufferedInputs.IsEmpty()) return true;
 	}
+	return false;
+}
+
+const FSavedMove_Sf* UFormCharacterComponent::FindSavedMoveForResponse(const float TimeStamp) const
+{
+	const FNetworkPredictionData_Client_Character* ClientData = GetPredictionData_Client_Character();
+	if (!ClientData) return nullptr;
+	const int32 MoveIndex = ClientData->GetSavedMoveIndex(TimeStamp);
+	if (MoveIndex == INDEX_NONE) return nullptr;
+	return static_cast<const FSavedMove_Sf*>(ClientData->SavedMoves[MoveIndex].Get());
 }
 
 void UFormCharacterComponent::UpdateFromAdditionInputs()
 {
 	const FSfNetworkMoveData* MoveData = static_cast<FSfNetworkMoveData*>(GetCurrentNetworkMoveData());
 
-	if (EnabledInputSets > 0)
+	//Find the input bits the client had, which are the ones from the last move if they are unchanged.
+	if (MoveData->bInputBitsUnchanged)
 	{
-		PrimaryInputSet = MoveData->PrimaryInputSet;
+		if (const uint64* LastInputBits = GetServerInputBitsState(ServerLastProcessedInputBitsStateId))
+		{
+			InputBits = *LastInputBits;
+		}
 	}
-	if (EnabledInputSets > 1)
+	else if (!MoveData->bInputBitsBaselineLost)
 	{
-		SecondaryInputSet = MoveData->SecondaryInputSet;
+		InputBits = MoveData->InputBits;
+		ServerLastProcessedInputBitsStateId = MoveData->InputBitsStateId;
 	}
-	if (EnabledInputSets > 2)
+	else
 	{
-		TertiaryInputSet = MoveData->TertiaryInputSet;
+		//The inputs keep their last value and the correction makes the client send its input bits whole.
+		CorrectionConditionFlags |= Repredict_Sf;
 	}
 }
 
@@ -1227,6 +2184,7 @@ bool UFormCharacterComponent::ClientUpdatePositionAfterServerUpdate()
 		{
 			//Reset correction condition flags after replay so we know when we're replaying and when we're not.
 			CorrectionConditionFlags = 0;
+			bScopedReplay = false;
 
 			//Call a delegate so form components know to restart with their current state.
 			if (OnEndRollback.IsBound())
@@ -1244,18 +2202,17 @@ void UFormCharacterComponent::CorrectActionSets()
 	//Return if we're waiting for non-predicted objects to synchronize.
 	if (FormCore->ConstituentRegistry.Num() != ActionSetResponses.Num()) return;
 	if (ActionSetResponses.Num() == 0 || TimesSinceLastAction.Num() == 0) return;
-	uint16 i = 0;
 	//Constituent registry can't be used since this has to be in a deterministic order.
-	for (const UInventory* Inventory : FormCore->GetInventories())
+	const TArray<UConstituent*>& Constituents = FormCore->GetOrderedConstituents();
+	const TArray<int32>& InventoryStarts = FormCore->GetOrderedConstituentInventoryStarts();
+	if (Constituents.Num() != ActionSetResponses.Num() || Constituents.Num() != TimesSinceLastAction.Num()) return;
+	for (int32 InventoryIndex = 0; InventoryIndex < InventoryStarts.Num() - 1; InventoryIndex++)
 	{
-		for (const USlotable* Slotable : Inventory->GetSlotables())
+		if (!ShouldSimulateInventory(InventoryIndex)) continue;
+		for (int32 i = InventoryStarts[InventoryIndex]; i < InventoryStarts[InventoryIndex + 1]; i++)
 		{
-			for (UConstituent* Constituent : Slotable->GetConstituents())
-			{
-				Constituent->PredictedLastActionSet = ActionSetResponses[i];
-				Constituent->TimeSincePredictedLastActionSet = TimesSinceLastAction[i];
-				i++;
-			}
+			Constituents[i]->PredictedLastActionSet = ActionSetResponses[i];
+			Constituents[i]->TimeSincePredictedLastActionSet = TimesSinceLastAction[i];
 		}
 	}
 }
@@ -1266,7 +2223,10 @@ void UFormCharacterComponent::CorrectCards()
 	if (Inventories.Num() != CardResponse.Num()) return;
 	for (uint16 i = 0; i < Inventories.Num(); i++)
 	{
-		Inventories[i]->Cards = CardResponse[i].Cards;
+		if (!ShouldSimulateInventory(i)) continue;
+		TArrayCopyKeepAllocation(Inventories[i]->Cards, CardResponse[i].Cards);
+		Inventories[i]->MarkCardIndexDirty();
+		Inventories[i]->MarkCardExpiryQueuesDirty();
 		Inventories[i]->ClientCheckAndUpdateCardObjects();
 	}
 }
@@ -1287,42 +2247,53 @@ void UFormCharacterComponent::CorrectResources() const
 
 void UFormCharacterComponent::PackActionSets()
 {
-	ActionSetResponses.Empty();
-	TimesSinceLastAction.Empty();
-	ActionSetResponses.Reserve(FormCore->ConstituentRegistry.Num());
-	TimesSinceLastAction.Reserve(FormCore->ConstituentRegistry.Num());
 	//Constituent registry can't be used since this has to be in a deterministic order.
-	for (const UInventory* Inventory : FormCore->GetInventories())
+	const TArray<UConstituent*>& Constituents = FormCore->GetOrderedConstituents();
+	ActionSetResponses.Reset(Constituents.Num());
+	TimesSinceLastAction.Reset(Constituents.Num());
+	for (const UConstituent* Constituent : Constituents)
 	{
-		for (const USlotable* Slotable : Inventory->GetSlotables())
+		ActionSetResponses.Add(Constituent->PredictedLastActionSet);
+		TimesSinceLastAction.Add(Constituent->TimeSincePredictedLastActionSet);
+	}
+}
+
+void UFormCharacterComponent::PackPendingActionSets()
+{
+	const bool bIsClient = GetOwner() && !GetOwner()->HasAuthority();
+	//Packed in the same order as ActionSetResponses so the indices line up when a correction only sends some of them.
+	const TArray<UConstituent*>& Constituents = FormCore->GetOrderedConstituents();
+	PendingActionSets.Reset(Constituents.Num());
+	ClientTimesSinceLastAction.Reset(Constituents.Num());
+	for (const UConstituent* Constituent : Constituents)
+	{
+		PendingActionSets.Emplace(Constituent->InstanceId, Constituent->PredictedLastActionSet);
+		if (bIsClient)
 		{
-			for (const UConstituent* Constituent : Slotable->GetConstituents())
-			{
-				ActionSetResponses.Add(Constituent->PredictedLastActionSet);
-				TimesSinceLastAction.Add(Constituent->TimeSincePredictedLastActionSet);
-			}
+			ClientTimesSinceLastAction.Add(Constituent->TimeSincePredictedLastActionSet);
 		}
 	}
+	TArrayCopyKeepAllocation(PendingActionSetInventoryStarts, FormCore->GetOrderedConstituentInventoryStarts());
 }
 
 void UFormCharacterComponent::PackCards()
 {
-	CardResponse.Empty();
-	CardResponse.Reserve(FormCore->GetInventories().Num());
-	for (const UInventory* Inventory : FormCore->GetInventories())
-	{
-		FInventoryCards InventoryCards = FInventoryCards(Inventory->Cards);
-		TArray<FCard>& InventoryCardsArray = InventoryCards.Cards;
-		for (int16 i = InventoryCardsArray.Num() - 1; i >= 0; i--)
+	const TArray<UInventory*>& Inventories = FormCore->GetInventories();
+	CardResponse.SetNum(Inventories.Num(), false);
+	PackedCardsVersions.SetNumZeroed(Inventories.Num(), false);
+	for (int32 i = 0; i < Inventories.Num(); i++)
+	{
+		//Only repack inventories that have changed since they were last packed.
+		if (PackedCardsVersions[i] == Inventories[i]->GetCardsVersion()) continue;
+		PackedCardsVersions[i] = Inventories[i]->GetCardsVersion();
+		TArray<FCard>& InventoryCardsArray = CardResponse[i].Cards;
+		InventoryCardsArray.Reset(Inventories[i]->Cards.Num());
+		for (const FCard& Card : Inventories[i]->Cards)
 		{
-			//We remove the cards that are disabled for destroy as we don't want those syncing to the client.
-			if (InventoryCardsArray[i].bIsDisabledForDestroy)
-			{
-				InventoryCardsArray.RemoveAt(i, 1, false);
-			}
+			//We skip the cards that are disabled for destroy as we don't want those syncing to the client.
+			if (Card.bIsDisabledForDestroy) continue;
+			InventoryCardsArray.Add(Card);
 		}
-		InventoryCardsArray.Shrink();
-		CardResponse.Add(InventoryCards);
 	}
 }
 
@@ -1330,18 +2301,17 @@ void UFormCharacterComponent::PackResources()
 {
 	if (GetOwner()->HasAuthority())
 	{
-		ResourcesResponse = FormCore->GetFormResource()->Resources;
+		TArrayCopyKeepAllocation(ResourcesResponse.Items, FormCore->GetFormResource()->Resources.Items);
 	}
 	else
 	{
-		ClientSentResources = FormCore->GetFormResource()->Resources;
+		TArrayCopyKeepAllocation(ClientSentResources.Items, FormCore->GetFormResource()->Resources.Items);
 	}
 }
 
 void UFormCharacterComponent::PackVelocityCurves()
 {
-	ClientSentVelocityCurveKeys.Empty();
-	ClientSentVelocityCurveKeys.Reserve(ActiveVelocityCurves.Num());
+	ClientSentVelocityCurveKeys.Reset(ActiveVelocityCurves.Num());
 	for (const FTimestampedMovementCurve& Curve : ActiveVelocityCurves)
 	{
 		ClientSentVelocityCurveKeys.Emplace(Curve);
@@ -1350,25 +2320,134 @@ void UFormCharacterComponent::PackVelocityCurves()
 
 void UFormCharacterComponent::PackInventoryCardIdentifiers()
 {
-	CardIdentifiersInInventories.Empty();
-	for (UInventory* Inventory : FormCore->GetInventories())
+	const TArray<UInventory*>& Inventories = FormCore->GetInventories();
+	const uint32 OldCardIdentifiersSerial = CardIdentifiersSerial;
+	if (CardIdentifiersInInventories.Num() != Inventories.Num())
+	{
+		CardIdentifiersSerial++;
+	}
+	CardIdentifiersInInventories.SetNum(Inventories.Num(), false);
+	PackedCardIdentifiersVersions.SetNumZeroed(Inventories.Num(), false);
+	InventoryCardDigests.SetNumZeroed(Inventories.Num(), false);
+	for (int32 i = 0; i < Inventories.Num(); i++)
+	{
+		//Only repack inventories that have changed since they were last packed.
+		if (PackedCardIdentifiersVersions[i] == Inventories[i]->GetCardsVersion()) continue;
+		PackedCardIdentifiersVersions[i] = Inventories[i]->GetCardsVersion();
+		CardIdentifiersSerial++;
+		TArray<FNetCardIdentifier>& CardIdentifiers = CardIdentifiersInInventories[i].CardIdentifiers;
+		CardIdentifiers.Reset(Inventories[i]->Cards.Num());
+		for (const FCard& Card : Inventories[i]->Cards)
+		{
+			CardIdentifiers.Emplace(Card.ClassIndex, Card.OwnerConstituentInstanceId);
+		}
+		InventoryCardDigests[i] = CardIdentifiersInInventories[i].CalculateDigest();
+	}
+	if (CardIdentifiersSerial != OldCardIdentifiersSerial)
 	{
-		const uint8 i = CardIdentifiersInInventories.Emplace();
-		for (FCard Card : Inventory->Cards)
+		CardStateDigest = CombineInventoryCardDigests(InventoryCardDigests);
+
+		//Saved moves keep a reference to this to restore cards that a correction doesn't send.
+		TSharedRef<TArray<FInventoryCards>> CardsSnapshot = MakeShared<TArray<FInventoryCards>>();
+		CardsSnapshot->Reserve(Inventories.Num());
+		for (const UInventory* Inventory : Inventories)
 		{
-			CardIdentifiersInInventories[i].CardIdentifiers.Emplace(
-				Card.ClassIndex, Card.OwnerConstituentInstanceId);
+			CardsSnapshot->Emplace(Inventory->Cards);
 		}
+		ClientCardsSnapshot = CardsSnapshot;
+	}
+}
+
+uint32 UFormCharacterComponent::CombineInventoryCardDigests(const TArray<uint32>& InInventoryCardDigests)
+{
+	uint32 Digest = GetTypeHash(InInventoryCardDigests.Num());
+	for (const uint32 InventoryCardDigest : InInventoryCardDigests)
+	{
+		Digest = HashCombine(Digest, InventoryCardDigest);
 	}
+	return Digest;
+}
+
+void UFormCharacterComponent::UpdateCardIdentifiersBaseline()
+{
+	const FNetworkPredictionData_Client_Character* ClientData = GetPredictionData_Client_Character();
+	if (!ClientData || !ClientData->LastAckedMove.IsValid()) return;
+	const FSavedMove_Sf* AckedMove = static_cast<const FSavedMove_Sf*>(ClientData->LastAckedMove.Get());
+	//Card state digests aren't sent by id, so the baseline doesn't expire.
+	CardStateDigestBaselineSerial = AckedMove->CardIdentifiersSerial;
+	bHasCardStateDigestBaseline = true;
+	if (bHasCardIdentifiersBaseline && AckedMove->CardIdentifiersSerial == CardIdentifiersBaselineSerial) return;
+	//The server could have overwritten the state if we've sent a newer state with the same id.
+	if (CardIdentifiersSerial - AckedMove->CardIdentifiersSerial >= CardIdentifierStateIdCount)
+	{
+		bHasCardIdentifiersBaseline = false;
+		return;
+	}
+	TArrayCopyKeepAllocation(CardIdentifiersBaseline, AckedMove->CardIdentifiersInInventories,
+	                         &FCardIdentifiersInAnInventory::CardIdentifiers);
+	CardIdentifiersBaselineSerial = AckedMove->CardIdentifiersSerial;
+	bHasCardIdentifiersBaseline = true;
+}
+
+void UFormCharacterComponent::UpdateInputBitsBaseline()
+{
+	const FNetworkPredictionData_Client_Character* ClientData = GetPredictionData_Client_Character();
+	if (!ClientData || !ClientData->LastAckedMove.IsValid()) return;
+	const FSavedMove_Sf* AckedMove = static_cast<const FSavedMove_Sf*>(ClientData->LastAckedMove.Get());
+	if (bHasInputBitsBaseline && AckedMove->InputBitsSerial == InputBitsBaselineSerial) return;
+	//The server could have overwritten the state if we've sent a newer state with the same id.
+	if (InputBitsSerial - AckedMove->InputBitsSerial >= InputBitsStateIdCount)
+	{
+		bHasInputBitsBaseline = false;
+		return;
+	}
+	InputBitsBaseline = AckedMove->InputBits;
+	InputBitsBaselineSerial = AckedMove->InputBitsSerial;
+	bHasInputBitsBaseline = true;
+}
+
+const uint64* UFormCharacterComponent::GetServerInputBitsState(const int32 InStateId) const
+{
+	if (InStateId < 0 || InStateId >= static_cast<int32>(InputBitsStateIdCount)
+		|| (ServerInputBitsStatesMask & 1 << InStateId) == 0)
+		return nullptr;
+	return &ServerInputBitsStates[InStateId];
+}
+
+void UFormCharacterComponent::StoreServerInputBitsState(const uint32 InStateId, const uint64 InState)
+{
+	if (InStateId >= InputBitsStateIdCount) return;
+	ServerInputBitsStates[InStateId] = InState;
+	ServerInputBitsStatesMask |= 1 << InStateId;
+}
+
+const TArray<FCardIdentifiersInAnInventory>* UFormCharacterComponent::GetServerCardIdentifierState(
+	const uint32 InStateId) const
+{
+	if (InStateId >= CardIdentifierStateIdCount || (ServerCardIdentifierStatesMask & 1ull << InStateId) == 0)
+		return nullptr;
+	return &ServerCardIdentifierStates[InStateId];
+}
+
+void UFormCharacterComponent::StoreServerCardIdentifierState(const uint32 InStateId,
+                                                             const TArray<FCardIdentifiersInAnInventory>& InState)
+{
+	if (InStateId >= CardIdentifierStateIdCount) return;
+	ServerCardIdentifierStates.SetNum(CardIdentifierStateIdCount, false);
+	TArrayCopyKeepAllocation(ServerCardIdentifierStates[InStateId], InState,
+	                         &FCardIdentifiersInAnInventory::CardIdentifiers);
+	ServerCardIdentifierStatesMask |= 1ull << InStateId;
 }
 
 void UFormCharacterComponent::HandleCardClientSyncTimeout() const
 {
 	if (!GetOwner()) return;
 	if (!GetOwner()->HasAuthority()) return;
+	TArray<int32, TInlineAllocator<8>> TimedOutIndices;
 	for (UInventory* Inventory : FormCore->GetInventories())
 	{
 		TArray<FCard>& Cards = Inventory->Cards;
+		TimedOutIndices.Reset();
 		for (int16 i = Cards.Num() - 1; i >= 0; i--)
 		{
 			if (!HasServerTimestampPassed(
@@ -1383,66 +2462,201 @@ void UFormCharacterComponent::HandleCardClientSyncTimeout() const
 			if (Cards[i].bIsDisabledForDestroy)
 			{
 				//We remove these cards which also forces a correction to get the client to sync up.
-				Cards.RemoveAt(i, 1, false);
+				TimedOutIndices.Add(i);
 			}
 		}
-		Cards.Shrink();
+		Inventory->RemoveCardsAt(TimedOutIndices, false);
 	}
 }
 
-void UFormCharacterComponent::ApplyInputBitsToInventory(const uint32 InInputBits, UInventory* InInventory)
+void UFormCharacterComponent::BuildInputDispatchTable()
 {
-	//Note that input indices 0-23 represent the index of the input action that is registered in the InputActionRegistry.
-	const TArray<int8>& BoundInputIndices = InInventory->OrderedInputBindingIndices;
-	for (uint8 i = 0; i < BoundInputIndices.Num(); i++)
-	{
-		//Check if input is actually bound.
-		if (BoundInputIndices[i] == INDEX_NONE) continue;
-		const bool bInputValue = GetValueFromInputSets(BoundInputIndices[i], InInputBits);
-		//We don't want to do anything if the value isn't actually updated.
-		if (InInventory->OrderedLastInputState[i] == bInputValue) continue;
-		if (InInventory->Slotables.Num() <= i) continue;
-		if (InInventory->Slotables[i] == nullptr) continue;
-		for (UConstituent* Constituent : InInventory->Slotables[i]->GetConstituents())
+	bInputDispatchTableDirty = false;
+	const TArray<UInventory*>& Inventories = FormCore->GetInventories();
+	InputDispatchSlots.Reset();
+	InputDispatchConstituents.Reset();
+	InputDispatchInventoryStarts.SetNumUninitialized(Inventories.Num() + 1);
+	InputDispatchInventoryMasks.Init(0, Inventories.Num());
+	InputDispatchStaleInventories.Init(false, Inventories.Num());
+	for (int32 i = 0; i < Inventories.Num(); i++)
+	{
+		InputDispatchInventoryStarts[i] = InputDispatchSlots.Num();
+		const UInventory* Inventory = Inventories[i];
+		if (!Inventory) continue;
+		const int32 NumSlots = FMath::Min(Inventory->OrderedInputBindingIndices.Num(), Inventory->Slotables.Num());
+		for (int32 j = 0; j < NumSlots; j++)
 		{
-			if (!Constituent->bEnableInputsAndPrediction) continue;
-			if (bInputValue)
+			const int32 InputIndex = Inventory->OrderedInputBindingIndices[j];
+			if (InputIndex == INDEX_NONE || !Inventory->Slotables[j]) continue;
+			InputDispatchInventoryMasks[i] |= 1ull << InputIndex;
+			if (Inventory->OrderedLastInputState[j] != ((Inventory->LastInputBits & 1ull << InputIndex) != 0))
 			{
-				Constituent->OnInputDown(true);
+				InputDispatchStaleInventories[i] = true;
 			}
-			else
+			//Constituents are filtered by bEnableInputsAndPrediction when dispatching, as it can change at any time.
+			for (UConstituent* Constituent : Inventory->Slotables[j]->GetConstituents())
 			{
-				Constituent->OnInputUp(true);
+				if (Constituent) InputDispatchConstituents.Add(Constituent);
 			}
+			InputDispatchSlots.Add({j, InputIndex, InputDispatchConstituents.Num()});
 		}
-		InInventory->OrderedLastInputState[i] = bInputValue;
 	}
+	InputDispatchInventoryStarts[Inventories.Num()] = InputDispatchSlots.Num();
 }
 
-void UFormCharacterComponent::RemovePredictedCardWithEndedLifetimes() const
+template <typename FunctionType>
+void UFormCharacterComponent::ForEachSimulatedConstituent(FunctionType&& Function) const
 {
-	for (UInventory* Inventory : FormCore->GetInventories())
+	if (!IsScopedReplaying())
 	{
-		TArray<FCard>& Cards = Inventory->Cards;
-		for (int16 i = Cards.Num() - 1; i >= 0; i--)
+		for (UConstituent* Constituent : FormCore->ConstituentRegistry)
+		{
+			Function(Constituent);
+		}
+		return;
+	}
+	const TArray<UConstituent*>& Constituents = FormCore->GetOrderedConstituents();
+	const TArray<int32>& InventoryStarts = FormCore->GetOrderedConstituentInventoryStarts();
+	for (int32 i = 0; i < InventoryStarts.Num() - 1; i++)
+	{
+		if (!ShouldSimulateInventory(i)) continue;
+		for (int32 j = InventoryStarts[i]; j < InventoryStarts[i + 1]; j++)
+		{
+			Function(Constituents[j]);
+		}
+	}
+}
+
+void UFormCharacterComponent::ApplyInputBits()
+{
+	const TArray<UInventory*>& Inventories = FormCore->GetInventories();
+	if (bInputDispatchTableDirty || InputDispatchInventoryMasks.Num() != Inventories.Num())
+	{
+		BuildInputDispatchTable();
+	}
+
+	for (int32 i = 0; i < Inventories.Num(); i++)
+	{
+		UInventory* Inventory = Inventories[i];
+		//Inventories that didn't diverge keep their predicted state during a scoped replay.
+		if (!Inventory || !ShouldSimulateInventory(i)) continue;
+		//Only inventories where a bound input flipped have slots whose state changes.
+		if (((InputBits ^ Inventory->LastInputBits) & InputDispatchInventoryMasks[i]) == 0 &&
+			!InputDispatchStaleInventories[i]) continue;
+		Inventory->LastInputBits = InputBits;
+		InputDispatchStaleInventories[i] = false;
+		for (int32 j = InputDispatchInventoryStarts[i]; j < InputDispatchInventoryStarts[i + 1]; j++)
 		{
-			if (Cards[i].bUsingPredictedTimestamp && Cards[i].LifetimeEndTimestamp > -1.f &&
-				CalculateTimeUntilPredictedTimestamp(Cards[i].LifetimeEndTimestamp)
-				< 0)
+			const FSfInputDispatchSlot& Slot = InputDispatchSlots[j];
+			const bool bInputValue = (InputBits & 1ull << Slot.InputIndex) != 0;
+			//We don't want to do anything if the value isn't actually updated.
+			if (Inventory->OrderedLastInputState[Slot.SlotIndex] == bInputValue) continue;
+			Inventory->OrderedLastInputState[Slot.SlotIndex] = bInputValue;
+			const int32 ConstituentStart = j > 0 ? InputDispatchSlots[j - 1].ConstituentEnd : 0;
+			for (int32 k = ConstituentStart; k < Slot.ConstituentEnd; k++)
 			{
-				Cards.RemoveAt(i, 1, false);
+				UConstituent* Constituent = InputDispatchConstituents[k];
+				if (!Constituent->bEnableInputsAndPrediction) continue;
+				if (bInputValue)
+				{
+					Constituent->OnInputDown(true);
+				}
+				else
+				{
+					Constituent->OnInputUp(true);
+				}
 			}
 		}
-		Cards.Shrink();
 	}
-	for (UConstituent* Constituent : FormCore->ConstituentRegistry)
+}
+
+void UFormCharacterComponent::SimulateSfTime(const float InDeltaSeconds)
+{
+	//Time is added in whole ticks so the clock stays exact. The unwrapped clock is kept for this tick so that
+	//the resource updates are consistent across the loop.
+	const uint32 PreviousNetClockTicks = PredictedNetClockTicks;
+	const uint32 UnwrappedNetClockTicks = AddTimeToPredictedNetClock(PreviousNetClockTicks,
+	                                                                 PredictedNetClockRemainder, InDeltaSeconds);
+
+	if (bFixedStepSfSimulation)
+	{
+		//Steps end on multiples of the step on the clock, so they are the same no matter how time is split into
+		//moves. Input runs after the steps at the current clock. Steps are a power of two ticks so that they divide
+		//the loop of the clock and still line up after it loops.
+		const uint32 StepTicks = 1u << FMath::Clamp(FMath::RoundToInt(FMath::Log2(
+			static_cast<float>(PredictedNetClockTicksPerSecond) / FMath::Max(SfStepsPerSecond, 1))), 0,
+			static_cast<int32>(FMath::FloorLog2(PredictedNetClockTicksPerSecond)));
+		//A step that the previous move ended inside of runs from its own start, so resource updates in the part of it
+		//that the previous move covered aren't missed.
+		uint32 StepStartTicks = PreviousNetClockTicks / StepTicks * StepTicks;
+		for (uint32 StepEndTicks = (PreviousNetClockTicks / StepTicks + 1) * StepTicks;
+		     StepEndTicks <= UnwrappedNetClockTicks; StepEndTicks += StepTicks)
+		{
+			PredictedNetClockTicks = StepEndTicks % PredictedNetClockTicksPerLoop;
+			SimulateSfTimeStep(StepStartTicks, StepEndTicks);
+			StepStartTicks = StepEndTicks;
+		}
+		PredictedNetClockTicks = UnwrappedNetClockTicks % PredictedNetClockTicksPerLoop;
+		ApplyInputBits();
+	}
+	else
 	{
-		UInventory::UpdateAndRunBufferedInputs(Constituent);
+		PredictedNetClockTicks = UnwrappedNetClockTicks % PredictedNetClockTicksPerLoop;
+		ApplyInputBits();
+		SimulateSfTimeStep(PreviousNetClockTicks, UnwrappedNetClockTicks);
+	}
+}
+
+void UFormCharacterComponent::SimulateSfTimeStep(const uint32 InFromTicks, const uint32 InToTicks)
+{
+	RemovePredictedCardWithEndedLifetimes();
+
+	//Remove timed out buffered inputs.
+	ForEachSimulatedConstituent([](UConstituent* Constituent)
+	{
+		Constituent->HandleBufferInputTimeout();
+		//Note that the buffered inputs firing is implemented with the addition or removal of cards.
+	});
+
+	//Resources aren't re-simulated in a scoped replay as they are offset when the correction is received.
+	if (!FormResource || !FormStat || IsScopedReplaying()) return;
+	//Apply consistent resource changes.
+	//Applies every at a specified increment of the predicted net clock only to reduce bandwidth and processing usage.
+	//This is based directly on the net clock as determinism is required here.
+	//This math is supposed to divide the clock by the time between resource updates and use FMath::Floor to determine whether
+	//the second number has crossed the threshold.
+	if (FMath::FloorToInt64(static_cast<double>(InFromTicks) * ResourceUpdatesPerSecond
+			/ PredictedNetClockTicksPerSecond) == FMath::FloorToInt64(
+			static_cast<double>(InToTicks) * ResourceUpdatesPerSecond / PredictedNetClockTicksPerSecond))
+	{
+		return;
+	}
+	for (FResource& Resource : FormResource->Resources.Items)
+	{
+		FormResource->LocalInternalAddResourceValue(
+			Resource, FormStat->GetStat(Resource.IncreasePerSecondStat) * TimeBetweenResourceUpdate);
+		FormResource->LocalInternalRemoveResourceValue(
+			Resource, FormStat->GetStat(Resource.DecreasePerSecondStat) * TimeBetweenResourceUpdate);
+	}
+}
+
+void UFormCharacterComponent::RemovePredictedCardWithEndedLifetimes() const
+{
+	const TArray<UInventory*>& Inventories = FormCore->GetInventories();
+	for (int32 i = 0; i < Inventories.Num(); i++)
+	{
+		if (!ShouldSimulateInventory(i)) continue;
+		Inventories[i]->RemovePredictedCardsWithEndedLifetimes(this);
 	}
+	ForEachSimulatedConstituent([](UConstituent* Constituent)
+	{
+		UInventory::UpdateAndRunBufferedInputs(Constituent);
+	});
 }
 
 void UFormCharacterComponent::ApplyVelocityCurves()
 {
+	SCOPE_CYCLE_COUNTER(STAT_SfApplyVelocityCurves);
 	bool bUsingCurveVelocity = false;
 	for (int16 i = ActiveVelocityCurves.Num() - 1; i >= 0; i--)
 	{
@@ -1451,6 +2665,7 @@ void UFormCharacterComponent::ApplyVelocityCurves()
 		{
 			//We remove timed out curves.
 			ActiveVelocityCurves.RemoveAt(i, 1, false);
+			continue;
 		}
 		//Don't apply if self movement is disabled and the curve is owned by the character.
 		if (!(bDisableSelfMovement && Curve.bSelfInitiated))
@@ -1468,11 +2683,11 @@ void UFormCharacterComponent::ApplyVelocityCurves()
 				continue;
 			}
 			//Get velocity to add from the curve.
-			Velocity += Curve.MagnitudeCurve->GetFloatValue(
-				FMath::Min(CalculateTimeSincePredictedTimestamp(Curve.StartTimestamp), 0.f)) * Curve.Vector;
+			Velocity += FSfCurveTable::Evaluate(
+				Curve.MagnitudeCurve, FMath::Max(CalculateTimeSincePredictedTimestamp(Curve.StartTimestamp), 0.f))
+				* Curve.Vector;
 		}
 	}
-	ActiveVelocityCurves.Shrink();
 	//Only reset friction when there are no more applied velocity curves.
 	//The 0 checks prevents this from running more than once.
 	if (!bUsingCurveVelocity && GroundFriction == 0 && BrakingFrictionFactor == 0 && GravityScale == 0)
@@ -1569,7 +2784,12 @@ void UFormCharacterComponent::CalculateMovementSpeed()
 
 float UFormCharacterComponent::GetPredictedNetClock() const
 {
-	return PredictedNetClock;
+	return static_cast<float>(PredictedNetClockTicks) / PredictedNetClockTicksPerSecond;
+}
+
+uint32 UFormCharacterComponent::GetPredictedNetClockTicks() const
+{
+	return PredictedNetClockTicks;
 }
 
 void UFormCharacterComponent::UpdateCharacterStateBeforeMovement(float DeltaSeconds)
@@ -1607,62 +2827,21 @@ void UFormCharacterComponent::UpdateCharacterStateBeforeMovement(float DeltaSeco
 		}
 	}
 
+	//The part of a combined move that was already simulated by the pending move isn't simulated again.
+	DeltaSeconds -= CombinedMoveSimulatedDeltaTime;
+	CombinedMoveSimulatedDeltaTime = 0;
+
 	//If we're not replaying, or if we would like to repredict the net clock or action sets, cards, or resources.
 	//Not if we want to repredict movement or update cards only.
 	if (!IsReplaying() || (CorrectionConditionFlags & (Repredict_NetClock | Repredict_Sf)) != 0)
 	{
-		//Begin tick setup.
-
-		PredictedNetClock += DeltaSeconds;
-		//We reset when it is soon to lose 2 decimal points of precision.
-		if (PredictedNetClock > 40000.0)
-		{
-			PredictedNetClock = 0;
-		}
-
-		//End tick setup.
-
 		//Begin tick simulation.
 
-		//Run input if we're not replaying, or if we want to repredict anything that is not movement.
-		const uint32 InputBits = GetInputSetsJoinedBits();
-		for (UInventory* Inventory : FormCore->GetInventories())
-		{
-			ApplyInputBitsToInventory(InputBits, Inventory);
-		}
-
-		RemovePredictedCardWithEndedLifetimes();
-
-		//Remove timed out buffered inputs.
-		for (UConstituent* Constituent : FormCore->ConstituentRegistry)
-		{
-			Constituent->HandleBufferInputTimeout();
-			//Note that the buffered inputs firing is implemented with the addition or removal of cards.
-		}
-
-		if (FormResource && FormStat)
-		{
-			//Apply consistent resource changes.
-			//Applies every at a specified increment of the predicted net clock only to reduce bandwidth and processing usage.
-			//This is based directly on the net clock as determinism is required here.
-			//This math is supposed to divide the clock by the time between resource updates and use FMath::Floor to determine whether
-			//the second number has crossed the threshold.
-			if (FMath::Floor(PredictedNetClock * ResourceUpdatesPerSecond) != FMath::Floor(
-				(PredictedNetClock + DeltaSeconds) * ResourceUpdatesPerSecond))
-			{
-				for (FResource& Resource : FormResource->Resources.Items)
-				{
-					FormResource->LocalInternalAddResourceValue(
-						Resource, FormStat->GetStat(Resource.IncreasePerSecondStat) * TimeBetweenResourceUpdate);
-					FormResource->LocalInternalRemoveResourceValue(
-						Resource, FormStat->GetStat(Resource.DecreasePerSecondStat) * TimeBetweenResourceUpdate);
-				}
-			}
-		}
+		SimulateSfTime(DeltaSeconds);
 
 		if (OnPredictionTick.IsBound())
 		{
-			OnPredictionTick.Broadcast(PredictedNetClock, DeltaSeconds, IsReplaying());
+			OnPredictionTick.Broadcast(GetPredictedNetClock(), DeltaSeconds, IsReplaying());
 		}
 
 		if (bDisableSelfMovement)
@@ -1677,15 +2856,14 @@ void UFormCharacterComponent::UpdateCharacterStateBeforeMovement(float DeltaSeco
 
 		//Begin tick cleanup.
 
-		//Pack the action sets back into the FormCharacter only after we've changed them. PendingActionSets are only used
-		//for checking and isn't sent back to client on a correction.
-		PendingActionSets.Empty();
-		PendingActionSets.Reserve(FormCore->ConstituentRegistry.Num());
-		for (UConstituent* Constituent : FormCore->ConstituentRegistry)
+		ForEachSimulatedConstituent([DeltaSeconds](UConstituent* Constituent)
 		{
 			Constituent->IncrementTimeSincePredictedLastActionSet(DeltaSeconds);
-			PendingActionSets.Emplace(Constituent->InstanceId, Constituent->PredictedLastActionSet);
-		}
+		});
+
+		//Pack the action sets back into the FormCharacter only after we've changed them. PendingActionSets are only used
+		//for checking and isn't sent back to client on a correction.
+		PackPendingActionSets();
 
 		if (FormResource)
 		{
@@ -1736,6 +2914,58 @@ void UFormCharacterComponent::ServerMove_HandleMoveData(const FCharacterNetworkM
 		LatestServerReceivedMoveTimestamp, CharacterOwner->GetActorTimeDilation(*MyWorld));
 }
 
+void UFormCharacterComponent::ServerMovePacked_ServerReceive(const FCharacterServerMovePackedBits& PackedBits)
+{
+	if (!bUseServerJitterBuffer || !GetWorld())
+	{
+		//Moves that are still buffered go first.
+		ServerReleaseBufferedMoves(true);
+		Super::ServerMovePacked_ServerReceive(PackedBits);
+		return;
+	}
+
+	//Track how much the time between moves arriving varies.
+	const double Now = GetWorld()->GetRealTimeSeconds();
+	if (JitterBufferLastArrivalTime >= 0)
+	{
+		const float Interval = static_cast<float>(Now - JitterBufferLastArrivalTime);
+		JitterBufferDeviation += (FMath::Abs(Interval - JitterBufferMeanInterval) - JitterBufferDeviation)
+			* JitterBufferSmoothing;
+		JitterBufferMeanInterval += (Interval - JitterBufferMeanInterval) * JitterBufferSmoothing;
+	}
+	JitterBufferLastArrivalTime = Now;
+
+	BufferedServerMoves.Add({PackedBits, Now});
+	ServerReleaseBufferedMoves(false);
+}
+
+void UFormCharacterComponent::ServerReleaseBufferedMoves(const bool bInFlush)
+{
+	if (BufferedServerMoves.IsEmpty()) return;
+	const double Now = GetWorld() ? GetWorld()->GetRealTimeSeconds() : 0;
+	const float HoldTime = FMath::Min(JitterBufferDeviation * JitterBufferDeviationMultiplier,
+	                                  JitterBufferLatencyBudget);
+	//The cadence doesn't fall further behind than the hold time, so a stall isn't followed by a long burst.
+	JitterBufferNextReleaseTime = FMath::Max(JitterBufferNextReleaseTime, Now - HoldTime);
+	int32 NumToRelease = 0;
+	for (; NumToRelease < BufferedServerMoves.Num(); NumToRelease++)
+	{
+		//Moves are released on a steady cadence, but aren't held longer than the hold time.
+		const bool bIsDue = JitterBufferNextReleaseTime <= Now
+			|| Now - BufferedServerMoves[NumToRelease].ArrivalTime >= HoldTime
+			|| BufferedServerMoves.Num() - NumToRelease > MaxBufferedServerMoves;
+		if (!bInFlush && !bIsDue) break;
+		JitterBufferNextReleaseTime += JitterBufferMeanInterval;
+	}
+	if (NumToRelease == 0) return;
+
+	for (int32 i = 0; i < NumToRelease; i++)
+	{
+		Super::ServerMovePacked_ServerReceive(BufferedServerMoves[i].PackedBits);
+	}
+	BufferedServerMoves.RemoveAt(0, NumToRelease, false);
+}
+
 void UFormCharacterComponent::ReplicateMoveToServer(float DeltaTime, const FVector& NewAcceleration)
 {
 	Super::ReplicateMoveToServer(DeltaTime, NewAcceleration);
@@ -1746,10 +2976,14 @@ void UFormCharacterComponent::TickComponent(float DeltaTime, ELevelTick TickType
 {
 	if (GetOwner()->HasAuthority())
 	{
+		ServerReleaseBufferedMoves(!bUseServerJitterBuffer);
+
 		//We insert a empty move with the correct timestamp if the client failed to send a move recently to ensure that predicted
 		//time is still ticked. This will let the server continue to tick properly if the autonomous proxy doesn't send moves.
 		TimeSinceLastClientMoveReceivedOnServer += DeltaTime;
-		if (TimeSinceLastClientMoveReceivedOnServer >= ClientMoveWaitTimeBeforeForcingServerSimulation)
+		//Buffered moves are always processed before a move would be forced.
+		if (TimeSinceLastClientMoveReceivedOnServer >= ClientMoveWaitTimeBeforeForcingServerSimulation
+			&& BufferedServerMoves.IsEmpty())
 		{
 			FCharacterNetworkMoveDataContainer MoveDataContainer;
 			FSavedMove_Character NewMove;
@@ -1764,9 +2998,9 @@ void UFormCharacterComponent::TickComponent(float DeltaTime, ELevelTick TickType
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
 }
 
-uint8 UFormCharacterComponent::FindInputIndexInRegistry(const FInputActionInstance& InInstance)
+int32 UFormCharacterComponent::FindInputIndexInRegistry(const FInputActionInstance& InInstance) const
 {
-	for (uint8 i = 0; i < InputActionRegistry.Num(); i++)
+	for (int32 i = 0; i < InputActionRegistry.Num(); i++)
 	{
 		if (InInstance.GetSourceAction() == InputActionRegistry[i])
 		{
@@ -1776,36 +3010,17 @@ uint8 UFormCharacterComponent::FindInputIndexInRegistry(const FInputActionInstan
 	return INDEX_NONE;
 }
 
-void UFormCharacterComponent::SetInputSet(uint8* InputSet, const uint8 InIndex, const bool bInIsTrue)
+void UFormCharacterComponent::SetInputBit(const int32 InIndex, const bool bInIsTrue)
 {
-	if (InIndex > 7)
+	if (InIndex < 0 || InIndex >= MaxInputActions)
 	{
-		UE_LOG(LogSfCore, Error, TEXT("Index for input set may not be larger than 7."));
+		UE_LOG(LogSfCore, Error, TEXT("Index for input bits must be from 0 to 63."));
 		return;
 	}
-	const uint8 BitModifier = 1 << InIndex;
-	if (bInIsTrue)
-	{
-		*InputSet |= BitModifier;
-	}
-	else
-	{
-		*InputSet &= ~BitModifier;
-	}
+	const uint64 BitMask = 1ull << InIndex;
+	const uint64 NewInputBits = bInIsTrue ? InputBits | BitMask : InputBits & ~BitMask;
+	if (NewInputBits == InputBits) return;
+	InputBits = NewInputBits;
+	InputBitsSerial++;
 }
 
-bool UFormCharacterComponent::GetValueFromInputSets(const uint8 InIndex, const uint32 InInputSetsJoinedBits)
-{
-	if (InIndex > 23)
-	{
-		UE_LOG(LogSfCore, Error, TEXT("Index for input search may not be larger than 23."));
-		return false;
-	}
-	const uint32 BitMask = 1 << InIndex;
-	return (InInputSetsJoinedBits & BitMask) != 0;
-}
-
-uint32 UFormCharacterComponent::GetInputSetsJoinedBits() const
-{
-	return static_cast<uint32>(TertiaryInputSet) << 16 | static_cast<uint16>(SecondaryInputSet) << 8 | PrimaryInputSet;
-}
@@ -6,19 +6,16 @@
 #include "CardObject.h"
 #include "Constituent.h"
 #include "Inventory.h"
+#include "Slotable.h"
 #include "FormCharacterComponent.h"
 #include "SfHealthComponent.h"
 #include "FormQueryComponent.h"
 #include "FormResourceComponent.h"
 #include "FormStatComponent.h"
 #include "SfGameMode.h"
-#include "Kismet/KismetMathLibrary.h"
+#include "SfLagCompensationSubsystem.h"
 #include "Net/UnrealNetwork.h"
 
-FTimestampedTransformSnapshot::FTimestampedTransformSnapshot(): Timestamp(0)
-{
-}
-
 UFormCoreComponent::UFormCoreComponent()
 {
 	PrimaryComponentTick.bCanEverTick = true;
@@ -26,11 +23,6 @@ UFormCoreComponent::UFormCoreComponent()
 	SetIsReplicatedByDefault(true);
 }
 
-const TArray<UClass*>& UFormCoreComponent::GetAllCardObjectClassesSortedByName()
-{
-	return AllCardObjectClassesSortedByName;
-}
-
 UFormQueryComponent* UFormCoreComponent::GetFormQuery() const
 {
 	return FormQuery;
@@ -92,52 +84,21 @@ bool UFormCoreComponent::Server_HasTrigger(const FGameplayTag Trigger)
 	return false;
 }
 
-void UFormCoreComponent::ServerRollbackLocation(const float ServerTimestamp)
+void UFormCoreComponent::ServerRollbackLocation(const float ServerTimestamp) const
 {
 	if (!GetOwner() || !GetOwner()->HasAuthority()) return;
-	CurrentTransform = GetOwner()->GetActorTransform();
-
-	//TimeBetweenServerLocationSnapshot is also the 1 / server tick rate.
-	//As such TimeBetweenServerLocationSnapshot/2 would roughly get the average client local latency of a replicated
-	//position (on top of network latency) due to interpolation.
-	const float InterpolationAccountedServerTimestamp = ServerTimestamp - TimeBetweenServerLocationSnapshots/2;
-	
-	const uint16 IndexOfNewestSnapshot = IndexOfOldestSnapshot == 0 ? ServerLocationSnapshots.Num() - 1 : IndexOfOldestSnapshot - 1;
-	FTimestampedTransformSnapshot& ClosestOlderSnapshot = ServerLocationSnapshots[IndexOfOldestSnapshot];
-	FTimestampedTransformSnapshot& ClosestNewerSnapshot = ServerLocationSnapshots[IndexOfNewestSnapshot];
-
-	//We compare snapshots against the oldest and newest snapshots to get the closest two snapshots in order to interpolate.
-	for (const FTimestampedTransformSnapshot& TimestampedSnapshot : ServerLocationSnapshots)
-	{
-		if (TimestampedSnapshot.Timestamp >= InterpolationAccountedServerTimestamp && ClosestNewerSnapshot.Timestamp > TimestampedSnapshot.Timestamp)
-		{
-			ClosestNewerSnapshot = TimestampedSnapshot;
-		}
-		else if (TimestampedSnapshot.Timestamp <= InterpolationAccountedServerTimestamp && ClosestOlderSnapshot.Timestamp < TimestampedSnapshot.Timestamp)
-		{
-			ClosestOlderSnapshot = TimestampedSnapshot;
-		}
-	}
-
-	//Timestamp is likely not in range if the closest older snapshot hasn't changed.
-	if (ClosestOlderSnapshot.Timestamp == ServerLocationSnapshots[IndexOfOldestSnapshot].Timestamp)
-	{
-		UE_LOG(LogSfCore, Warning, TEXT("Could not find suitable snapshot to roll location back to. Timestamp may be too far in the past."));
-		return;
-	}
-
-	//Interpolate to get the most likely accurate position that would have been on the client.
-	const float InterpAlpha = (InterpolationAccountedServerTimestamp - ClosestOlderSnapshot.Timestamp) / (ClosestNewerSnapshot.Timestamp - ClosestOlderSnapshot.Timestamp);
-	const FTransform InterpolatedTransform = UKismetMathLibrary::TLerp(ClosestOlderSnapshot.Transform,
-	                                                                   ClosestNewerSnapshot.Transform, InterpAlpha);
-	
-	GetOwner()->SetActorTransform(InterpolatedTransform);
+	GetWorld()->GetSubsystem<USfLagCompensationSubsystem>()->Server_RewindForm(LagCompensationSlot, ServerTimestamp);
 }
 
 void UFormCoreComponent::ServerRestoreLatestLocation() const
 {
 	if (!GetOwner() || !GetOwner()->HasAuthority()) return;
-	GetOwner()->SetActorTransform(CurrentTransform);
+	GetWorld()->GetSubsystem<USfLagCompensationSubsystem>()->Server_RestoreForm(LagCompensationSlot);
+}
+
+int32 UFormCoreComponent::GetLagCompensationSlot() const
+{
+	return LagCompensationSlot;
 }
 
 void UFormCoreComponent::BeginPlay()
@@ -196,26 +157,6 @@ void UFormCoreComponent::BeginPlay()
 		FormResource->SecondarySetupFormResource();
 	}
 
-	//This is used to narrow down the classes that need to be iterated through when serializing card classes with names.
-	if (!CardObjectClassesFetched)
-	{
-		AllCardObjectClassesSortedByName = GetSubclassesOf(UCardObject::StaticClass());
-		for (int64 i = AllCardObjectClassesSortedByName.Num() - 1; i >= 0; i--)
-		{
-			if (AllCardObjectClassesSortedByName[i]->HasAnyClassFlags(CLASS_Abstract) || AllCardObjectClassesSortedByName[i] == UCardObject::StaticClass())
-			{
-				AllCardObjectClassesSortedByName.RemoveAt(i, 1, false);
-			}
-		}
-		AllCardObjectClassesSortedByName.Shrink();
-		//We sort this in a deterministic order to index items.
-		AllCardObjectClassesSortedByName.Sort([](const UClass& A, const UClass& B)
-		{
-			return A.GetPathName() > B.GetPathName();
-		});
-		CardObjectClassesFetched = true;
-	}
-
 	if (GetOwner()->HasAuthority())
 	{
 		Inventories.Reserve(DefaultInventoryClasses.Num());
@@ -240,10 +181,9 @@ void UFormCoreComponent::BeginPlay()
 			Triggers.Add(TriggerTag, FTriggerDelegate());
 		}
 
-		TimeBetweenServerLocationSnapshots = 1 / ServerTickRate;
-
-		//Initialize a circular buffer large enough to hold all snapshots for 1 second.
-		ServerLocationSnapshots.AddDefaulted(ServerTickRate);
+		//Location history for lag compensation is recorded for all forms by the world.
+		LagCompensationSlot = GetWorld()->GetSubsystem<USfLagCompensationSubsystem>()->Server_RegisterForm(
+			GetOwner(), ServerTickRate);
 	}
 
 	if (FormCharacter)
@@ -262,11 +202,17 @@ void UFormCoreComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
 		{
 			Server_RemoveInventoryByIndex(i);
 		}
+		if (USfLagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<USfLagCompensationSubsystem>())
+		{
+			LagCompensation->Server_UnregisterForm(LagCompensationSlot);
+		}
+		LagCompensationSlot = INDEX_NONE;
 	}
 }
 
 void UFormCoreComponent::OnRep_Inventories()
 {
+	MarkConstituentTableDirty();
 	//Register and deregister subobjects on client.
 	for (UInventory* ReplicatedInventory : Inventories)
 	{
@@ -287,15 +233,6 @@ void UFormCoreComponent::OnRep_Inventories()
 	}
 }
 
-void UFormCoreComponent::TenSecondTick(const float DeltaTime)
-{
-	//Remove empty delegate bindings for inventories every 10 seconds.
-	for (UInventory* Inventory : Inventories)
-	{
-		Inventory->RemoveEmptyDelegateBindings();
-	}
-}
-
 void UFormCoreComponent::SetMovementStatsDirty() const
 {
 	MARK_PROPERTY_DIRTY_FROM_NAME(UFormCoreComponent, WalkSpeedStat, this);
@@ -304,6 +241,35 @@ void UFormCoreComponent::SetMovementStatsDirty() const
 	MARK_PROPERTY_DIRTY_FROM_NAME(UFormCoreComponent, AccelerationStat, this);
 }
 
+bool FSfActionSetBatch::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	Ar << ServerTimestamp;
+	uint32 Num = ActionSets.Num();
+	Ar.SerializeIntPacked(Num);
+	if (Ar.IsLoading())
+	{
+		//Forms can't have this many constituents, so this stops bad data from allocating a huge array.
+		if (Num > MAX_uint16)
+		{
+			Ar.SetError();
+			bOutSuccess = false;
+			return false;
+		}
+		ActionSets.SetNum(Num);
+	}
+	for (FSfBatchedActionSet& BatchedActionSet : ActionSets)
+	{
+		uint32 InventoryIndex = BatchedActionSet.InventoryIndex;
+		Ar.SerializeIntPacked(InventoryIndex);
+		BatchedActionSet.InventoryIndex = InventoryIndex;
+		Ar << BatchedActionSet.InstanceId;
+		Ar << BatchedActionSet.ActionSet;
+		if (Ar.IsError()) break;
+	}
+	bOutSuccess = !Ar.IsError();
+	return true;
+}
+
 void UFormCoreComponent::TickComponent(float DeltaTime, ELevelTick TickType,
                                        FActorComponentTickFunction* ThisTickFunction)
 {
@@ -319,8 +285,6 @@ void UFormCoreComponent::TickComponent(float DeltaTime, ELevelTick TickType,
 		bInputsRequireSetup = false;
 	}
 
-	TenSecondTickHelper.DriveTick(DeltaTime);
-	
 	if (!GetOwner()->HasAuthority()) return;
 	//Server only.
 
@@ -329,12 +293,7 @@ void UFormCoreComponent::TickComponent(float DeltaTime, ELevelTick TickType,
 		Inventory->AuthorityTick(DeltaTime);
 	}
 
-	for (UConstituent* Constituent : ConstituentRegistry)
-	{
-		if (!Constituent->bLastActionSetPendingClientExecution) return;
-		Constituent->PerformLastActionSetOnClients();
-		Constituent->bLastActionSetPendingClientExecution = false;
-	}
+	SendQueuedActionSets();
 	
 	LowFrequencyTickDeltaTime += DeltaTime;
 	if (LowFrequencyTickDeltaTime > CalculatedTimeBetweenLowFrequencyTicks)
@@ -346,22 +305,6 @@ void UFormCoreComponent::TickComponent(float DeltaTime, ELevelTick TickType,
 		}
 		LowFrequencyTickDeltaTime -= CalculatedTimeBetweenLowFrequencyTicks;
 	}
-
-	TimeSinceLastSnapshot += DeltaTime;
-	//Update snapshot circular buffer.
-	if (TimeSinceLastSnapshot > TimeBetweenServerLocationSnapshots)
-	{
-		ServerLocationSnapshots[IndexOfOldestSnapshot].Timestamp = GetWorld()->TimeSeconds;
-		ServerLocationSnapshots[IndexOfOldestSnapshot].Transform = GetOwner()->GetActorTransform();
-		if (IndexOfOldestSnapshot + 1 < ServerLocationSnapshots.Num())
-		{
-			IndexOfOldestSnapshot++;
-		}
-		else
-		{
-			IndexOfOldestSnapshot = 0;
-		}
-	}
 }
 
 void UFormCoreComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
@@ -420,6 +363,7 @@ UInventory* UFormCoreComponent::Server_AddInventory(const TSubclassOf<UInventory
 		return nullptr;
 	}
 	Inventories.Add(InventoryInstance);
+	MarkConstituentTableDirty();
 	InventoryInstance->OwningFormCore = this;
 	MARK_PROPERTY_DIRTY_FROM_NAME(UInventory, OwningFormCore, InventoryInstance);
 	GetOwner()->AddReplicatedSubObject(InventoryInstance);
@@ -454,6 +398,7 @@ void UFormCoreComponent::Server_RemoveInventoryByIndex(const int32 InIndex)
 	Inventory->Destroy();
 	Inventories.RemoveAt(InIndex);
 	MARK_PROPERTY_DIRTY_FROM_NAME(UFormCoreComponent, Inventories, this);
+	MarkConstituentTableDirty();
 }
 
 bool UFormCoreComponent::Server_RemoveInventory(UInventory* Inventory)
@@ -511,4 +456,166 @@ void UFormCoreComponent::InternalClientSetToThirdPerson()
 bool UFormCoreComponent::IsFirstPerson()
 {
 	return bIsFirstPerson;
-}
\ No newline at end of file
+}
+
+UConstituent* UFormCoreComponent::FindConstituent(const int32 InInventoryIndex, const uint8 InInstanceId)
+{
+	UpdateConstituentTable();
+	const int32 TableIndex = InInventoryIndex * 256 + InInstanceId;
+	if (InInventoryIndex < 0 || InInventoryIndex >= Inventories.Num()) return nullptr;
+	UConstituent* Constituent = ConstituentTable[TableIndex].Constituent;
+	//Instance ids replicate separately on clients, so the table may be out of date.
+	if (Constituent && Constituent->InstanceId != InInstanceId)
+	{
+		bConstituentTableDirty = true;
+		UpdateConstituentTable();
+		Constituent = ConstituentTable[TableIndex].Constituent;
+	}
+	return Constituent;
+}
+
+FSfConstituentHandle UFormCoreComponent::MakeConstituentHandle(const int32 InInventoryIndex, const uint8 InInstanceId)
+{
+	FSfConstituentHandle Handle;
+	if (!FindConstituent(InInventoryIndex, InInstanceId)) return Handle;
+	Handle.InventoryIndex = InInventoryIndex;
+	Handle.InstanceId = InInstanceId;
+	Handle.Generation = ConstituentTable[InInventoryIndex * 256 + InInstanceId].Generation;
+	return Handle;
+}
+
+UConstituent* UFormCoreComponent::ResolveConstituentHandle(const FSfConstituentHandle& InHandle)
+{
+	if (!InHandle.IsValid()) return nullptr;
+	UConstituent* Constituent = FindConstituent(InHandle.InventoryIndex, InHandle.InstanceId);
+	if (!Constituent) return nullptr;
+	const uint32 Generation = ConstituentTable[InHandle.InventoryIndex * 256 + InHandle.InstanceId].Generation;
+	return Generation == InHandle.Generation ? Constituent : nullptr;
+}
+
+int32 UFormCoreComponent::GetInventoryIndex(const UInventory* InInventory)
+{
+	UpdateConstituentTable();
+	const int32 Index = InInventory->InventoryIndex;
+	return Inventories.IsValidIndex(Index) && Inventories[Index] == InInventory ? Index : INDEX_NONE;
+}
+
+const TArray<UConstituent*>& UFormCoreComponent::GetOrderedConstituents()
+{
+	UpdateConstituentTable();
+	return OrderedConstituents;
+}
+
+const TArray<int32>& UFormCoreComponent::GetOrderedConstituentInventoryStarts()
+{
+	UpdateConstituentTable();
+	return OrderedConstituentInventoryStarts;
+}
+
+void UFormCoreComponent::MarkConstituentTableDirty()
+{
+	bConstituentTableDirty = true;
+	if (FormCharacter)
+	{
+		FormCharacter->MarkInputDispatchTableDirty();
+	}
+}
+
+void UFormCoreComponent::UpdateConstituentTable()
+{
+	if (!bConstituentTableDirty) return;
+	bConstituentTableDirty = false;
+
+	//Generations are kept for slots that still hold the same constituent. The table doesn't shrink so generations
+	//aren't reset if inventories are removed and added again.
+	TArray<FSfConstituentTableSlot> OldTable = MoveTemp(ConstituentTable);
+	ConstituentTable.SetNum(FMath::Max(OldTable.Num(), Inventories.Num() * 256));
+	for (int32 i = 0; i < ConstituentTable.Num(); i++)
+	{
+		if (OldTable.IsValidIndex(i))
+		{
+			ConstituentTable[i].Generation = OldTable[i].Generation;
+		}
+	}
+
+	OrderedConstituents.Reset(ConstituentRegistry.Num());
+	OrderedConstituentInventoryStarts.Reset(Inventories.Num() + 1);
+	for (int32 i = 0; i < Inventories.Num(); i++)
+	{
+		OrderedConstituentInventoryStarts.Add(OrderedConstituents.Num());
+		if (!Inventories[i]) continue;
+		Inventories[i]->InventoryIndex = i;
+		for (const USlotable* Slotable : Inventories[i]->GetSlotables())
+		{
+			if (!Slotable) continue;
+			for (UConstituent* Constituent : Slotable->GetConstituents())
+			{
+				if (!Constituent) continue;
+				OrderedConstituents.Add(Constituent);
+				ConstituentTable[i * 256 + Constituent->InstanceId].Constituent = Constituent;
+			}
+		}
+	}
+	OrderedConstituentInventoryStarts.Add(OrderedConstituents.Num());
+
+	for (int32 i = 0; i < ConstituentTable.Num(); i++)
+	{
+		const UConstituent* OldConstituent = OldTable.IsValidIndex(i) ? OldTable[i].Constituent : nullptr;
+		if (ConstituentTable[i].Constituent != OldConstituent)
+		{
+			ConstituentTable[i].Generation++;
+		}
+	}
+}
+
+void UFormCoreComponent::QueueActionSetForClients(UConstituent* InConstituent)
+{
+	if (InConstituent->bLastActionSetPendingClientExecution) return;
+	InConstituent->bLastActionSetPendingClientExecution = true;
+	ConstituentsPendingClientExecution.Add(InConstituent);
+}
+
+bool UFormCoreComponent::BuildQueuedActionSetBatch(FSfActionSetBatch& OutBatch)
+{
+	if (ConstituentsPendingClientExecution.Num() == 0) return false;
+	OutBatch.ServerTimestamp = GetWorld()->GetGameState()->GetServerWorldTimeSeconds();
+	OutBatch.ActionSets.Reset(ConstituentsPendingClientExecution.Num());
+	for (UConstituent* Constituent : ConstituentsPendingClientExecution)
+	{
+		//The constituent may have been removed after executing.
+		if (!IsValid(Constituent)) continue;
+		Constituent->bLastActionSetPendingClientExecution = false;
+		if (!Constituent->OwningSlotable) continue;
+		const int32 InventoryIndex = Inventories.IndexOfByKey(Constituent->OwningSlotable->OwningInventory);
+		if (InventoryIndex == INDEX_NONE) continue;
+		FSfBatchedActionSet& BatchedActionSet = OutBatch.ActionSets.AddDefaulted_GetRef();
+		BatchedActionSet.InventoryIndex = InventoryIndex;
+		BatchedActionSet.InstanceId = Constituent->InstanceId;
+		BatchedActionSet.ActionSet = Constituent->LastActionSet;
+		//Kept for clients that become relevant later, which don't receive the multicast.
+		Constituent->ReplicatedActionState.ActionSet = Constituent->LastActionSet;
+		Constituent->ReplicatedActionState.ServerTimestamp = OutBatch.ServerTimestamp;
+		MARK_PROPERTY_DIRTY_FROM_NAME(UConstituent, ReplicatedActionState, Constituent);
+	}
+	ConstituentsPendingClientExecution.Reset();
+	return OutBatch.ActionSets.Num() > 0;
+}
+
+void UFormCoreComponent::SendQueuedActionSets()
+{
+	FSfActionSetBatch Batch;
+	if (!BuildQueuedActionSetBatch(Batch)) return;
+	NetMulticastClientPerformActionSets(Batch);
+}
+
+void UFormCoreComponent::NetMulticastClientPerformActionSets_Implementation(const FSfActionSetBatch& InBatch)
+{
+	if (GetOwner()->HasAuthority()) return;
+	for (const FSfBatchedActionSet& BatchedActionSet : InBatch.ActionSets)
+	{
+		UConstituent* Constituent = FindConstituent(BatchedActionSet.InventoryIndex, BatchedActionSet.InstanceId);
+		//The constituent may not have replicated yet.
+		if (!Constituent) continue;
+		Constituent->ClientPerformActionSet(BatchedActionSet.ActionSet, InBatch.ServerTimestamp);
+	}
+}
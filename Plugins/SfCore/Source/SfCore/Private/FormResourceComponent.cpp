@@ -189,6 +189,7 @@ bool UFormResourceComponent::Predicted_AddResourceValue(const FGameplayTag InTag
 	FResource* FoundResource = GetResourceFromTag(InTag);
 	if (FoundResource == nullptr) return false;
 	LocalInternalAddResourceValue(*FoundResource, InValue);
+	RecordPredictedChange();
 	if (GetOwner()->HasAuthority())
 	{
 		MARK_PROPERTY_DIRTY_FROM_NAME(UFormResourceComponent, Resources, this);
@@ -208,6 +209,7 @@ bool UFormResourceComponent::Predicted_RemoveResourceValue(const FGameplayTag In
 	FResource* FoundResource = GetResourceFromTag(InTag);
 	if (FoundResource == nullptr) return false;
 	LocalInternalRemoveResourceValue(*FoundResource, InValue);
+	RecordPredictedChange();
 	if (GetOwner()->HasAuthority())
 	{
 		MARK_PROPERTY_DIRTY_FROM_NAME(UFormResourceComponent, Resources, this);
@@ -227,6 +229,7 @@ bool UFormResourceComponent::Predicted_SetResourceValue(const FGameplayTag InTag
 	FResource* FoundResource = GetResourceFromTag(InTag);
 	if (FoundResource == nullptr) return false;
 	LocalInternalSetResourceValue(*FoundResource, InValue);
+	RecordPredictedChange();
 	if (GetOwner()->HasAuthority())
 	{
 		MARK_PROPERTY_DIRTY_FROM_NAME(UFormResourceComponent, Resources, this);
@@ -241,6 +244,15 @@ bool UFormResourceComponent::Predicted_SetResourceValue(const FGameplayTag InTag
 	return true;
 }
 
+void UFormResourceComponent::RecordPredictedChange() const
+{
+	//Resources are shared by every inventory, so the form character can't re-simulate them for only some inventories.
+	if (FormCore && FormCore->FormCharacter)
+	{
+		FormCore->FormCharacter->RecordPredictedChange();
+	}
+}
+
 float UFormResourceComponent::GetMaxValue(const FResource& Resource) const
 {
 	if (!FormStat && Resource.MaxValueOverride == 0)
@@ -52,6 +52,162 @@ FStatArray::FStatArray(): OwningFormStat(nullptr)
 {
 }
 
+FStatModifier::FStatModifier(): Type(Additive), Value(0)
+{
+}
+
+FStatModifier::FStatModifier(const FGameplayTag& InStatTag, const EStatModifierType InType, const float InValue):
+	StatTag(InStatTag), Type(InType), Value(InValue)
+{
+}
+
+FStatModifierHandle::FStatModifierHandle(): Id(0)
+{
+}
+
+FStatModifierHandle::FStatModifierHandle(const int32 InId): Id(InId)
+{
+}
+
+bool FStatModifierHandle::IsValid() const
+{
+	return Id != 0;
+}
+
+bool FStatModifierHandle::operator==(const FStatModifierHandle& Other) const
+{
+	return Id == Other.Id;
+}
+
+FStatAggregate::FStatAggregate(const int32 InStatIndex): StatIndex(InStatIndex)
+{
+}
+
+void FStatAggregate::AddModifier(const int32 InId, const FStatModifier& InModifier)
+{
+	if (InModifier.Type > FlatAdditive) return;
+	ModifiersByType[InModifier.Type].Emplace(InId, InModifier.Value);
+	ModifierCount++;
+	if (InModifier.Type != TrueMultiplicative)
+	{
+		(InModifier.Value < 0 ? NegativeSums : PositiveSums)[InModifier.Type] += InModifier.Value;
+	}
+	switch (InModifier.Type)
+	{
+	case Additive:
+		AdditiveSum += InModifier.Value;
+		break;
+	case AdditiveMultiplicative:
+		AdditiveMultiplicativeSum += InModifier.Value;
+		break;
+	case TrueMultiplicative:
+		if (InModifier.Value == 0)
+		{
+			TrueMultiplicativeZeroCount++;
+		}
+		else
+		{
+			TrueMultiplicativeNonZeroProduct *= InModifier.Value;
+		}
+		if (InModifier.Value < 0)
+		{
+			TrueMultiplicativeNegativeCount++;
+		}
+		else if (InModifier.Value > 1)
+		{
+			TrueMultiplicativeAboveOneProduct *= InModifier.Value;
+		}
+		break;
+	case FlatAdditive:
+		FlatAdditiveSum += InModifier.Value;
+		break;
+	default:
+		break;
+	}
+}
+
+void FStatAggregate::RemoveModifier(const int32 InId, const FStatModifier& InModifier)
+{
+	if (InModifier.Type > FlatAdditive) return;
+	TArray<TPair<int32, float>>& Modifiers = ModifiersByType[InModifier.Type];
+	const int32 Index = Modifiers.IndexOfByPredicate([InId](const TPair<int32, float>& Modifier)
+	{
+		return Modifier.Key == InId;
+	});
+	if (Index == INDEX_NONE) return;
+	//Order is kept as it matters when clamping after each modifier.
+	Modifiers.RemoveAt(Index, 1, false);
+	ModifierCount--;
+	//Reset to exact values once there are no modifiers left.
+	if (ModifierCount <= 0)
+	{
+		ModifierCount = 0;
+		AdditiveSum = 0;
+		AdditiveMultiplicativeSum = 0;
+		TrueMultiplicativeNonZeroProduct = 1;
+		TrueMultiplicativeZeroCount = 0;
+		FlatAdditiveSum = 0;
+		FMemory::Memzero(NegativeSums);
+		FMemory::Memzero(PositiveSums);
+		TrueMultiplicativeAboveOneProduct = 1;
+		TrueMultiplicativeNegativeCount = 0;
+		return;
+	}
+	if (InModifier.Type != TrueMultiplicative)
+	{
+		(InModifier.Value < 0 ? NegativeSums : PositiveSums)[InModifier.Type] -= InModifier.Value;
+	}
+	switch (InModifier.Type)
+	{
+	case Additive:
+		AdditiveSum -= InModifier.Value;
+		break;
+	case AdditiveMultiplicative:
+		AdditiveMultiplicativeSum -= InModifier.Value;
+		break;
+	case TrueMultiplicative:
+		if (InModifier.Value == 0)
+		{
+			TrueMultiplicativeZeroCount--;
+		}
+		else
+		{
+			TrueMultiplicativeNonZeroProduct /= InModifier.Value;
+		}
+		if (InModifier.Value < 0)
+		{
+			TrueMultiplicativeNegativeCount--;
+		}
+		else if (InModifier.Value > 1)
+		{
+			TrueMultiplicativeAboveOneProduct /= InModifier.Value;
+		}
+		break;
+	case FlatAdditive:
+		FlatAdditiveSum -= InModifier.Value;
+		break;
+	default:
+		break;
+	}
+}
+
+bool FStatAggregate::CanClampBeforeTotals(const double InBaseValue, const double InMaxValue) const
+{
+	//Every partial sum is between the sum of the negative modifiers and the sum of the positive ones.
+	const auto CanSumClamp = [this, InMaxValue](const EStatModifierType InType, const double InStartValue)
+	{
+		return InStartValue + NegativeSums[InType] < 0 || InStartValue + PositiveSums[InType] > InMaxValue;
+	};
+	if (CanSumClamp(Additive, InBaseValue) || CanSumClamp(AdditiveMultiplicative, 1)) return true;
+	//The multiplier is applied with a single clamp either way.
+	double Value = InBaseValue + AdditiveSum;
+	Value = FMath::Clamp(Value * (1 + AdditiveMultiplicativeSum), 0.0, InMaxValue);
+	//A negative modifier clamps to zero, and no partial product of the rest is above the product of those above one.
+	if (TrueMultiplicativeNegativeCount > 0 || Value * TrueMultiplicativeAboveOneProduct > InMaxValue) return true;
+	Value *= TrueMultiplicativeZeroCount > 0 ? 0.0 : TrueMultiplicativeNonZeroProduct;
+	return CanSumClamp(FlatAdditive, Value);
+}
+
 UFormStatComponent::UFormStatComponent()
 {
 	PrimaryComponentTick.bCanEverTick = false;
@@ -70,170 +226,217 @@ void UFormStatComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& O
 
 bool UFormStatComponent::CalculateStat(const FGameplayTag& InStatTag)
 {
-	const FStat* BaseStat = BaseStats.FindByPredicate([InStatTag](const FStat& Stat){ return Stat.StatTag == InStatTag;});
-	FStat* CurrentStat = CurrentStats.Items.FindByPredicate([InStatTag](const FStat& Stat)
-	{
-		return Stat.StatTag == InStatTag;
-	});
 	//We don't need to calculate if stat doesn't exist in base or current stats.
-	if (!BaseStat || !CurrentStat) return false;
+	const FStatAggregate* Aggregate = StatAggregates.Find(InStatTag);
+	if (!Aggregate) return false;
+	if (!BaseStats.IsValidIndex(Aggregate->StatIndex) || !CurrentStats.Items.IsValidIndex(Aggregate->StatIndex)) return false;
+	const FStat& BaseStat = BaseStats[Aggregate->StatIndex];
+	FStat& CurrentStat = CurrentStats.Items[Aggregate->StatIndex];
 
-	//We pass the value through all the modifiers in the order specified in the header file.
-	float Value = BaseStat->Value;
-	for (const FStat& AdditiveStat : AdditiveStatModifiers)
+	//We pass the value through the modifiers in the order specified in the header file. Modifiers are only walked
+	//when clamping after each of them can give a different value than clamping the totals.
+	if (bClampModifierTotals || !Aggregate->CanClampBeforeTotals(BaseStat.Value, BaseStat.MaxValue))
 	{
-		if (AdditiveStat.StatTag == InStatTag)
-		{
-			Value = FMath::Clamp(Value + AdditiveStat.Value, 0, BaseStat->MaxValue);
-		}
+		const double MaxValue = BaseStat.MaxValue;
+		double Value = FMath::Clamp(BaseStat.Value + Aggregate->AdditiveSum, 0.0, MaxValue);
+		const double ToMultiply = FMath::Clamp(1.0 + Aggregate->AdditiveMultiplicativeSum, 0.0, MaxValue);
+		Value = FMath::Clamp(Value * ToMultiply, 0.0, MaxValue);
+		const double TrueMultiplicativeProduct = Aggregate->TrueMultiplicativeZeroCount > 0
+			                                         ? 0.0
+			                                         : Aggregate->TrueMultiplicativeNonZeroProduct;
+		Value = FMath::Clamp(Value * TrueMultiplicativeProduct, 0.0, MaxValue);
+		Value = FMath::Clamp(Value + Aggregate->FlatAdditiveSum, 0.0, MaxValue);
+		CurrentStat.Value = static_cast<float>(Value);
 	}
-	float ToMultiply = 1.f;
-	for (const FStat& AdditiveMultiplicativeStat : AdditiveMultiplicativeStatModifiers)
+	else
 	{
-		if (AdditiveMultiplicativeStat.StatTag == InStatTag)
+		const float MaxValue = BaseStat.MaxValue;
+		float Value = BaseStat.Value;
+		for (const TPair<int32, float>& Modifier : Aggregate->ModifiersByType[Additive])
 		{
-			ToMultiply = FMath::Clamp(ToMultiply + AdditiveMultiplicativeStat.Value, 0, BaseStat->MaxValue);
+			Value = FMath::Clamp(Value + Modifier.Value, 0.f, MaxValue);
 		}
-	}
-	Value = FMath::Clamp(Value * ToMultiply, 0, BaseStat->MaxValue);
-	for (const FStat& TrueMultiplicativeStat : TrueMultiplicativeStatModifiers)
-	{
-		if (TrueMultiplicativeStat.StatTag == InStatTag)
+		float ToMultiply = 1.f;
+		for (const TPair<int32, float>& Modifier : Aggregate->ModifiersByType[AdditiveMultiplicative])
 		{
-			Value = FMath::Clamp(Value * TrueMultiplicativeStat.Value, 0, BaseStat->MaxValue);
+			ToMultiply = FMath::Clamp(ToMultiply + Modifier.Value, 0.f, MaxValue);
 		}
-	}
-	for (const FStat& FlatAdditiveStat : FlatAdditiveStatModifiers)
-	{
-		if (FlatAdditiveStat.StatTag == InStatTag)
+		Value = FMath::Clamp(Value * ToMultiply, 0.f, MaxValue);
+		for (const TPair<int32, float>& Modifier : Aggregate->ModifiersByType[TrueMultiplicative])
+		{
+			Value = FMath::Clamp(Value * Modifier.Value, 0.f, MaxValue);
+		}
+		for (const TPair<int32, float>& Modifier : Aggregate->ModifiersByType[FlatAdditive])
 		{
-			Value = FMath::Clamp(Value + FlatAdditiveStat.Value, 0, BaseStat->MaxValue);
+			Value = FMath::Clamp(Value + Modifier.Value, 0.f, MaxValue);
 		}
+		CurrentStat.Value = Value;
 	}
-	CurrentStat->Value = Value;
-	CurrentStats.MarkItemDirty(*CurrentStat);
+	CurrentStats.MarkItemDirty(CurrentStat);
 	MARK_PROPERTY_DIRTY_FROM_NAME(UFormStatComponent, CurrentStats, this);
 	return true;
 }
 
-const FStat& UFormStatComponent::Server_AddStatModifier(const FGameplayTag InStatTag, const EStatModifierType InType,
-	const float InValue)
+FStat UFormStatComponent::Server_AddStatModifier(const FGameplayTag InStatTag, const EStatModifierType InType,
+                                                 const float InValue)
+{
+	Server_AddStatModifierWithHandle(InStatTag, InType, InValue);
+
+	//The stat is returned so it can be removed.
+	return FStat(InStatTag, InValue);
+}
+
+TArray<FStat> UFormStatComponent::Server_AddStatModifierBatch(const TArray<FStat> InStats, const EStatModifierType InType)
+{
+	Server_AddStatModifierBatchWithHandles(InStats, InType);
+
+	//The stats are returned so they can be removed.
+	return InStats;
+}
+
+bool UFormStatComponent::Server_RemoveStatModifier(const FStat& InModifier, const EStatModifierType InType)
+{
+	return Server_RemoveStatModifierByHandle(FindStatModifier(InModifier, InType));
+}
+
+bool UFormStatComponent::Server_RemoveStatModifierBatch(TArray<FStat> InModifiers, const EStatModifierType InType)
 {
-	const FStat* StatInstance = nullptr;
-	switch (InType)
+	TSet<FGameplayTag> StatsToCalculate;
+	for (const FStat& Modifier : InModifiers)
 	{
-	case Additive:
-		StatInstance = &AdditiveStatModifiers[AdditiveStatModifiers.Emplace(InStatTag, InValue)];
-		break;
-	case AdditiveMultiplicative:
-		StatInstance = &AdditiveMultiplicativeStatModifiers[AdditiveMultiplicativeStatModifiers.Emplace(InStatTag, InValue)];
-		break;
-	case TrueMultiplicative:
-		StatInstance = &TrueMultiplicativeStatModifiers[TrueMultiplicativeStatModifiers.Emplace(InStatTag, InValue)];
-		break;
-	case FlatAdditive:
-		StatInstance = &FlatAdditiveStatModifiers[FlatAdditiveStatModifiers.Emplace(InStatTag, InValue)];
-		break;
-	default:
-		UE_LOG(LogTemp, Error, TEXT("Server_AddStatModifier was called with an invalid EStatModifierType."));
-		break;
+		FGameplayTag StatTag;
+		if (InternalRemoveStatModifier(FindStatModifier(Modifier, InType), StatTag))
+		{
+			StatsToCalculate.Add(StatTag);
+		}
 	}
+	for (const FGameplayTag& StatTag : StatsToCalculate)
+	{
+		CalculateStat(StatTag);
+	}
+	return StatsToCalculate.Num() > 0;
+}
+
+FStatModifierHandle UFormStatComponent::Server_AddStatModifierWithHandle(const FGameplayTag InStatTag,
+                                                                         const EStatModifierType InType,
+                                                                         const float InValue)
+{
+	const FStatModifierHandle Handle = InternalAddStatModifier(InStatTag, InType, InValue);
 
 	//This updates the relevant stat and sends updates to clients.
 	CalculateStat(InStatTag);
-	checkf(StatInstance, TEXT("StatInstance could not be created."));
-	
-	//The stat instance is returned so it can be removed.
-	return *StatInstance;
+
+	//The handle is returned so the modifier can be removed.
+	return Handle;
 }
 
-TArray<FStat> UFormStatComponent::Server_AddStatModifierBatch(const TArray<FStat> InStats, const EStatModifierType InType)
+TArray<FStatModifierHandle> UFormStatComponent::Server_AddStatModifierBatchWithHandles(const TArray<FStat>& InStats,
+	const EStatModifierType InType)
 {
-	TArray<FStat> ReturnStats;
-	switch (InType)
+	TArray<FStatModifierHandle> Handles;
+	Handles.Reserve(InStats.Num());
+	StatModifiers.Reserve(StatModifiers.Num() + InStats.Num());
+	TSet<FGameplayTag> StatsToCalculate;
+	for (const FStat& Stat : InStats)
 	{
-	case Additive:
-		AdditiveStatModifiers.Reserve(InStats.Num());
-		break;
-	case AdditiveMultiplicative:
-		AdditiveMultiplicativeStatModifiers.Reserve(InStats.Num());
-		break;
-	case TrueMultiplicative:
-		TrueMultiplicativeStatModifiers.Reserve(InStats.Num());
-		break;
-	case FlatAdditive:
-		FlatAdditiveStatModifiers.Reserve(InStats.Num());
-		break;
+		Handles.Add(InternalAddStatModifier(Stat.StatTag, InType, Stat.Value));
+		StatsToCalculate.Add(Stat.StatTag);
 	}
-	ReturnStats.Reserve(InStats.Num());
-	for (const FStat& Stat : InStats)
+	for (const FGameplayTag& StatTag : StatsToCalculate)
 	{
-		ReturnStats.Add(Server_AddStatModifier(Stat.StatTag, InType, Stat.Value));
+		CalculateStat(StatTag);
 	}
 
-	//The stat instance is returned so it can be removed.
-	return ReturnStats;
+	//The handles are returned so the modifiers can be removed.
+	return Handles;
 }
 
-bool UFormStatComponent::Server_RemoveStatModifier(const FStat& InModifier, const EStatModifierType InType)
+bool UFormStatComponent::Server_RemoveStatModifierByHandle(const FStatModifierHandle& InHandle)
 {
-	bool bRemoved;
-	switch (InType)
+	FGameplayTag StatTag;
+	if (!InternalRemoveStatModifier(InHandle, StatTag)) return false;
+
+	//This updates the relevant stat.
+	CalculateStat(StatTag);
+	return true;
+}
+
+bool UFormStatComponent::Server_RemoveStatModifierBatchByHandles(const TArray<FStatModifierHandle>& InHandles)
+{
+	TSet<FGameplayTag> StatsToCalculate;
+	for (const FStatModifierHandle& Handle : InHandles)
 	{
-	case Additive:
-		bRemoved = AdditiveStatModifiers.RemoveSingle(InModifier) != 0;
-		break;
-	case AdditiveMultiplicative:
-		bRemoved = AdditiveMultiplicativeStatModifiers.RemoveSingle(InModifier) != 0;
-		break;
-	case TrueMultiplicative:
-		bRemoved = TrueMultiplicativeStatModifiers.RemoveSingle(InModifier) != 0;
-		break;
-	case FlatAdditive:
-		bRemoved = FlatAdditiveStatModifiers.RemoveSingle(InModifier) != 0;
-		break;
-	default:
-		return false;
+		FGameplayTag StatTag;
+		if (InternalRemoveStatModifier(Handle, StatTag))
+		{
+			StatsToCalculate.Add(StatTag);
+		}
 	}
-	
-	//This updates the relevant stat.
-	CalculateStat(InModifier.StatTag);
-	return bRemoved;
+	for (const FGameplayTag& StatTag : StatsToCalculate)
+	{
+		CalculateStat(StatTag);
+	}
+	return StatsToCalculate.Num() > 0;
 }
 
-bool UFormStatComponent::Server_RemoveStatModifierBatch(TArray<FStat> InModifiers, const EStatModifierType InType)
+FStatModifierHandle UFormStatComponent::InternalAddStatModifier(const FGameplayTag& InStatTag,
+                                                                const EStatModifierType InType, const float InValue)
 {
-	bool bRemovedSomething = false;
-	TArray<FStat>* StatModifierArray;
-	switch (InType)
+	if (InType != Additive && InType != AdditiveMultiplicative && InType != TrueMultiplicative && InType !=
+		FlatAdditive)
 	{
-	case Additive:
-		StatModifierArray = &AdditiveStatModifiers;
-		break;
-	case AdditiveMultiplicative:
-		StatModifierArray = &AdditiveMultiplicativeStatModifiers;
-		break;
-	case TrueMultiplicative:
-		StatModifierArray = &TrueMultiplicativeStatModifiers;
-		break;
-	case FlatAdditive:
-		StatModifierArray = &FlatAdditiveStatModifiers;
-		break;
-	default:
-		return false;
+		UE_LOG(LogSfCore, Error, TEXT("Server_AddStatModifier was called with an invalid EStatModifierType."));
+		return FStatModifierHandle();
 	}
-	for (int16 i = StatModifierArray->Num(); i >= 0; i--)
+	//Id 0 is reserved for invalid handles.
+	LastStatModifierId = LastStatModifierId == MAX_int32 ? 1 : LastStatModifierId + 1;
+	const FStatModifier& Modifier = StatModifiers.Emplace(LastStatModifierId, FStatModifier(InStatTag, InType, InValue));
+	//Modifiers for stats not in base stats are kept but ignored.
+	if (FStatAggregate* Aggregate = StatAggregates.Find(InStatTag))
 	{
-		const FStat& StatModifier = (*StatModifierArray)[i];
-		const int16 InModifierIndex = InModifiers.Find(StatModifier);
-		if (InModifierIndex == INDEX_NONE) continue;
-		InModifiers.RemoveAtSwap(InModifierIndex, 1, false);
-		StatModifierArray->RemoveAt(i, 1, false);
-		bRemovedSomething = true;
-		CalculateStat(StatModifier.StatTag);
+		Aggregate->AddModifier(LastStatModifierId, Modifier);
 	}
-	StatModifierArray->Shrink();
-	return bRemovedSomething;
+	return FStatModifierHandle(LastStatModifierId);
+}
+
+bool UFormStatComponent::InternalRemoveStatModifier(const FStatModifierHandle& InHandle, FGameplayTag& OutStatTag)
+{
+	const FStatModifier* Modifier = StatModifiers.Find(InHandle.Id);
+	if (!Modifier) return false;
+	OutStatTag = Modifier->StatTag;
+	if (FStatAggregate* Aggregate = StatAggregates.Find(Modifier->StatTag))
+	{
+		Aggregate->RemoveModifier(InHandle.Id, *Modifier);
+	}
+	StatModifiers.Remove(InHandle.Id);
+	return true;
+}
+
+FStatModifierHandle UFormStatComponent::FindStatModifier(const FStat& InModifier,
+                                                         const EStatModifierType InType) const
+{
+	if (static_cast<uint8>(InType) > FlatAdditive) return FStatModifierHandle();
+	if (const FStatAggregate* Aggregate = StatAggregates.Find(InModifier.StatTag))
+	{
+		for (const TPair<int32, float>& Modifier : Aggregate->ModifiersByType[InType])
+		{
+			if (Modifier.Value == InModifier.Value) return FStatModifierHandle(Modifier.Key);
+		}
+		return FStatModifierHandle();
+	}
+	//Modifiers of stats not in base stats aren't kept per stat. Lower ids were added first unless ids have wrapped.
+	int32 FoundId = 0;
+	for (const TPair<int32, FStatModifier>& Pair : StatModifiers)
+	{
+		if (Pair.Value.Type != InType || Pair.Value.StatTag != InModifier.StatTag || Pair.Value.Value != InModifier.
+			Value)
+			continue;
+		if (FoundId == 0 || Pair.Key < FoundId)
+		{
+			FoundId = Pair.Key;
+		}
+	}
+	return FStatModifierHandle(FoundId);
 }
 
 TArray<FStat>& UFormStatComponent::GetCurrentStats()
@@ -272,4 +475,25 @@ void UFormStatComponent::SetupFormStat()
 	CurrentStats.Items = BaseStats;
 	CurrentStats.MarkArrayDirty();
 	MARK_PROPERTY_DIRTY_FROM_NAME(UFormStatComponent, CurrentStats, this);
+	//Current stats share indices with base stats. With duplicates only the first is used.
+	StatAggregates.Empty(BaseStats.Num());
+	for (int32 i = 0; i < BaseStats.Num(); i++)
+	{
+		if (StatAggregates.Contains(BaseStats[i].StatTag)) continue;
+		StatAggregates.Emplace(BaseStats[i].StatTag, FStatAggregate(i));
+	}
+	//Include any modifiers that were added before setup, in the order they were added.
+	StatModifiers.KeySort(TLess<int32>());
+	for (const TPair<int32, FStatModifier>& Pair : StatModifiers)
+	{
+		if (FStatAggregate* Aggregate = StatAggregates.Find(Pair.Value.StatTag))
+		{
+			Aggregate->AddModifier(Pair.Key, Pair.Value);
+		}
+	}
+	for (const TPair<FGameplayTag, FStatAggregate>& Pair : StatAggregates)
+	{
+		if (Pair.Value.ModifierCount == 0) continue;
+		CalculateStat(Pair.Key);
+	}
 }
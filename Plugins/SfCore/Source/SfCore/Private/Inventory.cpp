@@ -7,13 +7,21 @@
 #include "FormCharacterComponent.h"
 #include "FormCoreComponent.h"
 #include "Slotable.h"
+#include "Algo/BinarySearch.h"
 #include "Net/UnrealNetwork.h"
 #include "Net/Core/PushModel/PushModel.h"
 
+uint32 UInventory::LastCardsVersion = 0;
+
 UInventory::UInventory(): OwningFormCore(nullptr), bIsDynamic(false), bIsChangeLocked(false), LocalInventoryTime(0)
 {
 	bIsOnFormCharacter = false;
 	bInitialized = false;
+	bCardIndexDirty = true;
+	CardsVersion = ++LastCardsVersion;
+	CardDigest = 0;
+	CardDigestVersion = 0;
+	bCardExpiryQueuesDirty = true;
 }
 
 void UInventory::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
@@ -35,17 +43,45 @@ void UInventory::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifeti
 	DOREPLIFETIME_WITH_PARAMS_FAST(UInventory, Cards, CardParams);
 }
 
+struct FServerCardExpiryPredicate
+{
+	bool operator()(const FCardExpiryEntry& A, const FCardExpiryEntry& B) const
+	{
+		return A.LifetimeEndTimestamp < B.LifetimeEndTimestamp;
+	}
+};
+
+struct FPredictedCardExpiryPredicate
+{
+	bool operator()(const FCardExpiryEntry& A, const FCardExpiryEntry& B) const
+	{
+		//The predicted net clock loops, so we compare using the shorter distance around the loop.
+		return UFormCharacterComponent::CalculateTimeBetweenPredictedTimestamps(
+			B.LifetimeEndTimestamp, A.LifetimeEndTimestamp) < 0;
+	}
+};
+
 void UInventory::AuthorityTick(float DeltaTime)
 {
 	//We remove server timestamp cards with ended lifetimes only on the server.
 	//This is synchronized to clients through the FormCharacter and normal replication depending on the role of the client.
-	for (int16 i = Cards.Num() - 1; i >= 0; i--)
+	if (bCardExpiryQueuesDirty)
 	{
-		if (!Cards[i].bUsingPredictedTimestamp && Cards[i].LifetimeEndTimestamp > -1.f && CalculateTimeUntilServerTimestamp(
-			GetWorld(), Cards[i].LifetimeEndTimestamp) < 0)
-		{
-			Server_RemoveOwnedCard(Cards[i].Class, Cards[i].OwnerConstituentInstanceId);
-		}
+		RebuildCardExpiryQueues();
+	}
+	while (ServerCardExpiryQueue.Num() > 0 && CalculateTimeUntilServerTimestamp(
+		GetWorld(), ServerCardExpiryQueue.HeapTop().LifetimeEndTimestamp) < 0)
+	{
+		FCardExpiryEntry Entry;
+		ServerCardExpiryQueue.HeapPop(Entry, FServerCardExpiryPredicate(), false);
+		//Skip entries of cards that have already been removed or replaced.
+		const int32 Index = FindCardIndex(Entry.Class, Entry.OwnerConstituentInstanceId);
+		if (Index == INDEX_NONE) continue;
+		const FCard& Card = Cards[Index];
+		if (Card.bUsingPredictedTimestamp || Card.bIsDisabledForDestroy || Card.LifetimeEndTimestamp != Entry.
+			LifetimeEndTimestamp)
+			continue;
+		Server_RemoveOwnedCard(Entry.Class, Entry.OwnerConstituentInstanceId);
 	}
 }
 
@@ -146,6 +182,8 @@ void UInventory::ClientCheckAndUpdateCardObjects()
 
 void UInventory::OnRep_Cards()
 {
+	MarkCardIndexDirty();
+	MarkCardExpiryQueuesDirty();
 	ClientCheckAndUpdateCardObjects();
 }
 
@@ -217,16 +255,8 @@ bool UInventory::HasSharedCard(const TSubclassOf<UCardObject>& InCardClass) cons
 		       *GetClass()->GetName());
 		return false;
 	}
-	for (const FCard& Card : Cards)
-	{
-		//If disabled we don't count it as existing.
-		if (Card.bIsDisabledForDestroy) continue;
-		if (Card.Class == InCardClass && Card.OwnerConstituentInstanceId == 0)
-		{
-			return true;
-		}
-	}
-	return false;
+	//If disabled we don't count it as existing.
+	return FindEnabledCard(InCardClass, 0) != nullptr;
 }
 
 bool UInventory::HasOwnedCard(const TSubclassOf<UCardObject>& InCardClass,
@@ -238,16 +268,8 @@ bool UInventory::HasOwnedCard(const TSubclassOf<UCardObject>& InCardClass,
 		       *GetClass()->GetName());
 		return false;
 	}
-	for (const FCard& Card : Cards)
-	{
-		//If disabled we don't count it as existing.
-		if (Card.bIsDisabledForDestroy) continue;
-		if (Card.Class == InCardClass && Card.OwnerConstituentInstanceId == InOwnerConstituentInstanceId)
-		{
-			return true;
-		}
-	}
-	return false;
+	//If disabled we don't count it as existing.
+	return FindEnabledCard(InCardClass, InOwnerConstituentInstanceId) != nullptr;
 }
 
 float UInventory::GetSharedCardLifetime(const TSubclassOf<UCardObject>& InCardClass)
@@ -673,14 +695,9 @@ bool UInventory::Server_AddOwnedCard(const TSubclassOf<UCardObject>& InCardClass
 		       *GetClass()->GetName());
 		return false;
 	}
-	for (FCard Card : Cards)
-	{
-		//Check for duplicates.
-		if (Card.Class == InCardClass && Card.OwnerConstituentInstanceId == InOwnerConstituentInstanceId)
-		{
-			return false;
-		}
-	}
+	//Check for duplicates.
+	if (FindCardIndex(InCardClass, InOwnerConstituentInstanceId) != INDEX_NONE) return false;
+	if (!FCard::IsClassIndexed(InCardClass)) return false;
 	if (InCustomLifetime != 0)
 	{
 		//References to FormCharacter and FormCore are needed because they provide timestamps for lifetime.
@@ -710,7 +727,9 @@ bool UInventory::Server_AddOwnedCard(const TSubclassOf<UCardObject>& InCardClass
 			              nullptr, OwningFormCore);
 		}
 	}
+	IndexLastCard();
 	FCard& CardAdded = Cards.Last();
+	AddCardToExpiryQueue(CardAdded);
 	if (FormCharacter)
 	{
 		FormCharacter->bMovementSpeedNeedsRecalculation = true;
@@ -742,40 +761,36 @@ bool UInventory::Server_RemoveOwnedCard(const TSubclassOf<UCardObject>& InCardCl
 		       *GetClass()->GetName());
 		return false;
 	}
-	for (int16 i = Cards.Num() - 1; i >= 0; i--)
+	const int32 i = FindCardIndex(InCardClass, InOwnerConstituentInstanceId);
+	if (i == INDEX_NONE) return false;
+	if (FormCharacter)
 	{
-		if (Cards[i].Class == InCardClass && Cards[i].OwnerConstituentInstanceId == InOwnerConstituentInstanceId)
-		{
-			if (FormCharacter)
-			{
-				//Same concept as above.
-				Cards[i].bIsDisabledForDestroy = true;
-				Cards[i].ServerAwaitClientSyncTimeoutTimestamp = Cards[i].ServerAwaitClientSyncTimeoutDuration +
-					GetWorld()->
-					TimeSeconds;
-				FormCharacter->MarkCardsDirty();
-				MARK_PROPERTY_DIRTY_FROM_NAME(UInventory, Cards, this);
-				return true;
-			}
-			//Otherwise remove it instantly.
-			if (InOwnerConstituentInstanceId == 0)
-			{
-				CallBindedOnRemoveSharedCardDelegates(Cards[i], false);
-			}
-			else
-			{
-				CallBindedOnAddOwnedCardDelegates(Cards[i], false);
-			}
-			Cards.RemoveAt(i);
-			MARK_PROPERTY_DIRTY_FROM_NAME(UInventory, Cards, this);
-			if (FormCharacter)
-			{
-				FormCharacter->bMovementSpeedNeedsRecalculation = true;
-			}
-			return true;
-		}
+		//Same concept as above.
+		Cards[i].bIsDisabledForDestroy = true;
+		Cards[i].ServerAwaitClientSyncTimeoutTimestamp = Cards[i].ServerAwaitClientSyncTimeoutDuration +
+			GetWorld()->
+			TimeSeconds;
+		MarkCardsChanged();
+		FormCharacter->MarkCardsDirty();
+		MARK_PROPERTY_DIRTY_FROM_NAME(UInventory, Cards, this);
+		return true;
 	}
-	return false;
+	//Otherwise remove it instantly.
+	if (InOwnerConstituentInstanceId == 0)
+	{
+		CallBindedOnRemoveSharedCardDelegates(Cards[i], false);
+	}
+	else
+	{
+		CallBindedOnRemoveOwnedCardDelegates(Cards[i], false);
+	}
+	RemoveCardAt(i);
+	MARK_PROPERTY_DIRTY_FROM_NAME(UInventory, Cards, this);
+	if (FormCharacter)
+	{
+		FormCharacter->bMovementSpeedNeedsRecalculation = true;
+	}
+	return true;
 }
 
 bool UInventory::Predicted_AddSharedCard(const TSubclassOf<UCardObject>& InCardClass, const float InCustomLifetime)
@@ -819,14 +834,9 @@ bool UInventory::Predicted_AddOwnedCard(const TSubclassOf<UCardObject>& InCardCl
 		return false;
 	}
 	FormCharacter->bMovementSpeedNeedsRecalculation = true;
-	for (FCard Card : Cards)
-	{
-		//Check for duplicates.
-		if (Card.Class == InCardClass && Card.OwnerConstituentInstanceId == InOwnerConstituentInstanceId)
-		{
-			return false;
-		}
-	}
+	//Check for duplicates.
+	if (FindCardIndex(InCardClass, InOwnerConstituentInstanceId) != INDEX_NONE) return false;
+	if (!FCard::IsClassIndexed(InCardClass)) return false;
 	if (InCustomLifetime != 0)
 	{
 		//References to FormCharacter and FormCore are needed because they provide timestamps for lifetime.
@@ -838,6 +848,9 @@ bool UInventory::Predicted_AddOwnedCard(const TSubclassOf<UCardObject>& InCardCl
 		Cards.Emplace(InCardClass, FCard::ECardType::UseDefaultLifetimePredictedTimestamp, InOwnerConstituentInstanceId,
 		              FormCharacter);
 	}
+	IndexLastCard();
+	AddCardToExpiryQueue(Cards.Last());
+	FormCharacter->RecordPredictedChange();
 	if (InOwnerConstituentInstanceId == 0)
 	{
 		CallBindedOnAddSharedCardDelegates(Cards.Last(), true);
@@ -885,40 +898,36 @@ bool UInventory::Predicted_RemoveOwnedCard(const TSubclassOf<UCardObject>& InCar
 		return false;
 	}
 	FormCharacter->bMovementSpeedNeedsRecalculation = true;
-	for (int16 i = Cards.Num() - 1; i >= 0; i--)
+	const int32 i = FindCardIndex(InCardClass, InOwnerConstituentInstanceId);
+	if (i == INDEX_NONE) return false;
+	//We always instantly destroy as we should be able to sync instantly.
+	if (InOwnerConstituentInstanceId == 0)
+	{
+		CallBindedOnRemoveSharedCardDelegates(Cards[i], true);
+	}
+	else
+	{
+		CallBindedOnRemoveOwnedCardDelegates(Cards[i], true);
+	}
+	RemoveCardAt(i);
+	FormCharacter->RecordPredictedChange();
+	if (HasAuthority())
+	{
+		MARK_PROPERTY_DIRTY_FROM_NAME(UInventory, Cards, this);
+	}
+	else
+	{
+		ClientCheckAndUpdateCardObjects();
+	}
+	//Check buffered inputs.
+	for (USlotable* Slotable : Slotables)
 	{
-		if (Cards[i].Class == InCardClass && Cards[i].OwnerConstituentInstanceId == InOwnerConstituentInstanceId)
+		for (UConstituent* Constituent : Slotable->GetConstituents())
 		{
-			//We always instantly destroy as we should be able to sync instantly.
-			if (InOwnerConstituentInstanceId == 0)
-			{
-				CallBindedOnRemoveSharedCardDelegates(Cards[i], true);
-			}
-			else
-			{
-				CallBindedOnAddOwnedCardDelegates(Cards[i], true);
-			}
-			Cards.RemoveAt(i);
-			if (HasAuthority())
-			{
-				MARK_PROPERTY_DIRTY_FROM_NAME(UInventory, Cards, this);
-			}
-			else
-			{
-				ClientCheckAndUpdateCardObjects();
-			}
-			//Check buffered inputs.
-			for (USlotable* Slotable : Slotables)
-			{
-				for (UConstituent* Constituent : Slotable->GetConstituents())
-				{
-					UpdateAndRunBufferedInputs(Constituent);
-				}
-			}
-			return true;
+			UpdateAndRunBufferedInputs(Constituent);
 		}
 	}
-	return false;
+	return true;
 }
 
 void UInventory::SetupInputs(const UFormCharacterComponent* FormCharacterComponent)
@@ -926,10 +935,10 @@ void UInventory::SetupInputs(const UFormCharacterComponent* FormCharacterCompone
 	if (!FormCharacterComponent) return;
 	//Clear bindings and input states as this function may be called more than once.
 	OrderedInputBindingIndices.Empty();
-	OrderedLastInputState.Empty();
+	LastInputBits = 0;
+	OrderedLastInputState.Init(false, OrderedInputBindings.Num());
 	//Translate InputActions to indices so we don't have to search when applying inputs.
 	OrderedInputBindingIndices.Reserve(OrderedInputBindings.Num());
-	OrderedLastInputState.Reserve(OrderedInputBindings.Num());
 	for (UInputAction* Input : OrderedInputBindings)
 	{
 		if (Input == nullptr)
@@ -939,19 +948,27 @@ void UInventory::SetupInputs(const UFormCharacterComponent* FormCharacterCompone
 		}
 		else
 		{
-			const uint8 Index = FormCharacterComponent->InputActionRegistry.Find(Input);
+			const int32 Index = FormCharacterComponent->InputActionRegistry.Find(Input);
 			if (Index == INDEX_NONE)
 			{
 				UE_LOG(LogSfCore, Error,
 				       TEXT(
 					       "Found input on UInventory class %s that is unregistered with the UFormCharacterComponent. Skipping."
 				       ), *GetClass()->GetName());
+				//The slot is kept unbound so the indices still line up with the slotables.
+				OrderedInputBindingIndices.Add(INDEX_NONE);
 				continue;
 			}
 			OrderedInputBindingIndices.Add(Index);
 		}
-		OrderedLastInputState.Add(false);
 	}
+	MarkConstituentTableDirty();
+}
+
+void UInventory::MarkConstituentTableDirty() const
+{
+	if (!OwningFormCore) return;
+	OwningFormCore->MarkConstituentTableDirty();
 }
 
 void UInventory::AutonomousInitialize()
@@ -999,6 +1016,7 @@ void UInventory::ServerInitialize()
 	Cards.Reserve(InitialSharedCardClassesInfiniteLifetime.Num());
 	for (const TSubclassOf<UCardObject> CardClass : InitialSharedCardClassesInfiniteLifetime)
 	{
+		if (!FCard::IsClassIndexed(CardClass)) continue;
 		if (bIsOnFormCharacter)
 		{
 			Cards.Emplace(CardClass, FCard::ECardType::UseDefaultLifetimePredictedTimestamp,
@@ -1010,6 +1028,7 @@ void UInventory::ServerInitialize()
 			              0,
 			              nullptr, OwningFormCore);
 		}
+		IndexLastCard();
 		FCard& CardAdded = Cards.Last();
 		CardAdded.LifetimeEndTimestamp = -1.f;
 		if (bIsOnFormCharacter)
@@ -1050,6 +1069,7 @@ void UInventory::ServerDeinitialize()
 
 void UInventory::AssignConstituentInstanceId(UConstituent* Constituent)
 {
+	MarkConstituentTableDirty();
 	//If less than max value - 1 we can keep adding.
 	//0 is intentionally left unused.
 	if (LastAssignedConstituentId < 255)
@@ -1109,6 +1129,30 @@ void UInventory::RemoveCardsOfOwner(const int32 InOwnerConstituentInstanceId)
 	}
 }
 
+void UInventory::RemovePredictedCardsWithEndedLifetimes(const UFormCharacterComponent* FormCharacter)
+{
+	if (!FormCharacter) return;
+	if (bCardExpiryQueuesDirty)
+	{
+		RebuildCardExpiryQueues();
+	}
+	//Cards are removed together after the queue is drained, so indices found while draining stay valid.
+	TArray<int32, TInlineAllocator<8>> ExpiredIndices;
+	while (PredictedCardExpiryQueue.Num() > 0 && FormCharacter->CalculateTimeUntilPredictedTimestamp(
+		PredictedCardExpiryQueue.HeapTop().LifetimeEndTimestamp) < 0)
+	{
+		FCardExpiryEntry Entry;
+		PredictedCardExpiryQueue.HeapPop(Entry, FPredictedCardExpiryPredicate(), false);
+		//Skip entries of cards that have already been removed or replaced.
+		const int32 Index = FindCardIndex(Entry.Class, Entry.OwnerConstituentInstanceId);
+		if (Index == INDEX_NONE) continue;
+		const FCard& Card = Cards[Index];
+		if (!Card.bUsingPredictedTimestamp || Card.LifetimeEndTimestamp != Entry.LifetimeEndTimestamp) continue;
+		ExpiredIndices.Add(Index);
+	}
+	RemoveCardsAt(ExpiredIndices, false);
+}
+
 bool UInventory::IsDynamicLength() const
 {
 	return bIsDynamic;
@@ -1117,12 +1161,16 @@ bool UInventory::IsDynamicLength() const
 TArray<const FCard*> UInventory::GetCardsOfClass(const TSubclassOf<UCardObject>& InClass) const
 {
 	TArray<const FCard*> Result;
-	for (const FCard& Card : Cards)
+	if (bCardIndexDirty)
 	{
-		if (Card.Class == InClass)
-		{
-			Result.Add(&Card);
-		}
+		RebuildCardIndex();
+	}
+	const TArray<int32>* Indices = CardIndicesByClass.Find(InClass);
+	if (!Indices) return Result;
+	Result.Reserve(Indices->Num());
+	for (const int32 Index : *Indices)
+	{
+		Result.Add(&Cards[Index]);
 	}
 	return Result;
 }
@@ -1136,16 +1184,7 @@ void UInventory::Server_BindOnAddSlotable(const TSubclassOf<USlotable>& InSlotab
 		       *GetClass()->GetName());
 		return;
 	}
-	//Add to existing pair if possible, otherwise add pair.
-	for (TPair<TSubclassOf<USlotable>, TSet<FOnAddSlotable>>& Pair : BindedOnAddSlotableDelegates)
-	{
-		if (Pair.Key == InSlotableClass)
-		{
-			Pair.Value.Add(EventToBind);
-			return;
-		}
-	}
-	BindedOnAddSlotableDelegates.Emplace(InSlotableClass, TSet{EventToBind});
+	BindedOnAddSlotableDelegates.Bind(InSlotableClass.Get(), EventToBind);
 }
 
 void UInventory::Server_BindOnRemoveSlotable(const TSubclassOf<USlotable>& InSlotableClass,
@@ -1158,16 +1197,7 @@ void UInventory::Server_BindOnRemoveSlotable(const TSubclassOf<USlotable>& InSlo
 		       *GetClass()->GetName());
 		return;
 	}
-	//Add to existing pair if possible, otherwise add pair.
-	for (TPair<TSubclassOf<USlotable>, TSet<FOnRemoveSlotable>>& Pair : BindedOnRemoveSlotableDelegates)
-	{
-		if (Pair.Key == InSlotableClass)
-		{
-			Pair.Value.Add(EventToBind);
-			return;
-		}
-	}
-	BindedOnRemoveSlotableDelegates.Emplace(InSlotableClass, TSet{EventToBind});
+	BindedOnRemoveSlotableDelegates.Bind(InSlotableClass.Get(), EventToBind);
 }
 
 void UInventory::BindOnAddSharedCard(const TSubclassOf<UCardObject>& InCardClass, const FOnAddSharedCard& EventToBind)
@@ -1178,16 +1208,7 @@ void UInventory::BindOnAddSharedCard(const TSubclassOf<UCardObject>& InCardClass
 		       *GetClass()->GetName());
 		return;
 	}
-	//Add to existing pair if possible, otherwise add pair.
-	for (TPair<TSubclassOf<UCardObject>, TSet<FOnAddSharedCard>>& Pair : BindedOnAddSharedCardDelegates)
-	{
-		if (Pair.Key == InCardClass)
-		{
-			Pair.Value.Add(EventToBind);
-			return;
-		}
-	}
-	BindedOnAddSharedCardDelegates.Emplace(InCardClass, TSet{EventToBind});
+	BindedOnAddSharedCardDelegates.Bind(InCardClass.Get(), EventToBind);
 }
 
 void UInventory::BindOnRemoveSharedCard(const TSubclassOf<UCardObject>& InCardClass,
@@ -1199,16 +1220,7 @@ void UInventory::BindOnRemoveSharedCard(const TSubclassOf<UCardObject>& InCardCl
 		       *GetClass()->GetName());
 		return;
 	}
-	//Add to existing pair if possible, otherwise add pair.
-	for (TPair<TSubclassOf<UCardObject>, TSet<FOnRemoveSharedCard>>& Pair : BindedOnRemoveSharedCardDelegates)
-	{
-		if (Pair.Key == InCardClass)
-		{
-			Pair.Value.Add(EventToBind);
-			return;
-		}
-	}
-	BindedOnRemoveSharedCardDelegates.Emplace(InCardClass, TSet{EventToBind});
+	BindedOnRemoveSharedCardDelegates.Bind(InCardClass.Get(), EventToBind);
 }
 
 void UInventory::BindOnAddOwnedCard(const TSubclassOf<UCardObject>& InCardClass, const FOnAddOwnedCard& EventToBind)
@@ -1219,16 +1231,7 @@ void UInventory::BindOnAddOwnedCard(const TSubclassOf<UCardObject>& InCardClass,
 		       *GetClass()->GetName());
 		return;
 	}
-	//Add to existing pair if possible, otherwise add pair.
-	for (TPair<TSubclassOf<UCardObject>, TSet<FOnAddOwnedCard>>& Pair : BindedOnAddOwnedCardDelegates)
-	{
-		if (Pair.Key == InCardClass)
-		{
-			Pair.Value.Add(EventToBind);
-			return;
-		}
-	}
-	BindedOnAddOwnedCardDelegates.Emplace(InCardClass, TSet{EventToBind});
+	BindedOnAddOwnedCardDelegates.Bind(InCardClass.Get(), EventToBind);
 }
 
 void UInventory::BindOnRemoveOwnedCard(const TSubclassOf<UCardObject>& InCardClass,
@@ -1240,25 +1243,93 @@ void UInventory::BindOnRemoveOwnedCard(const TSubclassOf<UCardObject>& InCardCla
 		       *GetClass()->GetName());
 		return;
 	}
-	//Add to existing pair if possible, otherwise add pair.
-	for (TPair<TSubclassOf<UCardObject>, TSet<FOnRemoveOwnedCard>>& Pair : BindedOnRemoveOwnedCardDelegates)
+	BindedOnRemoveOwnedCardDelegates.Bind(InCardClass.Get(), EventToBind);
+}
+
+void UInventory::Server_UnbindOnAddSlotable(const TSubclassOf<USlotable>& InSlotableClass,
+                                            const FOnAddSlotable& EventToUnbind)
+{
+	if (!InSlotableClass.Get())
 	{
-		if (Pair.Key == InCardClass)
-		{
-			Pair.Value.Add(EventToBind);
-			return;
-		}
+		UE_LOG(LogSfCore, Error,
+		       TEXT("Server_UnbindOnAddSlotable called with empty TSubclassOf in UInventory class %s."),
+		       *GetClass()->GetName());
+		return;
+	}
+	BindedOnAddSlotableDelegates.Unbind(InSlotableClass.Get(), EventToUnbind);
+}
+
+void UInventory::Server_UnbindOnRemoveSlotable(const TSubclassOf<USlotable>& InSlotableClass,
+                                               const FOnRemoveSlotable& EventToUnbind)
+{
+	if (!InSlotableClass.Get())
+	{
+		UE_LOG(LogSfCore, Error,
+		       TEXT("Server_UnbindOnRemoveSlotable called with empty TSubclassOf in UInventory class %s."),
+		       *GetClass()->GetName());
+		return;
+	}
+	BindedOnRemoveSlotableDelegates.Unbind(InSlotableClass.Get(), EventToUnbind);
+}
+
+void UInventory::UnbindOnAddSharedCard(const TSubclassOf<UCardObject>& InCardClass,
+                                       const FOnAddSharedCard& EventToUnbind)
+{
+	if (!InCardClass.Get())
+	{
+		UE_LOG(LogSfCore, Error, TEXT("UnbindOnAddSharedCard called with empty TSubclassOf in UInventory class %s."),
+		       *GetClass()->GetName());
+		return;
+	}
+	BindedOnAddSharedCardDelegates.Unbind(InCardClass.Get(), EventToUnbind);
+}
+
+void UInventory::UnbindOnRemoveSharedCard(const TSubclassOf<UCardObject>& InCardClass,
+                                          const FOnRemoveSharedCard& EventToUnbind)
+{
+	if (!InCardClass.Get())
+	{
+		UE_LOG(LogSfCore, Error, TEXT("UnbindOnRemoveSharedCard called with empty TSubclassOf in UInventory class %s."),
+		       *GetClass()->GetName());
+		return;
+	}
+	BindedOnRemoveSharedCardDelegates.Unbind(InCardClass.Get(), EventToUnbind);
+}
+
+void UInventory::UnbindOnAddOwnedCard(const TSubclassOf<UCardObject>& InCardClass, const FOnAddOwnedCard& EventToUnbind)
+{
+	if (!InCardClass.Get())
+	{
+		UE_LOG(LogSfCore, Error, TEXT("UnbindOnAddOwnedCard called with empty TSubclassOf in UInventory class %s."),
+		       *GetClass()->GetName());
+		return;
+	}
+	BindedOnAddOwnedCardDelegates.Unbind(InCardClass.Get(), EventToUnbind);
+}
+
+void UInventory::UnbindOnRemoveOwnedCard(const TSubclassOf<UCardObject>& InCardClass,
+                                         const FOnRemoveOwnedCard& EventToUnbind)
+{
+	if (!InCardClass.Get())
+	{
+		UE_LOG(LogSfCore, Error, TEXT("UnbindOnRemoveOwnedCard called with empty TSubclassOf in UInventory class %s."),
+		       *GetClass()->GetName());
+		return;
 	}
-	BindedOnRemoveOwnedCardDelegates.Emplace(InCardClass, TSet{EventToBind});
+	BindedOnRemoveOwnedCardDelegates.Unbind(InCardClass.Get(), EventToUnbind);
 }
 
 UConstituent* UInventory::GetConstituentFromInstanceId(const uint8 Id)
 {
-	for (USlotable* Slotable : Slotables)
+	const int32 Index = OwningFormCore ? OwningFormCore->GetInventoryIndex(this) : INDEX_NONE;
+	if (Index != INDEX_NONE) return OwningFormCore->FindConstituent(Index, Id);
+	//Inventories that aren't on a form core yet aren't in its constituent table.
+	for (const USlotable* Slotable : Slotables)
 	{
+		if (!Slotable) continue;
 		for (UConstituent* Constituent : Slotable->GetConstituents())
 		{
-			if (Constituent->GetInstanceId() == Id)
+			if (Constituent && Constituent->GetInstanceId() == Id)
 			{
 				return Constituent;
 			}
@@ -1269,189 +1340,111 @@ UConstituent* UInventory::GetConstituentFromInstanceId(const uint8 Id)
 
 void UInventory::CallBindedOnAddSlotableDelegates(USlotable* Slotable)
 {
-	for (TPair<TSubclassOf<USlotable>, TSet<FOnAddSlotable>>& Pair : BindedOnAddSlotableDelegates)
+	//Copied as the called events may bind or unbind delegates.
+	const TArray<FOnAddSlotable, TInlineAllocator<8>> Delegates(BindedOnAddSlotableDelegates.GetDispatchList(
+		Slotable->GetClass(), USlotable::StaticClass()));
+	if (Delegates.IsEmpty()) return;
+	for (const FOnAddSlotable& Delegate : Delegates)
 	{
-		//Always call if it is USlotable.
-		if (Pair.Key.Get() == USlotable::StaticClass())
+		if (!Delegate.IsBound())
 		{
-			for (FOnAddSlotable& Delegate : Pair.Value)
-			{
-				Delegate.ExecuteIfBound(Slotable);
-			}
+			//Rebuild so the unbound delegate is removed.
+			BindedOnAddSlotableDelegates.Invalidate();
 			continue;
 		}
-		//Otherwise call if it is the class of the added slotable.
-		if (Pair.Key == Slotable->GetClass())
-		{
-			for (FOnAddSlotable& Delegate : Pair.Value)
-			{
-				Delegate.ExecuteIfBound(Slotable);
-			}
-		}
+		Delegate.Execute(Slotable);
 	}
 }
 
 void UInventory::CallBindedOnRemoveSlotableDelegates(USlotable* Slotable)
 {
-	for (TPair<TSubclassOf<USlotable>, TSet<FOnRemoveSlotable>>& Pair : BindedOnRemoveSlotableDelegates)
+	//Copied as the called events may bind or unbind delegates.
+	const TArray<FOnRemoveSlotable, TInlineAllocator<8>> Delegates(BindedOnRemoveSlotableDelegates.GetDispatchList(
+		Slotable->GetClass(), USlotable::StaticClass()));
+	if (Delegates.IsEmpty()) return;
+	for (const FOnRemoveSlotable& Delegate : Delegates)
 	{
-		//Always call if it is USlotable.
-		if (Pair.Key.Get() == USlotable::StaticClass())
+		if (!Delegate.IsBound())
 		{
-			for (FOnRemoveSlotable& Delegate : Pair.Value)
-			{
-				Delegate.ExecuteIfBound(Slotable);
-			}
+			//Rebuild so the unbound delegate is removed.
+			BindedOnRemoveSlotableDelegates.Invalidate();
 			continue;
 		}
-		//Otherwise call if it is the class of the removed slotable.
-		if (Pair.Key == Slotable->GetClass())
-		{
-			for (FOnRemoveSlotable& Delegate : Pair.Value)
-			{
-				Delegate.ExecuteIfBound(Slotable);
-			}
-		}
+		Delegate.Execute(Slotable);
 	}
 }
 
 void UInventory::CallBindedOnAddSharedCardDelegates(FCard& Card, const bool bInIsPredictableContext)
 {
-	for (TPair<TSubclassOf<UCardObject>, TSet<FOnAddSharedCard>>& Pair : BindedOnAddSharedCardDelegates)
+	//Copied as the called events may bind or unbind delegates.
+	const TArray<FOnAddSharedCard, TInlineAllocator<8>> Delegates(BindedOnAddSharedCardDelegates.GetDispatchList(
+		Card.Class.Get(), UCardObject::StaticClass()));
+	if (Delegates.IsEmpty()) return;
+	for (const FOnAddSharedCard& Delegate : Delegates)
 	{
-		//Always call if it is UCardObject.
-		if (Pair.Key.Get() == UCardObject::StaticClass())
+		if (!Delegate.IsBound())
 		{
-			for (FOnAddSharedCard& Delegate : Pair.Value)
-			{
-				Delegate.ExecuteIfBound(Card.Class, bInIsPredictableContext);
-			}
+			//Rebuild so the unbound delegate is removed.
+			BindedOnAddSharedCardDelegates.Invalidate();
 			continue;
 		}
-		//Otherwise call if it is the class of the added card.
-		if (Pair.Key == Card.Class)
-		{
-			for (FOnAddSharedCard& Delegate : Pair.Value)
-			{
-				Delegate.ExecuteIfBound(Card.Class, bInIsPredictableContext);
-			}
-		}
+		Delegate.Execute(Card.Class, bInIsPredictableContext);
 	}
 }
 
 void UInventory::CallBindedOnRemoveSharedCardDelegates(FCard& Card, const bool bInIsPredictableContext)
 {
-	for (TPair<TSubclassOf<UCardObject>, TSet<FOnRemoveSharedCard>>& Pair : BindedOnRemoveSharedCardDelegates)
+	//Copied as the called events may bind or unbind delegates.
+	const TArray<FOnRemoveSharedCard, TInlineAllocator<8>> Delegates(BindedOnRemoveSharedCardDelegates.GetDispatchList(
+		Card.Class.Get(), UCardObject::StaticClass()));
+	if (Delegates.IsEmpty()) return;
+	for (const FOnRemoveSharedCard& Delegate : Delegates)
 	{
-		//Always call if it is UCardObject.
-		if (Pair.Key.Get() == UCardObject::StaticClass())
+		if (!Delegate.IsBound())
 		{
-			for (FOnRemoveSharedCard& Delegate : Pair.Value)
-			{
-				Delegate.ExecuteIfBound(Card.Class, bInIsPredictableContext);
-			}
+			//Rebuild so the unbound delegate is removed.
+			BindedOnRemoveSharedCardDelegates.Invalidate();
 			continue;
 		}
-		//Otherwise call if it is the class of the removed card.
-		if (Pair.Key == Card.Class)
-		{
-			for (FOnRemoveSharedCard& Delegate : Pair.Value)
-			{
-				Delegate.ExecuteIfBound(Card.Class, bInIsPredictableContext);
-			}
-		}
+		Delegate.Execute(Card.Class, bInIsPredictableContext);
 	}
 }
 
 void UInventory::CallBindedOnAddOwnedCardDelegates(FCard& Card, const bool bInIsPredictableContext)
 {
-	for (TPair<TSubclassOf<UCardObject>, TSet<FOnAddOwnedCard>>& Pair : BindedOnAddOwnedCardDelegates)
+	//Copied as the called events may bind or unbind delegates.
+	const TArray<FOnAddOwnedCard, TInlineAllocator<8>> Delegates(BindedOnAddOwnedCardDelegates.GetDispatchList(
+		Card.Class.Get(), UCardObject::StaticClass()));
+	if (Delegates.IsEmpty()) return;
+	UConstituent* Owner = GetConstituentFromInstanceId(Card.OwnerConstituentInstanceId);
+	for (const FOnAddOwnedCard& Delegate : Delegates)
 	{
-		//Always call if it is UCardObject.
-		if (Pair.Key.Get() == UCardObject::StaticClass())
+		if (!Delegate.IsBound())
 		{
-			for (FOnAddOwnedCard& Delegate : Pair.Value)
-			{
-				Delegate.ExecuteIfBound(Card.Class, GetConstituentFromInstanceId(Card.OwnerConstituentInstanceId),
-				                        bInIsPredictableContext);
-			}
+			//Rebuild so the unbound delegate is removed.
+			BindedOnAddOwnedCardDelegates.Invalidate();
 			continue;
 		}
-		//Otherwise call if it is the class of the added card.
-		if (Pair.Key == Card.Class)
-		{
-			for (FOnAddOwnedCard& Delegate : Pair.Value)
-			{
-				Delegate.ExecuteIfBound(Card.Class, GetConstituentFromInstanceId(Card.OwnerConstituentInstanceId),
-				                        bInIsPredictableContext);
-			}
-		}
+		Delegate.Execute(Card.Class, Owner, bInIsPredictableContext);
 	}
 }
 
 void UInventory::CallBindedOnRemoveOwnedCardDelegates(FCard& Card, const bool bInIsPredictableContext)
 {
-	for (TPair<TSubclassOf<UCardObject>, TSet<FOnRemoveOwnedCard>>& Pair : BindedOnRemoveOwnedCardDelegates)
+	//Copied as the called events may bind or unbind delegates.
+	const TArray<FOnRemoveOwnedCard, TInlineAllocator<8>> Delegates(BindedOnRemoveOwnedCardDelegates.GetDispatchList(
+		Card.Class.Get(), UCardObject::StaticClass()));
+	if (Delegates.IsEmpty()) return;
+	UConstituent* Owner = GetConstituentFromInstanceId(Card.OwnerConstituentInstanceId);
+	for (const FOnRemoveOwnedCard& Delegate : Delegates)
 	{
-		//Always call if it is UCardObject.
-		if (Pair.Key.Get() == UCardObject::StaticClass())
+		if (!Delegate.IsBound())
 		{
-			for (FOnRemoveOwnedCard& Delegate : Pair.Value)
-			{
-				Delegate.ExecuteIfBound(Card.Class, GetConstituentFromInstanceId(Card.OwnerConstituentInstanceId),
-				                        bInIsPredictableContext);
-			}
+			//Rebuild so the unbound delegate is removed.
+			BindedOnRemoveOwnedCardDelegates.Invalidate();
 			continue;
 		}
-		//Otherwise call if it is the class of the removed card.
-		if (Pair.Key == Card.Class)
-		{
-			for (FOnRemoveOwnedCard& Delegate : Pair.Value)
-			{
-				Delegate.ExecuteIfBound(Card.Class, GetConstituentFromInstanceId(Card.OwnerConstituentInstanceId),
-				                        bInIsPredictableContext);
-			}
-		}
-	}
-}
-
-void UInventory::RemoveEmptyDelegateBindings()
-{
-	for (TPair<TSubclassOf<USlotable>, TSet<FOnAddSlotable>>& Pair : BindedOnAddSlotableDelegates)
-	{
-		RemoveEmptyDelegatesFromTSet(Pair.Value);
-	}
-	for (TPair<TSubclassOf<USlotable>, TSet<FOnRemoveSlotable>>& Pair : BindedOnRemoveSlotableDelegates)
-	{
-		RemoveEmptyDelegatesFromTSet(Pair.Value);
-	}
-	for (TPair<TSubclassOf<UCardObject>, TSet<FOnAddSharedCard>>& Pair : BindedOnAddSharedCardDelegates)
-	{
-		RemoveEmptyDelegatesFromTSet(Pair.Value);
-	}
-	for (TPair<TSubclassOf<UCardObject>, TSet<FOnRemoveSharedCard>>& Pair : BindedOnRemoveSharedCardDelegates)
-	{
-		RemoveEmptyDelegatesFromTSet(Pair.Value);
-	}
-	for (TPair<TSubclassOf<UCardObject>, TSet<FOnAddOwnedCard>>& Pair : BindedOnAddOwnedCardDelegates)
-	{
-		RemoveEmptyDelegatesFromTSet(Pair.Value);
-	}
-	for (TPair<TSubclassOf<UCardObject>, TSet<FOnRemoveOwnedCard>>& Pair : BindedOnRemoveOwnedCardDelegates)
-	{
-		RemoveEmptyDelegatesFromTSet(Pair.Value);
-	}
-}
-
-template <class T>
-void UInventory::RemoveEmptyDelegatesFromTSet(TSet<T>& DelegateSet)
-{
-	for (auto It = DelegateSet.CreateIterator(); It; ++It)
-	{
-		if (It->GetUObjectEvenIfUnreachable() == nullptr)
-		{
-			It.RemoveCurrent();
-		}
+		Delegate.Execute(Card.Class, Owner, bInIsPredictableContext);
 	}
 }
 
@@ -1468,6 +1461,7 @@ void UInventory::InitializeSlotable(USlotable* Slotable, UConstituent* Origin)
 		MARK_PROPERTY_DIRTY_FROM_NAME(UConstituent, OriginatingConstituent, Constituent);
 	}
 	Slotable->ServerInitialize();
+	MarkConstituentTableDirty();
 }
 
 //Must be called before the slotable is removed from an inventory.
@@ -1478,10 +1472,12 @@ void UInventory::DeinitializeSlotable(USlotable* Slotable)
 	Slotable->OwningInventory = nullptr;
 	MARK_PROPERTY_DIRTY_FROM_NAME(USlotable, OwningInventory, Slotable);
 	GetOwner()->RemoveReplicatedSubObject(Slotable);
+	MarkConstituentTableDirty();
 }
 
 void UInventory::OnRep_Slotables()
 {
+	MarkConstituentTableDirty();
 	//Register and deregister subobjects on client.
 	for (USlotable* ReplicatedSlotable : Slotables)
 	{
@@ -1522,22 +1518,213 @@ void UInventory::ClientAutonomousDeinitialize_Implementation()
 float UInventory::GetCardLifetime(const TSubclassOf<UCardObject>& InCardClass, const int32 InOwnerConstituentInstanceId)
 {
 	const UFormCharacterComponent* FormCharacter = OwningFormCore->FormCharacter;
-	float Value = 0;
-	for (const FCard& Card : Cards)
+	const FCard* Card = FindEnabledCard(InCardClass, InOwnerConstituentInstanceId);
+	if (!Card) return 0;
+	if (Card->LifetimeEndTimestamp <= 0) return 0;
+	if (Card->bUsingPredictedTimestamp)
 	{
-		if (Card.bIsDisabledForDestroy) continue;
-		if (Card.Class != InCardClass || Card.OwnerConstituentInstanceId != InOwnerConstituentInstanceId) continue;
-		if (Card.LifetimeEndTimestamp <= 0) return 0;
-		if (Card.bUsingPredictedTimestamp)
+		return FormCharacter->CalculateTimeUntilPredictedTimestamp(Card->LifetimeEndTimestamp);
+	}
+	//Same function can be used for both server and client.
+	return CalculateTimeUntilServerTimestamp(GetWorld(), Card->LifetimeEndTimestamp);
+}
+
+void UInventory::MarkCardIndexDirty()
+{
+	bCardIndexDirty = true;
+	CardsVersion = ++LastCardsVersion;
+}
+
+void UInventory::MarkCardsChanged()
+{
+	CardsVersion = ++LastCardsVersion;
+}
+
+void UInventory::IndexLastCard()
+{
+	MarkCardsChanged();
+	//The index will be rebuilt from Cards anyway.
+	if (bCardIndexDirty) return;
+	const int32 Index = Cards.Num() - 1;
+	const FCard& Card = Cards[Index];
+	CardIndicesByClass.FindOrAdd(Card.Class).Add(Index);
+	int32& IndexForKey = CardIndexByClassAndOwner.FindOrAdd(
+		TPair<TSubclassOf<UCardObject>, uint8>(Card.Class, Card.OwnerConstituentInstanceId), Index);
+	if (Cards[IndexForKey].bIsDisabledForDestroy && !Card.bIsDisabledForDestroy)
+	{
+		IndexForKey = Index;
+	}
+}
+
+void UInventory::RemoveCardAt(const int32 InIndex, const bool bInAllowShrinking)
+{
+	MarkCardsChanged();
+	if (bCardIndexDirty)
+	{
+		Cards.RemoveAt(InIndex, 1, bInAllowShrinking);
+		return;
+	}
+	const TSubclassOf<UCardObject> RemovedClass = Cards[InIndex].Class;
+	const TPair<TSubclassOf<UCardObject>, uint8> RemovedKey(RemovedClass, Cards[InIndex].OwnerConstituentInstanceId);
+	TArray<int32>& RemovedClassIndices = CardIndicesByClass.FindChecked(RemovedClass);
+	RemovedClassIndices.RemoveSingle(InIndex);
+	Cards.RemoveAt(InIndex, 1, bInAllowShrinking);
+	//Shift down the indices of every card after the removed one. This is proportional to the cards moved by RemoveAt.
+	for (int32 i = InIndex; i < Cards.Num(); i++)
+	{
+		const FCard& Card = Cards[i];
+		int32* IndexForKey = CardIndexByClassAndOwner.Find(
+			TPair<TSubclassOf<UCardObject>, uint8>(Card.Class, Card.OwnerConstituentInstanceId));
+		if (IndexForKey && *IndexForKey == i + 1)
 		{
-			Value = FormCharacter->CalculateTimeUntilPredictedTimestamp(Card.LifetimeEndTimestamp);
+			*IndexForKey = i;
 		}
-		else
+		//Class lists are sorted so the old index is found by binary search.
+		TArray<int32>& ClassIndices = CardIndicesByClass.FindChecked(Card.Class);
+		const int32 Position = Algo::BinarySearch(ClassIndices, i + 1);
+		if (Position != INDEX_NONE)
 		{
-			//Same function can be used for both server and client.
-			Value = CalculateTimeUntilServerTimestamp(GetWorld(), Card.LifetimeEndTimestamp);
+			ClassIndices[Position] = i;
 		}
-		break;
 	}
-	return Value;
+	const int32* IndexForRemovedKey = CardIndexByClassAndOwner.Find(RemovedKey);
+	if (!IndexForRemovedKey || *IndexForRemovedKey != InIndex) return;
+	//Duplicates should only come from replicated state, but if there is one it takes the place of the removed card.
+	CardIndexByClassAndOwner.Remove(RemovedKey);
+	for (const int32 i : RemovedClassIndices)
+	{
+		if (Cards[i].OwnerConstituentInstanceId != RemovedKey.Value) continue;
+		int32& IndexForKey = CardIndexByClassAndOwner.FindOrAdd(RemovedKey, i);
+		if (Cards[IndexForKey].bIsDisabledForDestroy && !Cards[i].bIsDisabledForDestroy)
+		{
+			IndexForKey = i;
+		}
+	}
+}
+
+void UInventory::RemoveCardsAt(const TConstArrayView<int32> InIndices, const bool bInAllowShrinking)
+{
+	if (InIndices.Num() == 0) return;
+	if (InIndices.Num() == 1)
+	{
+		RemoveCardAt(InIndices[0], bInAllowShrinking);
+		return;
+	}
+	//Shifting the index for each removal is proportional to the cards after it, so batches are compacted and indexed
+	//again in linear time.
+	TBitArray<> RemovedCards(false, Cards.Num());
+	for (const int32 Index : InIndices)
+	{
+		RemovedCards[Index] = true;
+	}
+	int32 NumKept = 0;
+	for (int32 i = 0; i < Cards.Num(); i++)
+	{
+		if (RemovedCards[i]) continue;
+		if (NumKept != i)
+		{
+			Cards[NumKept] = MoveTemp(Cards[i]);
+		}
+		NumKept++;
+	}
+	Cards.SetNum(NumKept, bInAllowShrinking);
+	MarkCardIndexDirty();
+}
+
+uint32 UInventory::GetCardsVersion() const
+{
+	return CardsVersion;
+}
+
+uint32 UInventory::CalculateCardDigest() const
+{
+	if (CardDigestVersion == CardsVersion) return CardDigest;
+	//Summing makes the digest independent of card order.
+	CardDigest = 0;
+	for (const FCard& Card : Cards)
+	{
+		CardDigest += GetTypeHash(Card.GetNetCardIdentifier());
+	}
+	CardDigestVersion = CardsVersion;
+	return CardDigest;
+}
+
+void UInventory::RebuildCardIndex() const
+{
+	//Reset instead of empty so we keep the allocations between rebuilds.
+	CardIndexByClassAndOwner.Reset();
+	for (TPair<TSubclassOf<UCardObject>, TArray<int32>>& Pair : CardIndicesByClass)
+	{
+		Pair.Value.Reset();
+	}
+	for (int32 i = 0; i < Cards.Num(); i++)
+	{
+		const FCard& Card = Cards[i];
+		CardIndicesByClass.FindOrAdd(Card.Class).Add(i);
+		//There should only be one card per class and owner, but if there are more we prefer the enabled one.
+		int32& IndexForKey = CardIndexByClassAndOwner.FindOrAdd(
+			TPair<TSubclassOf<UCardObject>, uint8>(Card.Class, Card.OwnerConstituentInstanceId), i);
+		if (Cards[IndexForKey].bIsDisabledForDestroy && !Card.bIsDisabledForDestroy)
+		{
+			IndexForKey = i;
+		}
+	}
+	bCardIndexDirty = false;
+}
+
+int32 UInventory::FindCardIndex(const TSubclassOf<UCardObject>& InCardClass,
+                                const int32 InOwnerConstituentInstanceId) const
+{
+	//Instance ids are a uint8.
+	if (InOwnerConstituentInstanceId < 0 || InOwnerConstituentInstanceId > UINT8_MAX) return INDEX_NONE;
+	if (bCardIndexDirty)
+	{
+		RebuildCardIndex();
+	}
+	const int32* Index = CardIndexByClassAndOwner.Find(
+		TPair<TSubclassOf<UCardObject>, uint8>(InCardClass, InOwnerConstituentInstanceId));
+	return Index ? *Index : INDEX_NONE;
+}
+
+void UInventory::MarkCardExpiryQueuesDirty()
+{
+	bCardExpiryQueuesDirty = true;
+}
+
+void UInventory::RebuildCardExpiryQueues()
+{
+	ServerCardExpiryQueue.Reset();
+	PredictedCardExpiryQueue.Reset();
+	//Cleared first so AddCardToExpiryQueue doesn't skip.
+	bCardExpiryQueuesDirty = false;
+	for (const FCard& Card : Cards)
+	{
+		AddCardToExpiryQueue(Card);
+	}
+}
+
+void UInventory::AddCardToExpiryQueue(const FCard& Card)
+{
+	//The queues will be rebuilt from Cards anyway.
+	if (bCardExpiryQueuesDirty) return;
+	//Cards without a lifetime never expire.
+	if (Card.LifetimeEndTimestamp <= -1.f) return;
+	const FCardExpiryEntry Entry{Card.LifetimeEndTimestamp, Card.Class, Card.OwnerConstituentInstanceId};
+	if (Card.bUsingPredictedTimestamp)
+	{
+		PredictedCardExpiryQueue.HeapPush(Entry, FPredictedCardExpiryPredicate());
+	}
+	else
+	{
+		ServerCardExpiryQueue.HeapPush(Entry, FServerCardExpiryPredicate());
+	}
+}
+
+const FCard* UInventory::FindEnabledCard(const TSubclassOf<UCardObject>& InCardClass,
+                                         const int32 InOwnerConstituentInstanceId) const
+{
+	const int32 Index = FindCardIndex(InCardClass, InOwnerConstituentInstanceId);
+	if (Index == INDEX_NONE) return nullptr;
+	if (Cards[Index].bIsDisabledForDestroy) return nullptr;
+	return &Cards[Index];
 }
@@ -0,0 +1,291 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SfClassIndexManifest.h"
+
+#include "CardObject.h"
+#include "SfHealthComponent.h"
+#include "SfParamSerializer.h"
+#include "SfUtility.h"
+#include "Misc/NetworkVersion.h"
+
+#if WITH_EDITOR
+#include "AssetRegistry/IAssetRegistry.h"
+#include "UObject/UObjectHash.h"
+#include "UObject/UObjectIterator.h"
+#endif
+
+bool FSfParamQuantizationRule::HasRange() const
+{
+	return Max > Min;
+}
+
+void FSfClassIndex::Build(const TArray<FSoftClassPath>& InSortedClassPaths)
+{
+	ClassPaths = InSortedClassPaths;
+	IndicesByClassPath.Empty(ClassPaths.Num());
+	for (int32 i = 0; i < ClassPaths.Num(); i++)
+	{
+		IndicesByClassPath.Add(ClassPaths[i].GetAssetPath(), i);
+	}
+	ResolvedClasses.Empty(ClassPaths.Num());
+	ResolvedClasses.SetNum(ClassPaths.Num());
+}
+
+int32 FSfClassIndex::FindIndex(const UClass* InClass) const
+{
+	if (!InClass) return INDEX_NONE;
+	const int32* Index = IndicesByClassPath.Find(InClass->GetClassPathName());
+	return Index ? *Index : INDEX_NONE;
+}
+
+UClass* FSfClassIndex::GetClass(const int32 InIndex) const
+{
+	if (!ClassPaths.IsValidIndex(InIndex)) return nullptr;
+	UClass* Class = ResolvedClasses[InIndex].Get();
+	if (Class) return Class;
+	//Only classes that are actually received get loaded.
+	Class = ClassPaths[InIndex].ResolveClass();
+	if (!Class)
+	{
+		Class = ClassPaths[InIndex].TryLoadClass<UObject>();
+	}
+	ResolvedClasses[InIndex] = Class;
+	return Class;
+}
+
+int32 FSfClassIndex::Num() const
+{
+	return ClassPaths.Num();
+}
+
+uint32 USfClassIndexManifest::CalculateHash(const int32 InVersion, const TArray<FSoftClassPath>& InCardObjectClasses,
+                                            const TArray<FSoftClassPath>& InHealthChangeProcessorClasses,
+                                            const TArray<FSfParamQuantizationRule>& InParamQuantizationRules)
+{
+	uint32 Result = GetTypeHash(InVersion);
+	for (const FSoftClassPath& ClassPath : InCardObjectClasses)
+	{
+		Result = FCrc::StrCrc32(*ClassPath.ToString(), Result);
+	}
+	//Separate the lists so moving a class between them changes the hash.
+	Result = HashCombine(Result, GetTypeHash(InCardObjectClasses.Num()));
+	for (const FSoftClassPath& ClassPath : InHealthChangeProcessorClasses)
+	{
+		Result = FCrc::StrCrc32(*ClassPath.ToString(), Result);
+	}
+	Result = HashCombine(Result, GetTypeHash(InHealthChangeProcessorClasses.Num()));
+	for (const FSfParamQuantizationRule& Rule : InParamQuantizationRules)
+	{
+		Result = FCrc::StrCrc32(*FString::Printf(TEXT("%s.%s:%.17g:%.17g:%.17g:%i"), *Rule.Struct.ToString(),
+		                                         *Rule.Property.ToString(), Rule.Min, Rule.Max, Rule.Step, Rule.Bits),
+		                        Result);
+	}
+	return Result;
+}
+
+//Fallback for when there is no valid manifest. This loads every subclass so it should not be relied on.
+static TArray<FSoftClassPath> ScanSortedSubclassPaths(UClass* BaseClass)
+{
+	TArray<UClass*> Classes = GetSubclassesOf(BaseClass);
+	TArray<FSoftClassPath> ClassPaths;
+	ClassPaths.Reserve(Classes.Num());
+	for (const UClass* Class : Classes)
+	{
+		if (Class->HasAnyClassFlags(CLASS_Abstract) || Class == BaseClass) continue;
+		ClassPaths.Emplace(Class);
+	}
+	//We sort this in a deterministic order to index items.
+	ClassPaths.Sort([](const FSoftClassPath& A, const FSoftClassPath& B)
+	{
+		return A.ToString() > B.ToString();
+	});
+	return ClassPaths;
+}
+
+void USfClassIndexManifest::Initialize()
+{
+	const USfClassIndexManifest* Manifest = GetDefault<USfClassIndexManifest>();
+	TArray<FSoftClassPath> CardObjectClassPaths = Manifest->CardObjectClasses;
+	TArray<FSoftClassPath> HealthChangeProcessorClassPaths = Manifest->HealthChangeProcessorClasses;
+	TArray<FSfParamQuantizationRule> ParamQuantizationRules = Manifest->ParamQuantizationRules;
+	if (Manifest->Version != CurrentVersion || Manifest->Hash != CalculateHash(
+		Manifest->Version, CardObjectClassPaths, HealthChangeProcessorClassPaths, ParamQuantizationRules))
+	{
+		UE_LOG(LogSfCore, Error,
+		       TEXT("SfClassIndexManifest is missing or invalid. Open the project in the editor or cook to regenerate it. Scanning for classes instead."));
+		CardObjectClassPaths = ScanSortedSubclassPaths(UCardObject::StaticClass());
+		HealthChangeProcessorClassPaths = ScanSortedSubclassPaths(UHealthChangeProcessor::StaticClass());
+		//Params are sent unquantized as the metadata can't be read here.
+		ParamQuantizationRules.Empty();
+	}
+	if (HealthChangeProcessorClassPaths.Num() > 255)
+	{
+		UE_LOG(LogSfCore, Error, TEXT("Only 255 health change processors can exist. Removing excess."));
+		HealthChangeProcessorClassPaths.SetNum(255);
+	}
+	CardObjectClassIndex.Build(CardObjectClassPaths);
+	HealthChangeProcessorClassIndex.Build(HealthChangeProcessorClassPaths);
+	ParamQuantizationRulesByProperty.Empty(ParamQuantizationRules.Num());
+	for (const FSfParamQuantizationRule& Rule : ParamQuantizationRules)
+	{
+		ParamQuantizationRulesByProperty.Add(TPair<FTopLevelAssetPath, FName>(Rule.Struct, Rule.Property), Rule);
+	}
+	FSfParamSerializer::ClearCache();
+	const uint32 NewHash = CalculateHash(CurrentVersion, CardObjectClassPaths, HealthChangeProcessorClassPaths,
+	                                     ParamQuantizationRules);
+	if (bInitialized && NewHash != LoadedHash)
+	{
+		//The network version includes the hash, so it needs to be recalculated.
+		FNetworkVersion::InvalidateNetworkChecksum();
+	}
+	LoadedHash = NewHash;
+	bInitialized = true;
+}
+
+const FSfClassIndex& USfClassIndexManifest::GetCardObjectClassIndex()
+{
+	if (!bInitialized)
+	{
+		Initialize();
+	}
+	return CardObjectClassIndex;
+}
+
+const FSfClassIndex& USfClassIndexManifest::GetHealthChangeProcessorClassIndex()
+{
+	if (!bInitialized)
+	{
+		Initialize();
+	}
+	return HealthChangeProcessorClassIndex;
+}
+
+uint32 USfClassIndexManifest::GetLoadedHash()
+{
+	if (!bInitialized)
+	{
+		Initialize();
+	}
+	return LoadedHash;
+}
+
+const FSfParamQuantizationRule* USfClassIndexManifest::FindParamQuantizationRule(const UStruct* InStruct,
+                                                                                 const FName InProperty)
+{
+	if (!bInitialized)
+	{
+		Initialize();
+	}
+	if (!InStruct) return nullptr;
+	return ParamQuantizationRulesByProperty.Find(TPair<FTopLevelAssetPath, FName>(FTopLevelAssetPath(InStruct),
+	                                                                              InProperty));
+}
+
+#if WITH_EDITOR
+//Collects native and blueprint subclasses without loading any blueprints.
+static TArray<FSoftClassPath> CollectSortedSubclassPaths(const UClass* BaseClass)
+{
+	const IAssetRegistry& AssetRegistry = IAssetRegistry::GetChecked();
+	TSet<FTopLevelAssetPath> DerivedClassPaths;
+	AssetRegistry.GetDerivedClassNames({BaseClass->GetClassPathName()}, TSet<FTopLevelAssetPath>(), DerivedClassPaths);
+
+	//Native classes are always loaded so we can check them directly.
+	TArray<UClass*> NativeClasses;
+	GetDerivedClasses(BaseClass, NativeClasses, true);
+	for (const UClass* NativeClass : NativeClasses)
+	{
+		if (NativeClass->IsNative())
+		{
+			DerivedClassPaths.Add(NativeClass->GetClassPathName());
+		}
+	}
+
+	TArray<FSoftClassPath> ClassPaths;
+	ClassPaths.Reserve(DerivedClassPaths.Num());
+	for (const FTopLevelAssetPath& ClassPath : DerivedClassPaths)
+	{
+		if (ClassPath == BaseClass->GetClassPathName()) continue;
+		const FString AssetName = ClassPath.GetAssetName().ToString();
+		if (AssetName.StartsWith(TEXT("SKEL_")) || AssetName.StartsWith(TEXT("REINST_"))) continue;
+		//Abstract blueprints are only known once loaded, so those are indexed anyway.
+		if (const UClass* LoadedClass = FindObject<UClass>(ClassPath); LoadedClass && LoadedClass->IsNative() &&
+			LoadedClass->HasAnyClassFlags(CLASS_Abstract)) continue;
+		ClassPaths.Emplace(ClassPath.ToString());
+	}
+	//We sort this in a deterministic order to index items.
+	ClassPaths.Sort([](const FSoftClassPath& A, const FSoftClassPath& B)
+	{
+		return A.ToString() > B.ToString();
+	});
+	return ClassPaths;
+}
+
+//Resolves quantization metadata on native struct properties, which is stripped from cooked builds.
+static TArray<FSfParamQuantizationRule> CollectSortedParamQuantizationRules()
+{
+	static const FName SfBitsName = TEXT("SfBits");
+	static const FName SfQuantizeName = TEXT("SfQuantize");
+	static const FName SfQuantizationStepName = TEXT("SfQuantizationStep");
+	static const FName ClampMinName = TEXT("ClampMin");
+	static const FName ClampMaxName = TEXT("ClampMax");
+	TArray<FSfParamQuantizationRule> Rules;
+	for (TObjectIterator<UScriptStruct> It; It; ++It)
+	{
+		const UScriptStruct* Struct = *It;
+		if (!(Struct->StructFlags & STRUCT_Native)) continue;
+		for (TFieldIterator<FProperty> PropertyIt(Struct, EFieldIteratorFlags::ExcludeSuper); PropertyIt; ++PropertyIt)
+		{
+			const FProperty* Property = *PropertyIt;
+			if (!Property->HasMetaData(SfBitsName) && !Property->HasMetaData(SfQuantizeName) && !Property->
+				HasMetaData(SfQuantizationStepName)) continue;
+			FSfParamQuantizationRule& Rule = Rules.AddDefaulted_GetRef();
+			Rule.Struct = FTopLevelAssetPath(Struct);
+			Rule.Property = Property->GetFName();
+			if (Property->HasMetaData(ClampMinName) && Property->HasMetaData(ClampMaxName))
+			{
+				Rule.Min = FCString::Atod(*Property->GetMetaData(ClampMinName));
+				Rule.Max = FCString::Atod(*Property->GetMetaData(ClampMaxName));
+			}
+			if (Property->HasMetaData(SfQuantizationStepName))
+			{
+				Rule.Step = FCString::Atod(*Property->GetMetaData(SfQuantizationStepName));
+			}
+			if (Property->HasMetaData(SfBitsName))
+			{
+				Rule.Bits = FCString::Atoi(*Property->GetMetaData(SfBitsName));
+			}
+		}
+	}
+	Rules.Sort([](const FSfParamQuantizationRule& A, const FSfParamQuantizationRule& B)
+	{
+		const FString AStruct = A.Struct.ToString();
+		const FString BStruct = B.Struct.ToString();
+		if (AStruct != BStruct) return AStruct < BStruct;
+		return A.Property.LexicalLess(B.Property);
+	});
+	return Rules;
+}
+
+void USfClassIndexManifest::RegenerateAndSave()
+{
+	USfClassIndexManifest* Manifest = GetMutableDefault<USfClassIndexManifest>();
+	const TArray<FSoftClassPath> NewCardObjectClasses = CollectSortedSubclassPaths(UCardObject::StaticClass());
+	const TArray<FSoftClassPath> NewHealthChangeProcessorClasses = CollectSortedSubclassPaths(
+		UHealthChangeProcessor::StaticClass());
+	const TArray<FSfParamQuantizationRule> NewParamQuantizationRules = CollectSortedParamQuantizationRules();
+	const uint32 NewHash = CalculateHash(CurrentVersion, NewCardObjectClasses, NewHealthChangeProcessorClasses,
+	                                     NewParamQuantizationRules);
+	if (Manifest->Version == CurrentVersion && Manifest->Hash == NewHash) return;
+	Manifest->Version = CurrentVersion;
+	Manifest->CardObjectClasses = NewCardObjectClasses;
+	Manifest->HealthChangeProcessorClasses = NewHealthChangeProcessorClasses;
+	Manifest->ParamQuantizationRules = NewParamQuantizationRules;
+	Manifest->Hash = NewHash;
+	if (!Manifest->TryUpdateDefaultConfigFile())
+	{
+		UE_LOG(LogSfCore, Error, TEXT("Failed to save SfClassIndexManifest to the default config file."));
+	}
+	Initialize();
+}
+#endif
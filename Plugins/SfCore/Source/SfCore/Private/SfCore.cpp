@@ -1,4 +1,42 @@
 #include "CoreMinimal.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/NetworkVersion.h"
 #include "Modules/ModuleManager.h"
+#include "SfClassIndexManifest.h"
 
-IMPLEMENT_MODULE(FDefaultModuleImpl, SfCore);
\ No newline at end of file
+class FSfCoreModule : public FDefaultModuleImpl
+{
+public:
+	virtual void StartupModule() override
+	{
+		//Clients with a different class index manifest can't read our class indices, so we reject them in the handshake.
+		if (!FNetworkVersion::GetLocalNetworkVersionOverride.IsBound())
+		{
+			FNetworkVersion::GetLocalNetworkVersionOverride.BindStatic(&FSfCoreModule::GetLocalNetworkVersion);
+			bBoundNetworkVersionOverride = true;
+		}
+		//Wait for the engine so the fallback scan can use the asset registry if the manifest is invalid.
+		PostEngineInitHandle = FCoreDelegates::OnPostEngineInit.AddStatic(&USfClassIndexManifest::Initialize);
+	}
+
+	virtual void ShutdownModule() override
+	{
+		FCoreDelegates::OnPostEngineInit.Remove(PostEngineInitHandle);
+		if (bBoundNetworkVersionOverride)
+		{
+			FNetworkVersion::GetLocalNetworkVersionOverride.Unbind();
+		}
+	}
+
+private:
+	static uint32 GetLocalNetworkVersion()
+	{
+		return HashCombine(FNetworkVersion::GetLocalNetworkVersion(false), USfClassIndexManifest::GetLoadedHash());
+	}
+
+	FDelegateHandle PostEngineInitHandle;
+
+	bool bBoundNetworkVersionOverride = false;
+};
+
+IMPLEMENT_MODULE(FSfCoreModule, SfCore);
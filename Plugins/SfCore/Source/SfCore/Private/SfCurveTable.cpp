@@ -0,0 +1,118 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SfCurveTable.h"
+
+#include "Curves/CurveFloat.h"
+
+namespace SfCurveTable
+{
+	struct FTable
+	{
+		uint32 CurveHash = 0;
+
+		//If false the rich curve is evaluated.
+		bool bIsBaked = false;
+
+		float MinTime = 0;
+
+		float MaxTime = 0;
+
+		//Samples per second of curve time.
+		float SampleRate = 0;
+
+		TArray<float> Samples;
+
+#if WITH_EDITOR
+		//Used to detect if the curve has been edited.
+		uint32 KeysHash = 0;
+#endif
+	};
+
+	static TMap<TObjectKey<UCurveFloat>, FTable>& GetTables()
+	{
+		static TMap<TObjectKey<UCurveFloat>, FTable> Tables;
+		return Tables;
+	}
+
+#if WITH_EDITOR
+	static uint32 HashKeys(const FRichCurve& InCurve)
+	{
+		uint32 Hash = GetTypeHash(InCurve.GetNumKeys());
+		for (auto It = InCurve.GetKeyIterator(); It; ++It)
+		{
+			Hash = HashCombine(Hash, FCrc::MemCrc32(&*It, sizeof(FRichCurveKey)));
+		}
+		Hash = HashCombine(Hash, GetTypeHash(static_cast<uint8>(InCurve.PreInfinityExtrap)));
+		return HashCombine(Hash, GetTypeHash(static_cast<uint8>(InCurve.PostInfinityExtrap)));
+	}
+#endif
+
+	static void Bake(const UCurveFloat* InCurve, FTable& OutTable)
+	{
+		const FRichCurve& Curve = InCurve->FloatCurve;
+		OutTable.CurveHash = GetTypeHash(InCurve->GetPathName());
+		OutTable.bIsBaked = false;
+		OutTable.Samples.Reset();
+#if WITH_EDITOR
+		OutTable.KeysHash = HashKeys(Curve);
+#endif
+		if (Curve.GetNumKeys() < 2) return;
+		for (auto It = Curve.GetKeyIterator(); It; ++It)
+		{
+			//Steps can't be interpolated between samples.
+			if (It->InterpMode == RCIM_Constant) return;
+		}
+		Curve.GetTimeRange(OutTable.MinTime, OutTable.MaxTime);
+		if (OutTable.MaxTime <= OutTable.MinTime) return;
+
+		OutTable.SampleRate = (FSfCurveTable::NumSamples - 1) / (OutTable.MaxTime - OutTable.MinTime);
+		OutTable.Samples.SetNumUninitialized(FSfCurveTable::NumSamples);
+		for (int32 i = 0; i < FSfCurveTable::NumSamples; i++)
+		{
+			OutTable.Samples[i] = Curve.Eval(OutTable.MinTime + i / OutTable.SampleRate);
+		}
+		OutTable.bIsBaked = true;
+	}
+
+	static const FTable& FindOrBake(const UCurveFloat* InCurve)
+	{
+		FTable* Table = GetTables().Find(InCurve);
+		if (!Table)
+		{
+			Table = &GetTables().Add(InCurve);
+			Bake(InCurve, *Table);
+		}
+#if WITH_EDITOR
+		else if (Table->KeysHash != HashKeys(InCurve->FloatCurve))
+		{
+			Bake(InCurve, *Table);
+		}
+#endif
+		return *Table;
+	}
+}
+
+float FSfCurveTable::Evaluate(const UCurveFloat* InCurve, const float InTime)
+{
+	if (!InCurve) return 0;
+	const SfCurveTable::FTable& Table = SfCurveTable::FindOrBake(InCurve);
+	if (!Table.bIsBaked || InTime < Table.MinTime || InTime > Table.MaxTime)
+	{
+		return InCurve->FloatCurve.Eval(InTime);
+	}
+	const float SamplePosition = (InTime - Table.MinTime) * Table.SampleRate;
+	const int32 Index = FMath::Min(FMath::FloorToInt32(SamplePosition), NumSamples - 2);
+	return FMath::Lerp(Table.Samples[Index], Table.Samples[Index + 1], SamplePosition - Index);
+}
+
+uint32 FSfCurveTable::GetCurveHash(const UCurveFloat* InCurve)
+{
+	if (!InCurve) return 0;
+	return SfCurveTable::FindOrBake(InCurve).CurveHash;
+}
+
+void FSfCurveTable::ClearCache()
+{
+	SfCurveTable::GetTables().Empty();
+}
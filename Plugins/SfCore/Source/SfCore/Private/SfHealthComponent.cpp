@@ -5,6 +5,7 @@
 
 #include "FormCoreComponent.h"
 #include "FormStatComponent.h"
+#include "SfClassIndexManifest.h"
 #include "Net/UnrealNetwork.h"
 #include "Net/Core/PushModel/PushModel.h"
 
@@ -44,8 +45,9 @@ bool FHealthChangeData::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutS
 	{
 		for (TSubclassOf<UHealthChangeProcessor> Processor : Processors)
 		{
-			ProcessorClassIndicesToNetSerialize.Add(
-				USfHealthComponent::AllHealthChangeProcessorClassesSortedByName.Find(Processor));
+			const int32 ProcessorIndex = USfClassIndexManifest::GetHealthChangeProcessorClassIndex().FindIndex(Processor);
+			if (ProcessorIndex == INDEX_NONE) continue;
+			ProcessorClassIndicesToNetSerialize.Add(ProcessorIndex);
 		}
 	}
 	Ar << ProcessorClassIndicesToNetSerialize;
@@ -55,7 +57,13 @@ bool FHealthChangeData::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutS
 		//We ID processors in a deterministic way to reduce bandwidth use.
 		for (const uint8 ProcessorIndex : ProcessorClassIndicesToNetSerialize)
 		{
-			Processors.Add(USfHealthComponent::AllHealthChangeProcessorClassesSortedByName[ProcessorIndex]);
+			UClass* ProcessorClass = USfClassIndexManifest::GetHealthChangeProcessorClassIndex().GetClass(ProcessorIndex);
+			if (!ProcessorClass)
+			{
+				bOutSuccess = false;
+				continue;
+			}
+			Processors.Add(ProcessorClass);
 		}
 	}
 	return bOutSuccess;
@@ -99,34 +107,6 @@ void USfHealthComponent::BeginPlay()
 	{
 		UE_LOG(LogSfCore, Error, TEXT("RecentHealthChangeDataTimeout on SfHealthComponent class %s should be more than 0."), *GetClass()->GetName());
 	}
-	//Assign all health change processors an ID for net serialization.
-	if (!HealthChangeProcessorClassesFetched)
-	{
-		AllHealthChangeProcessorClassesSortedByName = GetSubclassesOf(UHealthChangeProcessor::StaticClass());
-		for (int64 i = AllHealthChangeProcessorClassesSortedByName.Num() - 1; i >= 0; i--)
-		{
-			if (AllHealthChangeProcessorClassesSortedByName[i]->HasAnyClassFlags(CLASS_Abstract) || AllHealthChangeProcessorClassesSortedByName[i] == UHealthChangeProcessor::StaticClass())
-			{
-				AllHealthChangeProcessorClassesSortedByName.RemoveAt(i, 1, false);
-			}
-		}
-		AllHealthChangeProcessorClassesSortedByName.Shrink();
-		//We sort this in a deterministic order to index items.
-		AllHealthChangeProcessorClassesSortedByName.Sort([](const UClass& A, const UClass& B)
-		{
-			return A.GetPathName() > B.GetPathName();
-		});
-		if (AllHealthChangeProcessorClassesSortedByName.Num() > 255)
-		{
-			UE_LOG(LogSfCore, Error, TEXT("Only 255 health change processors can exist. Removing excess."));
-			while (AllHealthChangeProcessorClassesSortedByName.Num() > 255)
-			{
-				AllHealthChangeProcessorClassesSortedByName.RemoveAt(256, 1, false);
-			}
-			AllHealthChangeProcessorClassesSortedByName.Shrink();
-		}
-		HealthChangeProcessorClassesFetched = true;
-	}
 	CalculatedTimeBetweenHealthUpdates = 1.f / HealthConstantUpdatesPerSecond;
 	if (FormCore) return;
 	//Only run if form core has not been set so SetupSfHeath called by FormCore will either not run (if it doesn't exist)
@@ -0,0 +1,240 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SfLagCompensationSubsystem.h"
+
+#include "SfObject.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+void USfLagCompensationSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+	if (FreeSlots.Num() == Slots.Num() || FrameCapacity == 0) return;
+	TRACE_CPUPROFILER_EVENT_SCOPE(USfLagCompensationSubsystem::Record);
+
+	int32 Row;
+	if (NumFrames < FrameCapacity)
+	{
+		Row = GetFrameRow(NumFrames);
+		NumFrames++;
+	}
+	else
+	{
+		//Overwrite the oldest frame.
+		Row = OldestFrameRow;
+		OldestFrameRow = (OldestFrameRow + 1) % FrameCapacity;
+	}
+	FrameTimestamps[Row] = GetWorld()->TimeSeconds;
+	TotalFramesRecorded++;
+
+	const int32 RowStart = Row * SlotCapacity;
+	for (int32 i = 0; i < Slots.Num(); i++)
+	{
+		const AActor* Form = Slots[i].Form.Get();
+		if (!Form) continue;
+		//Record the restore transform if a form is somehow left rewound.
+		const FTransform& Transform = Slots[i].bIsRewound ? Slots[i].RestoreTransform : Form->GetActorTransform();
+		Locations[RowStart + i] = Transform.GetLocation();
+		Rotations[RowStart + i] = Transform.GetRotation();
+	}
+}
+
+TStatId USfLagCompensationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(USfLagCompensationSubsystem, STATGROUP_Tickables);
+}
+
+int32 USfLagCompensationSubsystem::Server_RegisterForm(AActor* InForm, const uint32 InServerTickRate)
+{
+	if (!InForm || InServerTickRate == 0)
+	{
+		UE_LOG(LogSfCore, Error, TEXT("Called Server_RegisterForm on USfLagCompensationSubsystem with null form or 0 tick rate."));
+		return INDEX_NONE;
+	}
+	int32 Slot;
+	if (FreeSlots.Num() > 0)
+	{
+		Slot = FreeSlots.Pop(false);
+	}
+	else
+	{
+		Slot = Slots.AddDefaulted();
+	}
+	FFormSlot& FormSlot = Slots[Slot];
+	FormSlot.Form = InForm;
+	FormSlot.InterpolationDelay = 0.5f / InServerTickRate;
+	FormSlot.FirstRecordedFrame = TotalFramesRecorded;
+	FormSlot.bIsRewound = false;
+
+	//Only reallocate when the history needs to grow, so memory stays fixed once all forms have spawned.
+	const int32 RequiredFrameCapacity = FMath::CeilToInt32(HistorySeconds * InServerTickRate) + 1;
+	if (RequiredFrameCapacity > FrameCapacity || Slots.Num() > SlotCapacity)
+	{
+		Resize(FMath::Max(RequiredFrameCapacity, FrameCapacity),
+		       Slots.Num() > SlotCapacity ? FMath::Max(Slots.Num(), SlotCapacity * 2) : SlotCapacity);
+	}
+	return Slot;
+}
+
+void USfLagCompensationSubsystem::Server_UnregisterForm(const int32 InSlot)
+{
+	if (!Slots.IsValidIndex(InSlot) || FreeSlots.Contains(InSlot)) return;
+	if (Slots[InSlot].bIsRewound)
+	{
+		RewoundSlots.RemoveSingleSwap(InSlot, false);
+	}
+	Slots[InSlot] = FFormSlot();
+	FreeSlots.Add(InSlot);
+}
+
+bool USfLagCompensationSubsystem::Server_RewindForm(const int32 InSlot, const float InServerTimestamp)
+{
+	if (!Slots.IsValidIndex(InSlot)) return false;
+	FFormSlot& FormSlot = Slots[InSlot];
+	AActor* Form = FormSlot.Form.Get();
+	if (!Form) return false;
+	FVector Location;
+	FQuat Rotation;
+	if (!FindInterpolatedTransform(InSlot, InServerTimestamp, Location, Rotation))
+	{
+		UE_LOG(LogSfCore, Warning,
+		       TEXT("Could not find suitable snapshot to roll location back to. Timestamp may be too far in the past."));
+		return false;
+	}
+	//Keep the original transform if the form is rewound more than once before being restored.
+	if (!FormSlot.bIsRewound)
+	{
+		FormSlot.RestoreTransform = Form->GetActorTransform();
+		FormSlot.bIsRewound = true;
+		RewoundSlots.Add(InSlot);
+	}
+	Form->SetActorTransform(FTransform(Rotation, Location, FormSlot.RestoreTransform.GetScale3D()));
+	return true;
+}
+
+int32 USfLagCompensationSubsystem::Server_RewindForms(const TConstArrayView<int32> InSlots,
+                                                      const float InServerTimestamp)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(USfLagCompensationSubsystem::RewindForms);
+	int32 RewoundCount = 0;
+	for (const int32 Slot : InSlots)
+	{
+		if (Server_RewindForm(Slot, InServerTimestamp))
+		{
+			RewoundCount++;
+		}
+	}
+	return RewoundCount;
+}
+
+void USfLagCompensationSubsystem::Server_RestoreForm(const int32 InSlot)
+{
+	if (!Slots.IsValidIndex(InSlot) || !Slots[InSlot].bIsRewound) return;
+	FFormSlot& FormSlot = Slots[InSlot];
+	if (AActor* Form = FormSlot.Form.Get())
+	{
+		Form->SetActorTransform(FormSlot.RestoreTransform);
+	}
+	FormSlot.bIsRewound = false;
+	RewoundSlots.RemoveSingleSwap(InSlot, false);
+}
+
+void USfLagCompensationSubsystem::Server_RestoreForms(const TConstArrayView<int32> InSlots)
+{
+	for (const int32 Slot : InSlots)
+	{
+		Server_RestoreForm(Slot);
+	}
+}
+
+void USfLagCompensationSubsystem::Server_RestoreAllForms()
+{
+	for (int32 i = RewoundSlots.Num() - 1; i >= 0; i--)
+	{
+		Server_RestoreForm(RewoundSlots[i]);
+	}
+}
+
+void USfLagCompensationSubsystem::Resize(const int32 InFrameCapacity, const int32 InSlotCapacity)
+{
+	//Copy the newest frames into the new layout with the oldest frame at row 0.
+	const int32 FramesToKeep = FMath::Min(NumFrames, InFrameCapacity);
+	const int32 SlotsToKeep = FMath::Min(SlotCapacity, InSlotCapacity);
+	TArray<float> NewFrameTimestamps;
+	TArray<FVector> NewLocations;
+	TArray<FQuat> NewRotations;
+	NewFrameTimestamps.SetNumZeroed(InFrameCapacity);
+	NewLocations.SetNumZeroed(InFrameCapacity * InSlotCapacity);
+	NewRotations.Init(FQuat::Identity, InFrameCapacity * InSlotCapacity);
+	for (int32 i = 0; i < FramesToKeep; i++)
+	{
+		const int32 OldRow = GetFrameRow(NumFrames - FramesToKeep + i);
+		NewFrameTimestamps[i] = FrameTimestamps[OldRow];
+		for (int32 j = 0; j < SlotsToKeep; j++)
+		{
+			NewLocations[i * InSlotCapacity + j] = Locations[OldRow * SlotCapacity + j];
+			NewRotations[i * InSlotCapacity + j] = Rotations[OldRow * SlotCapacity + j];
+		}
+	}
+	FrameTimestamps = MoveTemp(NewFrameTimestamps);
+	Locations = MoveTemp(NewLocations);
+	Rotations = MoveTemp(NewRotations);
+	FrameCapacity = InFrameCapacity;
+	SlotCapacity = InSlotCapacity;
+	OldestFrameRow = 0;
+	NumFrames = FramesToKeep;
+}
+
+int32 USfLagCompensationSubsystem::GetFrameRow(const int32 InFrameIndex) const
+{
+	return (OldestFrameRow + InFrameIndex) % FrameCapacity;
+}
+
+bool USfLagCompensationSubsystem::FindInterpolatedTransform(const int32 InSlot, const float InServerTimestamp,
+                                                            FVector& OutLocation, FQuat& OutRotation) const
+{
+	if (NumFrames == 0) return false;
+	const FFormSlot& FormSlot = Slots[InSlot];
+	const float Timestamp = InServerTimestamp - FormSlot.InterpolationDelay;
+
+	//Binary search for the first frame newer than the timestamp. Frames are ordered oldest to newest.
+	int32 Low = 0;
+	int32 High = NumFrames;
+	while (Low < High)
+	{
+		const int32 Mid = Low + (High - Low) / 2;
+		if (FrameTimestamps[GetFrameRow(Mid)] <= Timestamp)
+		{
+			Low = Mid + 1;
+		}
+		else
+		{
+			High = Mid;
+		}
+	}
+	//Timestamp is older than the history.
+	if (Low == 0) return false;
+	const int32 OlderFrameIndex = Low - 1;
+	//Frames before the form registered belong to something else.
+	const uint64 FirstFrameInHistory = TotalFramesRecorded - NumFrames;
+	if (FirstFrameInHistory + OlderFrameIndex < FormSlot.FirstRecordedFrame) return false;
+
+	const int32 OlderRow = GetFrameRow(OlderFrameIndex);
+	if (Low == NumFrames)
+	{
+		//Newer than the newest frame so we use that.
+		OutLocation = Locations[OlderRow * SlotCapacity + InSlot];
+		OutRotation = Rotations[OlderRow * SlotCapacity + InSlot];
+		return true;
+	}
+
+	//Interpolate to get the most likely accurate position that would have been on the client.
+	const int32 NewerRow = GetFrameRow(Low);
+	const float OlderTimestamp = FrameTimestamps[OlderRow];
+	const float InterpAlpha = (Timestamp - OlderTimestamp) / (FrameTimestamps[NewerRow] - OlderTimestamp);
+	OutLocation = FMath::Lerp(Locations[OlderRow * SlotCapacity + InSlot], Locations[NewerRow * SlotCapacity + InSlot],
+	                          InterpAlpha);
+	OutRotation = FQuat::Slerp(Rotations[OlderRow * SlotCapacity + InSlot], Rotations[NewerRow * SlotCapacity + InSlot],
+	                           InterpAlpha);
+	return true;
+}
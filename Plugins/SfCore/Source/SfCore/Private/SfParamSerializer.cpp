@@ -0,0 +1,489 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SfParamSerializer.h"
+
+#include "SfClassIndexManifest.h"
+#include "SfObject.h"
+#include "UObject/CoreNet.h"
+#include "UObject/UnrealType.h"
+
+namespace SfParamSerializer
+{
+	//Arrays in params shouldn't need to be large, and this stops bad data from allocating a huge array.
+	static constexpr uint32 MaxArrayNum = UINT8_MAX;
+
+	enum class EOpType : uint8
+	{
+		Bool,
+		FixedBits,
+		Packed,
+		QuantizedInt,
+		Float,
+		QuantizedFloat,
+		Name,
+		String,
+		Text,
+		Array
+	};
+
+	struct FOp
+	{
+		EOpType Type = EOpType::Bool;
+
+		//Offset of the value from the start of the struct or array element.
+		int32 Offset = 0;
+
+		const FProperty* Property = nullptr;
+
+		bool bIsSigned = false;
+
+		uint8 NumBits = 0;
+
+		int64 IntMin = 0;
+
+		int64 IntMax = 0;
+
+		double FloatMin = 0;
+
+		double FloatMax = 0;
+
+		double FloatStep = 0;
+
+		uint64 MaxQuantized = 0;
+
+		TArray<FOp> ElementOps;
+	};
+
+	struct FPlan
+	{
+		//Used to detect if a user defined struct has been recompiled.
+		const FField* ChildProperties = nullptr;
+
+		int32 StructureSize = 0;
+
+		TArray<FOp> Ops;
+	};
+
+	static TMap<const UScriptStruct*, FPlan>& GetPlans()
+	{
+		static TMap<const UScriptStruct*, FPlan> Plans;
+		return Plans;
+	}
+
+	static bool IsSignedInteger(const FProperty* Property)
+	{
+		return Property->IsA<FInt8Property>() || Property->IsA<FInt16Property>() || Property->IsA<FIntProperty>() ||
+			Property->IsA<FInt64Property>();
+	}
+
+	static uint8 GetBitsForRange(const uint64 InRange)
+	{
+		return FMath::Max(1, static_cast<int32>(FMath::CeilLogTwo64(InRange + 1)));
+	}
+
+	static void CompileProperty(const FProperty* Property, const int32 BaseOffset, TArray<FOp>& OutOps);
+
+	static void CompileEnum(const FNumericProperty* UnderlyingProperty, const UEnum* Enum, const int32 Offset,
+	                        TArray<FOp>& OutOps)
+	{
+		FOp& Op = OutOps.AddDefaulted_GetRef();
+		Op.Offset = Offset;
+		Op.Property = UnderlyingProperty;
+		Op.bIsSigned = IsSignedInteger(UnderlyingProperty);
+		int64 MinValue = 0;
+		int64 MaxValue = 0;
+		//The last entry is the generated _MAX.
+		for (int32 i = 0; i < Enum->NumEnums() - 1; i++)
+		{
+			MinValue = FMath::Min(MinValue, Enum->GetValueByIndex(i));
+			MaxValue = FMath::Max(MaxValue, Enum->GetValueByIndex(i));
+		}
+		if (MinValue < 0)
+		{
+			Op.Type = EOpType::Packed;
+			return;
+		}
+		//Only the bits needed for the largest value are sent.
+		Op.Type = EOpType::FixedBits;
+		Op.NumBits = GetBitsForRange(MaxValue);
+	}
+
+	static void CompileInteger(const FNumericProperty* Property, const int32 Offset, TArray<FOp>& OutOps)
+	{
+		FOp& Op = OutOps.AddDefaulted_GetRef();
+		Op.Offset = Offset;
+		Op.Property = Property;
+		Op.bIsSigned = IsSignedInteger(Property);
+		const FSfParamQuantizationRule* Rule = USfClassIndexManifest::FindParamQuantizationRule(
+			Property->GetOwnerStruct(), Property->GetFName());
+		if (Rule && Rule->HasRange())
+		{
+			Op.Type = EOpType::QuantizedInt;
+			Op.IntMin = FMath::RoundToInt64(Rule->Min);
+			Op.IntMax = FMath::RoundToInt64(Rule->Max);
+			Op.NumBits = GetBitsForRange(static_cast<uint64>(Op.IntMax - Op.IntMin));
+			return;
+		}
+		if (Rule && Rule->Bits > 0 && Rule->Bits <= 64)
+		{
+			Op.Type = EOpType::FixedBits;
+			Op.NumBits = Rule->Bits;
+			return;
+		}
+		if (Rule)
+		{
+			UE_LOG(LogSfCore, Warning, TEXT("Param quantization for property %s needs ClampMin and ClampMax or SfBits."),
+			       *Property->GetName());
+		}
+		//Small integers are sent whole, larger ones are packed since most values are small.
+		if (Property->ElementSize <= 2)
+		{
+			Op.Type = EOpType::FixedBits;
+			Op.NumBits = Property->ElementSize * 8;
+		}
+		else
+		{
+			Op.Type = EOpType::Packed;
+		}
+	}
+
+	static void CompileFloat(const FNumericProperty* Property, const int32 Offset, TArray<FOp>& OutOps)
+	{
+		FOp& Op = OutOps.AddDefaulted_GetRef();
+		Op.Offset = Offset;
+		Op.Property = Property;
+		Op.Type = EOpType::Float;
+		const FSfParamQuantizationRule* Rule = USfClassIndexManifest::FindParamQuantizationRule(
+			Property->GetOwnerStruct(), Property->GetFName());
+		if (!Rule) return;
+		if (!Rule->HasRange() || (Rule->Step <= 0 && (Rule->Bits <= 0 || Rule->Bits > 32)))
+		{
+			UE_LOG(LogSfCore, Warning,
+			       TEXT("Param quantization for property %s needs ClampMin, ClampMax and either SfQuantizationStep or SfBits."),
+			       *Property->GetName());
+			return;
+		}
+		const double Step = Rule->Step > 0 ? Rule->Step : (Rule->Max - Rule->Min) / ((1ull << Rule->Bits) - 1);
+		const uint64 MaxQuantized = static_cast<uint64>(FMath::RoundToDouble((Rule->Max - Rule->Min) / Step));
+		const uint8 NumBits = GetBitsForRange(MaxQuantized);
+		//Not worth quantizing if it's larger than a float.
+		if (NumBits >= 32) return;
+		Op.Type = EOpType::QuantizedFloat;
+		Op.FloatMin = Rule->Min;
+		Op.FloatMax = Rule->Max;
+		Op.FloatStep = Step;
+		Op.MaxQuantized = MaxQuantized;
+		Op.NumBits = NumBits;
+	}
+
+	static void CompileValue(const FProperty* Property, const int32 Offset, TArray<FOp>& OutOps)
+	{
+		if (const FBoolProperty* BoolProperty = CastField<FBoolProperty>(Property))
+		{
+			FOp& Op = OutOps.AddDefaulted_GetRef();
+			Op.Type = EOpType::Bool;
+			Op.Offset = Offset;
+			Op.Property = BoolProperty;
+		}
+		else if (const FEnumProperty* EnumProperty = CastField<FEnumProperty>(Property))
+		{
+			CompileEnum(EnumProperty->GetUnderlyingProperty(), EnumProperty->GetEnum(), Offset, OutOps);
+		}
+		else if (const FByteProperty* ByteProperty = CastField<FByteProperty>(Property); ByteProperty && ByteProperty->
+			Enum)
+		{
+			CompileEnum(ByteProperty, ByteProperty->Enum, Offset, OutOps);
+		}
+		else if (const FNumericProperty* NumericProperty = CastField<FNumericProperty>(Property))
+		{
+			if (NumericProperty->IsFloatingPoint())
+			{
+				CompileFloat(NumericProperty, Offset, OutOps);
+			}
+			else if (NumericProperty->IsInteger())
+			{
+				CompileInteger(NumericProperty, Offset, OutOps);
+			}
+		}
+		else if (Property->IsA<FNameProperty>() || Property->IsA<FStrProperty>() || Property->IsA<FTextProperty>())
+		{
+			FOp& Op = OutOps.AddDefaulted_GetRef();
+			Op.Type = EOpType::Text;
+			if (Property->IsA<FNameProperty>())
+			{
+				Op.Type = EOpType::Name;
+			}
+			else if (Property->IsA<FStrProperty>())
+			{
+				Op.Type = EOpType::String;
+			}
+			Op.Offset = Offset;
+			Op.Property = Property;
+		}
+		else if (const FArrayProperty* ArrayProperty = CastField<FArrayProperty>(Property))
+		{
+			FOp& Op = OutOps.AddDefaulted_GetRef();
+			Op.Type = EOpType::Array;
+			Op.Offset = Offset;
+			Op.Property = ArrayProperty;
+			CompileProperty(ArrayProperty->Inner, 0, Op.ElementOps);
+		}
+		else if (const FStructProperty* StructProperty = CastField<FStructProperty>(Property))
+		{
+			//Nested structs are flattened into the plan.
+			for (TFieldIterator<FProperty> PropertyIt(StructProperty->Struct); PropertyIt; ++PropertyIt)
+			{
+				CompileProperty(*PropertyIt, Offset, OutOps);
+			}
+		}
+		else
+		{
+			UE_LOG(LogSfCore, Warning, TEXT("Param property %s has an unsupported type and won't be serialized."),
+			       *Property->GetName());
+		}
+	}
+
+	static void CompileProperty(const FProperty* Property, const int32 BaseOffset, TArray<FOp>& OutOps)
+	{
+		for (int32 ArrayIndex = 0; ArrayIndex < Property->ArrayDim; ArrayIndex++)
+		{
+			CompileValue(Property, BaseOffset + Property->GetOffset_ForInternal() + Property->ElementSize * ArrayIndex,
+			             OutOps);
+		}
+	}
+
+	static const FPlan& GetPlan(const UScriptStruct* Struct)
+	{
+		FPlan* ExistingPlan = GetPlans().Find(Struct);
+		if (ExistingPlan && ExistingPlan->ChildProperties == Struct->ChildProperties && ExistingPlan->StructureSize ==
+			Struct->GetStructureSize())
+		{
+			return *ExistingPlan;
+		}
+		FPlan Plan;
+		Plan.ChildProperties = Struct->ChildProperties;
+		Plan.StructureSize = Struct->GetStructureSize();
+		for (TFieldIterator<FProperty> PropertyIt(Struct); PropertyIt; ++PropertyIt)
+		{
+			CompileProperty(*PropertyIt, 0, Plan.Ops);
+		}
+		return GetPlans().Add(Struct, MoveTemp(Plan));
+	}
+
+	static void SerializeOps(const TArray<FOp>& Ops, uint8* Base, FArchive& Ar)
+	{
+		const bool bIsSaving = Ar.IsSaving();
+		for (const FOp& Op : Ops)
+		{
+			void* ValuePtr = Base + Op.Offset;
+			switch (Op.Type)
+			{
+			case EOpType::Bool:
+				{
+					const FBoolProperty* BoolProperty = static_cast<const FBoolProperty*>(Op.Property);
+					uint8 bBoolValue = bIsSaving ? BoolProperty->GetPropertyValue(ValuePtr) : 0;
+					Ar.SerializeBits(&bBoolValue, 1);
+					if (!bIsSaving)
+					{
+						BoolProperty->SetPropertyValue(ValuePtr, bBoolValue != 0);
+					}
+					break;
+				}
+			case EOpType::FixedBits:
+				{
+					const FNumericProperty* NumericProperty = static_cast<const FNumericProperty*>(Op.Property);
+					const uint64 Mask = Op.NumBits >= 64 ? MAX_uint64 : (1ull << Op.NumBits) - 1;
+					uint64 Value = 0;
+					if (bIsSaving)
+					{
+						//Clamp so values out of range don't wrap around.
+						if (Op.bIsSigned)
+						{
+							const int64 SignedMax = static_cast<int64>(Mask >> 1);
+							Value = static_cast<uint64>(FMath::Clamp(NumericProperty->GetSignedIntPropertyValue(ValuePtr),
+							                                         -SignedMax - 1, SignedMax));
+						}
+						else
+						{
+							Value = FMath::Min(NumericProperty->GetUnsignedIntPropertyValue(ValuePtr), Mask);
+						}
+					}
+					Ar.SerializeBits(&Value, Op.NumBits);
+					if (!bIsSaving)
+					{
+						Value &= Mask;
+						if (Op.bIsSigned)
+						{
+							//Sign extend.
+							if (Op.NumBits < 64 && Value >> (Op.NumBits - 1) & 1)
+							{
+								Value |= ~Mask;
+							}
+							NumericProperty->SetIntPropertyValue(ValuePtr, static_cast<int64>(Value));
+						}
+						else
+						{
+							NumericProperty->SetIntPropertyValue(ValuePtr, Value);
+						}
+					}
+					break;
+				}
+			case EOpType::Packed:
+				{
+					const FNumericProperty* NumericProperty = static_cast<const FNumericProperty*>(Op.Property);
+					uint64 Value = 0;
+					if (bIsSaving)
+					{
+						if (Op.bIsSigned)
+						{
+							//Zigzag encode so small negative values are also small.
+							const int64 SignedValue = NumericProperty->GetSignedIntPropertyValue(ValuePtr);
+							Value = (static_cast<uint64>(SignedValue) << 1) ^ static_cast<uint64>(SignedValue >> 63);
+						}
+						else
+						{
+							Value = NumericProperty->GetUnsignedIntPropertyValue(ValuePtr);
+						}
+					}
+					Ar.SerializeIntPacked64(Value);
+					if (!bIsSaving)
+					{
+						if (Op.bIsSigned)
+						{
+							NumericProperty->SetIntPropertyValue(
+								ValuePtr, static_cast<int64>(Value >> 1) ^ -static_cast<int64>(Value & 1));
+						}
+						else
+						{
+							NumericProperty->SetIntPropertyValue(ValuePtr, Value);
+						}
+					}
+					break;
+				}
+			case EOpType::QuantizedInt:
+				{
+					const FNumericProperty* NumericProperty = static_cast<const FNumericProperty*>(Op.Property);
+					uint64 Quantized = 0;
+					if (bIsSaving)
+					{
+						const int64 Value = Op.bIsSigned
+							                    ? NumericProperty->GetSignedIntPropertyValue(ValuePtr)
+							                    : static_cast<int64>(NumericProperty->GetUnsignedIntPropertyValue(ValuePtr));
+						Quantized = static_cast<uint64>(FMath::Clamp(Value, Op.IntMin, Op.IntMax) - Op.IntMin);
+					}
+					Ar.SerializeBits(&Quantized, Op.NumBits);
+					if (!bIsSaving)
+					{
+						const int64 Value = FMath::Min(Op.IntMin + static_cast<int64>(Quantized), Op.IntMax);
+						NumericProperty->SetIntPropertyValue(ValuePtr, Value);
+					}
+					break;
+				}
+			case EOpType::Float:
+				{
+					const FNumericProperty* NumericProperty = static_cast<const FNumericProperty*>(Op.Property);
+					float FloatValue = bIsSaving ? NumericProperty->GetFloatingPointPropertyValue(ValuePtr) : 0;
+					Ar << FloatValue;
+					if (!bIsSaving)
+					{
+						NumericProperty->SetFloatingPointPropertyValue(ValuePtr, FloatValue);
+					}
+					break;
+				}
+			case EOpType::QuantizedFloat:
+				{
+					const FNumericProperty* NumericProperty = static_cast<const FNumericProperty*>(Op.Property);
+					uint64 Quantized = 0;
+					if (bIsSaving)
+					{
+						const double Value = FMath::Clamp(NumericProperty->GetFloatingPointPropertyValue(ValuePtr),
+						                                  Op.FloatMin, Op.FloatMax);
+						Quantized = FMath::Min(
+							static_cast<uint64>(FMath::RoundToDouble((Value - Op.FloatMin) / Op.FloatStep)),
+							Op.MaxQuantized);
+					}
+					Ar.SerializeBits(&Quantized, Op.NumBits);
+					if (!bIsSaving)
+					{
+						const double Value = FMath::Min(Op.FloatMin + FMath::Min(Quantized, Op.MaxQuantized) * Op.FloatStep,
+						                                Op.FloatMax);
+						NumericProperty->SetFloatingPointPropertyValue(ValuePtr, Value);
+					}
+					break;
+				}
+			case EOpType::Name:
+				{
+					//Names need to be serialized through the package map to be read on another machine.
+					const FNameProperty* NameProperty = static_cast<const FNameProperty*>(Op.Property);
+					FName NameValue = bIsSaving ? NameProperty->GetPropertyValue(ValuePtr) : FName();
+					UPackageMap::StaticSerializeName(Ar, NameValue);
+					if (!bIsSaving)
+					{
+						NameProperty->SetPropertyValue(ValuePtr, NameValue);
+					}
+					break;
+				}
+			case EOpType::String:
+				{
+					const FStrProperty* StringProperty = static_cast<const FStrProperty*>(Op.Property);
+					FString StringValue = bIsSaving ? StringProperty->GetPropertyValue(ValuePtr) : FString();
+					Ar << StringValue;
+					if (!bIsSaving)
+					{
+						StringProperty->SetPropertyValue(ValuePtr, StringValue);
+					}
+					break;
+				}
+			case EOpType::Text:
+				{
+					const FTextProperty* TextProperty = static_cast<const FTextProperty*>(Op.Property);
+					FText TextValue = bIsSaving ? TextProperty->GetPropertyValue(ValuePtr) : FText();
+					Ar << TextValue;
+					if (!bIsSaving)
+					{
+						TextProperty->SetPropertyValue(ValuePtr, TextValue);
+					}
+					break;
+				}
+			case EOpType::Array:
+				{
+					FScriptArrayHelper Helper(static_cast<const FArrayProperty*>(Op.Property), ValuePtr);
+					uint32 Num = Helper.Num();
+					Ar.SerializeIntPacked(Num);
+					if (Num > MaxArrayNum)
+					{
+						UE_LOG(LogSfCore, Error, TEXT("Param array has more than %u elements."), MaxArrayNum);
+						Ar.SetError();
+						return;
+					}
+					if (!bIsSaving)
+					{
+						Helper.Resize(Num);
+					}
+					for (uint32 i = 0; i < Num; i++)
+					{
+						SerializeOps(Op.ElementOps, Helper.GetRawPtr(i), Ar);
+					}
+					break;
+				}
+			}
+			if (Ar.IsError()) return;
+		}
+	}
+}
+
+void FSfParamSerializer::SerializeStruct(const UScriptStruct* Struct, void* StructPtr, FArchive& Ar)
+{
+	if (!Struct || !StructPtr) return;
+	SerializeOps(SfParamSerializer::GetPlan(Struct).Ops, static_cast<uint8*>(StructPtr), Ar);
+	if (Ar.IsError())
+	{
+		UE_LOG(LogSfCore, Error, TEXT("Error serializing params of struct %s."), *Struct->GetName());
+	}
+}
+
+void FSfParamSerializer::ClearCache()
+{
+	SfParamSerializer::GetPlans().Empty();
+}
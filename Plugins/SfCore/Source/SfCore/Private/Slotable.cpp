@@ -125,6 +125,10 @@ void USlotable::ServerDeinitializeConstituent(UConstituent* Constituent)
 
 void USlotable::OnRep_Constituents()
 {
+	if (OwningInventory)
+	{
+		OwningInventory->MarkConstituentTableDirty();
+	}
 	//Register and deregister subobjects on client.
 	for (UConstituent* ReplicatedConstituent : Constituents)
 	{
@@ -0,0 +1,201 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SfTestAccess.h"
+#include "SfTestWorld.h"
+#include "GameFramework/GameStateBase.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSfActionSetBatchTest, "SfCore.FormCore.ActionSetBatch",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+namespace SfActionSetBatchTest
+{
+	static constexpr int32 InventoryCount = 4;
+
+	static constexpr int32 ConstituentsPerInventory = 16;
+
+	static constexpr int32 Frames = 300;
+
+	static constexpr double StartTime = 100;
+
+	static constexpr double TickInterval = 1 / 30.0;
+
+	//Chance of each constituent executing in a frame, and of one executing again later in the same frame.
+	static constexpr float ExecuteChance = 0.3f;
+
+	static constexpr float ExecuteAgainChance = 0.1f;
+
+	//A form with inventories of constituents. Constituents are returned in inventory order.
+	static UFormCoreComponent* MakeForm(const FSfTestWorld& InWorld, const ENetRole InRole,
+	                                    TArray<UConstituent*>& OutConstituents)
+	{
+		AActor* Actor = InWorld.SpawnActor<AActor>();
+		Actor->SetRole(InRole);
+		UFormCoreComponent* FormCore = NewObject<UFormCoreComponent>(Actor);
+		for (int32 i = 0; i < InventoryCount; i++)
+		{
+			USlotable* Slotable = FSfTestAccess::AddSlotable(FSfTestAccess::AddInventory(FormCore));
+			for (int32 j = 0; j < ConstituentsPerInventory; j++)
+			{
+				OutConstituents.Add(FSfTestAccess::AddConstituent(Slotable, j + 1));
+			}
+		}
+		FormCore->MarkConstituentTableDirty();
+		return FormCore;
+	}
+
+	static bool IsSameBatch(const FSfActionSetBatch& A, const FSfActionSetBatch& B)
+	{
+		if (A.ServerTimestamp != B.ServerTimestamp || A.ActionSets.Num() != B.ActionSets.Num()) return false;
+		for (int32 i = 0; i < A.ActionSets.Num(); i++)
+		{
+			if (A.ActionSets[i].InventoryIndex != B.ActionSets[i].InventoryIndex
+				|| A.ActionSets[i].InstanceId != B.ActionSets[i].InstanceId
+				|| !(A.ActionSets[i].ActionSet == B.ActionSets[i].ActionSet))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+bool FSfActionSetBatchTest::RunTest(const FString& Parameters)
+{
+	using namespace SfActionSetBatchTest;
+	const FSfTestWorld World;
+	World.Get()->SetGameState(World.SpawnActor<AGameStateBase>());
+	TArray<UConstituent*> ServerConstituents;
+	UFormCoreComponent* Server = MakeForm(World, ROLE_Authority, ServerConstituents);
+	TArray<UConstituent*> ClientConstituents;
+	UFormCoreComponent* Client = MakeForm(World, ROLE_SimulatedProxy, ClientConstituents);
+
+	//Every frame constituents execute in a random order, some more than once. The batch has one entry for each
+	//constituent in the order it first executed, with the action set it last executed.
+	FRandomStream Random(24);
+	int32 ActionSets = 0;
+	int32 Batches = 0;
+	int32 BatchBits = 0;
+	int32 IndividualBits = 0;
+	int32 OrderMismatches = 0;
+	int32 ReplicatedStateMismatches = 0;
+	int32 RoundTripFailures = 0;
+	int32 ClientMismatches = 0;
+	double BuildTime = 0;
+	for (int32 Frame = 0; Frame < Frames; Frame++)
+	{
+		const double Time = StartTime + Frame * TickInterval;
+		World.Get()->TimeSeconds = Time;
+		TArray<int32> Executions;
+		for (int32 i = 0; i < ServerConstituents.Num(); i++)
+		{
+			if (Random.FRand() < ExecuteChance) Executions.Add(i);
+		}
+		for (int32 i = Executions.Num() - 1; i > 0; i--)
+		{
+			Executions.Swap(i, Random.RandRange(0, i));
+		}
+		TArray<int32> ExpectedOrder = Executions;
+		for (int32 i = 0; i < ExpectedOrder.Num(); i++)
+		{
+			if (Random.FRand() < ExecuteAgainChance) Executions.Add(ExpectedOrder[i]);
+		}
+		for (const int32 Execution : Executions)
+		{
+			FSfTestAccess::LastActionSet(ServerConstituents[Execution]) = FActionSet(
+				static_cast<float>(Time), static_cast<uint8>(Random.RandRange(1, 63)));
+			Server->QueueActionSetForClients(ServerConstituents[Execution]);
+		}
+
+		FSfActionSetBatch Batch;
+		const double StartBuildTime = FPlatformTime::Seconds();
+		const bool bBuilt = FSfTestAccess::BuildQueuedActionSetBatch(Server, Batch);
+		BuildTime += FPlatformTime::Seconds() - StartBuildTime;
+		if (!bBuilt)
+		{
+			OrderMismatches += ExpectedOrder.Num() > 0;
+			continue;
+		}
+		Batches++;
+		ActionSets += Batch.ActionSets.Num();
+		FSfActionSetBatch ExpectedBatch;
+		ExpectedBatch.ServerTimestamp = static_cast<float>(Time);
+		for (const int32 Execution : ExpectedOrder)
+		{
+			UConstituent* Constituent = ServerConstituents[Execution];
+			FSfBatchedActionSet& Expected = ExpectedBatch.ActionSets.AddDefaulted_GetRef();
+			Expected.InventoryIndex = Execution / ConstituentsPerInventory;
+			Expected.InstanceId = Constituent->InstanceId;
+			Expected.ActionSet = FSfTestAccess::LastActionSet(Constituent);
+			ReplicatedStateMismatches += !(Constituent->ReplicatedActionState.ActionSet == Expected.ActionSet)
+				|| Constituent->ReplicatedActionState.ServerTimestamp != Batch.ServerTimestamp;
+		}
+		OrderMismatches += !IsSameBatch(Batch, ExpectedBatch);
+
+		//The batch is read back as it was written, and performed by the matching constituents on the client.
+		FBitWriter Writer(0, true);
+		bool bWriteSuccess = false;
+		Batch.NetSerialize(Writer, nullptr, bWriteSuccess);
+		BatchBits += Writer.GetNumBits();
+		FBitReader Reader(Writer.GetData(), Writer.GetNumBits());
+		FSfActionSetBatch ReadBatch;
+		bool bReadSuccess = false;
+		ReadBatch.NetSerialize(Reader, nullptr, bReadSuccess);
+		RoundTripFailures += !bWriteSuccess || !bReadSuccess || !Reader.AtEnd()
+			|| !IsSameBatch(ReadBatch, Batch);
+		FSfTestAccess::NetMulticastClientPerformActionSets_Implementation(Client, ReadBatch);
+		for (const int32 Execution : ExpectedOrder)
+		{
+			ClientMismatches += !(FSfTestAccess::LastActionSet(ClientConstituents[Execution])
+				== FSfTestAccess::LastActionSet(ServerConstituents[Execution]));
+		}
+
+		//Sent on its own, each action set would also need a timestamp.
+		for (const FSfBatchedActionSet& BatchedActionSet : Batch.ActionSets)
+		{
+			FBitWriter IndividualWriter(0, true);
+			FSfReplicatedActionState State;
+			State.ActionSet = BatchedActionSet.ActionSet;
+			State.ServerTimestamp = Batch.ServerTimestamp;
+			State.NetSerialize(IndividualWriter, nullptr, bWriteSuccess);
+			IndividualBits += IndividualWriter.GetNumBits();
+		}
+	}
+	TestTrue(TEXT("Frames execute action sets"), ActionSets > Frames);
+	TestEqual(TEXT("Batches hold each executed constituent once in the order it first executed"), OrderMismatches, 0);
+	TestEqual(TEXT("Batched action sets are kept for clients that become relevant"), ReplicatedStateMismatches, 0);
+	TestEqual(TEXT("Batches are read as they were written"), RoundTripFailures, 0);
+	TestEqual(TEXT("Clients perform every batched action set"), ClientMismatches, 0);
+	AddInfo(FString::Printf(TEXT("%d constituents, %d frames: %d action sets in %d multicasts instead of %d, %d bits "
+		                        "batched and %d bits sent one by one before RPC overhead, %.2f us per batch."),
+	                        ServerConstituents.Num(), Frames, ActionSets, Batches, ActionSets, BatchBits,
+	                        IndividualBits, BuildTime * 1e6 / FMath::Max(Batches, 1)));
+
+	//Sending empties the queue, so constituents can be queued again.
+	Server->QueueActionSetForClients(ServerConstituents[0]);
+	FSfTestAccess::SendQueuedActionSets(Server);
+	TestEqual(TEXT("Sending empties the queue"), FSfTestAccess::ConstituentsPendingClientExecution(Server).Num(), 0);
+	Server->QueueActionSetForClients(ServerConstituents[0]);
+	TestEqual(TEXT("Sent constituents are queued again"),
+	          FSfTestAccess::ConstituentsPendingClientExecution(Server).Num(), 1);
+
+	//A batch with more action sets than a form can have is rejected before allocating.
+	FBitWriter BadWriter(0, true);
+	float ServerTimestamp = static_cast<float>(StartTime);
+	uint32 Num = MAX_uint16 + 1;
+	BadWriter << ServerTimestamp;
+	BadWriter.SerializeIntPacked(Num);
+	FBitReader BadReader(BadWriter.GetData(), BadWriter.GetNumBits());
+	FSfActionSetBatch BadBatch;
+	bool bBadSuccess = true;
+	BadBatch.NetSerialize(BadReader, nullptr, bBadSuccess);
+	TestFalse(TEXT("Batches with too many action sets fail"), bBadSuccess);
+	TestEqual(TEXT("Batches with too many action sets aren't allocated"), BadBatch.ActionSets.Num(), 0);
+	return true;
+}
+
+#endif
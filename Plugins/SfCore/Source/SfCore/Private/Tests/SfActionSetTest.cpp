@@ -0,0 +1,216 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Constituent.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "Serialization/BitReader.h"
+#include "Serialization/BitWriter.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSfActionSetTest, "SfCore.Constituent.ActionSet",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+namespace SfActionSetTest
+{
+	//Constituents on a form whose last action sets are copied into pending action sets and compared every tick.
+	static constexpr int32 ConstituentCount = 50;
+
+	static constexpr int32 Ticks = 10000;
+
+	//How action sets were stored before params were packed inline, with a bit array of params for each action.
+	struct FLegacyActionSet
+	{
+		uint8 NumActionsMinusOne = 0;
+
+		uint8 Actions[4] = {};
+
+		TBitArray<> Params[4];
+
+		float WorldTime = 0;
+
+		FLegacyActionSet() = default;
+
+		explicit FLegacyActionSet(const FActionSet& InActionSet)
+		{
+			NumActionsMinusOne = InActionSet.NumActionsMinusOne;
+			WorldTime = InActionSet.WorldTime;
+			for (int32 i = 0; i < 4; i++)
+			{
+				Actions[i] = InActionSet.GetAction(i);
+				Params[i] = InActionSet.GetParams(i);
+			}
+		}
+
+		bool operator==(const FLegacyActionSet& Other) const
+		{
+			return NumActionsMinusOne == Other.NumActionsMinusOne && Actions[0] == Other.Actions[0]
+				&& Actions[1] == Other.Actions[1] && Actions[2] == Other.Actions[2] && Actions[3] == Other.Actions[3];
+		}
+
+		//Same as the old operator<<, including action zero's params being written twice.
+		void Save(FArchive& Ar)
+		{
+			Ar.SerializeBits(&NumActionsMinusOne, 2);
+			bool bSendParams = Params[0].Num() > 0 || Params[1].Num() > 0 || Params[2].Num() > 0
+				|| Params[3].Num() > 0;
+			Ar.SerializeBits(&bSendParams, 1);
+			Ar.SerializeBits(&Actions[0], 6);
+			if (bSendParams) Ar << Params[0];
+			if (bSendParams) Ar << Params[0];
+			for (int32 i = 1; i <= NumActionsMinusOne; i++)
+			{
+				Ar.SerializeBits(&Actions[i], 6);
+				if (bSendParams) Ar << Params[i];
+			}
+		}
+	};
+
+	static FBitWriter MakeParams(const int32 InNumBits, FRandomStream& InRandom)
+	{
+		FBitWriter Params(0, true);
+		for (int32 i = 0; i < InNumBits; i++)
+		{
+			Params.WriteBit(InRandom.RandRange(0, 1));
+		}
+		return Params;
+	}
+
+	static FActionSet MakeActionSet(FRandomStream& InRandom, const bool bInWithParams)
+	{
+		FActionSet ActionSet(0, InRandom.RandRange(1, 63));
+		const int32 ExtraActions = InRandom.RandRange(0, 3);
+		for (int32 i = 0; i < ExtraActions; i++)
+		{
+			ActionSet.TryAddActionCheckIfSameFrame(0, InRandom.RandRange(1, 63),
+			                                       bInWithParams ? MakeParams(InRandom.RandRange(0, 40), InRandom)
+			                                                     : FBitWriter());
+		}
+		return ActionSet;
+	}
+
+	static bool HasSameParams(const FActionSet& InA, const FActionSet& InB)
+	{
+		for (int32 i = 0; i < 4; i++)
+		{
+			if (InA.GetParams(i) != InB.GetParams(i)) return false;
+		}
+		return true;
+	}
+
+	static bool RoundTrips(FActionSet& InActionSet, FActionSet& OutLoaded)
+	{
+		FBitWriter Writer(0, true);
+		Writer << InActionSet;
+		FBitReader Reader(Writer.GetData(), Writer.GetNumBits());
+		Reader << OutLoaded;
+		return !Reader.IsError() && Reader.AtEnd() && OutLoaded == InActionSet
+			&& OutLoaded.NumActionsMinusOne == InActionSet.NumActionsMinusOne && HasSameParams(OutLoaded, InActionSet);
+	}
+}
+
+bool FSfActionSetTest::RunTest(const FString& Parameters)
+{
+	using namespace SfActionSetTest;
+	FRandomStream Random(23);
+
+	//Sets without params are written exactly as before, so clients and servers on either format read them the same.
+	int32 FormatMismatches = 0;
+	for (int32 i = 0; i < 200; i++)
+	{
+		FActionSet ActionSet = MakeActionSet(Random, false);
+		FBitWriter Writer(0, true);
+		Writer << ActionSet;
+		FLegacyActionSet LegacyActionSet(ActionSet);
+		FBitWriter LegacyWriter(0, true);
+		LegacyActionSet.Save(LegacyWriter);
+		FormatMismatches += Writer.GetNumBits() != LegacyWriter.GetNumBits()
+			|| FMemory::Memcmp(Writer.GetData(), LegacyWriter.GetData(), Writer.GetNumBytes()) != 0;
+	}
+	TestEqual(TEXT("Sets without params serialize the same as the old format"), FormatMismatches, 0);
+
+	//Sets with params round trip, including params that overflow the inline buffer, and take fewer bits than before.
+	int32 RoundTripFailures = 0;
+	int64 Bits = 0;
+	int64 LegacyBits = 0;
+	for (int32 i = 0; i < 200; i++)
+	{
+		FActionSet ActionSet = MakeActionSet(Random, true);
+		FActionSet Loaded;
+		RoundTripFailures += !RoundTrips(ActionSet, Loaded);
+		FBitWriter Writer(0, true);
+		Writer << ActionSet;
+		Bits += Writer.GetNumBits();
+		FLegacyActionSet LegacyActionSet(ActionSet);
+		FBitWriter LegacyWriter(0, true);
+		LegacyActionSet.Save(LegacyWriter);
+		LegacyBits += LegacyWriter.GetNumBits();
+	}
+	TestEqual(TEXT("Sets with params round trip"), RoundTripFailures, 0);
+	TestTrue(TEXT("Params take fewer bits than before"), Bits < LegacyBits);
+	AddInfo(FString::Printf(TEXT("Sets with params: %.1f bits per set, %.1f bits per set before."), Bits / 200.0,
+	                        LegacyBits / 200.0));
+
+	FActionSet Overflowing(0, 1, MakeParams(200, Random), 2, MakeParams(300, Random));
+	FActionSet LoadedOverflowing;
+	TestTrue(TEXT("Params that overflow the inline buffer are kept"),
+	         Overflowing.ParamBytes.Num() > SfActionSetInlineParamBytes);
+	TestTrue(TEXT("Params that overflow the inline buffer round trip"), RoundTrips(Overflowing, LoadedOverflowing));
+
+	//Loading into a set that had more actions clears the ones that weren't sent.
+	FActionSet Single(0, 5);
+	FActionSet Full(0, 1, 2, 3, 4);
+	TestTrue(TEXT("Loading clears actions that weren't sent"), RoundTrips(Single, Full));
+	TestEqual(TEXT("Loading clears the last action of the longer set"), Full.GetAction(3), static_cast<uint8>(0));
+
+	//The hash compares the same way the action ids were compared before.
+	int32 EqualityMismatches = 0;
+	for (int32 i = 0; i < 2000; i++)
+	{
+		const FActionSet A = MakeActionSet(Random, true);
+		const FActionSet B = Random.FRand() < 0.5f ? FActionSet(A) : MakeActionSet(Random, true);
+		EqualityMismatches += (A == B) != (FLegacyActionSet(A) == FLegacyActionSet(B));
+	}
+	TestEqual(TEXT("Equality matches comparing the action ids"), EqualityMismatches, 0);
+
+	//Every tick the last action sets are copied into the pending action sets and compared with the responses.
+	TArray<FActionSet> LastActionSets;
+	TArray<FLegacyActionSet> LegacyLastActionSets;
+	for (int32 i = 0; i < ConstituentCount; i++)
+	{
+		LastActionSets.Add(MakeActionSet(Random, true));
+		LegacyLastActionSets.Emplace(LastActionSets.Last());
+	}
+	const TArray<FActionSet> Responses = LastActionSets;
+	const TArray<FLegacyActionSet> LegacyResponses = LegacyLastActionSets;
+	int32 Matches = 0;
+	TArray<FActionSet> PendingActionSets;
+	double StartTime = FPlatformTime::Seconds();
+	for (int32 Tick = 0; Tick < Ticks; Tick++)
+	{
+		PendingActionSets = LastActionSets;
+		for (int32 i = 0; i < ConstituentCount; i++)
+		{
+			Matches += PendingActionSets[i] == Responses[i];
+		}
+	}
+	const double Time = FPlatformTime::Seconds() - StartTime;
+	TArray<FLegacyActionSet> LegacyPendingActionSets;
+	StartTime = FPlatformTime::Seconds();
+	for (int32 Tick = 0; Tick < Ticks; Tick++)
+	{
+		LegacyPendingActionSets = LegacyLastActionSets;
+		for (int32 i = 0; i < ConstituentCount; i++)
+		{
+			Matches += LegacyPendingActionSets[i] == LegacyResponses[i];
+		}
+	}
+	const double LegacyTime = FPlatformTime::Seconds() - StartTime;
+	TestEqual(TEXT("Every copied set equals its response"), Matches, Ticks * ConstituentCount * 2);
+	AddInfo(FString::Printf(TEXT("%d sets: %.2f us per tick to copy and compare, %.2f us with bit arrays of params."),
+	                        ConstituentCount, Time * 1e6 / Ticks, LegacyTime * 1e6 / Ticks));
+	return true;
+}
+
+#endif
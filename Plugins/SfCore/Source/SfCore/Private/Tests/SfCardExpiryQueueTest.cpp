@@ -0,0 +1,128 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CardObject.h"
+#include "Inventory.h"
+#include "SfTestAccess.h"
+#include "SfTestWorld.h"
+#include "SfUtility.h"
+#include "GameFramework/GameStateBase.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSfCardExpiryQueueTest, "SfCore.Inventory.CardExpiryQueue",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+namespace SfCardExpiryQueueTest
+{
+	//Server time when the simulation starts.
+	static constexpr double StartTime = 100;
+
+	static constexpr int32 Ticks = 600;
+
+	static constexpr float TickInterval = 1 / 60.f;
+
+	//Cards whose lifetimes end during the simulation, half of them on each clock.
+	static constexpr int32 ShortLivedCards = 32;
+
+	//Long lived cards outlast the simulation on both clocks.
+	static constexpr float LongLifetime = 1000;
+
+	//Owners per card class, leaving out the shared owner of zero.
+	static constexpr int32 OwnersPerClass = 255;
+
+	//How ended lifetimes were found before the expiry queues, by checking every card each tick.
+	static int32 CountEndedLifetimesByScan(const TArray<FCard>& InCards, const UWorld* InWorld,
+	                                       const UFormCharacterComponent* InFormCharacter)
+	{
+		int32 Ended = 0;
+		for (const FCard& Card : InCards)
+		{
+			if (Card.LifetimeEndTimestamp <= -1.f) continue;
+			Ended += (Card.bUsingPredictedTimestamp
+				          ? InFormCharacter->CalculateTimeUntilPredictedTimestamp(Card.LifetimeEndTimestamp)
+				          : CalculateTimeUntilServerTimestamp(InWorld, Card.LifetimeEndTimestamp)) < 0;
+		}
+		return Ended;
+	}
+}
+
+bool FSfCardExpiryQueueTest::RunTest(const FString& Parameters)
+{
+	using namespace SfCardExpiryQueueTest;
+	const FSfTestWorld World;
+	AGameStateBase* GameState = World.SpawnActor<AGameStateBase>();
+	World.Get()->SetGameState(GameState);
+	//Card classes only act as keys here so they don't need to be generated from blueprints.
+	TArray<UClass*> CardClasses;
+	for (int32 i = 0; i < 8; i++)
+	{
+		UClass* CardClass = NewObject<UClass>(GetTransientPackage(), NAME_None, RF_Transient);
+		CardClass->SetSuperStruct(UCardObject::StaticClass());
+		CardClass->AddToRoot();
+		CardClasses.Add(CardClass);
+	}
+	FRandomStream Random(2);
+	for (const int32 CardCount : {10, 100, 1000})
+	{
+		//The form has no form character so the server removes ended cards instantly, and the predicted clock is
+		//read from a form character of its own.
+		AActor* Actor = World.SpawnActor<AActor>();
+		UInventory* Inventory = FSfTestAccess::AddInventory(NewObject<UFormCoreComponent>(Actor));
+		UFormCharacterComponent* FormCharacter = NewObject<UFormCharacterComponent>(Actor);
+		uint32& PredictedNetClockTicks = FSfTestAccess::PredictedNetClockTicks(FormCharacter);
+		PredictedNetClockTicks = 0;
+		float PredictedNetClockRemainder = 0;
+		World.Get()->TimeSeconds = StartTime;
+
+		TArray<FCard>& Cards = FSfTestAccess::Cards(Inventory);
+		for (int32 i = 0; i < CardCount + ShortLivedCards; i++)
+		{
+			FCard& Card = Cards.AddDefaulted_GetRef();
+			Card.Class = CardClasses[i / OwnersPerClass];
+			Card.OwnerConstituentInstanceId = i % OwnersPerClass + 1;
+			Card.bUsingPredictedTimestamp = i % 2 == 1;
+			const float Lifetime = i < CardCount ? LongLifetime : Random.FRandRange(0, Ticks * TickInterval);
+			//Predicted timestamps are whole ticks of the predicted clock.
+			constexpr float TicksPerSecond = UFormCharacterComponent::PredictedNetClockTicksPerSecond;
+			Card.LifetimeEndTimestamp = Card.bUsingPredictedTimestamp
+				                            ? FMath::RoundToFloat(Lifetime * TicksPerSecond) / TicksPerSecond
+				                            : StartTime + Lifetime;
+		}
+		FSfTestAccess::MarkCardIndexDirty(Inventory);
+		FSfTestAccess::MarkCardExpiryQueuesDirty(Inventory);
+
+		//Each tick ends lifetimes on both clocks, and no card whose lifetime ended may be left after the tick.
+		int32 LateCards = 0;
+		double QueueTime = 0;
+		double ScanTime = 0;
+		for (int32 Tick = 1; Tick <= Ticks; Tick++)
+		{
+			World.Get()->TimeSeconds = StartTime + Tick * TickInterval;
+			PredictedNetClockTicks = UFormCharacterComponent::AddTimeToPredictedNetClock(
+				PredictedNetClockTicks, PredictedNetClockRemainder, TickInterval);
+			double TickStartTime = FPlatformTime::Seconds();
+			Inventory->AuthorityTick(TickInterval);
+			Inventory->RemovePredictedCardsWithEndedLifetimes(FormCharacter);
+			QueueTime += FPlatformTime::Seconds() - TickStartTime;
+			TickStartTime = FPlatformTime::Seconds();
+			LateCards += CountEndedLifetimesByScan(Cards, World.Get(), FormCharacter);
+			ScanTime += FPlatformTime::Seconds() - TickStartTime;
+		}
+		TestEqual(FString::Printf(TEXT("Cards are removed on the tick their lifetime ends with %d cards"), CardCount),
+		          LateCards, 0);
+		TestEqual(FString::Printf(TEXT("Only cards whose lifetime ended are removed with %d cards"), CardCount),
+		          Cards.Num(), CardCount);
+		AddInfo(FString::Printf(TEXT("%d long lived cards: %.2f us per tick from the expiry queues, %.2f us scanning."),
+		                        CardCount, QueueTime * 1e6 / Ticks, ScanTime * 1e6 / Ticks));
+	}
+	for (UClass* CardClass : CardClasses)
+	{
+		CardClass->RemoveFromRoot();
+	}
+	return true;
+}
+
+#endif
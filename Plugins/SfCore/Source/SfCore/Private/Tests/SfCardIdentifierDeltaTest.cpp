@@ -0,0 +1,120 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FormCharacterComponent.h"
+#include "Misc/AutomationTest.h"
+#include "Serialization/BitReader.h"
+#include "Serialization/BitWriter.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSfCardIdentifierDeltaTest, "SfCore.FormCharacter.CardIdentifierDelta",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FSfCardIdentifierDeltaTest::RunTest(const FString& Parameters)
+{
+	//Scripted combat with up to 50 cards in an inventory. Each move applies and expires a few status effects, and the
+	//server acknowledges moves a few moves late like it would with latency.
+	constexpr int32 MoveCount = 600;
+	constexpr int32 AckDelay = 6;
+	constexpr int32 MaxCards = 50;
+	FRandomStream Random(11);
+	TArray<FCardIdentifiersInAnInventory> States;
+	States.Emplace();
+	for (int32 i = 0; i < 20; i++)
+	{
+		States[0].CardIdentifiers.Emplace(static_cast<uint16>(Random.RandRange(0, 300)),
+		                                  static_cast<uint8>(Random.RandRange(0, 40)));
+	}
+	for (int32 Move = 1; Move < MoveCount; Move++)
+	{
+		FCardIdentifiersInAnInventory State = States.Last();
+		//Most moves don't change cards at all.
+		if (Random.FRand() < 0.3f)
+		{
+			const int32 RemoveCount = State.CardIdentifiers.Num() > 0 ? Random.RandRange(0, 2) : 0;
+			for (int32 i = 0; i < RemoveCount && State.CardIdentifiers.Num() > 0; i++)
+			{
+				State.CardIdentifiers.RemoveAt(Random.RandRange(0, State.CardIdentifiers.Num() - 1));
+			}
+			const int32 AddCount = Random.RandRange(0, 2);
+			for (int32 i = 0; i < AddCount && State.CardIdentifiers.Num() < MaxCards; i++)
+			{
+				State.CardIdentifiers.Emplace(static_cast<uint16>(Random.RandRange(0, 300)),
+				                              static_cast<uint8>(Random.RandRange(0, 40)));
+			}
+		}
+		States.Add(MoveTemp(State));
+	}
+
+	int64 FullBits = 0;
+	int64 DeltaBits = 0;
+	int32 ChangedMoves = 0;
+	bool bRoundTripsMatch = true;
+	for (int32 Move = AckDelay; Move < MoveCount; Move++)
+	{
+		const FCardIdentifiersInAnInventory& Baseline = States[Move - AckDelay];
+		FCardIdentifiersInAnInventory& State = States[Move];
+		if (State == States[Move - 1]) continue;
+		ChangedMoves++;
+
+		//Before deltas the whole inventory was sent on every move in which a card changed.
+		FBitWriter FullWriter(0, true);
+		FullWriter << State.CardIdentifiers;
+		FullBits += FullWriter.GetNumBits();
+
+		//Same choice that FSfNetworkMoveData makes between a delta and the whole inventory.
+		uint32 NumRemoved;
+		uint32 NumAdded;
+		State.CountDelta(Baseline, NumRemoved, NumAdded);
+		FBitWriter DeltaWriter(0, true);
+		bool bIsInventoryDelta = NumRemoved + NumAdded < static_cast<uint32>(State.CardIdentifiers.Num());
+		DeltaWriter.SerializeBits(&bIsInventoryDelta, 1);
+		if (bIsInventoryDelta)
+		{
+			State.WriteDelta(DeltaWriter, Baseline);
+		}
+		else
+		{
+			DeltaWriter << State.CardIdentifiers;
+		}
+		DeltaBits += DeltaWriter.GetNumBits();
+
+		FBitReader Reader(DeltaWriter.GetData(), DeltaWriter.GetNumBits());
+		FCardIdentifiersInAnInventory Received;
+		bool bReadInventoryDelta = false;
+		Reader.SerializeBits(&bReadInventoryDelta, 1);
+		if (bReadInventoryDelta)
+		{
+			Received.ReadDelta(Reader, &Baseline);
+		}
+		else
+		{
+			Reader << Received.CardIdentifiers;
+		}
+		bRoundTripsMatch &= !Reader.IsError() && Received == State;
+	}
+	TestTrue(TEXT("Deltas read back into the sent card identifiers"), bRoundTripsMatch);
+	TestTrue(TEXT("Deltas send fewer bits than whole inventories"), DeltaBits < FullBits);
+	if (ChangedMoves > 0)
+	{
+		AddInfo(FString::Printf(TEXT("%d moves with card changes: %.1f bits per move whole, %.1f bits per move as deltas."),
+		                        ChangedMoves, static_cast<double>(FullBits) / ChangedMoves,
+		                        static_cast<double>(DeltaBits) / ChangedMoves));
+	}
+
+	//A lost baseline is only read past, so the rest of the move can still be read.
+	FBitWriter Writer(0, true);
+	States[AckDelay + 1].WriteDelta(Writer, States[1]);
+	uint32 Marker = 0x5f;
+	Writer << Marker;
+	FBitReader Reader(Writer.GetData(), Writer.GetNumBits());
+	FCardIdentifiersInAnInventory Skipped;
+	Skipped.ReadDelta(Reader, nullptr);
+	uint32 ReadMarker = 0;
+	Reader << ReadMarker;
+	TestEqual(TEXT("Deltas without a baseline are read past"), ReadMarker, Marker);
+	return true;
+}
+
+#endif
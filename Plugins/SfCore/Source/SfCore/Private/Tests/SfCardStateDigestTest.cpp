@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FormCharacterComponent.h"
+#include "SfTestAccess.h"
+#include "SfTestWorld.h"
+#include "Misc/AutomationTest.h"
+#include "Serialization/BitReader.h"
+#include "Serialization/BitWriter.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSfCardStateDigestTest, "SfCore.FormCharacter.CardStateDigest",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FSfCardStateDigestTest::RunTest(const FString& Parameters)
+{
+	//Cards change now and then, while the server acknowledges moves a few moves late like it would with latency and
+	//some moves are lost on the way.
+	constexpr int32 MoveCount = 2000;
+	constexpr int32 AckDelay = 6;
+	constexpr float CardChangeChance = 0.02f;
+	constexpr float MoveLossChance = 0.05f;
+	FRandomStream Random(12);
+	const FSfTestWorld World;
+	UFormCharacterComponent* Client = NewObject<UFormCharacterComponent>(GetTransientPackage());
+	UFormCharacterComponent* Server = FSfTestAccess::CreateForm(World.SpawnActor<AActor>())->FormCharacter;
+
+	uint32 CardIdentifiersSerial = 0;
+	uint32 CardStateDigest = Random.GetUnsignedInt();
+	TArray<uint32> SentSerials;
+	TArray<bool> Received;
+	int64 AlwaysSentBits = 0;
+	int64 FlaggedBits = 0;
+	int32 Mismatches = 0;
+	for (int32 Move = 0; Move < MoveCount; Move++)
+	{
+		if (Random.FRand() < CardChangeChance)
+		{
+			CardIdentifiersSerial++;
+			CardStateDigest = Random.GetUnsignedInt();
+		}
+
+		//Same as UpdateCardIdentifiersBaseline, with the last move received AckDelay moves ago as the last
+		//acknowledged move.
+		for (int32 Acked = Move - AckDelay; Acked >= 0; Acked--)
+		{
+			if (!Received[Acked]) continue;
+			FSfTestAccess::CardStateDigestBaselineSerial(Client) = SentSerials[Acked];
+			FSfTestAccess::bHasCardStateDigestBaseline(Client) = true;
+			break;
+		}
+		SentSerials.Add(CardIdentifiersSerial);
+
+		//Before the flag every move sent the whole digest.
+		AlwaysSentBits += 32;
+
+		FSfNetworkMoveData ClientMoveData;
+		ClientMoveData.CardIdentifiersSerial = CardIdentifiersSerial;
+		ClientMoveData.CardStateDigest = CardStateDigest;
+		FBitWriter Writer(0, true);
+		ClientMoveData.SerializeCardStateDigest(Writer, Client);
+		FlaggedBits += Writer.GetNumBits();
+
+		Received.Add(Random.FRand() >= MoveLossChance);
+		if (!Received.Last()) continue;
+		FBitReader Reader(Writer.GetData(), Writer.GetNumBits());
+		FSfNetworkMoveData ServerMoveData;
+		ServerMoveData.SerializeCardStateDigest(Reader, Server);
+		FSfTestAccess::HandleCardStateDigestAndSetCorrectionFlags(Server, &ServerMoveData);
+		Mismatches += Reader.IsError() || FSfTestAccess::ServerLastProcessedCardStateDigest(Server) != CardStateDigest;
+	}
+	TestEqual(TEXT("The server compares against the digest the client had"), Mismatches, 0);
+	TestTrue(TEXT("Flagged digests send fewer bits than sending the digest every move"),
+	         FlaggedBits < AlwaysSentBits);
+	AddInfo(FString::Printf(TEXT("%d moves: %.2f bits per move sending the digest every move, %.2f bits per move when "
+	                             "only sent after a card change."), MoveCount,
+	                        static_cast<double>(AlwaysSentBits) / MoveCount,
+	                        static_cast<double>(FlaggedBits) / MoveCount));
+
+	//Moves after a correction send the full state to verify, including the digest.
+	FSfTestAccess::bClientForceSerialize(Client) = true;
+	FSfNetworkMoveData ForcedMoveData;
+	ForcedMoveData.CardIdentifiersSerial = CardIdentifiersSerial;
+	FBitWriter ForcedWriter(0, true);
+	ForcedMoveData.SerializeCardStateDigest(ForcedWriter, Client);
+	TestEqual(TEXT("Forced moves send the digest"), static_cast<int64>(ForcedWriter.GetNumBits()), 33ll);
+	return true;
+}
+
+#endif
@@ -0,0 +1,143 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SfTestAccess.h"
+#include "SfTestWorld.h"
+#include "Algo/Reverse.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSfConstituentTableTest, "SfCore.FormCore.ConstituentTable",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+namespace SfConstituentTableTest
+{
+	static constexpr int32 InventoryCount = 10;
+
+	static constexpr int32 SlotablesPerInventory = 5;
+
+	static constexpr int32 ConstituentsPerSlotable = 2;
+
+	static constexpr int32 Corrections = 2000;
+
+	//How constituents were found before the table, by walking the slotables of the inventory.
+	static UConstituent* FindConstituentNested(UFormCoreComponent* InFormCore, const int32 InInventoryIndex,
+	                                           const uint8 InInstanceId)
+	{
+		for (const USlotable* Slotable : FSfTestAccess::Inventories(InFormCore)[InInventoryIndex]->GetSlotables())
+		{
+			for (UConstituent* Constituent : Slotable->GetConstituents())
+			{
+				if (Constituent->InstanceId == InInstanceId) return Constituent;
+			}
+		}
+		return nullptr;
+	}
+}
+
+bool FSfConstituentTableTest::RunTest(const FString& Parameters)
+{
+	using namespace SfConstituentTableTest;
+	const FSfTestWorld World;
+	AActor* Actor = World.SpawnActor<AActor>();
+	UFormCoreComponent* FormCore = FSfTestAccess::CreateForm(Actor);
+	for (int32 i = 0; i < InventoryCount; i++)
+	{
+		UInventory* Inventory = FSfTestAccess::AddInventory(FormCore);
+		for (int32 j = 0; j < SlotablesPerInventory; j++)
+		{
+			USlotable* Slotable = FSfTestAccess::AddSlotable(Inventory);
+			for (int32 k = 0; k < ConstituentsPerSlotable; k++)
+			{
+				FSfTestAccess::AddConstituent(Slotable, j * ConstituentsPerSlotable + k + 1);
+			}
+		}
+	}
+	FormCore->MarkConstituentTableDirty();
+
+	//A correction with a response for every constituent, found by the inventory index and instance id it was sent as.
+	constexpr int32 ConstituentsPerInventory = SlotablesPerInventory * ConstituentsPerSlotable;
+	int32 Mismatches = 0;
+	for (int32 i = 0; i < InventoryCount; i++)
+	{
+		for (int32 Id = 1; Id <= ConstituentsPerInventory; Id++)
+		{
+			Mismatches += FormCore->FindConstituent(i, Id) != FindConstituentNested(FormCore, i, Id);
+		}
+	}
+	TestEqual(TEXT("The table finds the same constituents as walking the slotables"), Mismatches, 0);
+	TestNull(TEXT("Unused instance ids aren't found"), FormCore->FindConstituent(0, ConstituentsPerInventory + 1));
+	TestNull(TEXT("Inventory indices out of range aren't found"), FormCore->FindConstituent(InventoryCount, 1));
+
+	double Times[2];
+	int32 Found = 0;
+	for (const bool bNested : {false, true})
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Correction = 0; Correction < Corrections; Correction++)
+		{
+			for (int32 i = 0; i < InventoryCount; i++)
+			{
+				for (int32 Id = 1; Id <= ConstituentsPerInventory; Id++)
+				{
+					Found += (bNested ? FindConstituentNested(FormCore, i, Id) : FormCore->FindConstituent(i, Id))
+						!= nullptr;
+				}
+			}
+		}
+		Times[bNested] = FPlatformTime::Seconds() - StartTime;
+	}
+	TestEqual(TEXT("Every lookup finds a constituent"), Found,
+	          Corrections * InventoryCount * ConstituentsPerInventory * 2);
+	AddInfo(FString::Printf(TEXT("%d constituents: %.2f us per correction from the table, %.2f us walking slotables."),
+	                        InventoryCount * ConstituentsPerInventory, Times[0] * 1e6 / Corrections,
+	                        Times[1] * 1e6 / Corrections));
+
+	//Instance ids reassigned on the server mark the table dirty, so the old ids find the constituents given them.
+	//Handles made before then are stale if their slot was given to another constituent.
+	UInventory* Inventory = FSfTestAccess::Inventories(FormCore)[0];
+	UConstituent* First = FormCore->FindConstituent(0, 1);
+	const FSfConstituentHandle FirstHandle = FormCore->MakeConstituentHandle(0, 1);
+	const FSfConstituentHandle OtherInventoryHandle = FormCore->MakeConstituentHandle(1, 1);
+	TestTrue(TEXT("Handles resolve to their constituent"), FormCore->ResolveConstituentHandle(FirstHandle) == First);
+	Algo::Reverse(FSfTestAccess::Slotables(Inventory));
+	Inventory->ReassignAllConstituentInstanceIds();
+	TestNotEqual(TEXT("Reversing the slotables gives new instance ids"), First->InstanceId, static_cast<uint8>(1));
+	TestTrue(TEXT("Reassigned instance ids are found"), FormCore->FindConstituent(0, First->InstanceId) == First);
+	TestTrue(TEXT("Old instance ids find the constituents given them"),
+	         FormCore->FindConstituent(0, 1) == FindConstituentNested(FormCore, 0, 1));
+	TestNull(TEXT("Handles to reassigned instance ids are stale"), FormCore->ResolveConstituentHandle(FirstHandle));
+	TestTrue(TEXT("Handles made after reassigning resolve"),
+	         FormCore->ResolveConstituentHandle(FormCore->MakeConstituentHandle(0, First->InstanceId)) == First);
+	TestTrue(TEXT("Handles in other inventories still resolve"),
+	         FormCore->ResolveConstituentHandle(OtherInventoryHandle) == FindConstituentNested(FormCore, 1, 1));
+
+	//Instance ids replicate separately on clients and may change before the table is marked dirty.
+	UConstituent* Second = FormCore->FindConstituent(1, 1);
+	UConstituent* Third = FormCore->FindConstituent(1, 2);
+	Second->InstanceId = 2;
+	Third->InstanceId = 1;
+	TestTrue(TEXT("Swapped instance ids are found before the table is marked dirty"),
+	         FormCore->FindConstituent(1, 1) == Third && FormCore->FindConstituent(1, 2) == Second);
+	TestNull(TEXT("Handles to swapped instance ids are stale"),
+	         FormCore->ResolveConstituentHandle(OtherInventoryHandle));
+
+	//Inventories find constituents with the table of their form core, or by walking their slotables if they aren't
+	//on it, like when the owning form core replicates before the inventories of the form or after a removal.
+	UInventory* Replicating = FSfTestAccess::AddInventory(FormCore);
+	UConstituent* ReplicatingConstituent = FSfTestAccess::AddConstituent(FSfTestAccess::AddSlotable(Replicating), 1);
+	FormCore->MarkConstituentTableDirty();
+	TestTrue(TEXT("Inventories on their form core find constituents with the table"),
+	         Replicating->GetConstituentFromInstanceId(1) == ReplicatingConstituent);
+	FSfTestAccess::Inventories(FormCore).Pop();
+	FormCore->MarkConstituentTableDirty();
+	TestTrue(TEXT("Inventories that aren't on their form core walk their slotables"),
+	         Replicating->GetConstituentFromInstanceId(1) == ReplicatingConstituent);
+	Replicating->OwningFormCore = nullptr;
+	TestTrue(TEXT("Inventories without a form core walk their slotables"),
+	         Replicating->GetConstituentFromInstanceId(1) == ReplicatingConstituent);
+	return true;
+}
+
+#endif
@@ -0,0 +1,187 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CardObject.h"
+#include "SfTestAccess.h"
+#include "SfTestWorld.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSfCorrectionDirtyElementsTest, "SfCore.FormCharacter.CorrectionDirtyElements",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+namespace SfCorrectionDirtyElementsTest
+{
+	static constexpr int32 InventoryCount = 2;
+
+	static constexpr int32 ResourceCount = 4;
+
+	static constexpr int32 ConstituentCount = 8;
+
+	//The only resource that diverged.
+	static constexpr int32 DivergedResource = 2;
+
+	static constexpr float CorrectedTimeStamp = 1.5f;
+
+	//The state of the corrected move, which the client recorded and the server agrees with except for one resource.
+	struct FSfState
+	{
+		TArray<FInventoryCards> Cards;
+
+		TArray<float> ResourceValues;
+
+		TArray<FActionSet> ActionSets;
+
+		TArray<FUint16_Quantize100> TimesSinceLastAction;
+	};
+
+	static FSfState MakeState(const float InValueOffset)
+	{
+		FSfState State;
+		for (int32 i = 0; i < InventoryCount; i++)
+		{
+			FCard& Card = State.Cards.AddDefaulted_GetRef().Cards.AddDefaulted_GetRef();
+			Card.Class = UCardObject::StaticClass();
+			Card.OwnerConstituentInstanceId = i + 1;
+			Card.LifetimeEndTimestamp = 10 + i + InValueOffset;
+		}
+		for (int32 i = 0; i < ResourceCount; i++)
+		{
+			State.ResourceValues.Add(100 * (i + 1) + InValueOffset);
+		}
+		for (int32 i = 0; i < ConstituentCount; i++)
+		{
+			State.ActionSets.Emplace(0, static_cast<uint8>(i + 1 + InValueOffset));
+			State.TimesSinceLastAction.AddDefaulted_GetRef().SetFloat(0.5f * i + InValueOffset);
+		}
+		return State;
+	}
+
+	//A form character on the server with the response to a correction set, but no dirty elements yet.
+	static UFormCharacterComponent* MakeServer(const FSfTestWorld& InWorld, const FSfState& InState)
+	{
+		AActor* Actor = InWorld.SpawnActor<AActor>();
+		UFormCharacterComponent* FormCharacter = NewObject<UFormCharacterComponent>(Actor);
+		FSfTestAccess::FormResource(FormCharacter) = NewObject<UFormResourceComponent>(Actor);
+		FSfTestAccess::CardResponse(FormCharacter) = InState.Cards;
+		for (const float Value : InState.ResourceValues)
+		{
+			FSfTestAccess::ResourcesResponse(FormCharacter).Items.AddDefaulted_GetRef().Value = Value;
+		}
+		FSfTestAccess::ActionSetResponses(FormCharacter) = InState.ActionSets;
+		FSfTestAccess::TimesSinceLastAction(FormCharacter) = InState.TimesSinceLastAction;
+		return FormCharacter;
+	}
+
+	//A form character on the client with a saved move of the state at the timestamp.
+	static UFormCharacterComponent* MakeClient(const FSfTestWorld& InWorld, const FSfState& InState,
+	                                           const float InTimeStamp)
+	{
+		AActor* Actor = InWorld.SpawnActor<AActor>();
+		UFormCharacterComponent* FormCharacter = NewObject<UFormCharacterComponent>(Actor);
+		FSfTestAccess::FormResource(FormCharacter) = NewObject<UFormResourceComponent>(Actor);
+		//Created directly as the prediction data otherwise needs a pawn to move.
+		FNetworkPredictionData_Client_Sf* ClientData = new FNetworkPredictionData_Client_Sf(*FormCharacter);
+		FSfTestAccess::ClientPredictionData(FormCharacter) = ClientData;
+		TSharedPtr<FSavedMove_Sf> Move = MakeShared<FSavedMove_Sf>();
+		Move->TimeStamp = InTimeStamp;
+		Move->Cards = MakeShared<TArray<FInventoryCards>>(InState.Cards);
+		for (const float Value : InState.ResourceValues)
+		{
+			Move->Resources.Items.AddDefaulted_GetRef().Value = Value;
+		}
+		for (int32 i = 0; i < ConstituentCount; i++)
+		{
+			Move->PendingActionSets.Emplace(i + 1, InState.ActionSets[i]);
+		}
+		Move->TimesSinceLastAction = InState.TimesSinceLastAction;
+		ClientData->SavedMoves.Add(Move);
+		return FormCharacter;
+	}
+
+	//Writes the correction the server has pending. Flags and dirty masks are reset by writing, like after sending.
+	static void WriteCorrection(UFormCharacterComponent* InServer, FBitWriter& OutWriter)
+	{
+		FSfMoveResponseDataContainer Container;
+		Container.ClientAdjustment.bAckGoodMove = false;
+		Container.ClientAdjustment.TimeStamp = CorrectedTimeStamp;
+		FSfTestAccess::CorrectionConditionFlags(InServer) = Repredict_Sf;
+		Container.Serialize(*InServer, OutWriter, nullptr);
+	}
+
+	static void ReadCorrection(UFormCharacterComponent* InClient, FBitWriter& InWriter)
+	{
+		FSfMoveResponseDataContainer Container;
+		FBitReader Reader(InWriter.GetData(), InWriter.GetNumBits());
+		Container.Serialize(*InClient, Reader, nullptr);
+	}
+}
+
+bool FSfCorrectionDirtyElementsTest::RunTest(const FString& Parameters)
+{
+	using namespace SfCorrectionDirtyElementsTest;
+	const FSfTestWorld World;
+
+	//The server state is off from the recorded state everywhere, so it shows which elements the client got from the
+	//server and which from its saved move.
+	const FSfState RecordedState = MakeState(0);
+	const FSfState ServerState = MakeState(1);
+	UFormCharacterComponent* Server = MakeServer(World, ServerState);
+
+	//A correction with every element dirty, as if everything diverged.
+	FBitWriter FullWriter(0, true);
+	FSfTestAccess::MarkResponseDirty(Server, FSfTestAccess::CardResponseDirtyMask(Server), 0, InventoryCount);
+	FSfTestAccess::MarkResponseDirty(Server, FSfTestAccess::ResourcesResponseDirtyMask(Server), 0, ResourceCount);
+	FSfTestAccess::MarkResponseDirty(Server, FSfTestAccess::ActionSetResponseDirtyMask(Server), 0, ConstituentCount);
+	WriteCorrection(Server, FullWriter);
+	TestEqual(TEXT("Sending a correction resets the dirty masks"),
+	          FSfTestAccess::ResourcesResponseDirtyMask(Server).Num(), 0);
+
+	//A correction where only one resource diverged.
+	FBitWriter Writer(0, true);
+	FSfTestAccess::MarkResponseDirty(Server, FSfTestAccess::ResourcesResponseDirtyMask(Server), DivergedResource);
+	WriteCorrection(Server, Writer);
+	TestFalse(TEXT("The correction is written"), Writer.IsError());
+	TestTrue(TEXT("A single diverged resource is sent in fewer bits than everything"),
+	         Writer.GetNumBits() < FullWriter.GetNumBits());
+	AddInfo(FString::Printf(TEXT("Correction of %d inventories, %d resources, %d constituents: %lld bits with one "
+		                        "diverged resource, %lld bits with everything diverged."), InventoryCount,
+	                        ResourceCount, ConstituentCount, Writer.GetNumBits(), FullWriter.GetNumBits()));
+
+	//The client takes the diverged resource from the server and restores the rest from the corrected move.
+	UFormCharacterComponent* Client = MakeClient(World, RecordedState, CorrectedTimeStamp);
+	ReadCorrection(Client, Writer);
+	TestTrue(TEXT("Cards are restored from the corrected move"),
+	         FSfTestAccess::CardResponse(Client) == RecordedState.Cards);
+	TestTrue(TEXT("The cards of the correction are applied"), FSfTestAccess::bClientCardsWereUpdated(Client));
+	const TArray<FResource>& Resources = FSfTestAccess::ResourcesResponse(Client).Items;
+	TestEqual(TEXT("Every resource is received"), Resources.Num(), ResourceCount);
+	for (int32 i = 0; i < Resources.Num(); i++)
+	{
+		const float ExpectedValue = i == DivergedResource
+			                            ? ServerState.ResourceValues[i]
+			                            : RecordedState.ResourceValues[i];
+		TestEqual(FString::Printf(TEXT("Resource %d is %s"), i, i == DivergedResource
+			                                                        ? TEXT("the value of the server")
+			                                                        : TEXT("restored from the corrected move")),
+		          Resources[i].Value, ExpectedValue);
+	}
+	TestTrue(TEXT("The resources of the correction are applied"), FSfTestAccess::bClientResourcesWereUpdated(Client));
+	TestTrue(TEXT("Action sets are restored from the corrected move"),
+	         FSfTestAccess::ActionSetResponses(Client) == RecordedState.ActionSets);
+	TestTrue(TEXT("Times since the last action are restored from the corrected move"),
+	         FSfTestAccess::TimesSinceLastAction(Client) == RecordedState.TimesSinceLastAction);
+	TestTrue(TEXT("The action sets of the correction are applied"), FSfTestAccess::bClientActionsWereUpdated(Client));
+
+	//Without the corrected move the elements that weren't sent can't be restored, so the sections aren't applied.
+	UFormCharacterComponent* LateClient = MakeClient(World, RecordedState, CorrectedTimeStamp + 1);
+	ReadCorrection(LateClient, Writer);
+	TestFalse(TEXT("Resources aren't applied without the corrected move"),
+	          FSfTestAccess::bClientResourcesWereUpdated(LateClient));
+	TestFalse(TEXT("Cards aren't applied without the corrected move"),
+	          FSfTestAccess::bClientCardsWereUpdated(LateClient));
+	return true;
+}
+
+#endif
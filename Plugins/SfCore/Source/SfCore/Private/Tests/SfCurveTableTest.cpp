@@ -0,0 +1,120 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SfCurveTable.h"
+#include "Curves/CurveFloat.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSfCurveTableTest, "SfCore.FormCharacter.CurveTable",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+namespace SfCurveTableTest
+{
+	//Largest error allowed against the rich curve, relative to the range of values of the curve.
+	static constexpr float MaxRelativeError = 1e-3f;
+
+	static constexpr int32 ActiveCurves = 8;
+
+	static constexpr int32 ReplayedMoves = 32;
+
+	static constexpr int32 Replays = 2000;
+
+	static UCurveFloat* MakeCurve(const TArray<TPair<float, float>>& InKeys, const ERichCurveInterpMode InInterpMode)
+	{
+		UCurveFloat* Curve = NewObject<UCurveFloat>(GetTransientPackage(), NAME_None, RF_Transient);
+		for (const TPair<float, float>& Key : InKeys)
+		{
+			const FKeyHandle Handle = Curve->FloatCurve.AddKey(Key.Key, Key.Value);
+			Curve->FloatCurve.SetKeyInterpMode(Handle, InInterpMode);
+		}
+		Curve->FloatCurve.AutoSetTangents();
+		return Curve;
+	}
+}
+
+bool FSfCurveTableTest::RunTest(const FString& Parameters)
+{
+	using namespace SfCurveTableTest;
+	FSfCurveTable::ClearCache();
+	//Shapes that velocity curves commonly have: a dash that eases out, a jump pad impulse and a knockback.
+	TArray<UCurveFloat*> Curves;
+	Curves.Add(MakeCurve({{0, 2400}, {0.1f, 1800}, {0.35f, 300}, {0.5f, 0}}, RCIM_Cubic));
+	Curves.Add(MakeCurve({{0, 0}, {0.05f, 1500}, {0.2f, 1600}, {0.6f, -200}, {1, 0}}, RCIM_Cubic));
+	Curves.Add(MakeCurve({{0, 900}, {0.25f, 450}, {0.4f, 0}}, RCIM_Linear));
+	for (int32 i = Curves.Num(); i < ActiveCurves; i++)
+	{
+		Curves.Add(MakeCurve({{0, 300.f * i}, {0.1f * i, -100.f * i}, {0.2f * i, 50}, {0.3f * i, 0}}, RCIM_Cubic));
+	}
+
+	for (int32 i = 0; i < Curves.Num(); i++)
+	{
+		const FRichCurve& RichCurve = Curves[i]->FloatCurve;
+		float MinTime;
+		float MaxTime;
+		RichCurve.GetTimeRange(MinTime, MaxTime);
+		float MinValue;
+		float MaxValue;
+		RichCurve.GetValueRange(MinValue, MaxValue);
+		float MaxError = 0;
+		//Samples between the baked samples are where linear interpolation is furthest from the curve.
+		constexpr int32 TestSamples = FSfCurveTable::NumSamples * 16;
+		for (int32 Sample = 0; Sample <= TestSamples; Sample++)
+		{
+			const float Time = FMath::Lerp(MinTime, MaxTime, static_cast<float>(Sample) / TestSamples);
+			const float Error = FMath::Abs(FSfCurveTable::Evaluate(Curves[i], Time) - RichCurve.Eval(Time));
+			MaxError = FMath::Max(MaxError, Error);
+		}
+		const float RelativeError = MaxError / FMath::Max(MaxValue - MinValue, UE_SMALL_NUMBER);
+		AddInfo(FString::Printf(TEXT("Curve %d: max error %g (%g of its range)."), i, MaxError, RelativeError));
+		TestTrue(FString::Printf(TEXT("Curve %d is within the error bound"), i), RelativeError <= MaxRelativeError);
+		TestEqual(FString::Printf(TEXT("Curve %d extrapolates like the rich curve"), i),
+		          FSfCurveTable::Evaluate(Curves[i], MaxTime + 1), RichCurve.Eval(MaxTime + 1));
+	}
+
+	//Steps can't be interpolated, so stepped curves give the exact values of the rich curve.
+	UCurveFloat* SteppedCurve = MakeCurve({{0, 100}, {0.2f, 500}, {0.4f, 0}}, RCIM_Constant);
+	bool bSteppedMatches = true;
+	for (int32 Sample = 0; Sample <= 100; Sample++)
+	{
+		const float Time = Sample * 0.004f;
+		bSteppedMatches &= FSfCurveTable::Evaluate(SteppedCurve, Time) == SteppedCurve->FloatCurve.Eval(Time);
+	}
+	TestTrue(TEXT("Stepped curves give the values of the rich curve"), bSteppedMatches);
+
+	//8 curves active during a 32 move replay, with moves at 120 Hz.
+	double Checksum = 0;
+	double StartTime = FPlatformTime::Seconds();
+	for (int32 Replay = 0; Replay < Replays; Replay++)
+	{
+		for (int32 Move = 0; Move < ReplayedMoves; Move++)
+		{
+			for (const UCurveFloat* Curve : Curves)
+			{
+				Checksum += FSfCurveTable::Evaluate(Curve, Move / 120.f);
+			}
+		}
+	}
+	const double TableTime = FPlatformTime::Seconds() - StartTime;
+	StartTime = FPlatformTime::Seconds();
+	for (int32 Replay = 0; Replay < Replays; Replay++)
+	{
+		for (int32 Move = 0; Move < ReplayedMoves; Move++)
+		{
+			for (const UCurveFloat* Curve : Curves)
+			{
+				Checksum -= Curve->GetFloatValue(Move / 120.f);
+			}
+		}
+	}
+	const double RichTime = FPlatformTime::Seconds() - StartTime;
+	AddInfo(FString::Printf(TEXT("%d curves over %d moves: %.2f us per replay from tables, %.2f us from rich curves."),
+	                        ActiveCurves, ReplayedMoves, TableTime * 1e6 / Replays, RichTime * 1e6 / Replays));
+	//Keeps the evaluations from being optimized away. The tables are close to the curves so it is close to zero.
+	TestTrue(TEXT("Tables and rich curves sum to about the same"), FMath::Abs(Checksum) < Replays * ReplayedMoves);
+	FSfCurveTable::ClearCache();
+	return true;
+}
+
+#endif
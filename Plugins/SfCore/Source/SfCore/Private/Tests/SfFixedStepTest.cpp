@@ -0,0 +1,170 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CardObject.h"
+#include "SfTestAccess.h"
+#include "SfTestWorld.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSfFixedStepTest, "SfCore.FormCharacter.FixedStep",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+namespace SfFixedStepTest
+{
+	static constexpr int32 StepsPerSecond = 64;
+
+	static constexpr uint32 StepTicks = UFormCharacterComponent::PredictedNetClockTicksPerSecond / StepsPerSecond;
+
+	static constexpr int32 SimulatedSeconds = 4;
+
+	static constexpr uint32 SimulatedTicks =
+		SimulatedSeconds * UFormCharacterComponent::PredictedNetClockTicksPerSecond;
+
+	//Predicted cards whose lifetimes end during the simulation.
+	static constexpr int32 CardCount = 200;
+
+	static constexpr int32 ResourceUpdatesPerSecond = 10;
+
+	static constexpr float RegenPerSecond = 10;
+
+	//How often the server corrects the client.
+	static constexpr int32 CorrectionsPerSecond = 30;
+
+	struct FSfState
+	{
+		TArray<FCard> Cards;
+
+		float ResourceValue = 0;
+
+		bool operator==(const FSfState& Other) const
+		{
+			return Cards == Other.Cards && ResourceValue == Other.ResourceValue;
+		}
+	};
+
+	using FMoveState = TPair<uint32, FSfState>;
+
+	//Simulates a form with a regenerating resource and expiring cards in moves of the frame rate. Moves are whole ticks
+	//of the predicted net clock, so every frame rate reaches the same clock at the same time. Returns the state after
+	//each move and the clock it ended at, starting with the state before the first move.
+	static TArray<FMoveState> Run(const FSfTestWorld& InWorld, const bool bInFixedStep, const int32 InFramesPerSecond,
+	                              const TArray<uint32>& InCardEndTicks, const FGameplayTag& InRegenStatTag)
+	{
+		AActor* Actor = InWorld.SpawnActor<AActor>();
+		UFormCoreComponent* FormCore = FSfTestAccess::CreateForm(Actor);
+		UFormCharacterComponent* FormCharacter = FormCore->FormCharacter;
+		FormCharacter->bFixedStepSfSimulation = bInFixedStep;
+		FormCharacter->SfStepsPerSecond = StepsPerSecond;
+		UFormStatComponent* FormStat = NewObject<UFormStatComponent>(Actor);
+		FSfTestAccess::BaseStats(FormStat).Emplace(InRegenStatTag, RegenPerSecond);
+		FormStat->SetupFormStat();
+		UFormResourceComponent* FormResource = NewObject<UFormResourceComponent>(Actor);
+		FormResource->OwnerResourceUpdateFrequencyPerSecond = ResourceUpdatesPerSecond;
+		FormResource->SetupFormResource(FormCore);
+		FResource& Resource = FSfTestAccess::Resources(FormResource).Items.AddDefaulted_GetRef();
+		Resource.IncreasePerSecondStat = InRegenStatTag;
+		Resource.MaxValueOverride = 999999;
+		FSfTestAccess::FormStat(FormCore) = FormStat;
+		FSfTestAccess::FormResource(FormCore) = FormResource;
+		FormCharacter->SecondarySetupFormCharacter();
+
+		UInventory* Inventory = FSfTestAccess::AddInventory(FormCore);
+		TArray<FCard>& Cards = FSfTestAccess::Cards(Inventory);
+		for (int32 i = 0; i < InCardEndTicks.Num(); i++)
+		{
+			FCard& Card = Cards.AddDefaulted_GetRef();
+			Card.Class = UCardObject::StaticClass();
+			Card.OwnerConstituentInstanceId = i + 1;
+			Card.bUsingPredictedTimestamp = true;
+			Card.LifetimeEndTimestamp = static_cast<float>(InCardEndTicks[i])
+				/ UFormCharacterComponent::PredictedNetClockTicksPerSecond;
+		}
+		FSfTestAccess::MarkCardIndexDirty(Inventory);
+		FSfTestAccess::MarkCardExpiryQueuesDirty(Inventory);
+
+		TArray<FMoveState> MoveStates;
+		MoveStates.Emplace(0, FSfState{Cards, Resource.Value});
+		const int32 MoveCount = SimulatedSeconds * InFramesPerSecond;
+		for (int32 Move = 1; Move <= MoveCount; Move++)
+		{
+			const uint32 EndTicks = static_cast<uint64>(Move) * SimulatedTicks / MoveCount;
+			FSfTestAccess::SimulateSfTime(FormCharacter, static_cast<float>(EndTicks - MoveStates.Last().Key)
+			                              / UFormCharacterComponent::PredictedNetClockTicksPerSecond);
+			MoveStates.Emplace(FormCharacter->GetPredictedNetClockTicks(), FSfState{Cards, Resource.Value});
+		}
+		return MoveStates;
+	}
+}
+
+bool FSfFixedStepTest::RunTest(const FString& Parameters)
+{
+	using namespace SfFixedStepTest;
+	const FGameplayTag RegenStatTag = FGameplayTag::RequestGameplayTag(TEXT("Stat.TestHealthRegen"), false);
+	if (!RegenStatTag.IsValid())
+	{
+		AddError(TEXT("Test stat tags are missing from DefaultGameplayTags.ini."));
+		return false;
+	}
+	const FSfTestWorld World;
+	FRandomStream Random(17);
+	TArray<uint32> CardEndTicks;
+	for (int32 i = 0; i < CardCount; i++)
+	{
+		CardEndTicks.Add(Random.RandRange(1, SimulatedTicks - 1));
+	}
+
+	//Moves of exactly one step give the state at the end of each step.
+	const TArray<FMoveState> StepStates = Run(World, true, StepsPerSecond, CardEndTicks, RegenStatTag);
+	TestEqual(TEXT("Moves of one step end on every step"), StepStates.Last().Key, SimulatedTicks);
+
+	//The same time is split into moves of clients at different frame rates. With fixed steps, the state after any move
+	//is the state at the end of the last step before it. The server corrects the client whenever the state at the
+	//last move before a correction isn't the state at the end of its step.
+	int32 VariableStepCorrections = 0;
+	for (const bool bFixedStep : {false, true})
+	{
+		for (const int32 FramesPerSecond : {30, 144, 240})
+		{
+			const TArray<FMoveState> MoveStates = Run(World, bFixedStep, FramesPerSecond, CardEndTicks, RegenStatTag);
+			int32 StepMismatches = 0;
+			for (const FMoveState& MoveState : MoveStates)
+			{
+				StepMismatches += !(MoveState.Value == StepStates[MoveState.Key / StepTicks].Value);
+			}
+			int32 Corrections = 0;
+			int32 Move = 0;
+			for (int32 Correction = 1; Correction <= SimulatedSeconds * CorrectionsPerSecond; Correction++)
+			{
+				const uint32 CorrectionTicks = Correction * SimulatedTicks / (SimulatedSeconds * CorrectionsPerSecond);
+				while (Move + 1 < MoveStates.Num() && MoveStates[Move + 1].Key <= CorrectionTicks)
+				{
+					Move++;
+				}
+				Corrections += !(MoveStates[Move].Value == StepStates[MoveStates[Move].Key / StepTicks].Value);
+			}
+			TestEqual(FString::Printf(TEXT("Moves at %d fps cover the simulated time"), FramesPerSecond),
+			          MoveStates.Last().Key, SimulatedTicks);
+			if (bFixedStep)
+			{
+				TestEqual(FString::Printf(TEXT("Fixed steps give the state of each step at %d fps"), FramesPerSecond),
+				          StepMismatches, 0);
+				TestEqual(FString::Printf(TEXT("Fixed steps aren't corrected at %d fps"), FramesPerSecond),
+				          Corrections, 0);
+			}
+			else
+			{
+				VariableStepCorrections += Corrections;
+			}
+			AddInfo(FString::Printf(TEXT("%s at %d fps: %d of %d corrections, %d moves off their step."),
+			                        bFixedStep ? TEXT("Fixed steps") : TEXT("Steps per move"), FramesPerSecond,
+			                        Corrections, SimulatedSeconds * CorrectionsPerSecond, StepMismatches));
+		}
+	}
+	TestTrue(TEXT("Stepping once per move is corrected at other frame rates"), VariableStepCorrections > 0);
+	return true;
+}
+
+#endif
@@ -0,0 +1,167 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FormStatComponent.h"
+#include "SfTestAccess.h"
+#include "SfTestWorld.h"
+#include "GameFramework/Actor.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSfFormStatModifierTest, "SfCore.FormStat.Modifiers",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+namespace SfFormStatModifierTest
+{
+	//Same as CalculateStat before modifiers were kept per stat, which scanned every modifier of every stat.
+	static float CalculateStatByScan(const FStat& InBaseStat, const TArray<FStat> (&InModifiers)[4])
+	{
+		float Value = InBaseStat.Value;
+		for (const FStat& Modifier : InModifiers[Additive])
+		{
+			if (Modifier.StatTag != InBaseStat.StatTag) continue;
+			Value = FMath::Clamp(Value + Modifier.Value, 0.f, InBaseStat.MaxValue);
+		}
+		float ToMultiply = 1.f;
+		for (const FStat& Modifier : InModifiers[AdditiveMultiplicative])
+		{
+			if (Modifier.StatTag != InBaseStat.StatTag) continue;
+			ToMultiply = FMath::Clamp(ToMultiply + Modifier.Value, 0.f, InBaseStat.MaxValue);
+		}
+		Value = FMath::Clamp(Value * ToMultiply, 0.f, InBaseStat.MaxValue);
+		for (const FStat& Modifier : InModifiers[TrueMultiplicative])
+		{
+			if (Modifier.StatTag != InBaseStat.StatTag) continue;
+			Value = FMath::Clamp(Value * Modifier.Value, 0.f, InBaseStat.MaxValue);
+		}
+		for (const FStat& Modifier : InModifiers[FlatAdditive])
+		{
+			if (Modifier.StatTag != InBaseStat.StatTag) continue;
+			Value = FMath::Clamp(Value + Modifier.Value, 0.f, InBaseStat.MaxValue);
+		}
+		return Value;
+	}
+}
+
+bool FSfFormStatModifierTest::RunTest(const FString& Parameters)
+{
+	using namespace SfFormStatModifierTest;
+	const FGameplayTag StatTag = FGameplayTag::RequestGameplayTag(TEXT("Stat.TestMaxHealth"), false);
+	const FGameplayTag OtherStatTag = FGameplayTag::RequestGameplayTag(TEXT("Stat.TestHealthRegen"), false);
+	if (!StatTag.IsValid() || !OtherStatTag.IsValid())
+	{
+		AddError(TEXT("Test stat tags are missing from DefaultGameplayTags.ini."));
+		return false;
+	}
+	const FSfTestWorld World;
+	AActor* Owner = World.SpawnActor<AActor>();
+	UFormStatComponent* FormStat = NewObject<UFormStatComponent>(Owner);
+	TArray<FStat>& BaseStats = FSfTestAccess::BaseStats(FormStat);
+	BaseStats.Emplace(StatTag, 10.f);
+	BaseStats.Emplace(OtherStatTag, 1.f);
+	FormStat->SetupFormStat();
+
+	//Values are clamped after each modifier by default.
+	FormStat->Server_AddStatModifier(StatTag, Additive, -20.f);
+	const FStatModifierHandle Handle = FormStat->Server_AddStatModifierWithHandle(StatTag, Additive, 15.f);
+	TestEqual(TEXT("Clamping after each modifier"), FormStat->GetStat(StatTag), 15.f);
+	FSfTestAccess::bClampModifierTotals(FormStat) = true;
+	FormStat->CalculateStat(StatTag);
+	TestEqual(TEXT("Clamping after each modifier type"), FormStat->GetStat(StatTag), 5.f);
+	FSfTestAccess::bClampModifierTotals(FormStat) = false;
+
+	//Handles remove exactly their modifier and value removal keeps working for Blueprint callers.
+	FormStat->Server_AddStatModifier(StatTag, Additive, 15.f);
+	TestTrue(TEXT("Remove by handle"), FormStat->Server_RemoveStatModifierByHandle(Handle));
+	TestFalse(TEXT("Handles are only removed once"), FormStat->Server_RemoveStatModifierByHandle(Handle));
+	TestEqual(TEXT("Stat after removing by handle"), FormStat->GetStat(StatTag), 15.f);
+	TestTrue(TEXT("Remove by value"), FormStat->Server_RemoveStatModifier(FStat(StatTag, -20.f), Additive));
+	TestFalse(TEXT("Remove by value with the wrong type"),
+	          FormStat->Server_RemoveStatModifier(FStat(StatTag, 15.f), FlatAdditive));
+	TestEqual(TEXT("Stat after removing by value"), FormStat->GetStat(StatTag), 25.f);
+	TestTrue(TEXT("Remove last modifier"), FormStat->Server_RemoveStatModifier(FStat(StatTag, 15.f), Additive));
+	TestEqual(TEXT("Stat without modifiers"), FormStat->GetStat(StatTag), 10.f);
+
+	//Compare against the old full scan with a mix of modifiers on two stats, then time an aura application and removal.
+	for (const int32 ModifierCount : {10, 30, 100, 300})
+	{
+		TArray<FStat> ScannedModifiers[4];
+		TArray<FStat> Aura[4];
+		FRandomStream Random(ModifierCount);
+		for (int32 i = 0; i < ModifierCount; i++)
+		{
+			const EStatModifierType Type = static_cast<EStatModifierType>(i % 4);
+			const float Value = Type == TrueMultiplicative || Type == AdditiveMultiplicative
+				                    ? Random.FRandRange(0.5f, 1.5f)
+				                    : Random.FRandRange(-5.f, 5.f);
+			Aura[Type].Emplace(i % 3 == 0 ? OtherStatTag : StatTag, Value);
+		}
+		double StartTime = FPlatformTime::Seconds();
+		for (int32 Type = 0; Type < 4; Type++)
+		{
+			for (const FStat& Modifier : Aura[Type])
+			{
+				ScannedModifiers[Type].Add(Modifier);
+				//The old batch path recalculated once per modifier.
+				CalculateStatByScan(BaseStats[Modifier.StatTag == StatTag ? 0 : 1], ScannedModifiers);
+			}
+		}
+		const double ScanTime = FPlatformTime::Seconds() - StartTime;
+		TArray<FStatModifierHandle> Handles;
+		StartTime = FPlatformTime::Seconds();
+		for (int32 Type = 0; Type < 4; Type++)
+		{
+			Handles.Append(
+				FormStat->Server_AddStatModifierBatchWithHandles(Aura[Type], static_cast<EStatModifierType>(Type)));
+		}
+		const double AggregateTime = FPlatformTime::Seconds() - StartTime;
+		TestEqual(FString::Printf(TEXT("Stat matches the full scan with %d modifiers"), ModifierCount),
+		          FormStat->GetStat(StatTag), CalculateStatByScan(BaseStats[0], ScannedModifiers));
+		TestEqual(FString::Printf(TEXT("Other stat matches the full scan with %d modifiers"), ModifierCount),
+		          FormStat->GetStat(OtherStatTag), CalculateStatByScan(BaseStats[1], ScannedModifiers));
+		AddInfo(FString::Printf(TEXT("%d modifiers: %.1f us to apply with the old scan, %.1f us with per-stat modifiers."),
+		                        ModifierCount, ScanTime * 1e6, AggregateTime * 1e6));
+		TestTrue(TEXT("Remove aura"), FormStat->Server_RemoveStatModifierBatchByHandles(Handles));
+		TestEqual(TEXT("Stat after removing aura"), FormStat->GetStat(StatTag), 10.f);
+	}
+
+	//Stats whose modifiers can't reach a clamp are calculated from the totals, so the cost doesn't grow with the
+	//modifiers, while still matching clamping after each modifier.
+	constexpr int32 Calculations = 1000;
+	for (const int32 ModifierCount : {10, 300})
+	{
+		UFormStatComponent* BuffedFormStat = NewObject<UFormStatComponent>(Owner);
+		FSfTestAccess::BaseStats(BuffedFormStat).Emplace(StatTag, 1000.f);
+		BuffedFormStat->SetupFormStat();
+		TArray<FStat> ScannedModifiers[4];
+		for (int32 i = 0; i < ModifierCount; i++)
+		{
+			const EStatModifierType Type = static_cast<EStatModifierType>(i % 4);
+			const float Value = Type == TrueMultiplicative ? 1.001f : Type == AdditiveMultiplicative ? 0.001f : 1.f;
+			BuffedFormStat->Server_AddStatModifier(StatTag, Type, Value);
+			ScannedModifiers[Type].Emplace(StatTag, Value);
+		}
+		double Times[2];
+		for (const bool bClampModifierTotals : {false, true})
+		{
+			FSfTestAccess::bClampModifierTotals(BuffedFormStat) = bClampModifierTotals;
+			const double StartTime = FPlatformTime::Seconds();
+			for (int32 i = 0; i < Calculations; i++)
+			{
+				BuffedFormStat->CalculateStat(StatTag);
+			}
+			Times[bClampModifierTotals] = FPlatformTime::Seconds() - StartTime;
+			//Totals are kept as doubles, so they only differ from the scan by float rounding.
+			TestEqual(FString::Printf(TEXT("Unclamped stat matches the full scan with %d modifiers"), ModifierCount),
+			          BuffedFormStat->GetStat(StatTag),
+			          CalculateStatByScan(FSfTestAccess::BaseStats(BuffedFormStat)[0], ScannedModifiers), 0.01f);
+		}
+		AddInfo(FString::Printf(TEXT("%d unclamped modifiers: %.1f ns per calculation clamping each modifier, %.1f ns "
+		                             "clamping totals."), ModifierCount, Times[0] * 1e9 / Calculations,
+		                        Times[1] * 1e9 / Calculations));
+	}
+	return true;
+}
+
+#endif
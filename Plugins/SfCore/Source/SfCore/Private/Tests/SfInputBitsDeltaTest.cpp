@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FormCharacterComponent.h"
+#include "SfTestAccess.h"
+#include "Misc/AutomationTest.h"
+#include "Serialization/BitReader.h"
+#include "Serialization/BitWriter.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSfInputBitsDeltaTest, "SfCore.FormCharacter.InputBitsDelta",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FSfInputBitsDeltaTest::RunTest(const FString& Parameters)
+{
+	//A form with 24 registered inputs. A fire input in the third set is held for stretches of moves and abilities
+	//are tapped now and then, while the server acknowledges moves a few moves late like it would with latency.
+	constexpr int32 NumInputs = 24;
+	constexpr int32 MoveCount = 2000;
+	constexpr int32 AckDelay = 6;
+	constexpr int32 FireInput = 20;
+	FRandomStream Random(19);
+	UFormCharacterComponent* Client = NewObject<UFormCharacterComponent>(GetTransientPackage());
+	UFormCharacterComponent* Server = NewObject<UFormCharacterComponent>(GetTransientPackage());
+	FSfTestAccess::InputActionRegistry(Client).SetNum(NumInputs);
+	FSfTestAccess::InputActionRegistry(Server).SetNum(NumInputs);
+
+	TArray<uint64> SentBits;
+	TArray<uint32> SentSerials;
+	int64 InputSetBits = 0;
+	int64 SparseBits = 0;
+	int32 Mismatches = 0;
+	for (int32 Move = 0; Move < MoveCount; Move++)
+	{
+		if (Random.FRand() < 0.02f)
+		{
+			FSfTestAccess::SetInputBit(Client, FireInput, (FSfTestAccess::InputBits(Client) & 1ull << FireInput) == 0);
+		}
+		const int32 TappedAbility = Random.FRand() < 0.05f ? Random.RandRange(8, 15) : INDEX_NONE;
+		for (int32 Ability = 8; Ability < 16; Ability++)
+		{
+			FSfTestAccess::SetInputBit(Client, Ability, Ability == TappedAbility);
+		}
+
+		//Same as UpdateInputBitsBaseline, with the move sent AckDelay moves ago as the last acknowledged move.
+		if (Move >= AckDelay)
+		{
+			const uint32 AckedSerial = SentSerials[Move - AckDelay];
+			if (FSfTestAccess::InputBitsSerial(Client) - AckedSerial >= FSfTestAccess::InputBitsStateIdCount)
+			{
+				FSfTestAccess::bHasInputBitsBaseline(Client) = false;
+			}
+			else
+			{
+				FSfTestAccess::InputBitsBaseline(Client) = SentBits[Move - AckDelay];
+				FSfTestAccess::InputBitsBaselineSerial(Client) = AckedSerial;
+				FSfTestAccess::bHasInputBitsBaseline(Client) = true;
+			}
+		}
+		SentBits.Add(FSfTestAccess::InputBits(Client));
+		SentSerials.Add(FSfTestAccess::InputBitsSerial(Client));
+
+		//Before the bitfield every move sent a 2 bit count of input sets and a byte for each set.
+		InputSetBits += 2 + 8 * FMath::DivideAndRoundUp(NumInputs, 8);
+
+		FSfNetworkMoveData ClientMoveData;
+		ClientMoveData.InputBits = FSfTestAccess::InputBits(Client);
+		ClientMoveData.InputBitsSerial = FSfTestAccess::InputBitsSerial(Client);
+		FBitWriter Writer(0, true);
+		ClientMoveData.SerializeInputBits(Writer, Client);
+		SparseBits += Writer.GetNumBits();
+
+		//Same as UpdateFromAdditionInputs.
+		FBitReader Reader(Writer.GetData(), Writer.GetNumBits());
+		FSfNetworkMoveData ServerMoveData;
+		ServerMoveData.SerializeInputBits(Reader, Server);
+		uint64 ReceivedBits = 0;
+		if (ServerMoveData.bInputBitsUnchanged)
+		{
+			const uint64* LastInputBits = FSfTestAccess::GetServerInputBitsState(
+				Server, FSfTestAccess::ServerLastProcessedInputBitsStateId(Server));
+			ReceivedBits = LastInputBits ? *LastInputBits : ~0ull;
+		}
+		else if (!ServerMoveData.bInputBitsBaselineLost)
+		{
+			ReceivedBits = ServerMoveData.InputBits;
+			FSfTestAccess::ServerLastProcessedInputBitsStateId(Server) = ServerMoveData.InputBitsStateId;
+		}
+		else
+		{
+			ReceivedBits = ~0ull;
+		}
+		Mismatches += Reader.IsError() || ReceivedBits != FSfTestAccess::InputBits(Client);
+	}
+	TestEqual(TEXT("The server reads the input bits the client sent"), Mismatches, 0);
+	TestTrue(TEXT("Sparse input bits send fewer bits than input sets"), SparseBits < InputSetBits);
+	AddInfo(FString::Printf(TEXT("%d moves: %.2f bits per move as input sets, %.2f bits per move as sparse deltas."),
+	                        MoveCount, static_cast<double>(InputSetBits) / MoveCount,
+	                        static_cast<double>(SparseBits) / MoveCount));
+
+	//All 64 bindings can be sent now that inputs aren't limited to three sets.
+	UFormCharacterComponent* WideClient = NewObject<UFormCharacterComponent>(GetTransientPackage());
+	UFormCharacterComponent* WideServer = NewObject<UFormCharacterComponent>(GetTransientPackage());
+	FSfTestAccess::InputActionRegistry(WideClient).SetNum(FSfTestAccess::MaxInputActions);
+	FSfTestAccess::InputActionRegistry(WideServer).SetNum(FSfTestAccess::MaxInputActions);
+	FSfTestAccess::SetInputBit(WideClient, 63, true);
+	FSfTestAccess::SetInputBit(WideClient, 0, true);
+	FSfNetworkMoveData WideMoveData;
+	WideMoveData.InputBits = FSfTestAccess::InputBits(WideClient);
+	WideMoveData.InputBitsSerial = FSfTestAccess::InputBitsSerial(WideClient);
+	FBitWriter WideWriter(0, true);
+	WideMoveData.SerializeInputBits(WideWriter, WideClient);
+	FBitReader WideReader(WideWriter.GetData(), WideWriter.GetNumBits());
+	FSfNetworkMoveData WideReceived;
+	WideReceived.SerializeInputBits(WideReader, WideServer);
+	TestTrue(TEXT("The last of 64 bindings round trips"),
+	         !WideReader.IsError() && WideReceived.InputBits == FSfTestAccess::InputBits(WideClient));
+	return true;
+}
+
+#endif
@@ -0,0 +1,165 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CardObject.h"
+#include "Inventory.h"
+#include "SfTestAccess.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSfInventoryCardIndexTest, "SfCore.Inventory.CardIndex",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+namespace SfInventoryCardIndexTest
+{
+	//Owners per card class, so 500 cards use 8 classes like a status effect heavy form would.
+	static constexpr int32 OwnersPerClass = 64;
+
+	static constexpr int32 LookupIterations = 200;
+
+	//Same as the scan that card queries did before the index.
+	static int32 LinearFindCardIndex(const TArray<FCard>& InCards, const TSubclassOf<UCardObject>& InCardClass,
+	                                 const uint8 InOwnerConstituentInstanceId)
+	{
+		int32 Found = INDEX_NONE;
+		for (int32 i = 0; i < InCards.Num(); i++)
+		{
+			if (InCards[i].Class != InCardClass || InCards[i].OwnerConstituentInstanceId != InOwnerConstituentInstanceId)
+				continue;
+			if (Found == INDEX_NONE || (InCards[Found].bIsDisabledForDestroy && !InCards[i].bIsDisabledForDestroy))
+			{
+				Found = i;
+			}
+		}
+		return Found;
+	}
+
+	//Whether lookups by class and owner and by class find the same cards as scanning them.
+	static bool IsCardIndexInSync(UInventory* InInventory, const TArray<UClass*>& InCardClasses,
+	                              const int32 InCardCount)
+	{
+		const TArray<FCard>& Cards = FSfTestAccess::Cards(InInventory);
+		bool bIndexMatches = true;
+		for (int32 Key = 0; Key < InCardCount; Key++)
+		{
+			const TSubclassOf<UCardObject> CardClass = InCardClasses[Key / OwnersPerClass];
+			const uint8 Owner = Key % OwnersPerClass;
+			bIndexMatches &= FSfTestAccess::FindCardIndex(InInventory, CardClass, Owner)
+				== LinearFindCardIndex(Cards, CardClass, Owner);
+		}
+		for (UClass* CardClass : InCardClasses)
+		{
+			TArray<const FCard*> Expected;
+			for (const FCard& Card : Cards)
+			{
+				if (Card.Class == CardClass) Expected.Add(&Card);
+			}
+			bIndexMatches &= InInventory->GetCardsOfClass(CardClass) == Expected;
+		}
+		return bIndexMatches;
+	}
+}
+
+bool FSfInventoryCardIndexTest::RunTest(const FString& Parameters)
+{
+	using namespace SfInventoryCardIndexTest;
+	//Card classes only act as keys here so they don't need to be generated from blueprints.
+	TArray<UClass*> CardClasses;
+	for (int32 i = 0; i < 8; i++)
+	{
+		UClass* CardClass = NewObject<UClass>(GetTransientPackage(), NAME_None, RF_Transient);
+		CardClass->SetSuperStruct(UCardObject::StaticClass());
+		CardClass->AddToRoot();
+		CardClasses.Add(CardClass);
+	}
+	for (const int32 CardCount : {10, 100, 500})
+	{
+		UInventory* Inventory = NewObject<UInventory>(GetTransientPackage(), NAME_None, RF_Transient);
+		//Built up front so the adds below go through the incremental path.
+		FSfTestAccess::RebuildCardIndex(Inventory);
+		TArray<FCard>& Cards = FSfTestAccess::Cards(Inventory);
+		for (int32 i = 0; i < CardCount; i++)
+		{
+			FCard& Card = Cards.AddDefaulted_GetRef();
+			Card.Class = CardClasses[i / OwnersPerClass];
+			Card.OwnerConstituentInstanceId = i % OwnersPerClass;
+			FSfTestAccess::IndexLastCard(Inventory);
+		}
+
+		//Query every card plus one miss per class, like the duplicate check on add does.
+		TArray<TPair<TSubclassOf<UCardObject>, uint8>> Queries;
+		for (int32 i = 0; i < CardCount; i++)
+		{
+			Queries.Emplace(Cards[i].Class, Cards[i].OwnerConstituentInstanceId);
+		}
+		for (UClass* CardClass : CardClasses)
+		{
+			Queries.Emplace(CardClass, UINT8_MAX);
+		}
+		int32 Checksum = 0;
+		double StartTime = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < LookupIterations; Iteration++)
+		{
+			for (const TPair<TSubclassOf<UCardObject>, uint8>& Query : Queries)
+			{
+				Checksum += FSfTestAccess::FindCardIndex(Inventory, Query.Key, Query.Value);
+			}
+		}
+		const double IndexedTime = FPlatformTime::Seconds() - StartTime;
+		int32 LinearChecksum = 0;
+		StartTime = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < LookupIterations; Iteration++)
+		{
+			for (const TPair<TSubclassOf<UCardObject>, uint8>& Query : Queries)
+			{
+				LinearChecksum += LinearFindCardIndex(Cards, Query.Key, Query.Value);
+			}
+		}
+		const double LinearTime = FPlatformTime::Seconds() - StartTime;
+		TestEqual(FString::Printf(TEXT("Indexed lookups match the linear scan with %d cards"), CardCount), Checksum,
+		          LinearChecksum);
+		const int32 LookupCount = LookupIterations * Queries.Num();
+		AddInfo(FString::Printf(TEXT("%d cards: %.1f ns per indexed lookup, %.1f ns per linear scan."), CardCount,
+		                        IndexedTime * 1e9 / LookupCount, LinearTime * 1e9 / LookupCount));
+
+		//A cleanse removes a burst of cards from the front half. Removed one at a time, every card after each removed
+		//one is shifted, while a batch is compacted and indexed once.
+		const int32 RemoveCount = FMath::Min(40, CardCount / 2);
+		UInventory* BatchInventory = NewObject<UInventory>(GetTransientPackage(), NAME_None, RF_Transient);
+		FSfTestAccess::Cards(BatchInventory) = Cards;
+		FSfTestAccess::RebuildCardIndex(BatchInventory);
+		//Removing index i after i removals removes the card that was at 2i.
+		TArray<int32> RemovedIndices;
+		for (int32 i = 0; i < RemoveCount; i++)
+		{
+			RemovedIndices.Add(i * 2);
+		}
+		StartTime = FPlatformTime::Seconds();
+		for (int32 i = 0; i < RemoveCount; i++)
+		{
+			FSfTestAccess::RemoveCardAt(Inventory, i, false);
+		}
+		const double RemoveTime = FPlatformTime::Seconds() - StartTime;
+		StartTime = FPlatformTime::Seconds();
+		FSfTestAccess::RemoveCardsAt(BatchInventory, RemovedIndices, false);
+		//Includes the rebuild on the first lookup.
+		FSfTestAccess::FindCardIndex(BatchInventory, CardClasses[0], 0);
+		const double BatchRemoveTime = FPlatformTime::Seconds() - StartTime;
+		AddInfo(FString::Printf(TEXT("%d cards: %.1f us to remove %d cards one at a time, %.1f us as a batch."),
+		                        CardCount, RemoveTime * 1e6, RemoveCount, BatchRemoveTime * 1e6));
+		TestTrue(FString::Printf(TEXT("Card index stays in sync after removing cards with %d cards"), CardCount),
+		         IsCardIndexInSync(Inventory, CardClasses, CardCount));
+		TestTrue(FString::Printf(TEXT("Batch removal keeps the same cards in order with %d cards"), CardCount),
+		         FSfTestAccess::Cards(BatchInventory) == Cards);
+		TestTrue(FString::Printf(TEXT("Card index stays in sync after a batch removal with %d cards"), CardCount),
+		         IsCardIndexInSync(BatchInventory, CardClasses, CardCount));
+	}
+	for (UClass* CardClass : CardClasses)
+	{
+		CardClass->RemoveFromRoot();
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,147 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SfTestAccess.h"
+#include "SfTestWorld.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSfJitterBufferTest, "SfCore.FormCharacter.JitterBuffer",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+namespace SfJitterBufferTest
+{
+	//Real time on the server when the simulation starts.
+	static constexpr double StartTime = 10;
+
+	static constexpr double SimulatedSeconds = 60;
+
+	//The client sends a move every frame and the server ticks at the same rate, half a frame apart.
+	static constexpr double ClientMoveInterval = 1 / 60.0;
+
+	static constexpr double ServerTickInterval = 1 / 60.0;
+
+	static constexpr double ServerTickOffset = ServerTickInterval / 2;
+
+	//One way latency, with jitter on every move.
+	static constexpr double Latency = 0.1;
+
+	static constexpr double Jitter = 0.1;
+
+	//Every few seconds the connection stalls, and the moves sent during it arrive together when it ends.
+	static constexpr double StallInterval = 2;
+
+	static constexpr double StallDuration = 0.45;
+
+	struct FRunResult
+	{
+		int32 ForcedMoves = 0;
+
+		//Longest time a move waited between arriving and being processed.
+		double MaxHoldTime = 0;
+
+		//How far each server tick was from processing the one move sent each tick, summed.
+		int32 UnevenMoves = 0;
+	};
+
+	//Moves arrive in the order they were sent, as a late move is dropped by the server anyway.
+	static TArray<double> MakeArrivalTimes(FRandomStream& InRandom)
+	{
+		TArray<double> ArrivalTimes;
+		double LastArrivalTime = 0;
+		const int32 MoveCount = FMath::RoundToInt(SimulatedSeconds / ClientMoveInterval);
+		for (int32 Move = 0; Move < MoveCount; Move++)
+		{
+			const double SendTime = Move * ClientMoveInterval;
+			const double StallEnd = (FMath::FloorToDouble(SendTime / StallInterval) + 1) * StallInterval;
+			const double ArrivalTime = SendTime >= StallEnd - StallDuration
+				                           ? StallEnd + Latency
+				                           : SendTime + Latency + InRandom.FRand() * Jitter;
+			LastArrivalTime = FMath::Max(LastArrivalTime, StartTime + ArrivalTime);
+			ArrivalTimes.Add(LastArrivalTime);
+		}
+		return ArrivalTimes;
+	}
+
+	//Receives the moves at their arrival times and ticks the server like TickComponent does, forcing a move when
+	//none has been processed for too long.
+	static FRunResult Run(UFormCharacterComponent* InFormCharacter, UWorld* InWorld,
+	                      const TArray<double>& InArrivalTimes)
+	{
+		FRunResult Result;
+		const TArray<FBufferedServerMove>& BufferedMoves = FSfTestAccess::BufferedServerMoves(InFormCharacter);
+		const float ForcedMoveWait = FSfTestAccess::ClientMoveWaitTimeBeforeForcingServerSimulation(InFormCharacter);
+		int32 NextArrival = 0;
+		int32 NextProcessed = 0;
+		int32 TickProcessed = 0;
+		double LastProcessedTime = StartTime;
+		//Moves leave the buffer in the order they arrived, so those that left since the last call were processed now.
+		auto CountProcessed = [&](const int32 InBufferedWithoutRelease)
+		{
+			for (int32 i = BufferedMoves.Num(); i < InBufferedWithoutRelease; i++)
+			{
+				Result.MaxHoldTime = FMath::Max(Result.MaxHoldTime,
+				                                InWorld->RealTimeSeconds - InArrivalTimes[NextProcessed++]);
+				TickProcessed++;
+				LastProcessedTime = InWorld->RealTimeSeconds;
+			}
+		};
+		const int32 TickCount = FMath::RoundToInt((SimulatedSeconds + 1) / ServerTickInterval);
+		for (int32 Tick = 1; Tick <= TickCount; Tick++)
+		{
+			const double TickTime = StartTime + ServerTickOffset + Tick * ServerTickInterval;
+			for (; NextArrival < InArrivalTimes.Num() && InArrivalTimes[NextArrival] < TickTime; NextArrival++)
+			{
+				InWorld->RealTimeSeconds = InArrivalTimes[NextArrival];
+				const int32 Buffered = BufferedMoves.Num();
+				FSfTestAccess::ServerMovePacked_ServerReceive(InFormCharacter, FCharacterServerMovePackedBits());
+				CountProcessed(Buffered + 1);
+			}
+			InWorld->RealTimeSeconds = TickTime;
+			const int32 Buffered = BufferedMoves.Num();
+			FSfTestAccess::ServerReleaseBufferedMoves(InFormCharacter, !InFormCharacter->bUseServerJitterBuffer);
+			CountProcessed(Buffered);
+			if (TickTime - LastProcessedTime >= ForcedMoveWait && BufferedMoves.IsEmpty())
+			{
+				Result.ForcedMoves++;
+				LastProcessedTime = TickTime;
+			}
+			Result.UnevenMoves += FMath::Abs(TickProcessed - 1);
+			TickProcessed = 0;
+		}
+		return Result;
+	}
+}
+
+bool FSfJitterBufferTest::RunTest(const FString& Parameters)
+{
+	using namespace SfJitterBufferTest;
+	const FSfTestWorld World;
+	FRandomStream Random(18);
+	const TArray<double> ArrivalTimes = MakeArrivalTimes(Random);
+
+	//The same moves are received without the jitter buffer, with it, and with it on a budget below the jitter.
+	//Without a pawn the moves themselves aren't simulated, only when the server gets to them.
+	TArray<FRunResult> Results;
+	for (const float LatencyBudget : {0.f, 0.1f, 0.03f})
+	{
+		UFormCharacterComponent* FormCharacter = NewObject<UFormCharacterComponent>(World.SpawnActor<AActor>());
+		FormCharacter->bUseServerJitterBuffer = LatencyBudget > 0;
+		FormCharacter->JitterBufferLatencyBudget = LatencyBudget;
+		Results.Add(Run(FormCharacter, World.Get(), ArrivalTimes));
+		TestTrue(FString::Printf(TEXT("Moves aren't held longer than a budget of %.2f s"), LatencyBudget),
+		         Results.Last().MaxHoldTime <= LatencyBudget + ServerTickInterval + UE_KINDA_SMALL_NUMBER);
+		AddInfo(FString::Printf(TEXT("Budget of %.2f s: %d forced moves, %d uneven moves, held up to %.1f ms."),
+		                        LatencyBudget, Results.Last().ForcedMoves, Results.Last().UnevenMoves,
+		                        Results.Last().MaxHoldTime * 1e3));
+	}
+	TestTrue(TEXT("Stalls force moves without the jitter buffer"), Results[0].ForcedMoves > 0);
+	TestTrue(TEXT("The jitter buffer forces fewer moves"), Results[1].ForcedMoves < Results[0].ForcedMoves);
+	TestTrue(TEXT("The jitter buffer processes moves at a steadier cadence"),
+	         Results[1].UnevenMoves < Results[0].UnevenMoves);
+	return true;
+}
+
+#endif
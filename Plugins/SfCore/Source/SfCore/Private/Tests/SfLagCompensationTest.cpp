@@ -0,0 +1,207 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SfLagCompensationSubsystem.h"
+#include "SfTestCharacter.h"
+#include "SfTestWorld.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSfLagCompensationTest, "SfCore.LagCompensation.RecordAndRewind",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+namespace SfLagCompensationTest
+{
+	//A second of history at this rate is 11 frames, so the history wraps a few times in a short run.
+	static constexpr uint32 TickRate = 10;
+
+	//Registering a form at this rate needs more frames, which resizes the history.
+	static constexpr uint32 FastTickRate = 20;
+
+	static constexpr double Tolerance = 0.01;
+
+	static constexpr int32 BenchmarkFormCount = 64;
+
+	static constexpr uint32 BenchmarkTickRate = 60;
+
+	static constexpr int32 BenchmarkFrames = 600;
+
+	static constexpr int32 BenchmarkRewinds = 1000;
+
+	struct FSfTestForm
+	{
+		AActor* Actor = nullptr;
+
+		int32 Slot = INDEX_NONE;
+
+		//Distance moved per frame, so the frame a form was rewound to can be told from its location.
+		float Speed = 0;
+
+		uint32 TickRate = 0;
+	};
+
+	static FSfTestForm RegisterForm(const FSfTestWorld& InWorld, USfLagCompensationSubsystem* InSubsystem,
+	                                const float InSpeed, const uint32 InTickRate)
+	{
+		FSfTestForm Form;
+		Form.Actor = InWorld.SpawnActor<ASfTestCharacter>();
+		Form.Slot = InSubsystem->Server_RegisterForm(Form.Actor, InTickRate);
+		Form.Speed = InSpeed;
+		Form.TickRate = InTickRate;
+		return Form;
+	}
+
+	//Moves the forms to where they are at the frame and records it.
+	static void Record(const FSfTestWorld& InWorld, USfLagCompensationSubsystem* InSubsystem,
+	                   const TArray<FSfTestForm>& InForms, const int32 InFrame, const uint32 InTickRate)
+	{
+		for (const FSfTestForm& Form : InForms)
+		{
+			Form.Actor->SetActorLocation(FVector(InFrame * Form.Speed, 0, 0));
+		}
+		InWorld.Get()->TimeSeconds = static_cast<double>(InFrame) / InTickRate;
+		InSubsystem->Tick(1.f / InTickRate);
+	}
+
+	//Timestamp a client would have sent when it saw the form at the frame, which is half a tick after it was recorded.
+	static float GetServerTimestamp(const double InFrame, const uint32 InRecordTickRate, const uint32 InFormTickRate)
+	{
+		return static_cast<float>(InFrame / InRecordTickRate + 0.5 / InFormTickRate);
+	}
+
+	//Rewinds the form to the frame and restores it. Returns false if the frame isn't in the history of the form.
+	static bool Rewind(USfLagCompensationSubsystem* InSubsystem, const FSfTestForm& InForm, const double InFrame,
+	                   const uint32 InRecordTickRate, double& OutX)
+	{
+		if (!InSubsystem->Server_RewindForm(InForm.Slot,
+		                                    GetServerTimestamp(InFrame, InRecordTickRate, InForm.TickRate)))
+		{
+			return false;
+		}
+		OutX = InForm.Actor->GetActorLocation().X;
+		InSubsystem->Server_RestoreForm(InForm.Slot);
+		return true;
+	}
+}
+
+bool FSfLagCompensationTest::RunTest(const FString& Parameters)
+{
+	using namespace SfLagCompensationTest;
+	//Rewinds to frames that aren't in the history warn.
+	AddExpectedError(TEXT("Could not find suitable snapshot"), EAutomationExpectedErrorFlags::Contains, 0);
+	const FSfTestWorld World;
+	USfLagCompensationSubsystem* Subsystem = World.Get()->GetSubsystem<USfLagCompensationSubsystem>();
+	if (!Subsystem)
+	{
+		AddError(TEXT("The test world has no lag compensation subsystem."));
+		return false;
+	}
+	TArray<FSfTestForm> Forms;
+	Forms.Add(RegisterForm(World, Subsystem, 100, TickRate));
+	Forms.Add(RegisterForm(World, Subsystem, 200, TickRate));
+	double X = 0;
+
+	//The history wraps, keeping the newest frames.
+	for (int32 Frame = 0; Frame < 30; Frame++)
+	{
+		Record(World, Subsystem, Forms, Frame, TickRate);
+	}
+	for (const FSfTestForm& Form : Forms)
+	{
+		TestTrue(FString::Printf(TEXT("Slot %d rewinds after the history wraps"), Form.Slot),
+		         Rewind(Subsystem, Form, 24.5, TickRate, X));
+		TestEqual(FString::Printf(TEXT("Slot %d is interpolated between frames"), Form.Slot), X, 24.5 * Form.Speed,
+		          Tolerance);
+		TestEqual(FString::Printf(TEXT("Slot %d is restored"), Form.Slot), Form.Actor->GetActorLocation().X,
+		          29.0 * Form.Speed, Tolerance);
+	}
+	TestFalse(TEXT("Overwritten frames aren't rewound to"), Rewind(Subsystem, Forms[0], 10.5, TickRate, X));
+	TestTrue(TEXT("Timestamps newer than the history rewind to the newest frame"),
+	         Rewind(Subsystem, Forms[0], 35, TickRate, X));
+	TestEqual(TEXT("The newest frame is used"), X, 29.0 * Forms[0].Speed, Tolerance);
+
+	//A form that needs more history resizes it and a form past the slot capacity grows it, keeping what was recorded.
+	Forms.Add(RegisterForm(World, Subsystem, 300, FastTickRate));
+	Forms.Add(RegisterForm(World, Subsystem, 400, TickRate));
+	for (const FSfTestForm& Form : {Forms[0], Forms[1]})
+	{
+		TestTrue(FString::Printf(TEXT("Slot %d keeps its history when resized"), Form.Slot),
+		         Rewind(Subsystem, Form, 24.5, TickRate, X));
+		TestEqual(FString::Printf(TEXT("Slot %d keeps its locations when resized"), Form.Slot), X,
+		          24.5 * Form.Speed, Tolerance);
+	}
+	TestFalse(TEXT("Frames from before a form registered aren't rewound to"),
+	          Rewind(Subsystem, Forms[2], 24.5, TickRate, X));
+	for (int32 Frame = 30; Frame < 50; Frame++)
+	{
+		Record(World, Subsystem, Forms, Frame, TickRate);
+	}
+	TestTrue(TEXT("The resized history holds more frames"), Rewind(Subsystem, Forms[0], 32.5, TickRate, X));
+	TestEqual(TEXT("The resized history holds the right locations"), X, 32.5 * Forms[0].Speed, Tolerance);
+	TestTrue(TEXT("Forms in slots added by the resize rewind"), Rewind(Subsystem, Forms[3], 40.5, TickRate, X));
+	TestEqual(TEXT("Forms in slots added by the resize have their own locations"), X, 40.5 * Forms[3].Speed,
+	          Tolerance);
+
+	//A form that takes a freed slot doesn't rewind to the frames of the form before it.
+	const int32 FreedSlot = Forms[0].Slot;
+	Subsystem->Server_UnregisterForm(FreedSlot);
+	Forms[0] = RegisterForm(World, Subsystem, -100, TickRate);
+	TestEqual(TEXT("The freed slot is reused"), Forms[0].Slot, FreedSlot);
+	TestFalse(TEXT("A reused slot doesn't rewind to frames of the previous form"),
+	          Rewind(Subsystem, Forms[0], 45.5, TickRate, X));
+	for (int32 Frame = 50; Frame < 55; Frame++)
+	{
+		Record(World, Subsystem, Forms, Frame, TickRate);
+	}
+	TestFalse(TEXT("A reused slot doesn't interpolate from frames of the previous form"),
+	          Rewind(Subsystem, Forms[0], 49.5, TickRate, X));
+	TestTrue(TEXT("A reused slot rewinds to its own frames"), Rewind(Subsystem, Forms[0], 52.5, TickRate, X));
+	TestEqual(TEXT("A reused slot has the locations of its form"), X, 52.5 * Forms[0].Speed, Tolerance);
+	TestTrue(TEXT("Other slots keep their history"), Rewind(Subsystem, Forms[1], 45.5, TickRate, X));
+	TestEqual(TEXT("Other slots keep their locations"), X, 45.5 * Forms[1].Speed, Tolerance);
+	for (const FSfTestForm& Form : Forms)
+	{
+		Subsystem->Server_UnregisterForm(Form.Slot);
+	}
+
+	//Benchmark of recording many forms and rewinding them all for hit registration, without anything else ticking.
+	const FSfTestWorld BenchmarkWorld;
+	USfLagCompensationSubsystem* BenchmarkSubsystem = BenchmarkWorld.Get()->GetSubsystem<USfLagCompensationSubsystem>();
+	TArray<FSfTestForm> BenchmarkForms;
+	TArray<int32> BenchmarkSlots;
+	for (int32 i = 0; i < BenchmarkFormCount; i++)
+	{
+		BenchmarkForms.Add(RegisterForm(BenchmarkWorld, BenchmarkSubsystem, i + 1, BenchmarkTickRate));
+		BenchmarkSlots.Add(BenchmarkForms.Last().Slot);
+	}
+	double RecordTime = 0;
+	for (int32 Frame = 0; Frame < BenchmarkFrames; Frame++)
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		Record(BenchmarkWorld, BenchmarkSubsystem, BenchmarkForms, Frame, BenchmarkTickRate);
+		RecordTime += FPlatformTime::Seconds() - StartTime;
+	}
+	FRandomStream Random(6);
+	int32 RewoundForms = 0;
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 i = 0; i < BenchmarkRewinds; i++)
+	{
+		const double Frame = BenchmarkFrames - 1 - Random.FRandRange(0, BenchmarkTickRate - 1);
+		RewoundForms += BenchmarkSubsystem->Server_RewindForms(
+			BenchmarkSlots, GetServerTimestamp(Frame, BenchmarkTickRate, BenchmarkTickRate));
+		BenchmarkSubsystem->Server_RestoreAllForms();
+	}
+	const double RewindTime = FPlatformTime::Seconds() - StartTime;
+	TestEqual(TEXT("Every form rewinds to timestamps in the history"), RewoundForms,
+	          BenchmarkFormCount * BenchmarkRewinds);
+	TestEqual(TEXT("Every form is restored"), BenchmarkForms.Last().Actor->GetActorLocation().X,
+	          (BenchmarkFrames - 1.0) * BenchmarkForms.Last().Speed, Tolerance);
+	AddInfo(FString::Printf(TEXT("%d forms at %u Hz: %.2f us per recorded frame (including moving the forms), "
+		                        "%.2f us per rewind and restore of every form."), BenchmarkFormCount, BenchmarkTickRate,
+	                        RecordTime * 1e6 / BenchmarkFrames, RewindTime * 1e6 / BenchmarkRewinds));
+	return true;
+}
+
+#endif
@@ -0,0 +1,148 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SfTestCharacter.h"
+#include "SfTestWorld.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSfMoveCombiningTest, "SfCore.FormCharacter.MoveCombining",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+namespace SfMoveCombiningTest
+{
+	static constexpr double SimulatedSeconds = 10;
+
+	static constexpr double FrameInterval = 1 / 240.0;
+
+	//Same as the default time between moves being sent, which pending moves are held for.
+	static constexpr double NetMoveDelta = 1 / 60.0;
+
+	static constexpr float MaxMoveDeltaTime = 0.125f;
+
+	//Chance of a frame changing Sf state, like an action being performed or a card being added, or changing inputs.
+	static constexpr float SfStateChangeChance = 0.05f;
+
+	static constexpr float InputChangeChance = 0.02f;
+
+	struct FSendResult
+	{
+		int32 Packets = 0;
+
+		int32 SavedMoves = 0;
+
+		//Sent moves that changed Sf state, which is every frame that changed it if none were combined away.
+		int32 SentSfStateChanges = 0;
+	};
+
+	static TSharedPtr<FSavedMove_Sf> MakeMove(const uint64 InInputBits, const bool bInSfStateChanged)
+	{
+		TSharedPtr<FSavedMove_Sf> Move = MakeShared<FSavedMove_Sf>();
+		Move->DeltaTime = FrameInterval;
+		Move->InputBits = InInputBits;
+		Move->bSfStateChanged = bInSfStateChanged;
+		return Move;
+	}
+
+	//Sends a move each frame the way ReplicateMoveToServer does. A new move takes in the pending move if they can be
+	//combined, and is held as the pending move if there isn't one and the last send was recent. Otherwise the pending
+	//move and the new move are sent together. The move still pending at the end is sent with the next frame.
+	static FSendResult Send(ACharacter* InCharacter, const TArray<TPair<uint64, bool>>& InFrames)
+	{
+		FSendResult Result;
+		TSharedPtr<FSavedMove_Sf> PendingMove;
+		double LastSendTime = -NetMoveDelta;
+		for (int32 Frame = 0; Frame < InFrames.Num(); Frame++)
+		{
+			const double Time = Frame * FrameInterval;
+			TSharedPtr<FSavedMove_Sf> NewMove = MakeMove(InFrames[Frame].Key, InFrames[Frame].Value);
+			Result.SavedMoves++;
+			if (PendingMove.IsValid() && PendingMove->CanCombineWith(NewMove, InCharacter, MaxMoveDeltaTime))
+			{
+				//The pending move is taken off the saved moves and its time is simulated again by the new move.
+				NewMove->DeltaTime += PendingMove->DeltaTime;
+				PendingMove.Reset();
+				Result.SavedMoves--;
+			}
+			if (!PendingMove.IsValid() && Time - LastSendTime < NetMoveDelta)
+			{
+				PendingMove = NewMove;
+				continue;
+			}
+			Result.SentSfStateChanges += NewMove->bSfStateChanged;
+			Result.SentSfStateChanges += PendingMove.IsValid() && PendingMove->bSfStateChanged;
+			PendingMove.Reset();
+			Result.Packets++;
+			LastSendTime = Time;
+		}
+		if (PendingMove.IsValid())
+		{
+			Result.SentSfStateChanges += PendingMove->bSfStateChanged;
+			Result.Packets++;
+		}
+		return Result;
+	}
+}
+
+bool FSfMoveCombiningTest::RunTest(const FString& Parameters)
+{
+	using namespace SfMoveCombiningTest;
+	const FSfTestWorld World;
+	ASfTestCharacter* Character = World.SpawnActor<ASfTestCharacter>();
+	UFormCharacterComponent* FormCharacter = Cast<UFormCharacterComponent>(Character->GetCharacterMovement());
+
+	//Moves only combine if the older one didn't change Sf state, which would otherwise be simulated a tick late.
+	const TSharedPtr<FSavedMove_Sf> NewMove = MakeMove(0, false);
+	TestTrue(TEXT("Moves that change nothing combine"),
+	         MakeMove(0, false)->CanCombineWith(NewMove, Character, MaxMoveDeltaTime));
+	TestFalse(TEXT("Moves that changed Sf state don't combine"),
+	          MakeMove(0, true)->CanCombineWith(NewMove, Character, MaxMoveDeltaTime));
+	TSharedPtr<FSavedMove_Sf> PredictedChangeMove = MakeMove(0, false);
+	PredictedChangeMove->bMadePredictedChanges = true;
+	TestFalse(TEXT("Moves that made predicted changes don't combine"),
+	          PredictedChangeMove->CanCombineWith(NewMove, Character, MaxMoveDeltaTime));
+	TestFalse(TEXT("Moves with other inputs don't combine"),
+	          MakeMove(1, false)->CanCombineWith(NewMove, Character, MaxMoveDeltaTime));
+	TSharedPtr<FSavedMove_Sf> VelocityCurveMove = MakeMove(0, false);
+	VelocityCurveMove->VelocityCurveKeys.AddDefaulted();
+	TestFalse(TEXT("Moves with velocity curves don't combine"),
+	          VelocityCurveMove->CanCombineWith(NewMove, Character, MaxMoveDeltaTime));
+	TestTrue(TEXT("Moves that change Sf state take in moves before them that didn't"),
+	         MakeMove(0, false)->CanCombineWith(MakeMove(0, true), Character, MaxMoveDeltaTime));
+	FormCharacter->bAllowMoveCombining = false;
+	TestFalse(TEXT("Moves don't combine if combining isn't allowed"),
+	          MakeMove(0, false)->CanCombineWith(NewMove, Character, MaxMoveDeltaTime));
+
+	//A 240 fps client that changes Sf state or inputs now and then.
+	FRandomStream Random(10);
+	TArray<TPair<uint64, bool>> Frames;
+	uint64 InputBits = 0;
+	int32 SfStateChanges = 0;
+	for (int32 Frame = 0; Frame < FMath::RoundToInt(SimulatedSeconds / FrameInterval); Frame++)
+	{
+		const bool bSfStateChanged = Random.FRand() < SfStateChangeChance;
+		if (Random.FRand() < InputChangeChance) InputBits ^= 1ull << Random.RandRange(0, 7);
+		Frames.Emplace(InputBits, bSfStateChanged);
+		SfStateChanges += bSfStateChanged;
+	}
+	FSendResult Results[2];
+	for (const bool bAllowMoveCombining : {false, true})
+	{
+		FormCharacter->bAllowMoveCombining = bAllowMoveCombining;
+		Results[bAllowMoveCombining] = Send(Character, Frames);
+		TestEqual(FString::Printf(TEXT("Every Sf state change is sent with combining %s"),
+		                          bAllowMoveCombining ? TEXT("on") : TEXT("off")),
+		          Results[bAllowMoveCombining].SentSfStateChanges, SfStateChanges);
+		AddInfo(FString::Printf(TEXT("Combining %s: %.1f packets and %.1f saved moves per second."),
+		                        bAllowMoveCombining ? TEXT("on") : TEXT("off"),
+		                        Results[bAllowMoveCombining].Packets / SimulatedSeconds,
+		                        Results[bAllowMoveCombining].SavedMoves / SimulatedSeconds));
+	}
+	TestTrue(TEXT("Combining sends fewer packets"), Results[1].Packets < Results[0].Packets);
+	TestTrue(TEXT("Combining saves fewer moves to replay"), Results[1].SavedMoves < Results[0].SavedMoves);
+	return true;
+}
+
+#endif
@@ -0,0 +1,280 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SfParamSerializer.h"
+#include "SfTestAccess.h"
+#include "SfTestParams.h"
+#include "Misc/AutomationTest.h"
+#include "UObject/CoreNet.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSfParamSerializerTest, "SfCore.Constituent.ParamSerializer",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+namespace SfParamSerializerTest
+{
+	static constexpr double FractionStep = 0.01;
+
+	static constexpr double AngleRange = 360;
+
+	static constexpr int32 AngleBits = 10;
+
+	static constexpr double ScaleStep = 0.5;
+
+	static constexpr double ScaleMax = 10;
+
+	static void AddRule(TMap<TPair<FTopLevelAssetPath, FName>, FSfParamQuantizationRule>& InOutRules,
+	                    const UStruct* InStruct, const FName InProperty, const double InMin, const double InMax,
+	                    const double InStep, const int32 InBits)
+	{
+		FSfParamQuantizationRule Rule;
+		Rule.Struct = FTopLevelAssetPath(InStruct);
+		Rule.Property = InProperty;
+		Rule.Min = InMin;
+		Rule.Max = InMax;
+		Rule.Step = InStep;
+		Rule.Bits = InBits;
+		InOutRules.Add(TPair<FTopLevelAssetPath, FName>(Rule.Struct, Rule.Property), Rule);
+	}
+
+	//The rules the editor would resolve from metadata like meta = (SfBits = "6") or
+	//meta = (ClampMin = "0", ClampMax = "1", SfQuantizationStep = "0.01").
+	static void AddRules(TMap<TPair<FTopLevelAssetPath, FName>, FSfParamQuantizationRule>& InOutRules)
+	{
+		const UStruct* Struct = FSfTestParams::StaticStruct();
+		AddRule(InOutRules, Struct, GET_MEMBER_NAME_CHECKED(FSfTestParams, SmallSigned), 0, 0, 0, 6);
+		AddRule(InOutRules, Struct, GET_MEMBER_NAME_CHECKED(FSfTestParams, SmallUnsigned), 0, 0, 0, 4);
+		AddRule(InOutRules, Struct, GET_MEMBER_NAME_CHECKED(FSfTestParams, Ranged), -10, 100, 0, 0);
+		AddRule(InOutRules, Struct, GET_MEMBER_NAME_CHECKED(FSfTestParams, Fraction), 0, 1, FractionStep, 0);
+		AddRule(InOutRules, Struct, GET_MEMBER_NAME_CHECKED(FSfTestParams, Angle), -AngleRange / 2, AngleRange / 2, 0,
+		        AngleBits);
+		AddRule(InOutRules, FSfTestNestedParams::StaticStruct(), GET_MEMBER_NAME_CHECKED(FSfTestNestedParams, Scale), 0,
+		        ScaleMax, ScaleStep, 0);
+	}
+
+	static FSfTestParams MakeParams()
+	{
+		FSfTestParams Params;
+		Params.bFlag = true;
+		Params.Byte = 200;
+		Params.Short = -1234;
+		Params.SmallSigned = -20;
+		Params.SmallUnsigned = 9;
+		Params.Signed = -70000;
+		Params.Large = -(1ll << 40) - 7;
+		Params.Unsigned = 3000000000u;
+		Params.Ranged = 37;
+		Params.Value = 3.14159f;
+		Params.Fraction = 0.374f;
+		Params.Angle = 45.3f;
+		Params.Enum = ESfTestParamEnum::Five;
+		Params.SignedEnum = ESfTestSignedParamEnum::Negative;
+		Params.ByteEnum = FlatAdditive;
+		Params.Name = TEXT("SfTestParam");
+		Params.String = TEXT("Param string");
+		Params.Text = FText::FromString(TEXT("Param text"));
+		Params.StaticArray[0] = -1;
+		Params.StaticArray[2] = 70000;
+		Params.Array = {1, -2, 300};
+		Params.Nested = {-5, 2.26f, TEXT("Nested")};
+		Params.NestedArray = {{7, 9.74f, TEXT("First")}, {-9, 0.2f, FString()}};
+		return Params;
+	}
+
+	//Returns false if the params weren't read back from exactly the bits that were written.
+	static bool RoundTrip(FSfTestParams InParams, FSfTestParams& OutParams, int64& OutBits)
+	{
+		FBitWriter Writer(0, true);
+		FSfParamSerializer::SerializeStruct(FSfTestParams::StaticStruct(), &InParams, Writer);
+		OutBits = Writer.GetNumBits();
+		FBitReader Reader(Writer.GetData(), Writer.GetNumBits());
+		FSfParamSerializer::SerializeStruct(FSfTestParams::StaticStruct(), &OutParams, Reader);
+		return !Writer.IsError() && !Reader.IsError() && Reader.GetBitsLeft() == 0;
+	}
+
+	//How params were written before plans, with every integer as an int64 and every float whole. Enum classes weren't
+	//written at all and arrays were written without their size. Names are written like plans write them.
+	static void WriteByReflection(const FProperty* InProperty, const void* InValuePtr, FArchive& Ar)
+	{
+		if (const FNumericProperty* NumericProperty = CastField<FNumericProperty>(InProperty))
+		{
+			if (NumericProperty->IsFloatingPoint())
+			{
+				float FloatValue = NumericProperty->GetFloatingPointPropertyValue(InValuePtr);
+				Ar << FloatValue;
+			}
+			else
+			{
+				int64 IntValue = NumericProperty->GetSignedIntPropertyValue(InValuePtr);
+				Ar << IntValue;
+			}
+		}
+		else if (const FBoolProperty* BoolProperty = CastField<FBoolProperty>(InProperty))
+		{
+			bool bBoolValue = BoolProperty->GetPropertyValue(InValuePtr);
+			Ar.SerializeBits(&bBoolValue, 1);
+		}
+		else if (const FNameProperty* NameProperty = CastField<FNameProperty>(InProperty))
+		{
+			FName NameValue = NameProperty->GetPropertyValue(InValuePtr);
+			UPackageMap::StaticSerializeName(Ar, NameValue);
+		}
+		else if (const FStrProperty* StringProperty = CastField<FStrProperty>(InProperty))
+		{
+			FString StringValue = StringProperty->GetPropertyValue(InValuePtr);
+			Ar << StringValue;
+		}
+		else if (const FTextProperty* TextProperty = CastField<FTextProperty>(InProperty))
+		{
+			FText TextValue = TextProperty->GetPropertyValue(InValuePtr);
+			Ar << TextValue;
+		}
+		else if (const FArrayProperty* ArrayProperty = CastField<FArrayProperty>(InProperty))
+		{
+			FScriptArrayHelper Helper(ArrayProperty, InValuePtr);
+			for (int32 i = 0; i < Helper.Num(); i++)
+			{
+				WriteByReflection(ArrayProperty->Inner, Helper.GetRawPtr(i), Ar);
+			}
+		}
+		else if (const FStructProperty* StructProperty = CastField<FStructProperty>(InProperty))
+		{
+			for (TFieldIterator<FProperty> PropertyIt(StructProperty->Struct); PropertyIt; ++PropertyIt)
+			{
+				for (int32 ArrayIndex = 0; ArrayIndex < PropertyIt->ArrayDim; ArrayIndex++)
+				{
+					WriteByReflection(*PropertyIt, PropertyIt->ContainerPtrToValuePtr<void>(InValuePtr, ArrayIndex),
+					                  Ar);
+				}
+			}
+		}
+	}
+
+	static int64 CountBitsByReflection(const FSfTestParams& InParams)
+	{
+		FBitWriter Writer(0, true);
+		for (TFieldIterator<FProperty> PropertyIt(FSfTestParams::StaticStruct()); PropertyIt; ++PropertyIt)
+		{
+			for (int32 ArrayIndex = 0; ArrayIndex < PropertyIt->ArrayDim; ArrayIndex++)
+			{
+				WriteByReflection(*PropertyIt, PropertyIt->ContainerPtrToValuePtr<void>(&InParams, ArrayIndex), Writer);
+			}
+		}
+		return Writer.GetNumBits();
+	}
+}
+
+bool FSfParamSerializerTest::RunTest(const FString& Parameters)
+{
+	using namespace SfParamSerializerTest;
+	TMap<TPair<FTopLevelAssetPath, FName>, FSfParamQuantizationRule>& Rules =
+		FSfTestAccess::ParamQuantizationRulesByProperty();
+	const TMap<TPair<FTopLevelAssetPath, FName>, FSfParamQuantizationRule> LoadedRules = Rules;
+	const FSfTestParams Params = MakeParams();
+
+	//Without quantization every value is read back as it was.
+	FSfParamSerializer::ClearCache();
+	FSfTestParams Received;
+	int64 UnquantizedBits = 0;
+	TestTrue(TEXT("Unquantized params are read from the bits that were written"),
+	         RoundTrip(Params, Received, UnquantizedBits));
+	TestEqual(TEXT("Ranged integers are read back whole without quantization"), Received.Ranged, Params.Ranged);
+	TestEqual(TEXT("Floats are read back whole without quantization"), Received.Fraction, Params.Fraction);
+
+	//With quantization, plans are compiled again once the cache is cleared.
+	AddRules(Rules);
+	FSfParamSerializer::ClearCache();
+	Received = FSfTestParams();
+	int64 Bits = 0;
+	TestTrue(TEXT("Params are read from the bits that were written"), RoundTrip(Params, Received, Bits));
+	const int64 QuantizedBits = Bits;
+	TestTrue(TEXT("Quantization applies once the cached plans are cleared"), Bits < UnquantizedBits);
+	TestTrue(TEXT("Bools"), Received.bFlag == Params.bFlag);
+	TestEqual(TEXT("Bytes"), static_cast<int32>(Received.Byte), static_cast<int32>(Params.Byte));
+	TestEqual(TEXT("Negative small integers are sign extended"), static_cast<int32>(Received.Short),
+	          static_cast<int32>(Params.Short));
+	TestEqual(TEXT("Negative integers of a set bit width are sign extended"), Received.SmallSigned, Params.SmallSigned);
+	TestEqual(TEXT("Unsigned integers of a set bit width"), Received.SmallUnsigned, Params.SmallUnsigned);
+	TestEqual(TEXT("Negative packed integers"), Received.Signed, Params.Signed);
+	TestEqual(TEXT("Negative packed 64 bit integers"), Received.Large, Params.Large);
+	TestEqual(TEXT("Unsigned packed integers above the signed range"), Received.Unsigned, Params.Unsigned);
+	TestEqual(TEXT("Integers in a range"), Received.Ranged, Params.Ranged);
+	TestEqual(TEXT("Floats"), Received.Value, Params.Value);
+	TestEqual(TEXT("Floats quantized in steps"), Received.Fraction, Params.Fraction,
+	          static_cast<float>(FractionStep / 2 + UE_KINDA_SMALL_NUMBER));
+	TestEqual(TEXT("Floats quantized to a bit width"), Received.Angle, Params.Angle,
+	          static_cast<float>(AngleRange / ((1 << AngleBits) - 1) / 2 + UE_KINDA_SMALL_NUMBER));
+	TestTrue(TEXT("Enums"), Received.Enum == Params.Enum);
+	TestTrue(TEXT("Enums with negative values"), Received.SignedEnum == Params.SignedEnum);
+	TestTrue(TEXT("Byte enums"), Received.ByteEnum == Params.ByteEnum);
+	TestTrue(TEXT("Names"), Received.Name == Params.Name);
+	TestEqual(TEXT("Strings"), Received.String, Params.String);
+	TestTrue(TEXT("Texts"), Received.Text.EqualTo(Params.Text));
+	for (int32 i = 0; i < UE_ARRAY_COUNT(Params.StaticArray); i++)
+	{
+		TestEqual(FString::Printf(TEXT("Static array element %d"), i), Received.StaticArray[i], Params.StaticArray[i]);
+	}
+	TestTrue(TEXT("Arrays"), Received.Array == Params.Array);
+	TestEqual(TEXT("Nested structs"), Received.Nested.Count, Params.Nested.Count);
+	TestEqual(TEXT("Quantized floats in nested structs"), Received.Nested.Scale, Params.Nested.Scale,
+	          static_cast<float>(ScaleStep / 2 + UE_KINDA_SMALL_NUMBER));
+	TestEqual(TEXT("Strings in nested structs"), Received.Nested.Label, Params.Nested.Label);
+	TestEqual(TEXT("Arrays of structs"), Received.NestedArray.Num(), Params.NestedArray.Num());
+	for (int32 i = 0; i < FMath::Min(Received.NestedArray.Num(), Params.NestedArray.Num()); i++)
+	{
+		TestEqual(FString::Printf(TEXT("Struct array element %d"), i), Received.NestedArray[i].Count,
+		          Params.NestedArray[i].Count);
+		TestEqual(FString::Printf(TEXT("Quantized floats in struct array element %d"), i),
+		          Received.NestedArray[i].Scale, Params.NestedArray[i].Scale,
+		          static_cast<float>(ScaleStep / 2 + UE_KINDA_SMALL_NUMBER));
+		TestEqual(FString::Printf(TEXT("Strings in struct array element %d"), i), Received.NestedArray[i].Label,
+		          Params.NestedArray[i].Label);
+	}
+
+	//Values outside the range or bit width are clamped instead of wrapping around.
+	FSfTestParams Low = Params;
+	Low.SmallSigned = -40;
+	Low.Ranged = -50;
+	Low.Fraction = -0.2f;
+	Low.Angle = -200;
+	Low.Nested.Scale = -3;
+	Received = FSfTestParams();
+	TestTrue(TEXT("Params below their range are read from the bits that were written"),
+	         RoundTrip(Low, Received, Bits));
+	TestEqual(TEXT("Integers below their bit width clamp"), Received.SmallSigned, -32);
+	TestEqual(TEXT("Integers below their range clamp"), Received.Ranged, -10);
+	TestEqual(TEXT("Floats below their range clamp"), Received.Fraction, 0.f);
+	TestEqual(TEXT("Floats below their range clamp with a bit width"), Received.Angle,
+	          static_cast<float>(-AngleRange / 2), UE_KINDA_SMALL_NUMBER);
+	TestEqual(TEXT("Floats in nested structs below their range clamp"), Received.Nested.Scale, 0.f);
+	FSfTestParams High = Params;
+	High.SmallSigned = 40;
+	High.SmallUnsigned = 20;
+	High.Ranged = 1000;
+	High.Fraction = 1.5f;
+	High.Angle = 200;
+	High.Nested.Scale = 30;
+	Received = FSfTestParams();
+	TestTrue(TEXT("Params above their range are read from the bits that were written"),
+	         RoundTrip(High, Received, Bits));
+	TestEqual(TEXT("Integers above their bit width clamp"), Received.SmallSigned, 31);
+	TestEqual(TEXT("Unsigned integers above their bit width clamp"), Received.SmallUnsigned, 15u);
+	TestEqual(TEXT("Integers above their range clamp"), Received.Ranged, 100);
+	TestEqual(TEXT("Floats above their range clamp"), Received.Fraction, 1.f, UE_KINDA_SMALL_NUMBER);
+	TestEqual(TEXT("Floats above their range clamp with a bit width"), Received.Angle,
+	          static_cast<float>(AngleRange / 2), UE_KINDA_SMALL_NUMBER);
+	TestEqual(TEXT("Floats in nested structs above their range clamp"), Received.Nested.Scale,
+	          static_cast<float>(ScaleMax), UE_KINDA_SMALL_NUMBER);
+
+	const int64 ReflectionBits = CountBitsByReflection(Params);
+	AddInfo(FString::Printf(TEXT("Params of every type: %lld bits with plans, %lld without quantization and %lld by "
+		                        "reflection, saving %lld bits per action."), QuantizedBits, UnquantizedBits,
+	                        ReflectionBits, ReflectionBits - QuantizedBits));
+
+	Rules = LoadedRules;
+	FSfParamSerializer::ClearCache();
+	return true;
+}
+
+#endif
@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FormCharacterComponent.h"
+#include "SfTestAccess.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSfPredictedNetClockTest, "SfCore.FormCharacter.PredictedNetClock",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+namespace SfPredictedNetClockTest
+{
+	//Longer than a day so the clock loops a few times.
+	static constexpr double SimulatedSeconds = 25 * 60 * 60;
+}
+
+bool FSfPredictedNetClockTest::RunTest(const FString& Parameters)
+{
+	using namespace SfPredictedNetClockTest;
+	constexpr uint32 TicksPerLoop = UFormCharacterComponent::PredictedNetClockTicksPerLoop;
+	constexpr float ToleranceTicks = FSfTestAccess::NetClockAcceptableTolerance
+		* UFormCharacterComponent::PredictedNetClockTicksPerSecond;
+
+	//The client simulates every frame, while the server simulates pairs of them as one combined move.
+	FRandomStream Stream(16);
+	uint32 ClientTicks = 0;
+	float ClientRemainder = 0;
+	uint32 ServerTicks = 0;
+	float ServerRemainder = 0;
+	double ElapsedSeconds = 0;
+	int32 Moves = 0;
+	int32 Loops = 0;
+	int32 ClockCorrections = 0;
+	int32 InexactTimestamps = 0;
+	int32 MaxTicksApart = 0;
+	while (ElapsedSeconds < SimulatedSeconds)
+	{
+		const float FirstDeltaSeconds = Stream.FRandRange(1 / 144.f, 1 / 30.f);
+		const float SecondDeltaSeconds = Stream.FRandRange(1 / 144.f, 1 / 30.f);
+		const uint32 PreviousClientTicks = ClientTicks;
+		ClientTicks = UFormCharacterComponent::AddTimeToPredictedNetClock(ClientTicks, ClientRemainder,
+		                                                                  FirstDeltaSeconds) % TicksPerLoop;
+		ClientTicks = UFormCharacterComponent::AddTimeToPredictedNetClock(ClientTicks, ClientRemainder,
+		                                                                  SecondDeltaSeconds) % TicksPerLoop;
+		ServerTicks = UFormCharacterComponent::AddTimeToPredictedNetClock(ServerTicks, ServerRemainder,
+		                                                                  FirstDeltaSeconds + SecondDeltaSeconds)
+			% TicksPerLoop;
+		ElapsedSeconds += static_cast<double>(FirstDeltaSeconds) + SecondDeltaSeconds;
+		Moves++;
+		Loops += ClientTicks < PreviousClientTicks;
+
+		//Same check as the server does on the clock that the client sends.
+		const int32 TicksApart = UFormCharacterComponent::CalculateTicksBetweenPredictedNetClocks(
+			ServerTicks, ClientTicks);
+		MaxTicksApart = FMath::Max(MaxTicksApart, FMath::Abs(TicksApart));
+		ClockCorrections += FMath::Abs(TicksApart) > ToleranceTicks;
+
+		//Card lifetimes and action timestamps are made from the clock, so they have to convert back exactly.
+		const float Timestamp = static_cast<float>(ClientTicks)
+			/ UFormCharacterComponent::PredictedNetClockTicksPerSecond;
+		InexactTimestamps += UFormCharacterComponent::PredictedTimestampToTicks(Timestamp) != ClientTicks;
+	}
+	AddInfo(FString::Printf(TEXT("%d moves over %.1f hours, the clock looped %d times and was at most %d ticks apart."),
+	                        Moves, ElapsedSeconds / 3600, Loops, MaxTicksApart));
+	TestTrue(TEXT("The clock loops during the simulation"), Loops >= 2);
+	TestEqual(TEXT("No clock corrections over more than a day"), ClockCorrections, 0);
+	TestEqual(TEXT("Timestamps made from the clock convert back to the same ticks"), InexactTimestamps, 0);
+
+	//Comparisons are the shorter way around the loop, so timestamps just past the loop are still ahead.
+	TestEqual(TEXT("Ticks across the loop are ahead"),
+	          UFormCharacterComponent::CalculateTicksBetweenPredictedNetClocks(TicksPerLoop - 10, 20), 30);
+	TestEqual(TEXT("Ticks back across the loop are behind"),
+	          UFormCharacterComponent::CalculateTicksBetweenPredictedNetClocks(20, TicksPerLoop - 10), -30);
+	TestTrue(TEXT("Negative timestamps wrap to the end of the loop"),
+	         UFormCharacterComponent::PredictedTimestampToTicks(-1) == TicksPerLoop - 512);
+	return true;
+}
+
+#endif
@@ -0,0 +1,218 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CardObject.h"
+#include "SfTestAccess.h"
+#include "SfTestCharacter.h"
+#include "SfTestWorld.h"
+#include "GameFramework/GameStateBase.h"
+#include "HAL/MemoryBase.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSfPredictionTickAllocationTest, "SfCore.FormCharacter.PredictionTickAllocations",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+namespace SfPredictionTickAllocationTest
+{
+	static constexpr int32 Ticks = 1000;
+
+	//Ticks before counting, so buffers have grown to what they need.
+	static constexpr int32 WarmUpTicks = 100;
+
+	static constexpr float TickInterval = 1 / 60.f;
+
+	static constexpr int32 InventoryCount = 4;
+
+	static constexpr int32 ConstituentsPerInventory = 3;
+
+	static constexpr int32 CardsPerInventory = 8;
+
+	//The client is corrected every so often and replays the moves since the corrected one.
+	static constexpr int32 CorrectionInterval = 100;
+
+	static constexpr int32 ReplayedMoves = 10;
+
+	//Saved moves are pooled like the client prediction data does.
+	static constexpr int32 SavedMovePoolSize = 32;
+
+	//Ticks between an input being pressed or released.
+	static constexpr int32 InputChangeInterval = 15;
+
+	//Forwards to the allocator it replaces and counts the allocations made on the game thread.
+	class FSfCountingMalloc final : public FMalloc
+	{
+	public:
+		FMalloc* Inner = nullptr;
+
+		int32 Allocations = 0;
+
+		virtual void* Malloc(const SIZE_T Count, const uint32 Alignment) override
+		{
+			Allocations += IsInGameThread();
+			return Inner->Malloc(Count, Alignment);
+		}
+
+		virtual void* Realloc(void* Original, const SIZE_T Count, const uint32 Alignment) override
+		{
+			Allocations += IsInGameThread() && Count > 0;
+			return Inner->Realloc(Original, Count, Alignment);
+		}
+
+		virtual void Free(void* Original) override
+		{
+			Inner->Free(Original);
+		}
+
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override
+		{
+			return Inner->GetAllocationSize(Original, SizeOut);
+		}
+
+		virtual SIZE_T QuantizeSize(const SIZE_T Count, const uint32 Alignment) override
+		{
+			return Inner->QuantizeSize(Count, Alignment);
+		}
+
+		virtual bool IsInternallyThreadSafe() const override
+		{
+			return Inner->IsInternallyThreadSafe();
+		}
+
+		virtual const TCHAR* GetDescriptiveName() override
+		{
+			return TEXT("SfCountingMalloc");
+		}
+	};
+
+	//Other threads may still be in the counter after it is uninstalled, so it is never destroyed.
+	static FSfCountingMalloc& GetCountingMalloc()
+	{
+		static FSfCountingMalloc* CountingMalloc = new FSfCountingMalloc();
+		return *CountingMalloc;
+	}
+
+	//Runs the prediction tick for each move, pressing and releasing inputs now and then. A client also saves each move
+	//and replays the last moves when it is corrected. Returns the allocations made on the game thread.
+	static int32 Run(ACharacter* InCharacter, const int32 InFirstTick, const int32 InTicks,
+	                 const TArray<TSharedPtr<FSavedMove_Sf>>& InSavedMoves)
+	{
+		UFormCharacterComponent* FormCharacter = Cast<UFormCharacterComponent>(InCharacter->GetCharacterMovement());
+		const bool bIsClient = !InCharacter->HasAuthority();
+		FNetworkPredictionData_Client_Character* ClientData = bIsClient
+			                                                      ? FormCharacter->GetPredictionData_Client_Character()
+			                                                      : nullptr;
+		FSfCountingMalloc& CountingMalloc = GetCountingMalloc();
+		CountingMalloc.Inner = GMalloc;
+		CountingMalloc.Allocations = 0;
+		GMalloc = &CountingMalloc;
+		for (int32 Tick = InFirstTick; Tick < InFirstTick + InTicks; Tick++)
+		{
+			if (Tick % InputChangeInterval == 0)
+			{
+				FSfTestAccess::InputBits(FormCharacter) ^= 1ull << (Tick / InputChangeInterval % InventoryCount);
+			}
+			FSfTestAccess::UpdateCharacterStateBeforeMovement(FormCharacter, TickInterval);
+			if (!bIsClient) continue;
+			FSavedMove_Sf* Move = InSavedMoves[Tick % SavedMovePoolSize].Get();
+			Move->Clear();
+			Move->SetMoveFor(InCharacter, TickInterval, FVector::ZeroVector, *ClientData);
+			Move->PostUpdate(InCharacter, FSavedMove_Character::PostUpdate_Record);
+			if (Tick % CorrectionInterval != CorrectionInterval - 1) continue;
+			FSfTestAccess::bIsReplaying(FormCharacter) = true;
+			for (int32 ReplayedTick = Tick - ReplayedMoves + 1; ReplayedTick <= Tick; ReplayedTick++)
+			{
+				FSavedMove_Sf* ReplayedMove = InSavedMoves[ReplayedTick % SavedMovePoolSize].Get();
+				ReplayedMove->PrepMoveFor(InCharacter);
+				FSfTestAccess::CorrectionConditionFlags(FormCharacter) = Repredict_Sf;
+				FSfTestAccess::UpdateCharacterStateBeforeMovement(FormCharacter, ReplayedMove->DeltaTime);
+				ReplayedMove->PostUpdate(InCharacter, FSavedMove_Character::PostUpdate_Replay);
+			}
+			FSfTestAccess::bIsReplaying(FormCharacter) = false;
+			FSfTestAccess::CorrectionConditionFlags(FormCharacter) = 0;
+		}
+		GMalloc = CountingMalloc.Inner;
+		return CountingMalloc.Allocations;
+	}
+}
+
+bool FSfPredictionTickAllocationTest::RunTest(const FString& Parameters)
+{
+	using namespace SfPredictionTickAllocationTest;
+	const FGameplayTag RegenStatTag = FGameplayTag::RequestGameplayTag(TEXT("Stat.TestHealthRegen"), false);
+	if (!RegenStatTag.IsValid())
+	{
+		AddError(TEXT("Test stat tags are missing from DefaultGameplayTags.ini."));
+		return false;
+	}
+	const FSfTestWorld World;
+	World.Get()->SetGameState(World.SpawnActor<AGameStateBase>());
+	TArray<TSharedPtr<FSavedMove_Sf>> SavedMoves;
+	for (int32 i = 0; i < SavedMovePoolSize; i++)
+	{
+		SavedMoves.Add(MakeShared<FSavedMove_Sf>());
+	}
+
+	for (const bool bIsClient : {true, false})
+	{
+		//A form with a regenerating resource, and inventories of constituents bound to inputs and of cards whose
+		//lifetimes don't end during the run.
+		ASfTestCharacter* Character = World.SpawnActor<ASfTestCharacter>();
+		Character->SetRole(bIsClient ? ROLE_AutonomousProxy : ROLE_Authority);
+		UFormCharacterComponent* FormCharacter = Cast<UFormCharacterComponent>(Character->GetCharacterMovement());
+		UFormCoreComponent* FormCore = NewObject<UFormCoreComponent>(Character);
+		FormCore->FormCharacter = FormCharacter;
+		FSfTestAccess::FormCore(FormCharacter) = FormCore;
+		UFormStatComponent* FormStat = NewObject<UFormStatComponent>(Character);
+		FSfTestAccess::BaseStats(FormStat).Emplace(RegenStatTag, 1);
+		FormStat->SetupFormStat();
+		UFormResourceComponent* FormResource = NewObject<UFormResourceComponent>(Character);
+		FormResource->SetupFormResource(FormCore);
+		FResource& Resource = FSfTestAccess::Resources(FormResource).Items.AddDefaulted_GetRef();
+		Resource.IncreasePerSecondStat = RegenStatTag;
+		Resource.MaxValueOverride = 999999;
+		FSfTestAccess::FormStat(FormCore) = FormStat;
+		FSfTestAccess::FormResource(FormCore) = FormResource;
+		FormCharacter->SecondarySetupFormCharacter();
+		for (int32 i = 0; i < InventoryCount; i++)
+		{
+			UInventory* Inventory = FSfTestAccess::AddInventory(FormCore);
+			USlotable* Slotable = FSfTestAccess::AddSlotable(Inventory);
+			for (int32 j = 0; j < ConstituentsPerInventory; j++)
+			{
+				FSfTestAccess::AddConstituent(Slotable, j + 1)->bEnableInputsAndPrediction = true;
+			}
+			FSfTestAccess::OrderedInputBindingIndices(Inventory) = {static_cast<int8>(i)};
+			FSfTestAccess::OrderedLastInputState(Inventory).Init(false, 1);
+			for (int32 j = 0; j < CardsPerInventory; j++)
+			{
+				FCard& Card = FSfTestAccess::Cards(Inventory).AddDefaulted_GetRef();
+				Card.Class = UCardObject::StaticClass();
+				Card.OwnerConstituentInstanceId = j % ConstituentsPerInventory + 1;
+				Card.bUsingPredictedTimestamp = j % 2 == 1;
+				Card.LifetimeEndTimestamp = Card.bUsingPredictedTimestamp ? 1000 : -1;
+			}
+			FSfTestAccess::MarkCardIndexDirty(Inventory);
+		}
+		FormCore->MarkConstituentTableDirty();
+
+		Run(Character, 0, WarmUpTicks, SavedMoves);
+		const uint32 CardIdentifiersSerial = FSfTestAccess::CardIdentifiersSerial(FormCharacter);
+		const double StartTime = FPlatformTime::Seconds();
+		const int32 Allocations = Run(Character, WarmUpTicks, Ticks, SavedMoves);
+		const double Time = FPlatformTime::Seconds() - StartTime;
+		const TCHAR* Side = bIsClient ? TEXT("client") : TEXT("server");
+		TestEqual(FString::Printf(TEXT("The %s prediction tick doesn't allocate"), Side), Allocations, 0);
+		if (bIsClient)
+		{
+			TestEqual(TEXT("Unchanged inventories aren't repacked"),
+			          FSfTestAccess::CardIdentifiersSerial(FormCharacter), CardIdentifiersSerial);
+		}
+		AddInfo(FString::Printf(TEXT("%d %s ticks: %d allocations, %.2f us per tick."), Ticks, Side, Allocations,
+		                        Time * 1e6 / Ticks));
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,352 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Constituent.h"
+#include "FormCoreComponent.h"
+#include "SfTestAccess.h"
+#include "SfTestWorld.h"
+#include "SfUtility.h"
+#include "GameFramework/GameStateBase.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "Net/UnrealNetwork.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSfRelevancyCatchUpTest, "SfCore.Constituent.RelevancyCatchUp",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+namespace SfRelevancyCatchUpTest
+{
+	//Server time when the simulation starts, so action sets are never at the timestamp of a new constituent.
+	static constexpr double StartTime = 100;
+
+	static constexpr double SimulatedSeconds = 60;
+
+	static constexpr double TickInterval = 1 / 60.0;
+
+	static constexpr double NetUpdateInterval = 0.1;
+
+	//One way latency, with jitter that lets multicasts arrive out of order.
+	static constexpr double Latency = 0.1;
+
+	static constexpr double Jitter = 0.08;
+
+	static constexpr float MulticastDropChance = 0.1f;
+
+	//Chance of each constituent executing in a tick.
+	static constexpr float ActionChance = 0.1f;
+
+	static constexpr int32 ConstituentCount = 3;
+
+	//The client joins while the form is already performing actions.
+	static constexpr double JoinTime = 3;
+
+	enum class EDeliveryType : uint8
+	{
+		//The form becoming relevant.
+		Spawn,
+		Multicast,
+		ReplicatedActionState,
+		//The form going out of relevancy.
+		Destroy
+	};
+
+	struct FDelivery
+	{
+		double ArrivalTime = 0;
+
+		EDeliveryType Type = EDeliveryType::Multicast;
+
+		//Each time the form becomes relevant the client spawns it again.
+		int32 RelevancyPeriod = 0;
+
+		//Constituent of a replicated action state, and whether it was sent with the spawn.
+		int32 ConstituentIndex = INDEX_NONE;
+
+		bool bInitial = false;
+
+		//The batch or replicated action state as it was serialized by the server.
+		TArray<uint8> Data;
+
+		int64 NumBits = 0;
+	};
+
+	template <typename StructType>
+	static void Write(StructType& InStruct, FDelivery& OutDelivery)
+	{
+		FBitWriter Writer(0, true);
+		bool bSuccess = false;
+		InStruct.NetSerialize(Writer, nullptr, bSuccess);
+		OutDelivery.Data = TArray<uint8>(Writer.GetData(), Writer.GetNumBytes());
+		OutDelivery.NumBits = Writer.GetNumBits();
+	}
+
+	template <typename StructType>
+	static StructType Read(const FDelivery& InDelivery)
+	{
+		FBitReader Reader(const_cast<uint8*>(InDelivery.Data.GetData()), InDelivery.NumBits);
+		StructType Struct;
+		bool bSuccess = false;
+		Struct.NetSerialize(Reader, nullptr, bSuccess);
+		return Struct;
+	}
+
+	static UFormCoreComponent* MakeForm(const FSfTestWorld& InWorld, const ENetRole InRole,
+	                                    TArray<UConstituent*>& OutConstituents)
+	{
+		AActor* Actor = InWorld.SpawnActor<AActor>();
+		Actor->SetRole(InRole);
+		UFormCoreComponent* FormCore = NewObject<UFormCoreComponent>(Actor);
+		USlotable* Slotable = FSfTestAccess::AddSlotable(FSfTestAccess::AddInventory(FormCore));
+		for (int32 i = 0; i < ConstituentCount; i++)
+		{
+			OutConstituents.Add(FSfTestAccess::AddConstituent(Slotable, i + 1));
+		}
+		FormCore->MarkConstituentTableDirty();
+		return FormCore;
+	}
+}
+
+bool FSfRelevancyCatchUpTest::RunTest(const FString& Parameters)
+{
+	using namespace SfRelevancyCatchUpTest;
+	const FSfTestWorld World;
+	AGameStateBase* GameState = World.SpawnActor<AGameStateBase>();
+	World.Get()->SetGameState(GameState);
+	TArray<UConstituent*> ServerConstituents;
+	UFormCoreComponent* Server = MakeForm(World, ROLE_Authority, ServerConstituents);
+
+	//The replicated action state only goes to simulated proxies, and is only compared by the replicator after it is
+	//marked dirty, which sending the queued action sets does.
+	TArray<FLifetimeProperty> LifetimeProperties;
+	ServerConstituents[0]->GetLifetimeReplicatedProps(LifetimeProperties);
+	const FProperty* StateProperty = FindFProperty<FProperty>(
+		UConstituent::StaticClass(), GET_MEMBER_NAME_CHECKED(UConstituent, ReplicatedActionState));
+	const FLifetimeProperty* StateLifetimeProperty = LifetimeProperties.FindByPredicate(
+		[StateProperty](const FLifetimeProperty& LifetimeProperty)
+		{
+			return LifetimeProperty.RepIndex == StateProperty->RepIndex;
+		});
+	if (!StateLifetimeProperty)
+	{
+		AddError(TEXT("The replicated action state isn't replicated."));
+		return false;
+	}
+	TestEqual(TEXT("The replicated action state only goes to simulated proxies"),
+	          static_cast<int32>(StateLifetimeProperty->Condition), static_cast<int32>(COND_SimulatedOnly));
+	TestTrue(TEXT("The replicated action state uses the push model"), StateLifetimeProperty->bIsPushBased);
+
+	//Constituents execute on the server and the form sends the queued action sets at the end of each tick, which are
+	//multicast while the client is relevant. Net updates replicate the action states that changed since they were last
+	//sent to the client. Relevancy is toggled every few seconds.
+	FRandomStream Random(25);
+	TArray<FDelivery> Deliveries;
+	TArray<TArray<FSfReplicatedActionState>> ServerActionStates;
+	ServerActionStates.SetNum(ConstituentCount);
+	TArray<FSfReplicatedActionState> SentStates;
+	SentStates.SetNum(ConstituentCount);
+	TArray<TPair<double, double>> RelevantPeriods;
+	bool bRelevant = false;
+	double NextRelevancyToggle = JoinTime;
+	double NextNetUpdate = StartTime;
+	double LastStateArrival = 0;
+	//Sends the action states that changed since they were last sent, in order after the ones sent before.
+	auto ReplicateActionStates = [&](const double InArrivalTime, const bool bInitial)
+	{
+		for (int32 i = 0; i < ConstituentCount; i++)
+		{
+			FSfReplicatedActionState& State = ServerConstituents[i]->ReplicatedActionState;
+			if (State == SentStates[i]) continue;
+			SentStates[i] = State;
+			LastStateArrival = FMath::Max(LastStateArrival, InArrivalTime);
+			FDelivery& Delivery = Deliveries.AddDefaulted_GetRef();
+			Delivery.ArrivalTime = LastStateArrival;
+			Delivery.Type = EDeliveryType::ReplicatedActionState;
+			Delivery.RelevancyPeriod = RelevantPeriods.Num() - 1;
+			Delivery.ConstituentIndex = i;
+			Delivery.bInitial = bInitial;
+			Write(State, Delivery);
+		}
+	};
+	const int32 TickCount = FMath::RoundToInt(SimulatedSeconds / TickInterval);
+	for (int32 Tick = 0; Tick < TickCount; Tick++)
+	{
+		const double Time = StartTime + Tick * TickInterval;
+		World.Get()->TimeSeconds = Time;
+		//The form is relevant for the last seconds so the client can be checked against the final state.
+		const bool bEnding = Time >= StartTime + SimulatedSeconds - 5;
+		const bool bToggleRelevancy = bRelevant ? !bEnding && Time >= StartTime + NextRelevancyToggle
+			                                    : bEnding || Time >= StartTime + NextRelevancyToggle;
+		if (bToggleRelevancy)
+		{
+			bRelevant = !bRelevant;
+			NextRelevancyToggle += bRelevant ? Random.FRandRange(2, 4) : Random.FRandRange(1, 3);
+			if (bRelevant)
+			{
+				RelevantPeriods.Emplace(Time, StartTime + SimulatedSeconds);
+				LastStateArrival = FMath::Max(LastStateArrival, Time + Latency);
+				Deliveries.Add({LastStateArrival, EDeliveryType::Spawn, RelevantPeriods.Num() - 1});
+				//A new channel sends every property that isn't at its default with the spawn.
+				for (FSfReplicatedActionState& SentState : SentStates)
+				{
+					SentState = FSfReplicatedActionState();
+				}
+				ReplicateActionStates(LastStateArrival, true);
+			}
+			else
+			{
+				RelevantPeriods.Last().Value = Time;
+				Deliveries.Add({Time + Latency, EDeliveryType::Destroy, RelevantPeriods.Num() - 1});
+			}
+		}
+
+		for (UConstituent* Constituent : ServerConstituents)
+		{
+			if (Random.FRand() >= ActionChance) continue;
+			FSfTestAccess::LastActionSet(Constituent) = FActionSet(static_cast<float>(Time),
+			                                                       static_cast<uint8>(Random.RandRange(1, 63)));
+			Server->QueueActionSetForClients(Constituent);
+		}
+		//What SendQueuedActionSets multicasts at the end of the tick.
+		FSfActionSetBatch Batch;
+		if (FSfTestAccess::BuildQueuedActionSetBatch(Server, Batch))
+		{
+			for (const FSfBatchedActionSet& BatchedActionSet : Batch.ActionSets)
+			{
+				const int32 Index = BatchedActionSet.InstanceId - 1;
+				ServerActionStates[Index].Add(ServerConstituents[Index]->ReplicatedActionState);
+			}
+			if (bRelevant && Random.FRand() >= MulticastDropChance)
+			{
+				FDelivery& Delivery = Deliveries.AddDefaulted_GetRef();
+				Delivery.ArrivalTime = Time + Latency + Random.FRand() * Jitter;
+				Delivery.RelevancyPeriod = RelevantPeriods.Num() - 1;
+				Write(Batch, Delivery);
+			}
+		}
+
+		//Property updates are sequenced, so they arrive in the order they were sent.
+		if (Time >= NextNetUpdate)
+		{
+			NextNetUpdate += NetUpdateInterval;
+			if (bRelevant)
+			{
+				ReplicateActionStates(Time + Latency + Random.FRand() * Jitter, false);
+			}
+		}
+	}
+	//The last action sets are replicated by a net update after the simulation.
+	ReplicateActionStates(LastStateArrival + NetUpdateInterval, false);
+	Deliveries.StableSort([](const FDelivery& A, const FDelivery& B) { return A.ArrivalTime < B.ArrivalTime; });
+
+	UFormCoreComponent* Client = nullptr;
+	TArray<UConstituent*> ClientConstituents;
+	int32 CurrentPeriod = INDEX_NONE;
+	int32 ActionSets = 0;
+	int32 Performed = 0;
+	int32 StaleMulticasts = 0;
+	int32 OutOfOrderPerforms = 0;
+	int32 UncaughtPeriods = 0;
+	int32 JoinMismatches = 0;
+	int32 UnforwardedStates = 0;
+	TArray<float> LastPerformedTimestamps;
+	for (const TArray<FSfReplicatedActionState>& States : ServerActionStates)
+	{
+		ActionSets += States.Num();
+	}
+	//Counts the action set the client constituent performed, if it did.
+	auto CountPerformed = [&](const int32 InIndex, const float InPreviousTimestamp)
+	{
+		const float Timestamp = FSfTestAccess::LastActionSetTimestamp(ClientConstituents[InIndex]);
+		if (Timestamp == InPreviousTimestamp) return false;
+		Performed++;
+		OutOfOrderPerforms += Timestamp <= LastPerformedTimestamps[InIndex];
+		LastPerformedTimestamps[InIndex] = Timestamp;
+		return true;
+	};
+	for (const FDelivery& Delivery : Deliveries)
+	{
+		World.Get()->TimeSeconds = Delivery.ArrivalTime;
+		if (Delivery.Type == EDeliveryType::Spawn)
+		{
+			ClientConstituents.Reset();
+			Client = MakeForm(World, ROLE_SimulatedProxy, ClientConstituents);
+			LastPerformedTimestamps.Init(0, ConstituentCount);
+			CurrentPeriod = Delivery.RelevancyPeriod;
+			continue;
+		}
+		//The form isn't on the client outside of relevancy, so anything sent to an earlier spawn is dropped.
+		if (Delivery.RelevancyPeriod != CurrentPeriod || !Client) continue;
+		if (Delivery.Type == EDeliveryType::Destroy)
+		{
+			//Every action set sent long enough before relevancy ended has been caught up on.
+			const double CaughtUpTime = RelevantPeriods[CurrentPeriod].Value - Latency - Jitter - NetUpdateInterval;
+			for (int32 i = 0; i < ConstituentCount; i++)
+			{
+				float ExpectedTimestamp = 0;
+				for (const FSfReplicatedActionState& ServerActionState : ServerActionStates[i])
+				{
+					if (ServerActionState.ServerTimestamp > CaughtUpTime) break;
+					ExpectedTimestamp = ServerActionState.ServerTimestamp;
+				}
+				UncaughtPeriods += FSfTestAccess::LastActionSetTimestamp(ClientConstituents[i]) < ExpectedTimestamp;
+			}
+			Client = nullptr;
+			continue;
+		}
+		if (Delivery.Type == EDeliveryType::Multicast)
+		{
+			const FSfActionSetBatch Batch = Read<FSfActionSetBatch>(Delivery);
+			TArray<float> PreviousTimestamps;
+			for (const FSfBatchedActionSet& BatchedActionSet : Batch.ActionSets)
+			{
+				PreviousTimestamps.Add(FSfTestAccess::LastActionSetTimestamp(
+					ClientConstituents[BatchedActionSet.InstanceId - 1]));
+			}
+			FSfTestAccess::NetMulticastClientPerformActionSets_Implementation(Client, Batch);
+			for (int32 i = 0; i < Batch.ActionSets.Num(); i++)
+			{
+				StaleMulticasts += !CountPerformed(Batch.ActionSets[i].InstanceId - 1, PreviousTimestamps[i]);
+			}
+			continue;
+		}
+		//Rep notifies are only called when the replicated value changed.
+		UConstituent* Constituent = ClientConstituents[Delivery.ConstituentIndex];
+		const FSfReplicatedActionState State = Read<FSfReplicatedActionState>(Delivery);
+		if (State == Constituent->ReplicatedActionState) continue;
+		const float PreviousTimestamp = FSfTestAccess::LastActionSetTimestamp(Constituent);
+		Constituent->ReplicatedActionState = State;
+		Constituent->OnRep_ReplicatedActionState();
+		if (Delivery.bInitial && Delivery.RelevancyPeriod == 0)
+		{
+			//The action sets in progress when the client joined are performed with the spawn.
+			JoinMismatches += FSfTestAccess::LastActionSetTimestamp(Constituent) != State.ServerTimestamp
+				|| !(FSfTestAccess::LastActionSet(Constituent) == State.ActionSet);
+		}
+		if (!CountPerformed(Delivery.ConstituentIndex, PreviousTimestamp)) continue;
+		//Action sets caught up on are fast forwarded by at least the latency.
+		UnforwardedStates += CalculateTimeSinceServerTimestamp(
+			World.Get(), FSfTestAccess::LastActionSetTimestamp(Constituent)) < Latency - UE_KINDA_SMALL_NUMBER;
+	}
+
+	AddInfo(FString::Printf(TEXT("%d action sets, %d relevancy periods, %d performed, %d stale multicasts dropped."),
+	                        ActionSets, RelevantPeriods.Num(), Performed, StaleMulticasts));
+	TestTrue(TEXT("Relevancy is toggled a few times"), RelevantPeriods.Num() >= 3);
+	TestTrue(TEXT("Multicasts arrive after newer action sets were performed"), StaleMulticasts > 0);
+	TestEqual(TEXT("Joining in progress performs the last action sets"), JoinMismatches, 0);
+	TestEqual(TEXT("Replicated action states are fast forwarded by at least the latency"), UnforwardedStates, 0);
+	TestEqual(TEXT("Action sets are never performed twice or out of order"), OutOfOrderPerforms, 0);
+	TestEqual(TEXT("Clients catch up on the last action sets while relevant"), UncaughtPeriods, 0);
+	TestNotNull(TEXT("The client is relevant at the end"), Client);
+	for (int32 i = 0; Client && i < ConstituentCount; i++)
+	{
+		const FSfReplicatedActionState& ServerState = ServerConstituents[i]->ReplicatedActionState;
+		TestTrue(FString::Printf(TEXT("Constituent %d ends on the last action set of the server"), i),
+		         FSfTestAccess::LastActionSet(ClientConstituents[i]) == ServerState.ActionSet
+		         && FSfTestAccess::LastActionSetTimestamp(ClientConstituents[i]) == ServerState.ServerTimestamp);
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,129 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CardObject.h"
+#include "SfTestAccess.h"
+#include "SfTestWorld.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSfReplayConvergenceTest, "SfCore.FormCharacter.ReplayConvergence",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+namespace SfReplayConvergenceTest
+{
+	static constexpr int32 InventoryCount = 2;
+
+	static constexpr int32 ConstituentsPerInventory = 2;
+
+	//Input bits of the second inventory, which are held in the latest move but not in the move it converges on.
+	static constexpr uint64 HeldInputBits = 0b10;
+}
+
+bool FSfReplayConvergenceTest::RunTest(const FString& Parameters)
+{
+	using namespace SfReplayConvergenceTest;
+	const FSfTestWorld World;
+	AActor* Actor = World.SpawnActor<AActor>();
+	UFormCoreComponent* FormCore = FSfTestAccess::CreateForm(Actor);
+	UFormCharacterComponent* FormCharacter = FormCore->FormCharacter;
+	//Created directly as the prediction data otherwise needs a pawn to move.
+	FNetworkPredictionData_Client_Sf* ClientData = new FNetworkPredictionData_Client_Sf(*FormCharacter);
+	FSfTestAccess::ClientPredictionData(FormCharacter) = ClientData;
+	for (int32 i = 0; i < InventoryCount; i++)
+	{
+		USlotable* Slotable = FSfTestAccess::AddSlotable(FSfTestAccess::AddInventory(FormCore));
+		for (int32 j = 0; j < ConstituentsPerInventory; j++)
+		{
+			FSfTestAccess::AddConstituent(Slotable, j + 1);
+		}
+	}
+	FormCore->MarkConstituentTableDirty();
+	const TArray<UConstituent*>& Constituents = FormCore->GetOrderedConstituents();
+	UInventory* Inventory = FSfTestAccess::Inventories(FormCore)[1];
+
+	//The state that was predicted before the correction, which a full replay would reproduce once the second
+	//inventory has converged.
+	FCard& Card = FSfTestAccess::Cards(Inventory).AddDefaulted_GetRef();
+	Card.Class = UCardObject::StaticClass();
+	Card.OwnerConstituentInstanceId = 1;
+	FSfTestAccess::MarkCardIndexDirty(Inventory);
+	const FActionSet ActionSet(0, 2);
+	FUint16_Quantize100 LatestTimeSinceLastAction;
+	LatestTimeSinceLastAction.SetFloat(1.5f);
+	for (UConstituent* Constituent : Constituents)
+	{
+		Constituent->PredictedLastActionSet = ActionSet;
+		Constituent->TimeSincePredictedLastActionSet = LatestTimeSinceLastAction;
+	}
+	FSfTestAccess::LastInputBits(Inventory) = HeldInputBits;
+	TArray<FInventoryCards> LatestCards;
+	for (UInventory* EachInventory : FSfTestAccess::Inventories(FormCore))
+	{
+		LatestCards.Emplace(FSfTestAccess::Cards(EachInventory));
+	}
+	FSfTestAccess::PendingActionSetInventoryStarts(FormCharacter) = FormCore->GetOrderedConstituentInventoryStarts();
+	for (const UConstituent* Constituent : Constituents)
+	{
+		FSfTestAccess::PendingActionSets(FormCharacter).Emplace(Constituent->InstanceId,
+		                                                        Constituent->PredictedLastActionSet);
+	}
+	TSharedPtr<FSavedMove_Sf> LatestMove = MakeShared<FSavedMove_Sf>();
+	LatestMove->Cards = MakeShared<TArray<FInventoryCards>>(LatestCards);
+	LatestMove->PendingActionSets = FSfTestAccess::PendingActionSets(FormCharacter);
+	ClientData->PendingMove = LatestMove;
+	FSfTestAccess::ClientSnapshotPredictedState(FormCharacter);
+
+	//The second inventory is re-simulated up to an earlier move whose recorded state it matches, but the time since
+	//the last action and the input bits aren't recorded and are still those of the earlier move.
+	FUint16_Quantize100 EarlierTimeSinceLastAction;
+	EarlierTimeSinceLastAction.SetFloat(0.5f);
+	for (int32 i = ConstituentsPerInventory; i < Constituents.Num(); i++)
+	{
+		Constituents[i]->TimeSincePredictedLastActionSet = EarlierTimeSinceLastAction;
+	}
+	FSfTestAccess::LastInputBits(Inventory) = 0;
+	FSfTestAccess::ClientTimesSinceLastAction(FormCharacter).SetNum(Constituents.Num());
+	FSavedMove_Sf ConvergedMove;
+	ConvergedMove.Cards = LatestMove->Cards;
+	ConvergedMove.PendingActionSets = FSfTestAccess::PendingActionSets(FormCharacter);
+	ConvergedMove.TimesSinceLastAction = FSfTestAccess::ClientTimesSinceLastAction(FormCharacter);
+	FSfTestAccess::bIsReplaying(FormCharacter) = true;
+	FSfTestAccess::bScopedReplay(FormCharacter) = true;
+	FSfTestAccess::ScopedReplayInventories(FormCharacter).Init(false, InventoryCount);
+	FSfTestAccess::ScopedReplayInventories(FormCharacter)[1] = true;
+	TestTrue(TEXT("An inventory matching the recorded move has converged"),
+	         ConvergedMove.HasInventoryConverged(FormCharacter, 1));
+
+	//Buffered inputs aren't recorded, so they stop an inventory from converging.
+	TSet<FBufferedInput>& BufferedInputs = FSfTestAccess::BufferedInputs(Constituents[ConstituentsPerInventory]);
+	BufferedInputs.Add(FBufferedInput({UCardObject::StaticClass()}, {}, {}, {}, 1000, FBufferedInputDelegate()));
+	TestFalse(TEXT("An inventory with buffered inputs doesn't converge"),
+	          ConvergedMove.HasInventoryConverged(FormCharacter, 1));
+	BufferedInputs.Empty();
+	FSfTestAccess::ClientPredictedBufferedInputInventories(FormCharacter)[1] = true;
+	TestFalse(TEXT("An inventory that had buffered inputs when corrected doesn't converge"),
+	          ConvergedMove.HasInventoryConverged(FormCharacter, 1));
+	FSfTestAccess::ClientPredictedBufferedInputInventories(FormCharacter)[1] = false;
+
+	//Resuming the predicted state gives the same state as re-simulating every remaining move.
+	FSfTestAccess::ClientResumePredictedInventory(FormCharacter, 1);
+	TestFalse(TEXT("A resumed inventory is no longer re-simulated"), FormCharacter->ShouldSimulateInventory(1));
+	TestTrue(TEXT("Resumed cards equal a full replay"), FSfTestAccess::Cards(Inventory) == LatestCards[1].Cards);
+	TestEqual(TEXT("Resumed input bits equal a full replay"), FSfTestAccess::LastInputBits(Inventory), HeldInputBits);
+	for (int32 i = ConstituentsPerInventory; i < Constituents.Num(); i++)
+	{
+		TestTrue(TEXT("Resumed action sets equal a full replay"),
+		         Constituents[i]->PredictedLastActionSet == ActionSet);
+		TestTrue(TEXT("Resumed times since the last action equal a full replay"),
+		         Constituents[i]->TimeSincePredictedLastActionSet == LatestTimeSinceLastAction);
+	}
+	FSfTestAccess::bIsReplaying(FormCharacter) = false;
+	FSfTestAccess::bScopedReplay(FormCharacter) = false;
+	TestFalse(TEXT("Stopping replays on convergence is off by default"),
+	          GetDefault<UFormCharacterComponent>()->bStopReplayOnConvergence);
+	return true;
+}
+
+#endif
@@ -0,0 +1,112 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CardObject.h"
+#include "SfTestAccess.h"
+#include "SfTestWorld.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSfScopedReplayTest, "SfCore.FormCharacter.ScopedReplay",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+namespace SfScopedReplayTest
+{
+	static constexpr int32 InventoryCount = 10;
+
+	static constexpr int32 ConstituentsPerInventory = 5;
+
+	//A correction at 120 moves per second with 250 ms of round trip time.
+	static constexpr int32 ReplayedMoves = 30;
+
+	static constexpr int32 Corrections = 200;
+}
+
+bool FSfScopedReplayTest::RunTest(const FString& Parameters)
+{
+	using namespace SfScopedReplayTest;
+	const FSfTestWorld World;
+	AActor* Actor = World.SpawnActor<AActor>();
+	UFormCoreComponent* FormCore = FSfTestAccess::CreateForm(Actor);
+	UFormCharacterComponent* FormCharacter = FormCore->FormCharacter;
+
+	//Buffered inputs wait on a card that never arrives, so every replayed move checks them like a held input would.
+	UClass* BlockingCardClass = NewObject<UClass>(GetTransientPackage(), NAME_None, RF_Transient);
+	BlockingCardClass->SetSuperStruct(UCardObject::StaticClass());
+	BlockingCardClass->AddToRoot();
+	for (int32 i = 0; i < InventoryCount; i++)
+	{
+		USlotable* Slotable = FSfTestAccess::AddSlotable(FSfTestAccess::AddInventory(FormCore));
+		for (int32 j = 0; j < ConstituentsPerInventory; j++)
+		{
+			UConstituent* Constituent = FSfTestAccess::AddConstituent(Slotable, j + 1);
+			FSfTestAccess::BufferedInputs(Constituent).Add(FBufferedInput({BlockingCardClass}, {}, {}, {}, 1000,
+			                                                               FBufferedInputDelegate()));
+		}
+	}
+	FormCore->MarkConstituentTableDirty();
+
+	//The correction disagrees with every constituent so it is visible which ones were rolled back.
+	const FActionSet CorrectedActionSet(0, 1);
+	FSfTestAccess::ActionSetResponses(FormCharacter).Init(CorrectedActionSet,
+	                                                      InventoryCount * ConstituentsPerInventory);
+	FSfTestAccess::TimesSinceLastAction(FormCharacter).SetNum(InventoryCount * ConstituentsPerInventory);
+	FSfTestAccess::CardResponse(FormCharacter).SetNum(InventoryCount);
+
+	//Only the first inventory diverged in the scoped correction.
+	FSfTestAccess::bIsReplaying(FormCharacter) = true;
+	FSfTestAccess::ScopedReplayInventories(FormCharacter).Init(false, InventoryCount);
+	FSfTestAccess::ScopedReplayInventories(FormCharacter)[0] = true;
+	double Times[2];
+	for (const bool bScoped : {false, true})
+	{
+		FSfTestAccess::bScopedReplay(FormCharacter) = bScoped;
+		for (UConstituent* Constituent : FormCore->ConstituentRegistry)
+		{
+			Constituent->PredictedLastActionSet = FActionSet();
+		}
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Correction = 0; Correction < Corrections; Correction++)
+		{
+			FSfTestAccess::CorrectActionSets(FormCharacter);
+			FSfTestAccess::CorrectCards(FormCharacter);
+			for (int32 Move = 0; Move < ReplayedMoves; Move++)
+			{
+				FSfTestAccess::RemovePredictedCardWithEndedLifetimes(FormCharacter);
+			}
+		}
+		Times[bScoped] = FPlatformTime::Seconds() - StartTime;
+
+		int32 RolledBack = 0;
+		for (const UConstituent* Constituent : FormCore->ConstituentRegistry)
+		{
+			RolledBack += Constituent->PredictedLastActionSet == CorrectedActionSet;
+		}
+		TestEqual(bScoped ? TEXT("Scoped replay only rolls back the diverged inventory")
+		                  : TEXT("Full replay rolls back every inventory"), RolledBack,
+		          bScoped ? ConstituentsPerInventory : InventoryCount * ConstituentsPerInventory);
+	}
+	AddInfo(FString::Printf(
+		TEXT("%d inventories, %d constituents, %d replayed moves: %.1f us per full correction, %.1f us per scoped one."),
+		InventoryCount, InventoryCount * ConstituentsPerInventory, ReplayedMoves, Times[0] * 1e6 / Corrections,
+		Times[1] * 1e6 / Corrections));
+
+	//Predicted changes made while replaying only some inventories are checked by the server.
+	FSfTestAccess::bScopedReplay(FormCharacter) = true;
+	FSfTestAccess::bClientForceSerialize(FormCharacter) = false;
+	FormCharacter->RecordPredictedChange();
+	TestTrue(TEXT("Predicted changes during a scoped replay are recorded"),
+	         FSfTestAccess::bMadePredictedChanges(FormCharacter));
+	TestTrue(TEXT("Predicted changes during a scoped replay send the full state"),
+	         FSfTestAccess::bClientForceSerialize(FormCharacter));
+	FSfTestAccess::bIsReplaying(FormCharacter) = false;
+	FSfTestAccess::bScopedReplay(FormCharacter) = false;
+	TestFalse(TEXT("Scoped reconciliation is off by default"),
+	          GetDefault<UFormCharacterComponent>()->bScopedReconciliation);
+
+	BlockingCardClass->RemoveFromRoot();
+	return true;
+}
+
+#endif
@@ -0,0 +1,184 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Constituent.h"
+#include "FormCharacterComponent.h"
+#include "FormCoreComponent.h"
+#include "FormResourceComponent.h"
+#include "FormStatComponent.h"
+#include "Inventory.h"
+#include "SfClassIndexManifest.h"
+#include "Slotable.h"
+
+//Gives tests a reference to a non-public member. Overloaded on the class, so members of different classes can have
+//the same name.
+#define SF_TEST_MEMBER(ClassType, Member) \
+	static auto& Member(ClassType* In) { return In->Member; }
+
+//Lets tests call a non-public function.
+#define SF_TEST_FUNCTION(ClassType, Function) \
+	template <typename... ArgTypes> \
+	static decltype(auto) Function(ClassType* In, ArgTypes&&... InArgs) \
+	{ \
+		return In->Function(Forward<ArgTypes>(InArgs)...); \
+	}
+
+//The only friend that production classes give to tests. Tests go through this instead of each being befriended, and
+//it builds the form hierarchy that tests would otherwise build through replication.
+struct FSfTestAccess
+{
+	SF_TEST_MEMBER(UFormCoreComponent, Inventories)
+	SF_TEST_MEMBER(UFormCoreComponent, FormStat)
+	SF_TEST_MEMBER(UFormCoreComponent, FormResource)
+	SF_TEST_MEMBER(UFormCoreComponent, LagCompensationSlot)
+	SF_TEST_MEMBER(UFormCoreComponent, ConstituentsPendingClientExecution)
+	SF_TEST_FUNCTION(UFormCoreComponent, BuildQueuedActionSetBatch)
+	SF_TEST_FUNCTION(UFormCoreComponent, SendQueuedActionSets)
+	SF_TEST_FUNCTION(UFormCoreComponent, NetMulticastClientPerformActionSets_Implementation)
+
+	SF_TEST_MEMBER(UFormCharacterComponent, FormCore)
+	SF_TEST_MEMBER(UFormCharacterComponent, ClientPredictionData)
+	SF_TEST_MEMBER(UFormCharacterComponent, InputActionRegistry)
+	SF_TEST_MEMBER(UFormCharacterComponent, InputBits)
+	SF_TEST_MEMBER(UFormCharacterComponent, InputBitsSerial)
+	SF_TEST_MEMBER(UFormCharacterComponent, InputBitsBaseline)
+	SF_TEST_MEMBER(UFormCharacterComponent, InputBitsBaselineSerial)
+	SF_TEST_MEMBER(UFormCharacterComponent, bHasInputBitsBaseline)
+	SF_TEST_MEMBER(UFormCharacterComponent, ServerLastProcessedInputBitsStateId)
+	SF_TEST_MEMBER(UFormCharacterComponent, PendingActionSets)
+	SF_TEST_MEMBER(UFormCharacterComponent, PendingActionSetInventoryStarts)
+	SF_TEST_MEMBER(UFormCharacterComponent, ActionSetResponses)
+	SF_TEST_MEMBER(UFormCharacterComponent, TimesSinceLastAction)
+	SF_TEST_MEMBER(UFormCharacterComponent, ClientTimesSinceLastAction)
+	SF_TEST_MEMBER(UFormCharacterComponent, CardResponse)
+	SF_TEST_MEMBER(UFormCharacterComponent, ClientPredictedBufferedInputInventories)
+	SF_TEST_MEMBER(UFormCharacterComponent, ScopedReplayInventories)
+	SF_TEST_MEMBER(UFormCharacterComponent, bIsReplaying)
+	SF_TEST_MEMBER(UFormCharacterComponent, bScopedReplay)
+	SF_TEST_MEMBER(UFormCharacterComponent, bMadePredictedChanges)
+	SF_TEST_MEMBER(UFormCharacterComponent, bClientForceSerialize)
+	SF_TEST_MEMBER(UFormCharacterComponent, CardStateDigestBaselineSerial)
+	SF_TEST_MEMBER(UFormCharacterComponent, bHasCardStateDigestBaseline)
+	SF_TEST_MEMBER(UFormCharacterComponent, ServerLastProcessedCardStateDigest)
+	SF_TEST_MEMBER(UFormCharacterComponent, PredictedNetClockTicks)
+	SF_TEST_MEMBER(UFormCharacterComponent, BufferedServerMoves)
+	SF_TEST_MEMBER(UFormCharacterComponent, ClientMoveWaitTimeBeforeForcingServerSimulation)
+	SF_TEST_MEMBER(UFormCharacterComponent, FormResource)
+	SF_TEST_MEMBER(UFormCharacterComponent, CorrectionConditionFlags)
+	SF_TEST_MEMBER(UFormCharacterComponent, ResourcesResponse)
+	SF_TEST_MEMBER(UFormCharacterComponent, CardResponseDirtyMask)
+	SF_TEST_MEMBER(UFormCharacterComponent, ResourcesResponseDirtyMask)
+	SF_TEST_MEMBER(UFormCharacterComponent, ActionSetResponseDirtyMask)
+	SF_TEST_MEMBER(UFormCharacterComponent, CardIdentifiersSerial)
+	SF_TEST_MEMBER(UFormCharacterComponent, ServerWorldTimeOnClient)
+	SF_TEST_FUNCTION(UFormCharacterComponent, SetInputBit)
+	SF_TEST_FUNCTION(UFormCharacterComponent, GetServerInputBitsState)
+	SF_TEST_FUNCTION(UFormCharacterComponent, CorrectActionSets)
+	SF_TEST_FUNCTION(UFormCharacterComponent, CorrectCards)
+	SF_TEST_FUNCTION(UFormCharacterComponent, RemovePredictedCardWithEndedLifetimes)
+	SF_TEST_FUNCTION(UFormCharacterComponent, ClientSnapshotPredictedState)
+	SF_TEST_FUNCTION(UFormCharacterComponent, ClientResumePredictedInventory)
+	SF_TEST_FUNCTION(UFormCharacterComponent, HandleCardStateDigestAndSetCorrectionFlags)
+	SF_TEST_FUNCTION(UFormCharacterComponent, ApplyInputBits)
+	SF_TEST_FUNCTION(UFormCharacterComponent, ServerMovePacked_ServerReceive)
+	SF_TEST_FUNCTION(UFormCharacterComponent, ServerReleaseBufferedMoves)
+	SF_TEST_FUNCTION(UFormCharacterComponent, SimulateSfTime)
+	SF_TEST_FUNCTION(UFormCharacterComponent, MarkResponseDirty)
+	SF_TEST_FUNCTION(UFormCharacterComponent, UpdateCharacterStateBeforeMovement)
+	//Bitfields can't be referenced, so they are read by value.
+	static bool bClientActionsWereUpdated(const UFormCharacterComponent* In) { return In->bClientActionsWereUpdated; }
+	static bool bClientCardsWereUpdated(const UFormCharacterComponent* In) { return In->bClientCardsWereUpdated; }
+	static bool bClientResourcesWereUpdated(const UFormCharacterComponent* In)
+	{
+		return In->bClientResourcesWereUpdated;
+	}
+	static constexpr uint32 InputBitsStateIdCount = UFormCharacterComponent::InputBitsStateIdCount;
+	static constexpr int32 MaxInputActions = UFormCharacterComponent::MaxInputActions;
+	static constexpr float NetClockAcceptableTolerance = UFormCharacterComponent::NetClockAcceptableTolerance;
+
+	SF_TEST_MEMBER(UInventory, Slotables)
+	SF_TEST_MEMBER(UInventory, Cards)
+	SF_TEST_MEMBER(UInventory, LastInputBits)
+	SF_TEST_MEMBER(UInventory, OrderedInputBindingIndices)
+	SF_TEST_MEMBER(UInventory, OrderedLastInputState)
+	SF_TEST_FUNCTION(UInventory, MarkCardIndexDirty)
+	SF_TEST_FUNCTION(UInventory, IndexLastCard)
+	SF_TEST_FUNCTION(UInventory, RemoveCardAt)
+	SF_TEST_FUNCTION(UInventory, RemoveCardsAt)
+	SF_TEST_FUNCTION(UInventory, RebuildCardIndex)
+	SF_TEST_FUNCTION(UInventory, FindCardIndex)
+	SF_TEST_FUNCTION(UInventory, MarkCardExpiryQueuesDirty)
+
+	SF_TEST_MEMBER(USlotable, Constituents)
+
+	SF_TEST_MEMBER(UConstituent, FormCore)
+	SF_TEST_MEMBER(UConstituent, BufferedInputs)
+	SF_TEST_MEMBER(UConstituent, LastActionSet)
+	SF_TEST_MEMBER(UConstituent, LastActionSetTimestamp)
+
+	SF_TEST_MEMBER(UFormResourceComponent, Resources)
+
+	SF_TEST_MEMBER(UFormStatComponent, BaseStats)
+	SF_TEST_MEMBER(UFormStatComponent, bClampModifierTotals)
+
+	//Param quantization rules loaded from the manifest, which tests can add to. Param serializer plans are only
+	//compiled with the changes once they are cleared.
+	static TMap<TPair<FTopLevelAssetPath, FName>, FSfParamQuantizationRule>& ParamQuantizationRulesByProperty()
+	{
+		if (!USfClassIndexManifest::bInitialized)
+		{
+			USfClassIndexManifest::Initialize();
+		}
+		return USfClassIndexManifest::ParamQuantizationRulesByProperty;
+	}
+
+	//Creates a form core and a form character on the actor that reference each other.
+	static UFormCoreComponent* CreateForm(AActor* InActor)
+	{
+		UFormCoreComponent* FormCore = NewObject<UFormCoreComponent>(InActor);
+		UFormCharacterComponent* FormCharacter = NewObject<UFormCharacterComponent>(InActor);
+		FormCore->FormCharacter = FormCharacter;
+		FormCharacter->FormCore = FormCore;
+		return FormCore;
+	}
+
+	static UInventory* AddInventory(UFormCoreComponent* InFormCore)
+	{
+		UInventory* Inventory = NewObject<UInventory>(InFormCore->GetOwner());
+		Inventory->OwningFormCore = InFormCore;
+		InFormCore->Inventories.Add(Inventory);
+		return Inventory;
+	}
+
+	static USlotable* AddSlotable(UInventory* InInventory)
+	{
+		USlotable* Slotable = NewObject<USlotable>(InInventory->GetOuter());
+		Slotable->OwningInventory = InInventory;
+		InInventory->Slotables.Add(Slotable);
+		return Slotable;
+	}
+
+	//The constituent table of the form must be marked dirty after constituents are added.
+	static UConstituent* AddConstituent(USlotable* InSlotable, const uint8 InInstanceId,
+	                                    const TSubclassOf<UConstituent> InClass = UConstituent::StaticClass())
+	{
+		UFormCoreComponent* FormCore = InSlotable->OwningInventory->OwningFormCore;
+		UConstituent* Constituent = NewObject<UConstituent>(InSlotable->GetOuter(), InClass);
+		Constituent->InstanceId = InInstanceId;
+		Constituent->OwningSlotable = InSlotable;
+		Constituent->FormCore = FormCore;
+		InSlotable->Constituents.Add(Constituent);
+		FormCore->ConstituentRegistry.Add(Constituent);
+		return Constituent;
+	}
+};
+
+#undef SF_TEST_MEMBER
+#undef SF_TEST_FUNCTION
+
+#endif
@@ -0,0 +1,22 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FormCharacterComponent.h"
+#include "GameFramework/Character.h"
+#include "SfTestCharacter.generated.h"
+
+//Character that moves with a form character component, for tests that need the saved moves of a character. Reflected
+//classes can't be compiled out, so this is built with the module but only used by tests.
+UCLASS(Transient, HideDropdown, NotBlueprintable)
+class ASfTestCharacter : public ACharacter
+{
+	GENERATED_BODY()
+
+public:
+	explicit ASfTestCharacter(const FObjectInitializer& ObjectInitializer)
+		: Super(ObjectInitializer.SetDefaultSubobjectClass<UFormCharacterComponent>(CharacterMovementComponentName))
+	{
+	}
+};
@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Constituent.h"
+#include "SfTestInputConstituent.generated.h"
+
+//Records the input events dispatched to it, which are otherwise only implemented in blueprints. Reflected classes
+//can't be compiled out, so this is built with the module but only used by tests.
+UCLASS(Transient, HideDropdown, NotBlueprintable)
+class USfTestInputConstituent : public UConstituent
+{
+	GENERATED_BODY()
+
+public:
+	//Input events of every test constituent in the order they were dispatched, with true for input down.
+	static inline TArray<TPair<const USfTestInputConstituent*, bool>> Events;
+
+	virtual void ProcessEvent(UFunction* Function, void* Parms) override
+	{
+		if (Function->GetFName() == GET_FUNCTION_NAME_CHECKED(UConstituent, OnInputDown))
+		{
+			Events.Emplace(this, true);
+		}
+		else if (Function->GetFName() == GET_FUNCTION_NAME_CHECKED(UConstituent, OnInputUp))
+		{
+			Events.Emplace(this, false);
+		}
+		Super::ProcessEvent(Function, Parms);
+	}
+};
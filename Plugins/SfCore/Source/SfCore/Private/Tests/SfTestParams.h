@@ -0,0 +1,114 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FormStatComponent.h"
+#include "SfTestParams.generated.h"
+
+//Param structs with every property type that action params can have. Reflected types can't be compiled out, so these
+//are built with the module but only used by tests. They have no quantization metadata so that they don't add rules to
+//the manifest, and tests add the rules themselves.
+
+UENUM()
+enum class ESfTestParamEnum : uint8
+{
+	Zero,
+	One,
+	Five = 5
+};
+
+UENUM()
+enum class ESfTestSignedParamEnum : int8
+{
+	Negative = -3,
+	Zero = 0,
+	Positive = 4
+};
+
+USTRUCT()
+struct FSfTestNestedParams
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	int32 Count = 0;
+
+	UPROPERTY()
+	float Scale = 0;
+
+	UPROPERTY()
+	FString Label;
+};
+
+USTRUCT()
+struct FSfTestParams
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	bool bFlag = false;
+
+	UPROPERTY()
+	uint8 Byte = 0;
+
+	UPROPERTY()
+	int16 Short = 0;
+
+	UPROPERTY()
+	int32 SmallSigned = 0;
+
+	UPROPERTY()
+	uint32 SmallUnsigned = 0;
+
+	UPROPERTY()
+	int32 Signed = 0;
+
+	UPROPERTY()
+	int64 Large = 0;
+
+	UPROPERTY()
+	uint32 Unsigned = 0;
+
+	UPROPERTY()
+	int32 Ranged = 0;
+
+	UPROPERTY()
+	float Value = 0;
+
+	UPROPERTY()
+	float Fraction = 0;
+
+	UPROPERTY()
+	float Angle = 0;
+
+	UPROPERTY()
+	ESfTestParamEnum Enum = ESfTestParamEnum::Zero;
+
+	UPROPERTY()
+	ESfTestSignedParamEnum SignedEnum = ESfTestSignedParamEnum::Zero;
+
+	UPROPERTY()
+	TEnumAsByte<EStatModifierType> ByteEnum = Additive;
+
+	UPROPERTY()
+	FName Name;
+
+	UPROPERTY()
+	FString String;
+
+	UPROPERTY()
+	FText Text;
+
+	UPROPERTY()
+	int32 StaticArray[3] = {};
+
+	UPROPERTY()
+	TArray<int32> Array;
+
+	UPROPERTY()
+	FSfTestNestedParams Nested;
+
+	UPROPERTY()
+	TArray<FSfTestNestedParams> NestedArray;
+};
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "FormCoreComponent.h"
+#include "SfClassIndexManifest.h"
 #include "Card.generated.h"
 
 class UFormCharacterComponent;
@@ -37,6 +38,9 @@ struct SFCORE_API FCard
 
 	//For serialization only.
 	uint16 ClassIndex;
+
+	//Index of classes that are not in the SfClassIndexManifest. Cards with this index can't be added or received.
+	static constexpr uint16 InvalidClassIndex = MAX_uint16;
 	
 	uint8 OwnerConstituentInstanceId;
 	
@@ -67,6 +71,9 @@ struct SFCORE_API FCard
 
 	struct FNetCardIdentifier GetNetCardIdentifier() const;
 
+	//Logs an error and returns false if the class is not in the SfClassIndexManifest.
+	static bool IsClassIndexed(const TSubclassOf<UCardObject>& InCardClass);
+
 	bool operator==(const FCard& Other) const;
 
 	friend FArchive& operator<<(FArchive& Ar, FCard& Card)
@@ -87,7 +94,7 @@ struct SFCORE_API FCard
 		}
 		if (Ar.IsLoading())
 		{
-			Card.Class = UFormCoreComponent::GetAllCardObjectClassesSortedByName()[Card.ClassIndex];
+			Card.Class = USfClassIndexManifest::GetCardObjectClassIndex().GetClass(Card.ClassIndex);
 		}
 		Ar << Card.OwnerConstituentInstanceId;
 		Ar.SerializeBits(&Card.bIsDisabledForDestroy, 1);
@@ -14,6 +14,9 @@ class USfQuery;
 class UFormCoreComponent;
 class UFormCharacterComponent;
 
+//Params of an action set that fit in this many bytes are stored inline, so copying the set doesn't allocate.
+static constexpr int32 SfActionSetInlineParamBytes = 32;
+
 //Set of maximum four action identifiers that are compressed on serialization if possible.
 USTRUCT()
 struct SFCORE_API FActionSet
@@ -24,23 +27,25 @@ struct SFCORE_API FActionSet
 
 	uint8 ActionZero; //Serialized to 6 bits.
 
-	TBitArray<> ActionZeroParams;
-
 	uint8 ActionOne; //Serialized to 6 bits.
 
-	TBitArray<> ActionOneParams;
-
 	uint8 ActionTwo; //Serialized to 6 bits.
 
-	TBitArray<> ActionTwoParams;
-
 	uint8 ActionThree; //Serialized to 6 bits.
 
-	TBitArray<> ActionThreeParams;
+	//Number of param bits of each action.
+	uint16 ParamNumBits[4];
+
+	//Params of each action one after another, each starting on a byte.
+	TArray<uint8, TInlineAllocator<SfActionSetInlineParamBytes>> ParamBytes;
 	
 	//Used for checking whether actions were performed in the same frame.
 	float WorldTime;
 
+	//The actions packed into 26 bits. This is what equality is checked with, so it never collides.
+	//Must be updated with UpdateHash if actions are changed directly.
+	uint32 Hash;
+
 	//Do not use default constructor.
 	FActionSet();
 
@@ -48,7 +53,8 @@ struct SFCORE_API FActionSet
 	           const uint8 InActionTwo = 0,
 	           const uint8 InActionThree = 0);
 
-	FActionSet(const float InCurrentWorldTime, const uint8 InActionZero, const FBitWriter& InActionZeroParams = FBitWriter(),
+	//Action zero's params have no default so that a set of only action zero uses the constructor above.
+	FActionSet(const float InCurrentWorldTime, const uint8 InActionZero, const FBitWriter& InActionZeroParams,
 	           const uint8 InActionOne = 0, const FBitWriter& InActionOneParams = FBitWriter(),
 	           const uint8 InActionTwo = 0, const FBitWriter& InActionTwoParams = FBitWriter(),
 	           const uint8 InActionThree = 0, const FBitWriter& InActionThreeParams = FBitWriter());
@@ -59,49 +65,30 @@ struct SFCORE_API FActionSet
 	bool operator==(const FActionSet& Other) const;
 
 	bool operator!=(const FActionSet& Other) const;
+
+	uint8 GetAction(const int32 InIndex) const;
+
+	TBitArray<> GetParams(const int32 InIndex) const;
 	
 	TMap<uint8, TBitArray<>> ToMap() const;
 
+	void UpdateHash();
+
 	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
 	
 	friend FArchive& operator<<(FArchive& Ar, FActionSet& Set)
 	{
-		Ar.SerializeBits(&Set.NumActionsMinusOne, 2);
-
-		bool bSendParams = Set.ActionZeroParams.Num() > 0 ||
-				Set.ActionOneParams.Num() > 0 ||
-				Set.ActionTwoParams.Num() > 0 ||
-				Set.ActionThreeParams.Num() > 0;
-
-		Ar.SerializeBits(&bSendParams, 1);
-
-		//Default action.
-		Ar.SerializeBits(&Set.ActionZero, 6);
-		if (bSendParams) Ar << Set.ActionZeroParams;
-		if (bSendParams) Ar << Set.ActionZeroParams;
+		Set.Serialize(Ar);
+		return Ar;
+	}
 
-		//First overflow action.
-		if (Set.NumActionsMinusOne > 0)
-		{
-			Ar.SerializeBits(&Set.ActionOne, 6);
-			if (bSendParams) Ar << Set.ActionOneParams;
-		}
+private:
+	int32 GetParamByteOffset(const int32 InIndex) const;
 
-		//Second overflow action.
-		if (Set.NumActionsMinusOne > 1)
-		{
-			Ar.SerializeBits(&Set.ActionTwo, 6);
-			if (bSendParams) Ar << Set.ActionTwoParams;
-		}
+	//Params must be appended in the order of the actions.
+	void AppendParams(const int32 InIndex, const uint8* InData, const int64 InNumBits);
 
-		//Third overflow action.
-		if (Set.NumActionsMinusOne > 2)
-		{
-			Ar.SerializeBits(&Set.ActionThree, 6);
-			if (bSendParams) Ar << Set.ActionThreeParams;
-		}
-		return Ar;
-	}
+	void Serialize(FArchive& Ar);
 };
 
 template<>
@@ -115,6 +102,32 @@ struct TStructOpsTypeTraits<FActionSet> : public TStructOpsTypeTraitsBase2<FActi
 	};
 };
 
+//The last action set of a constituent and the server time it was sent at. Replicated to simulated proxies so clients
+//that become relevant can catch up on effects that are still in progress.
+USTRUCT()
+struct SFCORE_API FSfReplicatedActionState
+{
+	GENERATED_BODY()
+
+	FActionSet ActionSet;
+
+	float ServerTimestamp = 0;
+
+	bool operator==(const FSfReplicatedActionState& Other) const;
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FSfReplicatedActionState> : public TStructOpsTypeTraitsBase2<FSfReplicatedActionState>
+{
+	enum
+	{
+		WithNetSerializer = true,
+		WithIdenticalViaEquality = true
+	};
+};
+
 DECLARE_DYNAMIC_DELEGATE(FBufferedInputDelegate);
 
 USTRUCT()
@@ -228,8 +241,12 @@ class SFCORE_API UConstituent : public USfObject
 
 	friend class UFormCharacterComponent;
 
+	friend class UFormCoreComponent;
+
 	friend class UInventory;
 
+	friend struct FSfTestAccess;
+
 public:
 	
 	UConstituent();
@@ -298,11 +315,9 @@ public:
 	void InternalExecuteAction(const uint8 InActionId, const bool bInIsPredictableContext, const FBitWriter& SerializedParams);
 
 	//Does both serialization and deserialization based on archive direction.
+	//Uses a serializer plan cached for the struct type. See FSfParamSerializer.
 	static void SerializeGenericStruct(FProperty* Property, void* StructPtr, FArchive& Ar);
 
-	//Does both serialization and deserialization based on archive direction.
-	static void SerializeProperty(FProperty* Property, void* ValuePtr, FArchive& Ar);
-
 	//Called when an action is executed on the server.
 	UPROPERTY(BlueprintAssignable)
 	FServer_OnExecute Server_OnExecute;
@@ -355,19 +370,17 @@ public:
 	UFUNCTION(BlueprintPure)
 	UConstituent* GetOriginatingConstituent() const;
 
-	UFUNCTION(NetMulticast, Unreliable)
-	void NetMulticastClientPerformActionSet(const FActionSet& InActionSet, const float InServerTimestamp);
+	//Called on clients when the action set is received from the server through the UFormCoreComponent or
+	//ReplicatedActionState. Returns false if the action set isn't newer than the last one performed.
+	bool ClientPerformActionSet(const FActionSet& InActionSet, const float InServerTimestamp);
 	
 	//The last action set and time since values will have to be passed through as those would presumably not have updated.
 	//This is so we can call internal client perform action set and play the most recent action(s).
-	//This might be used to add post-relevancy action synchronization in the future, where actors are expected to go relevant and irrelevant
-	//close to the line of sight of the viewer. But for the current use case RPC based actions should work well enough.
+	//This is also used for post-relevancy action synchronization with ReplicatedActionState.
 	void InternalClientPerformActionSet();
 
 	void IncrementTimeSincePredictedLastActionSet(const float InTimePassed);
 
-	void PerformLastActionSetOnClients();
-
 	//Returns the query of QueryClass.
 	//This needs to be casted to the class to get the event from the query.
 	USfQuery* GetQuery(const TSubclassOf<USfQuery> QueryClass) const;
@@ -400,9 +413,20 @@ public:
 	UFormCoreComponent* GetFormCoreComponent() const;
 
 	//Unique identifier within each inventory.
-	UPROPERTY(Replicated)
+	UPROPERTY(ReplicatedUsing = OnRep_InstanceId)
 	uint8 InstanceId;
 
+	UFUNCTION()
+	void OnRep_InstanceId();
+
+	//Only sent to simulated proxies. Relevant clients usually get the action set through the multicast first, so this
+	//mostly matters to clients that become relevant or dropped the multicast.
+	UPROPERTY(ReplicatedUsing = OnRep_ReplicatedActionState)
+	FSfReplicatedActionState ReplicatedActionState;
+
+	UFUNCTION()
+	void OnRep_ReplicatedActionState();
+
 	//We use ActionSet instead of just uint8 for multiple reasons. Most importantly we need to do so as more than one action
 	//can be executed within a frame. ActionSet allows us to work with up to four actions that execute in the same frame,
 	//which should guarantee actions should not be skipped assuming the guidelines for creating them are followed. ActionSet
@@ -472,7 +496,7 @@ public:
 
 	FBitReader CurrentBitReader;
 
-	//True to send and execute action set on clients.
+	//True if the action set is queued to be sent to clients by the UFormCoreComponent.
 	uint8 bLastActionSetPendingClientExecution:1;
 
 protected:
@@ -506,7 +530,7 @@ private:
 	//On the server, neither "time since" is relevant because actions are always executed instantly. On the simulated proxy,
 	//we always use LastActionSet paired with LastActionSetTimestamp because prediction isn't running. On the autonomous proxy,
 	//LastActionSetTimestamp will almost always be 0 since we're always relevant, so we only recreate the effects from
-	//PredictedLastActionSet using the respective "time since" and let NetMulticastClientPerformActionSet handle LastActionSet changes.
+	//PredictedLastActionSet using the respective "time since" and let ClientPerformActionSet handle LastActionSet changes.
 
 	TSet<FBufferedInput> BufferedInputs;
 };
@@ -216,6 +216,11 @@ struct TStructOpsTypeTraits<FNetCardIdentifier> : public TStructOpsTypeTraitsBas
 	};
 };
 
+FORCEINLINE uint32 GetTypeHash(const FNetCardIdentifier& CardIdentifier)
+{
+	return HashCombine(GetTypeHash(CardIdentifier.ClassIndex), GetTypeHash(CardIdentifier.OwnerConstituentInstanceId));
+}
+
 USTRUCT()
 struct SFCORE_API FCardIdentifiersInAnInventory
 {
@@ -229,6 +234,18 @@ struct SFCORE_API FCardIdentifiersInAnInventory
 
 	bool operator==(const FCardIdentifiersInAnInventory& Other) const;
 
+	//Counts the cards removed from and added to the baseline. Kept cards are in the same order and added cards are at
+	//the end, which is how cards are added and removed in an inventory.
+	void CountDelta(const FCardIdentifiersInAnInventory& Baseline, uint32& OutNumRemoved, uint32& OutNumAdded) const;
+
+	void WriteDelta(FArchive& Ar, const FCardIdentifiersInAnInventory& Baseline) const;
+
+	//If the baseline is null, the delta is only read past.
+	void ReadDelta(FArchive& Ar, const FCardIdentifiersInAnInventory* Baseline);
+
+	//Order independent digest of the identifiers, which matches UInventory::CalculateCardDigest.
+	uint32 CalculateDigest() const;
+
 	friend FArchive& operator<<(FArchive& Ar, FCardIdentifiersInAnInventory& InventoryCardIdentifiers)
 	{
 		Ar << InventoryCardIdentifiers.CardIdentifiers;
@@ -325,11 +342,8 @@ struct TStructOpsTypeTraits<FTimestampedMovementCurve> : public TStructOpsTypeTr
 	};
 };
 
-FORCEINLINE uint32 GetTypeHash(const FTimestampedMovementCurve& MovementCurve)
-{
-	const uint32 Hash = FCrc::MemCrc32(&MovementCurve, sizeof(FTimestampedMovementCurve));
-	return Hash;
-}
+//Only hashes fields that are the same on every machine, so keys can be compared between the client and server.
+SFCORE_API uint32 GetTypeHash(const FTimestampedMovementCurve& MovementCurve);
 
 //Wrapper for hashed movement curve.
 USTRUCT(BlueprintType)
@@ -381,15 +395,16 @@ public:
 
 	FInt16_Quantize10 LookPitch;
 
-	//Number of input sets to enable.
-	uint8 EnabledInputSets:2;
+	//Held inputs, indexed by the InputActionRegistry.
+	uint64 InputBits;
+
+	//Serial of the input bits, which identifies them for delta serialization.
+	uint32 InputBitsSerial;
 
-	//Additional inputs.
-	uint8 PrimaryInputSet;
-	uint8 SecondaryInputSet;
-	uint8 TertiaryInputSet;
+	uint32 PredictedNetClockTicks;
 
-	float PredictedNetClock;
+	//Restored when replaying from this move so the clock adds up the same way.
+	float PredictedNetClockRemainder;
 
 	float ServerWorldTimeOnClient;
 
@@ -397,12 +412,31 @@ public:
 
 	TArray<FCardIdentifiersInAnInventory> CardIdentifiersInInventories;
 
+	//Serial of CardIdentifiersInInventories on the client.
+	uint32 CardIdentifiersSerial;
+
+	uint32 CardStateDigest;
+
 	FResourceArray Resources;
 
 	TArray<FMovementCurveKey> VelocityCurveKeys;
 
 	uint8 bDisableSelfMovement:1;
 
+	//Client state that isn't sent, which a correction restores for the parts that the server didn't send.
+	TArray<FUint16_Quantize100> TimesSinceLastAction;
+	TSharedPtr<const TArray<FInventoryCards>> Cards;
+	TArray<FTimestampedMovementCurve> VelocityCurves;
+
+	//Hash of the packed Sf state above, excluding the clocks.
+	uint32 SfStateHash;
+
+	//Whether the Sf state was changed by this move. Only moves that didn't change it can be combined.
+	uint8 bSfStateChanged:1;
+
+	//Whether predicted card or resource changes were made during this move, which a scoped replay can't re-simulate.
+	uint8 bMadePredictedChanges:1;
+
 	virtual void Clear() override;
 	virtual void SetMoveFor(ACharacter* C, float InDeltaTime, FVector const& NewAccel,
 	                        FNetworkPredictionData_Client_Character& ClientData) override;
@@ -410,6 +444,17 @@ public:
 	virtual void PostUpdate(ACharacter* C, EPostUpdateMode PostUpdateMode) override;
 	virtual uint8 GetCompressedFlags() const override;
 	virtual bool CanCombineWith(const FSavedMovePtr& NewMove, ACharacter* InCharacter, float MaxDelta) const override;
+	virtual void CombineWith(const FSavedMove_Character* OldMove, ACharacter* InCharacter, APlayerController* PC,
+	                         const FVector& OldStartLocation) override;
+
+	uint32 CalculateSfStateHash() const;
+
+	//Updates the parts of a sent move that a scoped replay re-simulated. Inventories that have converged with what
+	//was recorded for this move stop being re-simulated.
+	void PostUpdateScopedReplay(UFormCharacterComponent* CharacterComponent);
+
+	//Whether the re-simulated state of an inventory is the same as what was recorded for this move.
+	bool HasInventoryConverged(const UFormCharacterComponent* CharacterComponent, int32 InventoryIndex) const;
 };
 
 class FNetworkPredictionData_Client_Sf : public FNetworkPredictionData_Client_Character
@@ -425,17 +470,23 @@ public:
 struct FSfNetworkMoveData : FCharacterNetworkMoveData
 {
 	FInt16_Quantize10 LookPitch;
-	
-	//Number of input sets to enable.
-	//Serialized to 2 bits.
-	uint8 EnabledInputSets;
 
-	//Additional inputs.
-	uint8 PrimaryInputSet;
-	uint8 SecondaryInputSet;
-	uint8 TertiaryInputSet;
+	//Held inputs, indexed by the InputActionRegistry.
+	uint64 InputBits;
+
+	//Only used on the client.
+	uint32 InputBitsSerial;
+
+	//Id of the input bits state this move was sent with. Only used on the server.
+	uint8 InputBitsStateId;
 
-	float PredictedNetClock;
+	//The client's input bits are the same as in the last move processed, so InputBits is unused.
+	uint8 bInputBitsUnchanged:1;
+
+	//The client sent a delta against a baseline that the server doesn't have.
+	uint8 bInputBitsBaselineLost:1;
+
+	uint32 PredictedNetClockTicks;
 
 	float ServerWorldTimeOnClient;
 
@@ -443,6 +494,27 @@ struct FSfNetworkMoveData : FCharacterNetworkMoveData
 
 	TArray<FCardIdentifiersInAnInventory> CardIdentifiersInInventories;
 
+	//Only used on the client.
+	uint32 CardIdentifiersSerial;
+
+	//Id of the card identifier state this move was sent with. Only used on the server.
+	uint8 CardIdentifiersStateId;
+
+	//The client's card identifiers are the same as in the last move processed, so CardIdentifiersInInventories is unused.
+	uint8 bCardIdentifiersUnchanged:1;
+
+	//The client sent a delta against a baseline that the server doesn't have.
+	uint8 bCardIdentifiersBaselineLost:1;
+
+	//Used instead of card identifiers when bVerifyCardsWithDigest is true.
+	uint32 CardStateDigest;
+
+	//The client's card state digest is the same as in the last move processed, so CardStateDigest is unused.
+	uint8 bCardStateDigestUnchanged:1;
+
+	//Card identifiers are only sent with the digest when the server requests them.
+	uint8 bHasCardIdentifiers:1;
+
 	FResourceArray Resources;
 
 	TArray<FMovementCurveKey> VelocityCurveKeys;
@@ -454,6 +526,16 @@ struct FSfNetworkMoveData : FCharacterNetworkMoveData
 	virtual bool Serialize(UCharacterMovementComponent& CharacterMovement, FArchive& Ar, UPackageMap* PackageMap,
 	                       ENetworkMoveType MoveType) override;
 
+	//Sends card identifiers as per inventory deltas against the last state the server acknowledged.
+	void SerializeCardIdentifiers(FArchive& Ar, UFormCharacterComponent* CharacterComponent);
+
+	//Sends the card state digest only if the cards changed since the last move the server acknowledged.
+	void SerializeCardStateDigest(FArchive& Ar, const UFormCharacterComponent* CharacterComponent);
+
+	//Sends input bits as the bits that changed from the last state the server acknowledged, or as all of the bindings
+	//if that is smaller.
+	void SerializeInputBits(FArchive& Ar, UFormCharacterComponent* CharacterComponent);
+
 	virtual void ClientFillNetworkMoveData(const FSavedMove_Character& ClientMove, ENetworkMoveType MoveType) override;
 };
 
@@ -465,6 +547,8 @@ enum ECorrectionConditionFlags : uint8
 	Repredict_Sf = 0x04,
 	//This overrides the update flag as if we rollback we guarantee that we send server state anyway.
 	Update_Cards = 0x08, //If update we only want to respond with changes and not rollback cards specifically.
+	//The card state digest didn't match, so the client should send card identifiers until it does.
+	Request_CardIdentifiers = 0x10,
 };
 
 struct FSfNetworkMoveDataContainer : FCharacterNetworkMoveDataContainer
@@ -476,22 +560,17 @@ struct FSfNetworkMoveDataContainer : FCharacterNetworkMoveDataContainer
 	FSfNetworkMoveDataContainer();
 };
 
-struct FSfMoveResponseDataContainer : FCharacterMoveResponseDataContainer
+//A move received by the server that is waiting in the jitter buffer.
+struct FBufferedServerMove
 {
-	TArray<FActionSet> ActionSetResponse;
-
-	float PredictedNetClock;
-
-	TArray<FUint16_Quantize100> TimeSinceLastAction;
+	FCharacterServerMovePackedBits PackedBits;
 
-	TArray<FInventoryCards> CardResponse;
-
-	FResourceArray ResourcesResponse;
-
-	TArray<FTimestampedMovementCurve> VelocityCurveResponse;
-
-	uint8 bDisableSelfMovement:1;
+	//Real time on the server when the move was received.
+	double ArrivalTime;
+};
 
+struct FSfMoveResponseDataContainer : FCharacterMoveResponseDataContainer
+{
 	FSfMoveResponseDataContainer();
 
 	virtual void ServerFillResponseData(const UCharacterMovementComponent& CharacterMovement,
@@ -499,6 +578,16 @@ struct FSfMoveResponseDataContainer : FCharacterMoveResponseDataContainer
 
 	void SerializeCardResponse(FArchive& Ar, UFormCharacterComponent* CharacterComponent, bool bIsSaving);
 
+	//Serializes a section of NumElements elements with a bit for the section and a bit per element if it is dirty.
+	//Only dirty elements are sent. The rest are restored on the client with RestoreElement, which returns false if
+	//that isn't possible. The client receives the dirty elements into DirtyMask.
+	template <typename SerializeElementType, typename RestoreElementType>
+	static bool SerializeDirtyElements(FArchive& Ar, int32 NumElements, TBitArray<>& DirtyMask,
+	                                   SerializeElementType&& SerializeElement, RestoreElementType&& RestoreElement);
+
+	//Serializes a section count. Returns false if the count is invalid.
+	static bool SerializeSectionNum(FArchive& Ar, int32& Num);
+
 	virtual bool Serialize(UCharacterMovementComponent& CharacterMovement, FArchive& Ar,
 	                       UPackageMap* PackageMap) override;
 };
@@ -507,6 +596,17 @@ DECLARE_MULTICAST_DELEGATE(FOnBeginRollback);
 DECLARE_MULTICAST_DELEGATE(FOnEndRollback);
 DECLARE_MULTICAST_DELEGATE_ThreeParams(FOnPredictionTick, const float InPredictedNetClock, const float InDeltaTime, const bool bInIsReplaying)
 
+//An inventory slot that is bound to an input and has a slotable.
+struct FSfInputDispatchSlot
+{
+	int32 SlotIndex;
+
+	int32 InputIndex;
+
+	//Constituents of the slotable end here in InputDispatchConstituents, and start where the previous slot ends.
+	int32 ConstituentEnd;
+};
+
 /**
 * The FormCharacterComponent is responsible for the movement and client prediction of a form.
 * The form must be an ACharacter. This component must be replicated.
@@ -526,6 +626,7 @@ class SFCORE_API UFormCharacterComponent : public UCharacterMovementComponent
 	friend struct FSfMoveResponseDataContainer;
 	friend class UInventory;
 	friend struct FCard;
+	friend struct FSfTestAccess;
 	
 public:
 	UFormCharacterComponent();
@@ -539,11 +640,24 @@ public:
 	                                                 bool bBaseRelativePosition, uint8 ServerMovementMode,
 	                                                 TOptional<FRotator> OptionalRotation) override;
 
+	virtual void ClientAckGoodMove_Implementation(float TimeStamp) override;
+
 	//Marking cards dirty allows them to be synchronized to a predicting client without rollback.
 	virtual void MarkCardsDirty();
 
 	bool IsReplaying() const;
 
+	//True while replaying a correction that only re-simulates some inventories.
+	bool IsScopedReplaying() const;
+
+	bool ShouldSimulateInventory(int32 InventoryIndex) const;
+
+	//Called by predicted card and resource changes, as they can't be attributed to a single inventory.
+	void RecordPredictedChange();
+
+	//Called when inventories, slotables or constituents change so inputs are dispatched to the right constituents.
+	void MarkInputDispatchTableDirty();
+
 	void SetupFormCharacter(UFormCoreComponent* FormCoreComponent);
 
 	void SecondarySetupFormCharacter();
@@ -556,10 +670,31 @@ public:
 
 	bool HasPredictedTimestampPassed(const float InTimestamp) const;
 
+	//Time from one predicted timestamp to another, going the shorter way around the loop of the clock.
+	static float CalculateTimeBetweenPredictedTimestamps(const float InFrom, const float InTo);
+
+	static uint32 PredictedTimestampToTicks(const float InTimestamp);
+
+	//Ticks from one point of the predicted net clock to another, going the shorter way around the loop.
+	static int32 CalculateTicksBetweenPredictedNetClocks(const uint32 InFrom, const uint32 InTo);
+
+	//Adds time to the predicted net clock in whole ticks and keeps the rest in the remainder. The result isn't wrapped
+	//around the loop of the clock.
+	static uint32 AddTimeToPredictedNetClock(const uint32 InTicks, float& InOutRemainder, const float InDeltaSeconds);
+
 	void CalculateMovementSpeed();
 
+	//Predicted timestamps are in seconds and are exact for every tick of the predicted net clock.
 	float GetPredictedNetClock() const;
 
+	uint32 GetPredictedNetClockTicks() const;
+
+	//The predicted net clock counts ticks so that it is exact no matter how long it has been running. It loops about
+	//every 9 hours, which is handled by comparing timestamps the shorter way around the loop. Every tick is exactly
+	//representable as a float timestamp.
+	static constexpr uint32 PredictedNetClockTicksPerSecond = 512;
+	static constexpr uint32 PredictedNetClockTicksPerLoop = 1 << 24;
+
 	//Must be called by character to setup input.
 	void SetupPlayerInputComponent(UInputComponent* PlayerInputComponent);
 
@@ -608,6 +743,51 @@ public:
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "FormCharacterComponent")
 	bool bAccelerationCalculatedByFormCharacter;
+
+	//Lets the client send moves that didn't change any inputs or Sf state as a single move.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "FormCharacterComponent")
+	bool bAllowMoveCombining = true;
+
+	//The client sends a 32-bit digest of its cards with each move instead of card identifiers. The server only
+	//compares card identifiers after asking for them when the digest doesn't match.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "FormCharacterComponent")
+	bool bVerifyCardsWithDigest = false;
+
+	//On a correction, only the inventories that diverged are rolled back and re-simulated, and diverged resources
+	//are offset by their difference instead of being re-simulated. Everything else keeps its predicted state.
+	//Predicted card and resource changes can be made by any constituent to any inventory, so everything is
+	//re-simulated if any were made in the moves being replayed. A net clock correction always re-simulates everything.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "FormCharacterComponent")
+	bool bScopedReconciliation = false;
+
+	//During a scoped replay, an inventory stops being re-simulated once it matches what was recorded for a saved
+	//move, as the remaining moves would be simulated the same way. It is restored to its predicted state instead.
+	//Inventories with buffered inputs never converge as they aren't recorded, and card objects are recreated from
+	//the restored cards, so only use this if card objects don't keep state that affects what is predicted.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "FormCharacterComponent")
+	bool bStopReplayOnConvergence = false;
+
+	//Card lifetimes, buffered input timeouts and resource updates are simulated in fixed steps of the predicted net
+	//clock instead of once per move, so they give the same results on the client and server regardless of frame rate.
+	//Movement is unaffected.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "FormCharacterComponent")
+	bool bFixedStepSfSimulation = false;
+
+	//Rounded to the nearest power of two so that steps are a whole number of ticks of the predicted net clock that
+	//divides the loop of the clock, which keeps every step the same length across the loop.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "FormCharacterComponent", meta = (ClampMin = 1, ClampMax = 512, EditCondition = "bFixedStepSfSimulation"))
+	int32 SfStepsPerSecond = 64;
+
+	//The server buffers moves from the client and processes them at a steady cadence instead of as they arrive, so
+	//that a jittery connection doesn't cause bursts of moves and forced moves. Moves are held for as long as the
+	//measured jitter calls for, up to the latency budget.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "FormCharacterComponent")
+	bool bUseServerJitterBuffer = false;
+
+	//Longest time in seconds that a move is held in the jitter buffer. Kept below the time before the server forces a
+	//move so that buffered moves are always processed first.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "FormCharacterComponent", meta = (ClampMin = 0.f, ClampMax = 0.3f, EditCondition = "bUseServerJitterBuffer"))
+	float JitterBufferLatencyBudget = 0.1f;
 	
 	//Movement inputs.
 	uint8 bWantsToSprint:1;
@@ -671,13 +851,28 @@ public:
 
 protected:
 	
-	//Number of input sets to enable, this is automatically set based on how many inputs are registered.
-	uint8 EnabledInputSets:2;
+	static constexpr uint32 InputBitsStateIdCount = 16;
 
-	//Additional inputs.
-	uint8 PrimaryInputSet = 0;
-	uint8 SecondaryInputSet = 0;
-	uint8 TertiaryInputSet = 0;
+	static constexpr int32 MaxInputActions = 64;
+
+	//Held inputs, indexed by the InputActionRegistry.
+	uint64 InputBits = 0;
+
+	//Incremented whenever InputBits changes on the client, so each distinct state has a serial. Serials are sent as
+	//ids that wrap at InputBitsStateIdCount.
+	uint32 InputBitsSerial = 0;
+
+	//The last input bits that the client knows the server has received, which deltas are sent against.
+	uint64 InputBitsBaseline = 0;
+	uint32 InputBitsBaselineSerial = 0;
+	bool bHasInputBitsBaseline = false;
+
+	//Input bits received on the server by id, so any baseline the client refers to can be found.
+	uint64 ServerInputBitsStates[InputBitsStateIdCount] = {};
+	uint16 ServerInputBitsStatesMask = 0;
+
+	//Used when the client indicates the input bits haven't changed.
+	int32 ServerLastProcessedInputBitsStateId = INDEX_NONE;
 
 	//This is used to determine how the pipeline is supposed to handle the separate sections of correction data to rollback
 	//as little as possible and send as little as possible.
@@ -689,8 +884,13 @@ protected:
 	//of ensuring that time discrepancies will not cause more rollbacks - by having the clock incremented in tandem with
 	//the logic that uses it in PerformMovement. To save bandwidth we only serialize this to the server once every second,
 	//and the server will only issue a correction when necessary.
-	float PredictedNetClock = 0;
-	uint32 NetClockNextInteger = 0;
+	uint32 PredictedNetClockTicks = 0;
+	//Time that hasn't added up to a tick yet. Not sent as the client and server each keep their own.
+	float PredictedNetClockRemainder = 0;
+	uint32 NetClockNextSendTicks = 0;
+
+	//Used by moves that don't send the clock.
+	static constexpr uint32 UnsentPredictedNetClockTicks = MAX_uint32;
 	
 	//+/- acceptable range.
 	static constexpr float NetClockAcceptableTolerance = 0.01f;
@@ -720,10 +920,43 @@ protected:
 
 	//Simplified versions of cards used to verify that client cards are correct.
 	TArray<FCardIdentifiersInAnInventory> CardIdentifiersInInventories;
-	TArray<FCardIdentifiersInAnInventory> OldCardIdentifiersInInventories;
+
+	//Incremented whenever CardIdentifiersInInventories is repacked on the client, so each distinct state has a serial.
+	//Serials are sent as ids that wrap at CardIdentifierStateIdCount.
+	uint32 CardIdentifiersSerial = 0;
+
+	//The last card identifier state that the client knows the server has received, which deltas are sent against.
+	TArray<FCardIdentifiersInAnInventory> CardIdentifiersBaseline;
+	uint32 CardIdentifiersBaselineSerial = 0;
+	bool bHasCardIdentifiersBaseline = false;
+
+	//Card identifier states received on the server by id, so any baseline the client refers to can be found.
+	TArray<TArray<FCardIdentifiersInAnInventory>> ServerCardIdentifierStates;
+	uint64 ServerCardIdentifierStatesMask = 0;
+
+	//Used when the client indicates the card identifiers haven't changed.
+	int32 ServerLastProcessedCardIdentifiersStateId = INDEX_NONE;
+
+	static constexpr uint32 CardIdentifierStateIdCount = 64;
+
+	//Per inventory digests, which are combined into CardStateDigest.
+	TArray<uint32> InventoryCardDigests;
+	uint32 CardStateDigest = 0;
+
+	//Card identifier serial of the last acknowledged move. The server has processed the digest of that move, so the
+	//digest isn't sent again until the cards change.
+	uint32 CardStateDigestBaselineSerial = 0;
+	bool bHasCardStateDigestBaseline = false;
+
+	//Used when the client indicates the card state digest hasn't changed.
+	uint32 ServerLastProcessedCardStateDigest = 0;
 
 	TArray<FInventoryCards> CardResponse;
 
+	//UInventory::CardsVersion of each inventory when it was last packed, so unchanged inventories aren't repacked.
+	TArray<uint32> PackedCardIdentifiersVersions;
+	TArray<uint32> PackedCardsVersions;
+
 	//If this is false, we shouldn't use CardResponse.
 	//We copy CardResponse to the inventory and set false in PerformMovement if is true.
 	uint8 bClientCardsWereUpdated:1;
@@ -736,14 +969,59 @@ protected:
 	//If this is false, we shouldn't use ResourcesResponse.
 	//We copy ResourcesResponse to the FormResource and set false in PerformMovement if is true.
 	uint8 bClientResourcesWereUpdated:1;
+
+	//Elements of each response section that have diverged from the client, indexed the same as the responses.
+	//Only these are sent in a correction as the client restores the rest from the corrected move.
+	//On the client these are the elements that were received, which decide what a scoped replay re-simulates.
+	TBitArray<> ActionSetResponseDirtyMask;
+	TBitArray<> CardResponseDirtyMask;
+	TBitArray<> ResourcesResponseDirtyMask;
+	TBitArray<> VelocityCurveResponseDirtyMask;
+
+	//Only used on the client to record the state of moves.
+	TArray<FUint16_Quantize100> ClientTimesSinceLastAction;
+
+	//Index of the first action set of each inventory in PendingActionSets, followed by the number of action sets.
+	TArray<int32> PendingActionSetInventoryStarts;
+
+	//Set on the client when a correction is received and cleared after replaying it.
+	bool bScopedReplay = false;
+	//Set by predicted card and resource changes since the last move was recorded.
+	bool bMadePredictedChanges = false;
+	TBitArray<> ScopedReplayInventories;
+
+	//Times since the last action set of each constituent when a correction is received, indexed the same as
+	//PendingActionSets. Restored for inventories that converge while replaying, as the last saved move may be older.
+	TArray<FUint16_Quantize100> ClientPredictedTimesSinceLastAction;
+	//Input state of each inventory and whether any of its constituents had buffered inputs when a correction is
+	//received.
+	TArray<uint64> ClientPredictedLastInputBits;
+	TArray<TBitArray<>> ClientPredictedLastInputStates;
+	TBitArray<> ClientPredictedBufferedInputInventories;
+	TSharedPtr<const TArray<FInventoryCards>> ClientCardsSnapshot;
 	
 	TArray<FMovementCurveKey> ClientSentVelocityCurveKeys;
 	TArray<FMovementCurveKey> OldClientSentVelocityCurveKeys;
 
 	TArray<FTimestampedMovementCurve> ActiveVelocityCurves;
 
+	//Slots of inventory i are from InputDispatchInventoryStarts[i] to InputDispatchInventoryStarts[i + 1], in slot
+	//order.
+	TArray<FSfInputDispatchSlot> InputDispatchSlots;
+	TArray<int32> InputDispatchInventoryStarts;
+	TArray<UConstituent*> InputDispatchConstituents;
+
+	//Inputs of the slots in each inventory.
+	TArray<uint64> InputDispatchInventoryMasks;
+
+	//Inventories with a slot whose last input state isn't the last input bits of the inventory, like a slot that was
+	//empty when its input flipped. They are visited on the next tick even if no input flipped.
+	TBitArray<> InputDispatchStaleInventories;
+
+	bool bInputDispatchTableDirty = true;
+
 	//Register InputActions that can be used for constituent implementation.
-	//Only 24 InputActions can be used.
+	//Only 64 InputActions can be used.
 	//Movement inputs work with the CMC system and not the constituent/form character system.
 	UPROPERTY(BlueprintReadOnly, EditAnywhere, Category = "FormCharacterComponent")
 	TArray<UInputAction*> InputActionRegistry;
@@ -770,15 +1048,48 @@ protected:
 
 	static bool CardCanBeFoundInInventory(UInventory* Inventory, const FNetCardIdentifier InCardIdentifier);
 
-	void HandleInventoryDifferencesAndSetCorrectionFlags(UInventory* Inventory,
+	//Returns true if the inventory diverged from the client.
+	bool HandleInventoryDifferencesAndSetCorrectionFlags(UInventory* Inventory,
 	                                                     const FCardIdentifiersInAnInventory& InCardIdentifierInventoryFromClient);
 
+	void HandleCardIdentifierDifferencesAndSetCorrectionFlags(
+		const TArray<FCardIdentifiersInAnInventory>& InCardIdentifiersInInventoriesFromClient);
+
+	void HandleCardStateDigestAndSetCorrectionFlags(const FSfNetworkMoveData* MoveData);
+
+	static uint32 CombineInventoryCardDigests(const TArray<uint32>& InInventoryCardDigests);
+
 	void HandleResourcesDifferencesAndSetCorrectionFlags(const UFormResourceComponent* FormResourceComponent, const FResourceArray& InResources);
 	
 	void HandleVelocityCurveDifferencesAndSetCorrectionFlags(const FSfNetworkMoveData* MoveData);
 
 	virtual void SfServerCheckClientError();
 
+	static void MarkResponseDirty(TBitArray<>& DirtyMask, int32 Index);
+
+	static void MarkResponseDirty(TBitArray<>& DirtyMask, int32 StartIndex, int32 EndIndex);
+
+	void ResetResponseDirtyMasks();
+
+	//Finds the saved move that a response from the server is for, or nullptr if it is no longer saved.
+	const FSavedMove_Sf* FindSavedMoveForResponse(float TimeStamp) const;
+
+	//Decides what a received correction re-simulates. Diverged resources are offset here, including in the saved
+	//moves that will be replayed.
+	void ClientSetupReplayScope(float TimeStamp);
+
+	//Keeps the state that saved moves don't record, so inventories that converge can be restored to it.
+	void ClientSnapshotPredictedState();
+
+	//Stops re-simulating an inventory and restores the state that was predicted for it before the correction.
+	void ClientResumePredictedInventory(int32 InventoryIndex);
+
+	bool HasInventoryBufferedInputs(int32 InventoryIndex) const;
+
+	//Runs on the constituents of the inventories that are simulated.
+	template <typename FunctionType>
+	void ForEachSimulatedConstituent(FunctionType&& Function) const;
+
 	virtual void UpdateFromAdditionInputs();
 
 	virtual bool ClientUpdatePositionAfterServerUpdate() override;
@@ -791,6 +1102,8 @@ protected:
 
 	void PackActionSets();
 
+	void PackPendingActionSets();
+
 	void PackCards();
 	
 	void PackResources();
@@ -798,13 +1111,36 @@ protected:
 	void PackVelocityCurves();
 
 	void PackInventoryCardIdentifiers();
+
+	//Moves the card identifier and card state digest baselines to the state of the last acknowledged move.
+	void UpdateCardIdentifiersBaseline();
+
+	//Makes the input bits of the last acknowledged move the baseline that deltas are sent against.
+	void UpdateInputBitsBaseline();
+
+	const uint64* GetServerInputBitsState(const int32 InStateId) const;
+
+	void StoreServerInputBitsState(const uint32 InStateId, const uint64 InState);
+
+	const TArray<FCardIdentifiersInAnInventory>* GetServerCardIdentifierState(const uint32 InStateId) const;
+
+	void StoreServerCardIdentifierState(const uint32 InStateId, const TArray<FCardIdentifiersInAnInventory>& InState);
 	
 	void HandleCardClientSyncTimeout() const;
 
-	static void ApplyInputBitsToInventory(const uint32 InInputBits, UInventory* InInventory);
+	//Lists the bound slots of each inventory and the constituents that handle their inputs.
+	void BuildInputDispatchTable();
 	
 	void RemovePredictedCardWithEndedLifetimes() const;
 
+	//Adds the time of a move to the predicted net clock and simulates the Sf logic over it, in fixed steps if enabled.
+	void SimulateSfTime(const float InDeltaSeconds);
+
+	//Simulates the Sf logic that depends on time from one point of the unwrapped predicted net clock to another.
+	void SimulateSfTimeStep(const uint32 InFromTicks, const uint32 InToTicks);
+
+	void ApplyInputBits();
+
 	void ApplyVelocityCurves();
 	
 	//This is where all the logic actually takes place. We'll call it the prediction tick.
@@ -813,6 +1149,12 @@ protected:
 	//Override to reset the client move timer when it is received.
 	virtual void ServerMove_HandleMoveData(const FCharacterNetworkMoveDataContainer& MoveDataContainer) override;
 
+	//Override to put received moves in the jitter buffer if it is used.
+	virtual void ServerMovePacked_ServerReceive(const FCharacterServerMovePackedBits& PackedBits) override;
+
+	//Processes the moves in the jitter buffer that are due, or all of them if flushing.
+	void ServerReleaseBufferedMoves(const bool bInFlush);
+
 	virtual void ReplicateMoveToServer(float DeltaTime, const FVector& NewAcceleration) override;
 
 	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
@@ -828,16 +1170,10 @@ private:
 	UPROPERTY()
 	UEnhancedInputComponent* EnhancedInputComponent;
 
-	uint8 FindInputIndexInRegistry(const FInputActionInstance& InInstance);
+	int32 FindInputIndexInRegistry(const FInputActionInstance& InInstance) const;
 
-	//Sets a value on an input set using an index from 0-7.
-	static void SetInputSet(uint8* InputSet, const uint8 InIndex, const bool bInIsTrue);
-
-	//Gets a value from all input sets using the input index from 0-23.
-	static bool GetValueFromInputSets(const uint8 InIndex, const uint32 InInputSetsJoinedBits);
-
-	//Gets the bits of the input sets as one value.
-	uint32 GetInputSetsJoinedBits() const;
+	//Sets the bit of an input using its index in the InputActionRegistry.
+	void SetInputBit(const int32 InIndex, const bool bInIsTrue);
 
 	bool bReferencesGathered = false;
 
@@ -852,11 +1188,31 @@ private:
 	float LatestServerReceivedMoveTimestamp = 0;
 	
 	float LatestServerReceivedMoveDeltaTime = 0;
+
+	TArray<FBufferedServerMove> BufferedServerMoves;
+
+	//Smoothed time between moves arriving and how much it varies.
+	float JitterBufferMeanInterval = 0;
+	float JitterBufferDeviation = 0;
+	double JitterBufferLastArrivalTime = -1;
+	double JitterBufferNextReleaseTime = 0;
+
+	//Gain of the smoothed interval and deviation, and how many deviations moves are held for.
+	static constexpr float JitterBufferSmoothing = 1.f / 16.f;
+	static constexpr float JitterBufferDeviationMultiplier = 2.f;
+	static constexpr int32 MaxBufferedServerMoves = 32;
 	
 	bool bClientForceSerialize = false;
 
 	bool bIsReplaying = false;
 
+	//SfStateHash of the last recorded move on the client.
+	uint32 LastRecordedSfStateHash = 0;
+
+	//Time of a combined move that has already been simulated by the Sf tick, as the pending move that was combined
+	//already ran its tick.
+	float CombinedMoveSimulatedDeltaTime = 0;
+
 	UPROPERTY()
 	UFormResourceComponent* FormResource;
 
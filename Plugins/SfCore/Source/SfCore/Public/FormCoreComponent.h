@@ -3,6 +3,7 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Constituent.h"
 #include "GameplayTagContainer.h"
 #include "SfUtility.h"
 #include "Components/ActorComponent.h"
@@ -16,20 +17,64 @@ class UFormCharacterComponent;
 class UConstituent;
 class UInventory;
 
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FTriggerDelegate);
+DECLARE_DYNAMIC_DELEGATE(FTriggerInputDelegate);
+
+//Refers to a constituent by its inventory index and instance id.
+//The generation detects if the slot has since been given to another constituent, such as after instance ids are
+//reassigned.
+struct FSfConstituentHandle
+{
+	int32 InventoryIndex = INDEX_NONE;
+
+	uint8 InstanceId = 0;
+
+	uint32 Generation = 0;
+
+	bool IsValid() const
+	{
+		return InventoryIndex != INDEX_NONE;
+	}
+};
+
+struct FSfConstituentTableSlot
+{
+	UConstituent* Constituent = nullptr;
+
+	uint32 Generation = 0;
+};
+
+struct FSfBatchedActionSet
+{
+	int32 InventoryIndex = 0;
+
+	uint8 InstanceId = 0;
+
+	FActionSet ActionSet;
+};
+
+//Last action sets of all constituents of a form that executed actions in a server frame, in the order they were
+//executed. Constituents are identified by their inventory index and instance id.
 USTRUCT()
-struct SFCORE_API FTimestampedTransformSnapshot
+struct SFCORE_API FSfActionSetBatch
 {
 	GENERATED_BODY()
 
-	FTimestampedTransformSnapshot();
-	
-	float Timestamp;
+	float ServerTimestamp = 0;
+
+	TArray<FSfBatchedActionSet> ActionSets;
 
-	FTransform Transform;
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
 };
 
-DECLARE_DYNAMIC_MULTICAST_DELEGATE(FTriggerDelegate);
-DECLARE_DYNAMIC_DELEGATE(FTriggerInputDelegate);
+template<>
+struct TStructOpsTypeTraits<FSfActionSetBatch> : public TStructOpsTypeTraitsBase2<FSfActionSetBatch>
+{
+	enum
+	{
+		WithNetSerializer = true
+	};
+};
 
 /**
  * The FormCoreComponent is responsible for the core logic of a form.
@@ -44,6 +89,8 @@ class SFCORE_API UFormCoreComponent : public UActorComponent
 	
 	GENERATED_BODY()
 
+	friend struct FSfTestAccess;
+
 public:
 	UFormCoreComponent();
 	
@@ -83,8 +130,6 @@ public:
 	UFUNCTION(BlueprintPure)
 	bool IsFirstPerson();
 
-	static const TArray<UClass*>& GetAllCardObjectClassesSortedByName();
-
 	UFormQueryComponent* GetFormQuery() const;
 
 	USfHealthComponent* GetHealth() const;
@@ -107,11 +152,41 @@ public:
 	bool Server_HasTrigger(FGameplayTag Trigger);
 
 	//For lag compensated hit registration.
-	void ServerRollbackLocation(const float ServerTimestamp);
+	void ServerRollbackLocation(const float ServerTimestamp) const;
 
 	//Must be called after ServerRollbackLocation to bring animation back to current time.
 	void ServerRestoreLatestLocation() const;
 
+	//Slot of this form in the USfLagCompensationSubsystem. INDEX_NONE on clients.
+	int32 GetLagCompensationSlot() const;
+
+	//Finds a constituent in O(1) with the constituent table.
+	UConstituent* FindConstituent(const int32 InInventoryIndex, const uint8 InInstanceId);
+
+	FSfConstituentHandle MakeConstituentHandle(const int32 InInventoryIndex, const uint8 InInstanceId);
+
+	//Returns nullptr if the handle is stale.
+	UConstituent* ResolveConstituentHandle(const FSfConstituentHandle& InHandle);
+
+	//Returns INDEX_NONE if the inventory isn't on this form core.
+	int32 GetInventoryIndex(const UInventory* InInventory);
+
+	//All constituents in inventory, slotable and constituent order. This is the order used when packing state that
+	//is sent between the client and server.
+	const TArray<UConstituent*>& GetOrderedConstituents();
+
+	//Index of the first constituent of each inventory in the ordered constituents, followed by the number of
+	//constituents.
+	const TArray<int32>& GetOrderedConstituentInventoryStarts();
+
+	//Called when inventories, slotables, constituents or instance ids change. Also marks tables built from the
+	//constituents on other components dirty.
+	void MarkConstituentTableDirty();
+
+	//Sends the last action set of the constituent to clients at the end of the frame. Action sets of all constituents
+	//are sent together.
+	void QueueActionSetForClients(UConstituent* InConstituent);
+
 	//References to all the constituents that isn't ordered. Used to iterate through all owned constituents on a form
 	//without accessing intermediate inventories and slotables.
 	UPROPERTY(Replicated)
@@ -183,11 +258,6 @@ private:
 	UPROPERTY(VisibleAnywhere, Category = "FormCoreComponent")
 	bool bIsFirstPerson = false;
 
-	//CardObjectClasses are indexed as they're net referenced very often and is worth using a simplified index for instead
-	//of repeatedly serializing the class reference.
-	inline static TArray<UClass*> AllCardObjectClassesSortedByName = TArray<UClass*>();
-
-	inline static bool CardObjectClassesFetched = false;
 	
 	TMap<FGameplayTag, FTriggerDelegate> Triggers;
 	
@@ -195,17 +265,29 @@ private:
 
 	bool bInputsRequireSetup = true;
 
-	float TimeSinceLastSnapshot = 0;
+	int32 LagCompensationSlot = INDEX_NONE;
+
+	void UpdateConstituentTable();
+
+	//Moves the last action sets of the queued constituents into the batch in the order they were queued, and keeps
+	//them in the replicated action states. Returns false if there is nothing to send.
+	bool BuildQueuedActionSetBatch(FSfActionSetBatch& OutBatch);
 
-	uint8 IndexOfOldestSnapshot = 0;
+	void SendQueuedActionSets();
 
-	TArray<FTimestampedTransformSnapshot> ServerLocationSnapshots;
+	UFUNCTION(NetMulticast, Unreliable)
+	void NetMulticastClientPerformActionSets(const FSfActionSetBatch& InBatch);
+
+	//Held until the end of the frame, so they are referenced for garbage collection in case they are removed first.
+	UPROPERTY()
+	TArray<TObjectPtr<UConstituent>> ConstituentsPendingClientExecution;
 
-	FTransform CurrentTransform;
+	//Indexed by inventory index * 256 + instance id.
+	TArray<FSfConstituentTableSlot> ConstituentTable;
 
-	float TimeBetweenServerLocationSnapshots;
+	TArray<UConstituent*> OrderedConstituents;
 
-	FSfTickFunctionHelper TenSecondTickHelper{this, &UFormCoreComponent::TenSecondTick, 10.f};
+	TArray<int32> OrderedConstituentInventoryStarts;
 
-	void TenSecondTick(const float DeltaTime);
+	bool bConstituentTableDirty = true;
 };
@@ -91,6 +91,7 @@ class SFCORE_API UFormResourceComponent : public UActorComponent
 	GENERATED_BODY()
 
 	friend class UFormCharacterComponent;
+	friend struct FSfTestAccess;
 
 public:
 	UFormResourceComponent();
@@ -129,6 +130,9 @@ public:
 
 	UFUNCTION(BlueprintCallable)
 	bool Predicted_SetResourceValue(const FGameplayTag InTag, const float InValue);
+
+	//Lets the form character know predicted changes were made, so a correction re-simulates every inventory.
+	void RecordPredictedChange() const;
 	
 	float GetMaxValue(const FResource& Resource) const;
 
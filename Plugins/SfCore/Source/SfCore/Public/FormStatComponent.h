@@ -91,6 +91,94 @@ enum EStatModifierType
 	FlatAdditive //Adds to value after all other modifications.
 };
 
+//A stat modifier that has been added to a UFormStatComponent.
+USTRUCT(BlueprintType)
+struct SFCORE_API FStatModifier
+{
+	GENERATED_BODY()
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	FGameplayTag StatTag;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	TEnumAsByte<EStatModifierType> Type;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+	float Value;
+
+	FStatModifier();
+
+	FStatModifier(const FGameplayTag& InStatTag, const EStatModifierType InType, const float InValue);
+};
+
+//Handle returned when adding a stat modifier which is used to remove it.
+//Handles stay valid until the modifier is removed regardless of other modifiers being added or removed.
+USTRUCT(BlueprintType)
+struct SFCORE_API FStatModifierHandle
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	int32 Id;
+
+	FStatModifierHandle();
+
+	explicit FStatModifierHandle(const int32 InId);
+
+	bool IsValid() const;
+
+	bool operator==(const FStatModifierHandle& Other) const;
+};
+
+FORCEINLINE uint32 GetTypeHash(const FStatModifierHandle& Handle)
+{
+	return GetTypeHash(Handle.Id);
+}
+
+//All modifiers of a single stat along with their running totals, updated as modifiers are added and removed.
+//Doubles are used so repeatedly adding and removing modifiers doesn't drift.
+struct FStatAggregate
+{
+	//Index of the stat in both BaseStats and CurrentStats.
+	int32 StatIndex;
+
+	//Ids and values of the modifiers of each EStatModifierType in the order they were added.
+	//These are used when clamping after each modifier.
+	TArray<TPair<int32, float>> ModifiersByType[4];
+
+	int32 ModifierCount = 0;
+
+	double AdditiveSum = 0;
+
+	double AdditiveMultiplicativeSum = 0;
+
+	//Zero modifiers are counted instead of multiplied in so they can be removed again.
+	double TrueMultiplicativeNonZeroProduct = 1;
+
+	int32 TrueMultiplicativeZeroCount = 0;
+
+	double FlatAdditiveSum = 0;
+
+	//Sums of the negative and of the positive modifiers of each summed type, which bound their partial sums.
+	double NegativeSums[4] = {};
+
+	double PositiveSums[4] = {};
+
+	//Bounds the partial products of non-negative TrueMultiplicative modifiers.
+	double TrueMultiplicativeAboveOneProduct = 1;
+
+	int32 TrueMultiplicativeNegativeCount = 0;
+
+	explicit FStatAggregate(const int32 InStatIndex);
+
+	//Whether clamping after each modifier can give a different value than clamping the totals of each type.
+	bool CanClampBeforeTotals(const double InBaseValue, const double InMaxValue) const;
+
+	void AddModifier(const int32 InId, const FStatModifier& InModifier);
+
+	void RemoveModifier(const int32 InId, const FStatModifier& InModifier);
+};
+
 DECLARE_DYNAMIC_MULTICAST_DELEGATE(FCurrentStatChangeDelegate);
 
 /**
@@ -102,10 +190,15 @@ DECLARE_DYNAMIC_MULTICAST_DELEGATE(FCurrentStatChangeDelegate);
  *
  * We combine each Stat in this deterministic order, only Stats with the same StatTag will be considered:
  * - Start with value found in BaseStats.
- * - Add values found in AdditiveStatModifiers to base value.
- * - Sum AdditiveMultiplicativeStatModifiers together, +1, and multiply with the previous value.
- * - Multiply by the values in TrueMultiplicativeStatModifiers.
- * - Add values in FlatStatModifiers.
+ * - Add the sum of Additive modifiers to base value.
+ * - Sum AdditiveMultiplicative modifiers together, +1, and multiply with the previous value.
+ * - Multiply by the product of TrueMultiplicative modifiers.
+ * - Add the sum of FlatAdditive modifiers.
+ * The value is clamped after each modifier. Stats whose modifiers can't reach a clamp are calculated from the totals of
+ * each type in constant time, while the rest walk their modifiers. If bClampModifierTotals is set the value is instead
+ * clamped after each step, which makes calculating every stat constant time but can give different results when a
+ * clamp is hit. Modifiers are kept per stat either way, so calculating a stat never looks at the modifiers of other
+ * stats.
  *
  * The way these stat numbers are uses is up to the user. But the recommendation is that normal stats (eg. max health) uses
  * the values as is while percentage stats (eg. percentage damage taken) is expressed as a decimal (100% = 1), also that
@@ -116,6 +209,8 @@ UCLASS(ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
 class SFCORE_API UFormStatComponent : public UActorComponent
 {
 	GENERATED_BODY()
+
+	friend struct FSfTestAccess;
 	
 public:
 	UFormStatComponent();
@@ -126,18 +221,36 @@ public:
 
 	//The user should clean up stat modifiers after use.
 	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly)
-	virtual const FStat& Server_AddStatModifier(const FGameplayTag InStatTag, const EStatModifierType InType, const float InValue);
+	virtual FStat Server_AddStatModifier(const FGameplayTag InStatTag, const EStatModifierType InType, const float InValue);
 
 	//The user should clean up stat modifiers after use.
 	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly)
 	virtual TArray<FStat> Server_AddStatModifierBatch(const TArray<FStat> InStats, const EStatModifierType InType);
 
+	//Removes the first added modifier of the type with the same tag and value.
 	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly)
 	virtual bool Server_RemoveStatModifier(const FStat& InModifier, const EStatModifierType InType);
 
 	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly)
 	virtual bool Server_RemoveStatModifierBatch(TArray<FStat> InModifiers, const EStatModifierType InType);
 
+	//The user should clean up stat modifiers after use.
+	//The returned handle removes exactly this modifier even if identical ones exist.
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly)
+	virtual FStatModifierHandle Server_AddStatModifierWithHandle(const FGameplayTag InStatTag, const EStatModifierType InType, const float InValue);
+
+	//The user should clean up stat modifiers after use.
+	//Each affected stat is only recalculated once.
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly)
+	virtual TArray<FStatModifierHandle> Server_AddStatModifierBatchWithHandles(const TArray<FStat>& InStats, const EStatModifierType InType);
+
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly)
+	virtual bool Server_RemoveStatModifierByHandle(const FStatModifierHandle& InHandle);
+
+	//Each affected stat is only recalculated once.
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly)
+	virtual bool Server_RemoveStatModifierBatchByHandles(const TArray<FStatModifierHandle>& InHandles);
+
 	//Add BP functions to update UI when stats change.
 	UPROPERTY(BlueprintAssignable)
 	FCurrentStatChangeDelegate OnClientStatsChange;
@@ -158,19 +271,32 @@ protected:
 	UPROPERTY(BlueprintReadOnly, EditAnywhere)
 	TArray<FStat> BaseStats;
 
-	UPROPERTY(BlueprintReadOnly, VisibleAnywhere)
-	TArray<FStat> AdditiveStatModifiers;
-
-	UPROPERTY(BlueprintReadOnly, VisibleAnywhere)
-	TArray<FStat> AdditiveMultiplicativeStatModifiers;
-
-	UPROPERTY(BlueprintReadOnly, VisibleAnywhere)
-	TArray<FStat> TrueMultiplicativeStatModifiers;
+	//Clamps after each modifier type instead of after each modifier, so stat calculation doesn't scale with the number
+	//of modifiers even when a clamp can be hit. This changes results whenever an intermediate value would have been
+	//clamped.
+	UPROPERTY(BlueprintReadOnly, EditAnywhere)
+	bool bClampModifierTotals = false;
 
+	//Modifiers by handle id.
 	UPROPERTY(BlueprintReadOnly, VisibleAnywhere)
-	TArray<FStat> FlatAdditiveStatModifiers;
+	TMap<int32, FStatModifier> StatModifiers;
 
 	//Current stats will always be positive.
 	UPROPERTY(BlueprintReadOnly, VisibleAnywhere, Replicated)
 	FStatArray CurrentStats;
+
+private:
+	//Only contains stats that exist in BaseStats.
+	TMap<FGameplayTag, FStatAggregate> StatAggregates;
+
+	int32 LastStatModifierId = 0;
+
+	//Adds the modifier without recalculating the stat.
+	FStatModifierHandle InternalAddStatModifier(const FGameplayTag& InStatTag, const EStatModifierType InType, const float InValue);
+
+	//Removes the modifier without recalculating the stat.
+	bool InternalRemoveStatModifier(const FStatModifierHandle& InHandle, FGameplayTag& OutStatTag);
+
+	//Finds the first added modifier of the type with the same tag and value.
+	FStatModifierHandle FindStatModifier(const FStat& InModifier, const EStatModifierType InType) const;
 };
@@ -21,6 +21,85 @@ DECLARE_DYNAMIC_DELEGATE_TwoParams(FOnRemoveSharedCard, UClass*, CardClass, cons
 DECLARE_DYNAMIC_DELEGATE_ThreeParams(FOnAddOwnedCard, UClass*, CardClass, UConstituent*, Owner, const bool, bIsPredictableContext);
 DECLARE_DYNAMIC_DELEGATE_ThreeParams(FOnRemoveOwnedCard, UClass*, CardClass, UConstituent*, Owner, const bool, bIsPredictableContext);
 
+//Entry in the card expiry queues of an inventory.
+//Entries are not removed when their card is, so they are checked against Cards when they are popped.
+struct FCardExpiryEntry
+{
+	float LifetimeEndTimestamp;
+
+	TSubclassOf<UCardObject> Class;
+
+	uint8 OwnerConstituentInstanceId;
+};
+
+//Delegates bound to slotable or card classes.
+//The delegates to call for each concrete class are cached so events don't need to check every binding.
+template <class DelegateType>
+struct TClassDelegateBindings
+{
+	void Bind(UClass* InClass, const DelegateType& InDelegate)
+	{
+		Bindings.FindOrAdd(InClass).Add(InDelegate);
+		Invalidate();
+	}
+
+	bool Unbind(UClass* InClass, const DelegateType& InDelegate)
+	{
+		TSet<DelegateType>* Delegates = Bindings.Find(InClass);
+		if (!Delegates || Delegates->Remove(InDelegate) == 0) return false;
+		if (Delegates->IsEmpty())
+		{
+			Bindings.Remove(InClass);
+		}
+		Invalidate();
+		return true;
+	}
+
+	//Delegates bound to the concrete class or the base class.
+	//The returned array may be invalidated by binding or by looking up another class.
+	const TArray<DelegateType>& GetDispatchList(UClass* InConcreteClass, UClass* InBaseClass)
+	{
+		if (const TArray<DelegateType>* DispatchList = DispatchLists.Find(InConcreteClass))
+		{
+			return *DispatchList;
+		}
+		TArray<DelegateType> DispatchList;
+		AppendBoundDelegates(InBaseClass, DispatchList);
+		if (InConcreteClass != InBaseClass)
+		{
+			AppendBoundDelegates(InConcreteClass, DispatchList);
+		}
+		return DispatchLists.Emplace(InConcreteClass, MoveTemp(DispatchList));
+	}
+
+	//Clears the cached dispatch lists so they are rebuilt from the bindings when next needed.
+	void Invalidate()
+	{
+		DispatchLists.Reset();
+	}
+
+private:
+	void AppendBoundDelegates(UClass* InClass, TArray<DelegateType>& OutDispatchList)
+	{
+		TSet<DelegateType>* Delegates = Bindings.Find(InClass);
+		if (!Delegates) return;
+		for (auto It = Delegates->CreateIterator(); It; ++It)
+		{
+			//Delegates of destroyed objects are removed here rather than in a periodic sweep.
+			if (!It->IsBound())
+			{
+				It.RemoveCurrent();
+				continue;
+			}
+			OutDispatchList.Add(*It);
+		}
+	}
+
+	TMap<UClass*, TSet<DelegateType>> Bindings;
+
+	TMap<UClass*, TArray<DelegateType>> DispatchLists;
+};
+
 /**
  * Inventories of slotables.
  * These can be dynamic or static, in terms of how many slotables they can contain.
@@ -32,7 +111,9 @@ class SFCORE_API UInventory : public USfObject
 	GENERATED_BODY()
 
 	friend class UFormCharacterComponent;
+	friend class UFormCoreComponent;
 	friend struct FBufferedInput;
+	friend struct FSfTestAccess;
 
 public:
 	UInventory();
@@ -141,6 +222,8 @@ public:
 
 	void SetupInputs(const UFormCharacterComponent* FormCharacterComponent);
 
+	void MarkConstituentTableDirty() const;
+
 	UFUNCTION(BlueprintImplementableEvent)
 	void Autonomous_Initialize();
 
@@ -159,6 +242,9 @@ public:
 
 	void RemoveCardsOfOwner(const int32 InOwnerConstituentInstanceId);
 
+	//Only removes cards that use predicted timestamps.
+	void RemovePredictedCardsWithEndedLifetimes(const UFormCharacterComponent* FormCharacter);
+
 	bool IsDynamicLength() const;
 
 	TArray<const FCard*> GetCardsOfClass(const TSubclassOf<UCardObject>& InClass) const;
@@ -193,6 +279,24 @@ public:
 	UFUNCTION(BlueprintCallable)
 	void BindOnRemoveOwnedCard(const TSubclassOf<UCardObject>& InCardClass, const FOnRemoveOwnedCard& EventToBind);
 
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly)
+	void Server_UnbindOnAddSlotable(const TSubclassOf<USlotable>& InSlotableClass, const FOnAddSlotable& EventToUnbind);
+
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly)
+	void Server_UnbindOnRemoveSlotable(const TSubclassOf<USlotable>& InSlotableClass, const FOnRemoveSlotable& EventToUnbind);
+
+	UFUNCTION(BlueprintCallable)
+	void UnbindOnAddSharedCard(const TSubclassOf<UCardObject>& InCardClass, const FOnAddSharedCard& EventToUnbind);
+
+	UFUNCTION(BlueprintCallable)
+	void UnbindOnRemoveSharedCard(const TSubclassOf<UCardObject>& InCardClass, const FOnRemoveSharedCard& EventToUnbind);
+
+	UFUNCTION(BlueprintCallable)
+	void UnbindOnAddOwnedCard(const TSubclassOf<UCardObject>& InCardClass, const FOnAddOwnedCard& EventToUnbind);
+
+	UFUNCTION(BlueprintCallable)
+	void UnbindOnRemoveOwnedCard(const TSubclassOf<UCardObject>& InCardClass, const FOnRemoveOwnedCard& EventToUnbind);
+
 	UFUNCTION(BlueprintCallable)
 	UConstituent* GetConstituentFromInstanceId(uint8 Id);
 
@@ -208,11 +312,6 @@ public:
 
 	void CallBindedOnRemoveOwnedCardDelegates(FCard& Card, const bool bInIsPredictableContext);
 
-	void RemoveEmptyDelegateBindings();
-
-	template<class T>
-	void RemoveEmptyDelegatesFromTSet(TSet<T>& DelegateSet);
-
 	UPROPERTY(BlueprintAssignable)
 	FClientVariableUpdateSignature Client_OnSlotableUpdate;
 
@@ -268,8 +367,15 @@ private:
 
 	TArray<int8> OrderedInputBindingIndices;
 
+	//Input bits that were last applied to this inventory.
+	uint64 LastInputBits = 0;
+
+	//Input state last applied to each slot. Slots without a slotable keep their state.
 	TBitArray<> OrderedLastInputState;
 
+	//Index in the inventories of the owning form core. Set when its constituent table is updated.
+	int32 InventoryIndex = INDEX_NONE;
+
 	//Does not synchronize to owner as owner should have it be predicted.
 	UPROPERTY(Replicated, ReplicatedUsing = OnRep_Cards)
 	TArray<FCard> Cards;
@@ -296,17 +402,81 @@ private:
 
 	float GetCardLifetime(const TSubclassOf<UCardObject>& InCardClass, const int32 InOwnerConstituentInstanceId);
 
-	TMap<TSubclassOf<USlotable>, TSet<FOnAddSlotable>> BindedOnAddSlotableDelegates;
+	//Must be called whenever Cards is replaced wholesale so the card index is rebuilt on the next lookup.
+	//Single adds and removes should go through IndexLastCard and RemoveCardAt instead.
+	//This also bumps CardsVersion.
+	void MarkCardIndexDirty();
+
+	//Must be called whenever a card in Cards changes without being added or removed.
+	void MarkCardsChanged();
+
+	//Adds the last card of Cards to the card index. Must be called after every card appended to Cards.
+	void IndexLastCard();
+
+	//Removes a card like TArray::RemoveAt while keeping the card index in sync.
+	void RemoveCardAt(const int32 InIndex, const bool bInAllowShrinking = true);
+
+	//Removes the cards at the indices in one pass, keeping the order of the rest. Indices may be in any order and
+	//repeat. Removing more than one card marks the card index dirty instead of shifting it once per card.
+	void RemoveCardsAt(const TConstArrayView<int32> InIndices, const bool bInAllowShrinking = true);
+
+	uint32 GetCardsVersion() const;
+
+	//Order independent digest of the identifiers of all cards, which matches FCardIdentifiersInAnInventory::CalculateDigest.
+	uint32 CalculateCardDigest() const;
+
+	void RebuildCardIndex() const;
+
+	//Returns the index of the card in Cards or INDEX_NONE. Cards disabled for destroy are included.
+	int32 FindCardIndex(const TSubclassOf<UCardObject>& InCardClass, const int32 InOwnerConstituentInstanceId) const;
+
+	//Returns nullptr if the card doesn't exist or is disabled for destroy.
+	const FCard* FindEnabledCard(const TSubclassOf<UCardObject>& InCardClass, const int32 InOwnerConstituentInstanceId) const;
+
+	//Lookup tables into Cards so card queries don't have to scan the array.
+	//These are not replicated. They are updated in place on single adds and removes and only rebuilt lazily after Cards
+	//is replaced wholesale. Indices in CardIndicesByClass are kept in ascending order.
+	mutable TMap<TPair<TSubclassOf<UCardObject>, uint8>, int32> CardIndexByClassAndOwner;
+
+	mutable TMap<TSubclassOf<UCardObject>, TArray<int32>> CardIndicesByClass;
+
+	mutable uint8 bCardIndexDirty:1;
+
+	//Changes whenever Cards is changed so packed copies of it are only rebuilt when necessary.
+	//Versions are unique across inventories so a replaced inventory is never mistaken for the old one.
+	uint32 CardsVersion;
+
+	static uint32 LastCardsVersion;
+
+	mutable uint32 CardDigest;
+
+	mutable uint32 CardDigestVersion;
+
+	//Must be called whenever Cards is replaced as a whole, as the expiry queues are otherwise only added to.
+	void MarkCardExpiryQueuesDirty();
+
+	void RebuildCardExpiryQueues();
+
+	void AddCardToExpiryQueue(const FCard& Card);
+
+	//Min-heaps of card lifetime ends so we only need to look at cards that are actually expiring.
+	TArray<FCardExpiryEntry> ServerCardExpiryQueue;
+
+	TArray<FCardExpiryEntry> PredictedCardExpiryQueue;
+
+	uint8 bCardExpiryQueuesDirty:1;
+
+	TClassDelegateBindings<FOnAddSlotable> BindedOnAddSlotableDelegates;
 
-	TMap<TSubclassOf<USlotable>, TSet<FOnRemoveSlotable>> BindedOnRemoveSlotableDelegates;
+	TClassDelegateBindings<FOnRemoveSlotable> BindedOnRemoveSlotableDelegates;
 
-	TMap<TSubclassOf<UCardObject>, TSet<FOnAddSharedCard>> BindedOnAddSharedCardDelegates;
+	TClassDelegateBindings<FOnAddSharedCard> BindedOnAddSharedCardDelegates;
 
-	TMap<TSubclassOf<UCardObject>, TSet<FOnRemoveSharedCard>> BindedOnRemoveSharedCardDelegates;
+	TClassDelegateBindings<FOnRemoveSharedCard> BindedOnRemoveSharedCardDelegates;
 
-	TMap<TSubclassOf<UCardObject>, TSet<FOnAddOwnedCard>> BindedOnAddOwnedCardDelegates;
+	TClassDelegateBindings<FOnAddOwnedCard> BindedOnAddOwnedCardDelegates;
 
-	TMap<TSubclassOf<UCardObject>, TSet<FOnRemoveOwnedCard>> BindedOnRemoveOwnedCardDelegates;
+	TClassDelegateBindings<FOnRemoveOwnedCard> BindedOnRemoveOwnedCardDelegates;
 
 	float LocalInventoryTime;
 };
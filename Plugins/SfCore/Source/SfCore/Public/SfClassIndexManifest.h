@@ -0,0 +1,132 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DeveloperSettings.h"
+#include "SfClassIndexManifest.generated.h"
+
+//Deterministic indices for a set of classes so they can be net serialized as an integer.
+//Classes are only loaded when they are first resolved from an index.
+struct SFCORE_API FSfClassIndex
+{
+	void Build(const TArray<FSoftClassPath>& InSortedClassPaths);
+
+	//Returns INDEX_NONE if the class is not indexed.
+	int32 FindIndex(const UClass* InClass) const;
+
+	//Returns nullptr if the index is out of range or the class could not be loaded.
+	UClass* GetClass(const int32 InIndex) const;
+
+	int32 Num() const;
+
+private:
+	TArray<FSoftClassPath> ClassPaths;
+
+	TMap<FTopLevelAssetPath, int32> IndicesByClassPath;
+
+	mutable TArray<TWeakObjectPtr<UClass>> ResolvedClasses;
+};
+
+//Quantization of a param property, resolved from its metadata. See FSfParamSerializer.
+USTRUCT()
+struct SFCORE_API FSfParamQuantizationRule
+{
+	GENERATED_BODY()
+
+	UPROPERTY(VisibleAnywhere)
+	FTopLevelAssetPath Struct;
+
+	UPROPERTY(VisibleAnywhere)
+	FName Property;
+
+	UPROPERTY(VisibleAnywhere)
+	double Min = 0;
+
+	UPROPERTY(VisibleAnywhere)
+	double Max = 0;
+
+	//0 if not set.
+	UPROPERTY(VisibleAnywhere)
+	double Step = 0;
+
+	//0 if not set.
+	UPROPERTY(VisibleAnywhere)
+	int32 Bits = 0;
+
+	//Min and Max are only used if this is true.
+	bool HasRange() const;
+};
+
+/**
+ * Manifest of the classes that SF indexes for net serialization (card objects and health change processors).
+ * This is generated by the editor when blueprints are saved or assets change and when cooking, and is stored in
+ * DefaultGame.ini so it ships with the build. It is loaded once the engine has initialized, so no asset scan or loading
+ * of every blueprint class is needed at runtime.
+ * Quantization of action params is also resolved into the manifest as it changes their net serialization.
+ * The hash of the manifest is combined into the network version, so clients with a different class index are rejected
+ * during the net handshake instead of misreading class indices.
+ */
+UCLASS(config = Game, defaultconfig, meta = (DisplayName = "Sf Class Index Manifest"))
+class SFCORE_API USfClassIndexManifest : public UDeveloperSettings
+{
+	GENERATED_BODY()
+
+	friend struct FSfTestAccess;
+
+public:
+	//Increment when the way the manifest is generated or hashed changes.
+	static constexpr int32 CurrentVersion = 2;
+
+	//0 if the manifest has never been generated.
+	UPROPERTY(config, VisibleAnywhere, Category = "Class Index")
+	int32 Version = 0;
+
+	UPROPERTY(config, VisibleAnywhere, Category = "Class Index")
+	uint32 Hash = 0;
+
+	//Sorted by path name descending.
+	UPROPERTY(config, VisibleAnywhere, Category = "Class Index")
+	TArray<FSoftClassPath> CardObjectClasses;
+
+	//Sorted by path name descending.
+	UPROPERTY(config, VisibleAnywhere, Category = "Class Index")
+	TArray<FSoftClassPath> HealthChangeProcessorClasses;
+
+	//Sorted by struct and property.
+	UPROPERTY(config, VisibleAnywhere, Category = "Class Index")
+	TArray<FSfParamQuantizationRule> ParamQuantizationRules;
+
+	static uint32 CalculateHash(const int32 InVersion, const TArray<FSoftClassPath>& InCardObjectClasses,
+	                            const TArray<FSoftClassPath>& InHealthChangeProcessorClasses,
+	                            const TArray<FSfParamQuantizationRule>& InParamQuantizationRules);
+
+	//Builds the class indices from the manifest. Falls back to scanning for classes if the manifest is missing or invalid.
+	static void Initialize();
+
+	static const FSfClassIndex& GetCardObjectClassIndex();
+
+	static const FSfClassIndex& GetHealthChangeProcessorClassIndex();
+
+	static uint32 GetLoadedHash();
+
+	//Returns nullptr if the property is not quantized.
+	static const FSfParamQuantizationRule* FindParamQuantizationRule(const UStruct* InStruct, const FName InProperty);
+
+#if WITH_EDITOR
+	//Collects the classes from the asset registry without loading blueprints, and saves the manifest if it changed.
+	static void RegenerateAndSave();
+#endif
+
+private:
+	inline static FSfClassIndex CardObjectClassIndex = FSfClassIndex();
+
+	inline static FSfClassIndex HealthChangeProcessorClassIndex = FSfClassIndex();
+
+	inline static TMap<TPair<FTopLevelAssetPath, FName>, FSfParamQuantizationRule> ParamQuantizationRulesByProperty =
+		TMap<TPair<FTopLevelAssetPath, FName>, FSfParamQuantizationRule>();
+
+	inline static uint32 LoadedHash = 0;
+
+	inline static bool bInitialized = false;
+};
@@ -0,0 +1,28 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UCurveFloat;
+
+/**
+ * Evaluates float curves from lookup tables that are baked once per curve instead of searching the keys of the
+ * rich curve every time.
+ * Tables cover the time range of the keys at a fixed resolution and are interpolated linearly. Times outside the
+ * range and curves that can't be represented by a table (such as ones with stepped keys) use the rich curve.
+ * Tables also hold a hash of the curve's path so curves can be identified the same way on every machine.
+ */
+struct SFCORE_API FSfCurveTable
+{
+	//Number of samples in each table.
+	static constexpr int32 NumSamples = 256;
+
+	static float Evaluate(const UCurveFloat* InCurve, const float InTime);
+
+	//Stable across machines, unlike the address or name index of the curve.
+	static uint32 GetCurveHash(const UCurveFloat* InCurve);
+
+	//Tables are rebaked when next used.
+	static void ClearCache();
+};
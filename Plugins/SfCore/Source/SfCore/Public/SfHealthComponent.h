@@ -210,9 +210,4 @@ protected:
 
 	UPROPERTY()
 	UFormStatComponent* FormStat;
-
-private:
-	inline static TArray<UClass*> AllHealthChangeProcessorClassesSortedByName = TArray<UClass*>();
-
-	inline static bool HealthChangeProcessorClassesFetched = false;
 };
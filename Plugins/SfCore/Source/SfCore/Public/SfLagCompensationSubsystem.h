@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "SfLagCompensationSubsystem.generated.h"
+
+/**
+ * Records the transforms of all forms on the server each tick for lag compensated hit registration.
+ * History is stored as columns (one shared timestamp column, and location and rotation columns with a row per frame)
+ * so recording is a linear write and rewinds are a binary search on the timestamps.
+ * Forms are registered by their FormCoreComponent and referred to by slot.
+ */
+UCLASS()
+class SFCORE_API USfLagCompensationSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Tick(float DeltaTime) override;
+
+	virtual TStatId GetStatId() const override;
+
+	//Returns the slot of the form which should be used for all other calls.
+	int32 Server_RegisterForm(AActor* InForm, const uint32 InServerTickRate);
+
+	void Server_UnregisterForm(const int32 InSlot);
+
+	//Moves the form to where it most likely was on the client at the timestamp. False if the timestamp is not in history.
+	bool Server_RewindForm(const int32 InSlot, const float InServerTimestamp);
+
+	//Only moves the forms in the given slots. Returns the number of forms that were rewound.
+	int32 Server_RewindForms(const TConstArrayView<int32> InSlots, const float InServerTimestamp);
+
+	//Must be called after rewinding to bring forms back to current time.
+	void Server_RestoreForm(const int32 InSlot);
+
+	void Server_RestoreForms(const TConstArrayView<int32> InSlots);
+
+	void Server_RestoreAllForms();
+
+	//Length of the history kept.
+	static constexpr float HistorySeconds = 1.f;
+
+private:
+	struct FFormSlot
+	{
+		TWeakObjectPtr<AActor> Form;
+
+		//Remote positions are interpolated, so they are on average half a server tick behind the timestamp.
+		float InterpolationDelay = 0;
+
+		//Frames recorded before this are from a previous form in the slot.
+		uint64 FirstRecordedFrame = 0;
+
+		FTransform RestoreTransform;
+
+		bool bIsRewound = false;
+	};
+
+	void Resize(const int32 InFrameCapacity, const int32 InSlotCapacity);
+
+	int32 GetFrameRow(const int32 InFrameIndex) const;
+
+	bool FindInterpolatedTransform(const int32 InSlot, const float InServerTimestamp, FVector& OutLocation,
+	                               FQuat& OutRotation) const;
+
+	TArray<FFormSlot> Slots;
+
+	TArray<int32> FreeSlots;
+
+	TArray<int32> RewoundSlots;
+
+	//Timestamp of each row.
+	TArray<float> FrameTimestamps;
+
+	//FrameCapacity * SlotCapacity, indexed by row * SlotCapacity + slot.
+	TArray<FVector> Locations;
+
+	TArray<FQuat> Rotations;
+
+	int32 FrameCapacity = 0;
+
+	int32 SlotCapacity = 0;
+
+	//Row of the oldest frame.
+	int32 OldestFrameRow = 0;
+
+	int32 NumFrames = 0;
+
+	uint64 TotalFramesRecorded = 0;
+};
@@ -0,0 +1,25 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Serializes action params with a plan that is compiled once per struct type instead of walking properties by
+ * reflection every time.
+ * Values are packed by type (bools are 1 bit, enums use only the bits needed for their values, larger integers
+ * are packed by magnitude).
+ * Numeric properties on native structs can be quantized with metadata:
+ * - SfBits: Number of bits for an integer, or for a float when used with ClampMin and ClampMax.
+ * - SfQuantize: Packs an integer into the range of ClampMin and ClampMax.
+ * - SfQuantizationStep: Packs a float into the range of ClampMin and ClampMax in steps of this size.
+ * Metadata isn't available in cooked builds, so it is resolved into the USfClassIndexManifest by the editor.
+ */
+struct SFCORE_API FSfParamSerializer
+{
+	//Does both serialization and deserialization based on archive direction.
+	static void SerializeStruct(const UScriptStruct* Struct, void* StructPtr, FArchive& Ar);
+
+	//Plans are recompiled when next used.
+	static void ClearCache();
+};
@@ -62,6 +62,25 @@ TMap<T, TSet<T*>> TArrayGroupEquivalentElements(TArray<T>& Array)
 	return SignatureGroupPairs;
 }
 
+//Copies without giving up the allocation of Dest, unlike assignment which reallocates whenever the sizes differ.
+template <class T>
+void TArrayCopyKeepAllocation(TArray<T>& Dest, const TArray<T>& Source)
+{
+	Dest.Reset(Source.Num());
+	Dest.Append(Source);
+}
+
+//Same as above for arrays of structs that wrap an array, where the inner allocations are also kept.
+template <class T, class U>
+void TArrayCopyKeepAllocation(TArray<T>& Dest, const TArray<T>& Source, TArray<U> T::* InnerArray)
+{
+	Dest.SetNum(Source.Num(), false);
+	for (int32 i = 0; i < Source.Num(); i++)
+	{
+		TArrayCopyKeepAllocation(Dest[i].*InnerArray, Source[i].*InnerArray);
+	}
+}
+
 template <class T, class F>
 bool TArrayCheckDuplicate(const TArray<T>& Array, F&& Predicate)
 {
@@ -21,6 +21,8 @@ class SFCORE_API USlotable : public USfObject
 {
 	GENERATED_BODY()
 
+	friend struct FSfTestAccess;
+
 public:
 
 	USlotable();
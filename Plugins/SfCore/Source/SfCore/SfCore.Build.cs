@@ -6,6 +6,7 @@ public class SfCore : ModuleRules
 {
 	public SfCore(ReadOnlyTargetRules Target) : base(Target)
 	{
-		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "NetCore", "EnhancedInput", "GameplayTags" });
+		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "NetCore", "EnhancedInput", "GameplayTags", "DeveloperSettings" });
+		PrivateDependencyModuleNames.AddRange(new string[] { "AssetRegistry" });
 	}
 }
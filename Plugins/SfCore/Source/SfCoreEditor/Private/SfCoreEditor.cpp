@@ -1,4 +1,100 @@
 ﻿#include "CoreMinimal.h"
+#include "CardObject.h"
+#include "SfClassIndexManifest.h"
+#include "SfHealthComponent.h"
+#include "AssetRegistry/IAssetRegistry.h"
+#include "Engine/Blueprint.h"
+#include "Misc/CoreDelegates.h"
 #include "Modules/ModuleManager.h"
+#include "UObject/ObjectSaveContext.h"
 
-IMPLEMENT_MODULE(FDefaultModuleImpl, SfCoreEditor);
\ No newline at end of file
+//Keeps the class index manifest up to date with the card object and health change processor classes in the project.
+class FSfCoreEditorModule : public FDefaultModuleImpl
+{
+public:
+	virtual void StartupModule() override
+	{
+		PostEngineInitHandle = FCoreDelegates::OnPostEngineInit.AddRaw(this, &FSfCoreEditorModule::OnPostEngineInit);
+		PackageSavedHandle = UPackage::PackageSavedWithContextEvent.AddRaw(this, &FSfCoreEditorModule::OnPackageSaved);
+	}
+
+	virtual void ShutdownModule() override
+	{
+		FCoreDelegates::OnPostEngineInit.Remove(PostEngineInitHandle);
+		UPackage::PackageSavedWithContextEvent.Remove(PackageSavedHandle);
+		if (IAssetRegistry* AssetRegistry = IAssetRegistry::Get())
+		{
+			AssetRegistry->OnFilesLoaded().Remove(FilesLoadedHandle);
+			AssetRegistry->OnAssetRemoved().Remove(AssetRemovedHandle);
+			AssetRegistry->OnAssetRenamed().Remove(AssetRenamedHandle);
+		}
+	}
+
+private:
+	void OnPostEngineInit()
+	{
+		IAssetRegistry& AssetRegistry = IAssetRegistry::GetChecked();
+		if (IsRunningCookCommandlet())
+		{
+			//The cook needs every class in the manifest before anything is staged.
+			AssetRegistry.SearchAllAssets(true);
+			USfClassIndexManifest::RegenerateAndSave();
+			return;
+		}
+		if (AssetRegistry.IsLoadingAssets())
+		{
+			FilesLoadedHandle = AssetRegistry.OnFilesLoaded().AddStatic(&USfClassIndexManifest::RegenerateAndSave);
+		}
+		else
+		{
+			USfClassIndexManifest::RegenerateAndSave();
+		}
+		AssetRemovedHandle = AssetRegistry.OnAssetRemoved().AddRaw(this, &FSfCoreEditorModule::OnAssetRemoved);
+		AssetRenamedHandle = AssetRegistry.OnAssetRenamed().AddRaw(this, &FSfCoreEditorModule::OnAssetRenamed);
+	}
+
+	void OnPackageSaved(const FString& PackageFileName, UPackage* Package, FObjectPostSaveContext SaveContext)
+	{
+		if (SaveContext.IsProceduralSave() || !Package) return;
+		const UBlueprint* Blueprint = FindObject<UBlueprint>(Package, *FPackageName::GetShortName(Package));
+		if (IsIndexedBlueprint(Blueprint))
+		{
+			USfClassIndexManifest::RegenerateAndSave();
+		}
+	}
+
+	void OnAssetRemoved(const FAssetData& AssetData)
+	{
+		if (IsIndexedBlueprint(Cast<UBlueprint>(AssetData.FastGetAsset(false))))
+		{
+			USfClassIndexManifest::RegenerateAndSave();
+		}
+	}
+
+	void OnAssetRenamed(const FAssetData& AssetData, const FString& OldObjectPath)
+	{
+		if (IsIndexedBlueprint(Cast<UBlueprint>(AssetData.FastGetAsset(false))))
+		{
+			USfClassIndexManifest::RegenerateAndSave();
+		}
+	}
+
+	static bool IsIndexedBlueprint(const UBlueprint* Blueprint)
+	{
+		if (!Blueprint || !Blueprint->GeneratedClass) return false;
+		return Blueprint->GeneratedClass->IsChildOf(UCardObject::StaticClass()) || Blueprint->GeneratedClass->IsChildOf(
+			UHealthChangeProcessor::StaticClass());
+	}
+
+	FDelegateHandle PostEngineInitHandle;
+
+	FDelegateHandle PackageSavedHandle;
+
+	FDelegateHandle FilesLoadedHandle;
+
+	FDelegateHandle AssetRemovedHandle;
+
+	FDelegateHandle AssetRenamedHandle;
+};
+
+IMPLEMENT_MODULE(FSfCoreEditorModule, SfCoreEditor);
@@ -34,7 +34,8 @@ public class SfCoreEditor : ModuleRules
                 "Sequencer",
                 "DetailCustomizations",
                 "Settings",
-                "RenderCore"
+                "RenderCore",
+                "AssetRegistry"
             }
         );
     }
@@ -6,6 +6,8 @@
 #include "FormAnimComponent.h"
 #include "FormCharacterComponent.h"
 #include "FormCoreComponent.h"
+#include "SfLagCompensationSubsystem.h"
+#include "WorldCollision.h"
 
 DEFINE_LOG_CATEGORY(LogSfTargeting);
 
@@ -22,15 +24,7 @@ bool USfTargetingLibrary::Predicted_SfMultiLineTrace(UConstituent* Target, const
 
 	if (!Target->GetOwner()->HasAuthority()) return false;
 
-	const float CurrentServerWorldTime = Target->GetWorld()->TimeSeconds;
-
-	float ClientSubmittedWorldTime = Target->GetFormCoreComponent()->FormCharacter->GetServerWorldTimeOnClient();
-
-	//Reject if client time is in the future or if their ping is too high.
-	if (ClientSubmittedWorldTime > CurrentServerWorldTime || ClientSubmittedWorldTime + MaxCompensationTimeSeconds < CurrentServerWorldTime)
-	{
-		ClientSubmittedWorldTime = CurrentServerWorldTime;
-	}
+	const float ClientSubmittedWorldTime = GetCompensatedWorldTime(Target);
 
 	//Run sphere trace to determine what actors can be hit considering compensation.
 	TArray<FHitResult> TargetsWithinCompensationRange;
@@ -55,15 +49,7 @@ bool USfTargetingLibrary::Predicted_SfLineTrace(UConstituent* Target, const FVec
 
 	if (!Target->GetOwner()->HasAuthority()) return false;
 
-	const float CurrentServerWorldTime = Target->GetWorld()->TimeSeconds;
-
-	float ClientSubmittedWorldTime = Target->GetFormCoreComponent()->FormCharacter->GetServerWorldTimeOnClient();
-
-	//Reject if client time is in the future or if their ping is too high.
-	if (ClientSubmittedWorldTime > CurrentServerWorldTime || ClientSubmittedWorldTime + MaxCompensationTimeSeconds < CurrentServerWorldTime)
-	{
-		ClientSubmittedWorldTime = CurrentServerWorldTime;
-	}
+	const float ClientSubmittedWorldTime = GetCompensatedWorldTime(Target);
 
 	//Run sphere trace to determine what actors can be hit considering compensation.
 	TArray<FHitResult> TargetsWithinCompensationRange;
@@ -79,36 +65,142 @@ bool USfTargetingLibrary::Predicted_SfLineTrace(UConstituent* Target, const FVec
 	return RetVal;
 }
 
-void USfTargetingLibrary::RollbackPotentialTargets(const float InClientSubmittedWorldTime, TArray<FHitResult>& TargetsWithinCompensationRange)
+bool USfTargetingLibrary::Predicted_SfBatchLineTrace(UConstituent* Target, const TArray<FSfTraceRay>& Rays,
+                                                     ETraceTypeQuery BlockingTraceChannel,
+                                                     ETraceTypeQuery NonBlockingTraceChannel, bool bTraceComplex,
+                                                     const TArray<AActor*>& ActorsToIgnore,
+                                                     EDrawDebugTrace::Type DrawDebugType, TArray<FHitResult>& OutHits,
+                                                     bool bIgnoreSelf, float MaxCompensationRadius,
+                                                     FLinearColor TraceColor, FLinearColor TraceHitColor,
+                                                     float DrawTime)
 {
-	//Rollback potential targets to world time indicated by the client.
-	for (FHitResult& PotentialTarget : TargetsWithinCompensationRange)
+	//This is marked Predicted even though it only has server logic to indicate that it should be client input driven and requires a form character.
+
+	OutHits.Reset();
+	if (!Target->GetOwner()->HasAuthority() || Rays.Num() == 0) return false;
+
+	const float ClientSubmittedWorldTime = GetCompensatedWorldTime(Target);
+
+	//Run a sphere trace along each ray like Predicted_SfLineTrace to determine what forms can be hit considering
+	//compensation. Overlapping the bounds of all rays instead would gather every form between the rays when they spread.
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(SfBatchLineTrace), bTraceComplex);
+	Params.AddIgnoredActors(ActorsToIgnore);
+	//The shooter's own form should not be gathered and rewound.
+	if (bIgnoreSelf)
+	{
+		Params.AddIgnoredActor(Target->GetOwner());
+	}
+	const ECollisionChannel CompensationChannel = UEngineTypes::ConvertToCollisionChannel(NonBlockingTraceChannel);
+	const FCollisionShape CompensationShape = FCollisionShape::MakeSphere(MaxCompensationRadius);
+	TArray<FHitResult> TargetsWithinCompensationRange;
+	TArray<UFormCoreComponent*> FormsWithinCompensationRange;
+	for (const FSfTraceRay& Ray : Rays)
 	{
-		AActor* Actor = PotentialTarget.GetActor();
-		if (UFormCoreComponent* FormCore = Cast<UFormCoreComponent>(Actor->GetComponentByClass(UFormCoreComponent::StaticClass())))
+		Target->GetWorld()->SweepMultiByChannel(TargetsWithinCompensationRange, Ray.Start, Ray.End, FQuat::Identity,
+		                                        CompensationChannel, CompensationShape, Params);
+		for (const FHitResult& PotentialTarget : TargetsWithinCompensationRange)
 		{
-			FormCore->ServerRollbackLocation(InClientSubmittedWorldTime);
-			if (UFormAnimComponent* AnimComp = UFormAnimComponent::GetFormAnimComponent(FormCore))
+			const AActor* Actor = PotentialTarget.GetActor();
+			if (!Actor) continue;
+			if (UFormCoreComponent* FormCore = Actor->FindComponentByClass<UFormCoreComponent>())
 			{
-				AnimComp->ServerRollbackPose(InClientSubmittedWorldTime);
+				FormsWithinCompensationRange.AddUnique(FormCore);
 			}
 		}
 	}
+
+	RollbackForms(ClientSubmittedWorldTime, FormsWithinCompensationRange);
+
+	//Run the actual line traces.
+	bool RetVal = false;
+	OutHits.SetNum(Rays.Num());
+	for (int32 i = 0; i < Rays.Num(); i++)
+	{
+		RetVal |= UKismetSystemLibrary::LineTraceSingle(Target->GetWorld(), Rays[i].Start, Rays[i].End, BlockingTraceChannel, bTraceComplex, ActorsToIgnore, DrawDebugType, OutHits[i], bIgnoreSelf, TraceColor, TraceHitColor, DrawTime);
+	}
+
+	RestoreForms(FormsWithinCompensationRange);
+
+	return RetVal;
+}
+
+void USfTargetingLibrary::RollbackPotentialTargets(const float InClientSubmittedWorldTime, TArray<FHitResult>& TargetsWithinCompensationRange)
+{
+	TArray<UFormCoreComponent*> Forms;
+	for (FHitResult& PotentialTarget : TargetsWithinCompensationRange)
+	{
+		const AActor* Actor = PotentialTarget.GetActor();
+		if (UFormCoreComponent* FormCore = Actor->FindComponentByClass<UFormCoreComponent>())
+		{
+			Forms.AddUnique(FormCore);
+		}
+	}
+	RollbackForms(InClientSubmittedWorldTime, Forms);
 }
 
 void USfTargetingLibrary::RestorePotentialTargets(TArray<FHitResult>& TargetsWithinCompensationRange)
 {
-	//Return potential targets to original states.
+	TArray<UFormCoreComponent*> Forms;
 	for (FHitResult& PotentialTarget : TargetsWithinCompensationRange)
 	{
 		const AActor* Actor = PotentialTarget.GetActor();
-		if (UFormCoreComponent* FormCore = Cast<UFormCoreComponent>(Actor->GetComponentByClass(UFormCoreComponent::StaticClass())))
+		if (UFormCoreComponent* FormCore = Actor->FindComponentByClass<UFormCoreComponent>())
 		{
-			FormCore->ServerRestoreLatestLocation();
-			if (UFormAnimComponent* AnimComp = UFormAnimComponent::GetFormAnimComponent(FormCore))
-			{
-				AnimComp->ServerRestoreLatestPose();
-			}
+			Forms.AddUnique(FormCore);
 		}
 	}
+	RestoreForms(Forms);
+}
+
+void USfTargetingLibrary::RollbackForms(const float InClientSubmittedWorldTime, const TArray<UFormCoreComponent*>& Forms)
+{
+	if (Forms.Num() == 0) return;
+	//Rollback potential targets to world time indicated by the client.
+	//Locations are rewound together by the world's lag compensation history.
+	TArray<int32, TInlineAllocator<16>> LagCompensationSlots;
+	for (UFormCoreComponent* FormCore : Forms)
+	{
+		LagCompensationSlots.Add(FormCore->GetLagCompensationSlot());
+		if (UFormAnimComponent* AnimComp = UFormAnimComponent::GetFormAnimComponent(FormCore))
+		{
+			AnimComp->ServerRollbackPose(InClientSubmittedWorldTime);
+		}
+	}
+	if (USfLagCompensationSubsystem* LagCompensation = Forms[0]->GetWorld()->GetSubsystem<USfLagCompensationSubsystem>())
+	{
+		LagCompensation->Server_RewindForms(LagCompensationSlots, InClientSubmittedWorldTime);
+	}
+}
+
+void USfTargetingLibrary::RestoreForms(const TArray<UFormCoreComponent*>& Forms)
+{
+	if (Forms.Num() == 0) return;
+	//Return potential targets to original states.
+	TArray<int32, TInlineAllocator<16>> LagCompensationSlots;
+	for (UFormCoreComponent* FormCore : Forms)
+	{
+		LagCompensationSlots.Add(FormCore->GetLagCompensationSlot());
+		if (UFormAnimComponent* AnimComp = UFormAnimComponent::GetFormAnimComponent(FormCore))
+		{
+			AnimComp->ServerRestoreLatestPose();
+		}
+	}
+	if (USfLagCompensationSubsystem* LagCompensation = Forms[0]->GetWorld()->GetSubsystem<USfLagCompensationSubsystem>())
+	{
+		LagCompensation->Server_RestoreForms(LagCompensationSlots);
+	}
+}
+
+float USfTargetingLibrary::GetCompensatedWorldTime(const UConstituent* Target)
+{
+	const float CurrentServerWorldTime = Target->GetWorld()->TimeSeconds;
+
+	float ClientSubmittedWorldTime = Target->GetFormCoreComponent()->FormCharacter->GetServerWorldTimeOnClient();
+
+	//Reject if client time is in the future or if their ping is too high.
+	if (ClientSubmittedWorldTime > CurrentServerWorldTime || ClientSubmittedWorldTime + MaxCompensationTimeSeconds < CurrentServerWorldTime)
+	{
+		ClientSubmittedWorldTime = CurrentServerWorldTime;
+	}
+	return ClientSubmittedWorldTime;
 }
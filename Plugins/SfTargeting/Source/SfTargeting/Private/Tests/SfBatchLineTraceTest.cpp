@@ -0,0 +1,208 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SfLagCompensationSubsystem.h"
+#include "SfTargetingLibrary.h"
+#include "SfTestAccess.h"
+#include "SfTestWorld.h"
+#include "Components/SphereComponent.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSfBatchLineTraceTest, "SfTargeting.BatchLineTrace",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+namespace SfBatchLineTraceTest
+{
+	static constexpr ECollisionChannel BlockingChannel = ECC_Visibility;
+
+	static constexpr ECollisionChannel CompensationChannel = ECC_Camera;
+
+	static constexpr uint32 TickRate = 30;
+
+	static constexpr int32 RecordedFrames = 30;
+
+	//How far behind the server the client saw the forms.
+	static constexpr float ClientDelay = 0.2f;
+
+	//Forms move sideways far enough in the delay that rays aimed at where the client saw them miss where they are now.
+	static constexpr float FormSpeed = 300;
+
+	static constexpr float FormRadius = 40;
+
+	static constexpr float MaxCompensationRadius = 100;
+
+	//A grid of forms in front of the shooter.
+	static constexpr int32 FormRows = 8;
+
+	static constexpr int32 FormColumns = 8;
+
+	static constexpr float FormSpacing = 200;
+
+	static constexpr float FormDistance = 1500;
+
+	//Shotgun pellets spread wide enough that the bounds of all of them cover the whole grid.
+	static constexpr int32 PelletCount = 8;
+
+	static constexpr float PelletSpread = 30;
+
+	static constexpr float PelletRange = 4000;
+
+	static constexpr int32 TimedShots = 100;
+
+	static FVector GetFormLocation(const int32 InForm, const int32 InFrame)
+	{
+		const int32 Row = InForm / FormColumns;
+		const int32 Column = InForm % FormColumns;
+		return FVector(FormDistance + Row * FormSpacing,
+		               (Column - (FormColumns - 1) / 2.f) * FormSpacing + FormSpeed * InFrame / TickRate, 0);
+	}
+
+	//A form that blocks the blocking channel and overlaps the compensation channel, recorded by lag compensation.
+	static AActor* SpawnForm(const FSfTestWorld& InWorld, USfLagCompensationSubsystem* InSubsystem)
+	{
+		AActor* Form = InWorld.SpawnActor<AActor>();
+		USphereComponent* Sphere = NewObject<USphereComponent>(Form);
+		Sphere->InitSphereRadius(FormRadius);
+		Sphere->SetMobility(EComponentMobility::Movable);
+		Sphere->SetCollisionEnabled(ECollisionEnabled::QueryOnly);
+		Sphere->SetCollisionResponseToAllChannels(ECR_Ignore);
+		Sphere->SetCollisionResponseToChannel(BlockingChannel, ECR_Block);
+		Sphere->SetCollisionResponseToChannel(CompensationChannel, ECR_Overlap);
+		Form->SetRootComponent(Sphere);
+		Sphere->RegisterComponent();
+		UFormCoreComponent* FormCore = NewObject<UFormCoreComponent>(Form);
+		FSfTestAccess::LagCompensationSlot(FormCore) = InSubsystem->Server_RegisterForm(Form, TickRate);
+		return Form;
+	}
+
+	//Forms gathered for compensation by sweeping each ray, and by overlapping the bounds of all rays.
+	static TPair<int32, int32> CountGatheredForms(UWorld* InWorld, const TArray<FSfTraceRay>& InRays)
+	{
+		const FCollisionQueryParams Params(SCENE_QUERY_STAT(SfBatchLineTraceTest), false);
+		TSet<const AActor*> SweptForms;
+		TArray<FHitResult> Hits;
+		FBox RayBounds(ForceInit);
+		for (const FSfTraceRay& Ray : InRays)
+		{
+			InWorld->SweepMultiByChannel(Hits, Ray.Start, Ray.End, FQuat::Identity, CompensationChannel,
+			                             FCollisionShape::MakeSphere(MaxCompensationRadius), Params);
+			for (const FHitResult& Hit : Hits)
+			{
+				SweptForms.Add(Hit.GetActor());
+			}
+			RayBounds += Ray.Start;
+			RayBounds += Ray.End;
+		}
+		RayBounds = RayBounds.ExpandBy(MaxCompensationRadius);
+		TArray<FOverlapResult> Overlaps;
+		InWorld->OverlapMultiByChannel(Overlaps, RayBounds.GetCenter(), FQuat::Identity, CompensationChannel,
+		                               FCollisionShape::MakeBox(RayBounds.GetExtent()), Params);
+		return TPair<int32, int32>(SweptForms.Num(), Overlaps.Num());
+	}
+}
+
+bool FSfBatchLineTraceTest::RunTest(const FString& Parameters)
+{
+	using namespace SfBatchLineTraceTest;
+	const FSfTestWorld World;
+	USfLagCompensationSubsystem* Subsystem = World.Get()->GetSubsystem<USfLagCompensationSubsystem>();
+	TArray<AActor*> Forms;
+	for (int32 i = 0; i < FormRows * FormColumns; i++)
+	{
+		Forms.Add(SpawnForm(World, Subsystem));
+	}
+	for (int32 Frame = 0; Frame < RecordedFrames; Frame++)
+	{
+		for (int32 i = 0; i < Forms.Num(); i++)
+		{
+			Forms[i]->SetActorLocation(GetFormLocation(i, Frame));
+		}
+		World.Get()->TimeSeconds = static_cast<double>(Frame) / TickRate;
+		Subsystem->Tick(1.f / TickRate);
+	}
+
+	//A shooter whose client saw the world a bit in the past.
+	UFormCoreComponent* ShooterCore = FSfTestAccess::CreateForm(World.SpawnActor<AActor>());
+	UConstituent* Shooter = FSfTestAccess::AddConstituent(
+		FSfTestAccess::AddSlotable(FSfTestAccess::AddInventory(ShooterCore)), 1);
+	FSfTestAccess::ServerWorldTimeOnClient(ShooterCore->FormCharacter) = static_cast<float>(
+		World.Get()->GetTimeSeconds() - ClientDelay);
+	TArray<FSfTraceRay> Rays;
+	for (int32 i = 0; i < PelletCount; i++)
+	{
+		const float Yaw = FMath::Lerp(-PelletSpread, PelletSpread, static_cast<float>(i) / (PelletCount - 1));
+		Rays.AddDefaulted_GetRef().End = FRotator(0, Yaw, 0).Vector() * PelletRange;
+	}
+	const ETraceTypeQuery BlockingTraceType = UEngineTypes::ConvertToTraceType(BlockingChannel);
+	const ETraceTypeQuery CompensationTraceType = UEngineTypes::ConvertToTraceType(CompensationChannel);
+	const TArray<AActor*> ActorsToIgnore;
+
+	//The batch gives the same hit for each ray as tracing the rays one by one.
+	TArray<FHitResult> BatchHits;
+	const bool bBatchHit = USfTargetingLibrary::Predicted_SfBatchLineTrace(
+		Shooter, Rays, BlockingTraceType, CompensationTraceType, false, ActorsToIgnore, EDrawDebugTrace::None,
+		BatchHits, true, MaxCompensationRadius);
+	TestEqual(TEXT("The batch has a result for each ray"), BatchHits.Num(), Rays.Num());
+	if (BatchHits.Num() != Rays.Num()) return false;
+	bool bAnyHit = false;
+	int32 CompensatedHits = 0;
+	for (int32 i = 0; i < Rays.Num(); i++)
+	{
+		FHitResult Hit;
+		bAnyHit |= USfTargetingLibrary::Predicted_SfLineTrace(Shooter, Rays[i].Start, Rays[i].End, BlockingTraceType,
+		                                                      CompensationTraceType, false, ActorsToIgnore,
+		                                                      EDrawDebugTrace::None, Hit, true, MaxCompensationRadius);
+		TestTrue(FString::Printf(TEXT("Ray %d hits in both"), i), BatchHits[i].bBlockingHit == Hit.bBlockingHit);
+		TestTrue(FString::Printf(TEXT("Ray %d hits the same form in both"), i),
+		         BatchHits[i].GetActor() == Hit.GetActor());
+		TestTrue(FString::Printf(TEXT("Ray %d hits the same point in both"), i),
+		         BatchHits[i].ImpactPoint.Equals(Hit.ImpactPoint, 0.01));
+		//Rays that hit something else where the forms are now only hit because of compensation.
+		FHitResult CurrentHit;
+		UKismetSystemLibrary::LineTraceSingle(World.Get(), Rays[i].Start, Rays[i].End, BlockingTraceType, false,
+		                                      ActorsToIgnore, EDrawDebugTrace::None, CurrentHit, true);
+		CompensatedHits += Hit.bBlockingHit && !CurrentHit.ImpactPoint.Equals(Hit.ImpactPoint, 0.01);
+	}
+	TestTrue(TEXT("The batch hits if any ray does"), bBatchHit == bAnyHit);
+	TestTrue(TEXT("Rays hit where the client saw the forms"), CompensatedHits > 0);
+	for (int32 i = 0; i < Forms.Num(); i++)
+	{
+		TestTrue(FString::Printf(TEXT("Form %d is restored"), i),
+		         Forms[i]->GetActorLocation().Equals(GetFormLocation(i, RecordedFrames - 1), 0.01));
+	}
+
+	//Sweeping each ray only gathers forms near a ray, where the bounds of a wide spread would gather all of them.
+	const TPair<int32, int32> GatheredForms = CountGatheredForms(World.Get(), Rays);
+	TestTrue(TEXT("Sweeping each ray gathers fewer forms than the bounds of all rays"),
+	         GatheredForms.Key < GatheredForms.Value);
+
+	double StartTime = FPlatformTime::Seconds();
+	for (int32 Shot = 0; Shot < TimedShots; Shot++)
+	{
+		for (const FSfTraceRay& Ray : Rays)
+		{
+			FHitResult Hit;
+			USfTargetingLibrary::Predicted_SfLineTrace(Shooter, Ray.Start, Ray.End, BlockingTraceType,
+			                                           CompensationTraceType, false, ActorsToIgnore,
+			                                           EDrawDebugTrace::None, Hit, true, MaxCompensationRadius);
+		}
+	}
+	const double SingleTime = FPlatformTime::Seconds() - StartTime;
+	StartTime = FPlatformTime::Seconds();
+	for (int32 Shot = 0; Shot < TimedShots; Shot++)
+	{
+		USfTargetingLibrary::Predicted_SfBatchLineTrace(Shooter, Rays, BlockingTraceType, CompensationTraceType, false,
+		                                                ActorsToIgnore, EDrawDebugTrace::None, BatchHits, true,
+		                                                MaxCompensationRadius);
+	}
+	const double BatchTime = FPlatformTime::Seconds() - StartTime;
+	AddInfo(FString::Printf(TEXT("%d pellets into %d forms: %.2f us per shot tracing each pellet, %.2f us per shot "
+		                        "batched. %d forms gathered by sweeping each pellet, %d by the bounds of all pellets."),
+	                        PelletCount, Forms.Num(), SingleTime * 1e6 / TimedShots, BatchTime * 1e6 / TimedShots,
+	                        GatheredForms.Key, GatheredForms.Value));
+	return true;
+}
+
+#endif
@@ -10,6 +10,20 @@
 
 DECLARE_LOG_CATEGORY_EXTERN(LogSfTargeting, Log, All);
 
+class UFormCoreComponent;
+
+USTRUCT(BlueprintType)
+struct SFTARGETING_API FSfTraceRay
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FVector Start = FVector::ZeroVector;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FVector End = FVector::ZeroVector;
+};
+
 /**
  * Library for UConstituent targeting functions.
  */
@@ -44,9 +58,31 @@ class SFTARGETING_API USfTargetingLibrary : public UObject
 										   FLinearColor TraceColor = FLinearColor::Red,
 										   FLinearColor TraceHitColor = FLinearColor::Green, float DrawTime = 5.0f);
 	
+	//Single line traces for many rays at the same time that compensate for latency when targeting forms.
+	//Forms in range of each ray are gathered and rewound once for all rays, which is cheaper than calling
+	//Predicted_SfLineTrace for each ray (eg. shotgun pellets).
+	//OutHits has a result for each ray in the same order. Returns true if any ray hit.
+	//This does not return values on the client.
+	//Results match individual traces as long as forms don't move more than MaxCompensationRadius in the compensated time.
+	UFUNCTION(BlueprintCallable, meta = (DefaultToSelf = "Target", bIgnoreSelf= "true", AutoCreateRefTerm = "ActorsToIgnore", AdvancedDisplay= "TraceColor, TraceHitColor, DrawTime"))
+	static bool Predicted_SfBatchLineTrace(UConstituent* Target, const TArray<FSfTraceRay>& Rays,
+	                                       ETraceTypeQuery BlockingTraceChannel, ETraceTypeQuery NonBlockingTraceChannel, bool bTraceComplex,
+	                                       const TArray<AActor*>& ActorsToIgnore, EDrawDebugTrace::Type DrawDebugType,
+	                                       TArray<FHitResult>& OutHits, bool bIgnoreSelf, float MaxCompensationRadius,
+	                                       FLinearColor TraceColor = FLinearColor::Red,
+	                                       FLinearColor TraceHitColor = FLinearColor::Green, float DrawTime = 5.0f);
+
 	static void RollbackPotentialTargets(const float InClientSubmittedWorldTime, TArray<FHitResult>& TargetsWithinCompensationRange);
 
 	static void RestorePotentialTargets(TArray<FHitResult>& TargetsWithinCompensationRange);
+
+	//Rewinds each form and its pose once.
+	static void RollbackForms(const float InClientSubmittedWorldTime, const TArray<UFormCoreComponent*>& Forms);
+
+	static void RestoreForms(const TArray<UFormCoreComponent*>& Forms);
+
+	//Gets the time the client saw the world at, or the current time if it can't be compensated.
+	static float GetCompensatedWorldTime(const UConstituent* Target);
 	
 	static constexpr float MaxCompensationTimeSeconds = 0.25;
 };
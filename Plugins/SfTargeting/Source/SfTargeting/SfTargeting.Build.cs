@@ -1,5 +1,6 @@
 ﻿// Copyright Epic Games, Inc. All Rights Reserved.
 
+using System.IO;
 using UnrealBuildTool;
 
 public class SfTargeting : ModuleRules
@@ -7,5 +8,9 @@ public class SfTargeting : ModuleRules
 	public SfTargeting(ReadOnlyTargetRules Target) : base(Target)
 	{
 		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "NetCore", "GameplayTags", "SfCore", "SfAudiovisual"});
+
+		//Tests use the test world and test access of SfCore, which only exist in its private test folder.
+		PrivateIncludePaths.Add(Path.Combine(ModuleDirectory, "..", "..", "..", "SfCore", "Source", "SfCore", "Private",
+			"Tests"));
 	}
 }
\ No newline at end of file